@@ -0,0 +1,273 @@
+#include "BatchRenderer.h"
+
+#include "Local.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+using namespace PixelMachine::GPU;
+using namespace PixelMachine::Capture;
+
+namespace PixelMachine {
+	namespace App {
+
+		// Jobs whose frames may still be outstanding before the renderer waits for the oldest one
+		static constexpr uint32_t s_maxJobsInFlight = 3u;
+
+		static const float s_triangleData3D[] = {
+			0.0,-0.5, 0.0, // pos
+			1.0, 0.5, 0.5, // color
+
+			0.5, 0.5, 0.0, // pos
+			0.1, 1.0, 0.4, // color
+
+		   -0.5, 0.5, 0.0, // pos
+			0.0, 0.0, 1.0  // color
+		};
+
+		static const float s_triangleData2D[] = {
+		   -0.5,-0.5,	   // pos
+			1.0, 0.1, 0.1, // color
+
+			0.5,-0.5,      // pos
+			0.1, 1.0, 0.1, // color
+
+			0.0, 0.5,      // pos
+			0.1, 0.1, 1.0  // color
+		};
+
+		static const float s_invertedData3D[] = {
+			0.0, 0.5, 0.0, // pos
+			0.2, 0.2, 0.9, // color
+
+		   -0.5,-0.5, 0.0, // pos
+			0.9, 0.8, 0.1, // color
+
+			0.5,-0.5, 0.0, // pos
+			0.1, 0.9, 0.9  // color
+		};
+
+		bool LoadBatchManifest(const std::string &path, std::vector<BatchJob> &outJobs) {
+
+			std::ifstream file(path);
+
+			if (!file.is_open()) {
+				std::fprintf(stderr, "Batch manifest not found: %s\n", path.c_str());
+				return false;
+			}
+
+			std::string line;
+			uint32_t lineNumber = 0u;
+
+			while (std::getline(file, line)) {
+
+				lineNumber++;
+
+				if (line.empty() || line[0] == '#') {
+					continue;
+				}
+
+				std::istringstream stream(line);
+				BatchJob job;
+				std::string format;
+
+				if (!(stream >> job.scene >> job.width >> job.height >> job.frameCount) ||
+					!job.width || !job.height || !job.frameCount) {
+					std::fprintf(stderr, "Batch manifest %s:%u - expected <scene> <width> <height> <frames>\n", path.c_str(), lineNumber);
+					return false;
+				}
+
+				stream >> job.outputPath >> format;
+
+				if (format == "ppm") {
+					job.outputFormat = FrameOutputFormat::PPMSequence;
+				}
+				else if (format == "y4m") {
+					job.outputFormat = FrameOutputFormat::Y4MStream;
+				}
+
+				outJobs.push_back(job);
+			}
+
+			return true;
+		}
+
+		BatchRenderer::BatchRenderer(RenderContext *contextP) : m_contextP(contextP) {
+			m_vertexShaderP = ShaderProgram::CreateFromCompiled("VS", VS_PATH, ShaderProgramType::VertexShader);
+			m_fragmentShaderP = ShaderProgram::CreateFromCompiled("FS", FS_PATH, ShaderProgramType::FragmentShader);
+		}
+
+		BatchRenderer::~BatchRenderer() {
+
+			m_contextP->FlushReadbacks();
+			m_jobsInFlight.clear();
+
+			for (auto &scene : m_scenes) {
+				for (auto bufferP : scene.second.buffers) {
+					delete bufferP;
+				}
+			}
+
+			delete m_vertexShaderP;
+			delete m_fragmentShaderP;
+		}
+
+		BatchRenderer::Scene *BatchRenderer::GetScene(const std::string &name) {
+
+			auto it = m_scenes.find(name);
+
+			if (it != m_scenes.end()) {
+				return &it->second;
+			}
+
+			const float *data3D = nullptr;
+
+			if (name == "triangle") {
+				data3D = s_triangleData3D;
+			}
+			else if (name == "triangle-inverted") {
+				data3D = s_invertedData3D;
+			}
+			else {
+				return nullptr;
+			}
+
+			Scene scene;
+
+			Buffer *vertexBuffer3D = Buffer::Create(
+				BufferType::VertexBuffer,
+				ShaderProgramType::VertexShader,
+				BufferLayout({
+				{ BufferDataType::float3, "position" },
+				{ BufferDataType::float3, "color" } }),
+				3);
+
+			Buffer *vertexBuffer2D = Buffer::Create(
+				BufferType::VertexBuffer,
+				ShaderProgramType::VertexShader,
+				BufferLayout({
+				{ BufferDataType::float2, "position" },
+				{ BufferDataType::float3, "color" } }),
+				3);
+
+			vertexBuffer3D->SetData(data3D);
+			vertexBuffer2D->SetData(s_triangleData2D);
+
+			m_contextP->BeginPass();
+			m_vertexShaderP->Bind();
+			vertexBuffer3D->Bind();
+			vertexBuffer2D->Bind();
+			m_fragmentShaderP->Bind();
+			m_contextP->EndPass();
+
+			scene.passIndex = m_scenes.size();
+			scene.buffers = { vertexBuffer3D, vertexBuffer2D };
+
+			return &m_scenes.emplace(name, scene).first->second;
+		}
+
+		void BatchRenderer::RetireJobs(const std::vector<BatchJob> &jobs, const bool flush) {
+
+			if (flush) {
+				m_contextP->FlushReadbacks();
+			}
+
+			const uint64_t framesCompleted = m_contextP->GetStats().framesCompleted;
+
+			while (m_jobsInFlight.size() && m_jobsInFlight.front()->lastFrame <= framesCompleted) {
+
+				JobProgress &progress = *m_jobsInFlight.front();
+				const BatchJob &job = jobs[progress.jobIndex];
+
+				if (progress.writer) {
+					progress.writer->Finish();
+				}
+
+				const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - progress.start).count();
+				const double megabytes = progress.bytesUploaded / (1024.0 * 1024.0);
+
+				std::printf("Job %u [%s %ux%u]: %u frames in %.3f s - %.1f frames/s, %.2f MB uploaded (%.1f MB/s)",
+					progress.jobIndex, job.scene.c_str(), job.width, job.height, job.frameCount,
+					seconds, job.frameCount / seconds, megabytes, megabytes / seconds);
+
+				if (progress.framesMissed) {
+					std::printf(", %u frames not captured", progress.framesMissed);
+				}
+				std::printf("\n");
+
+				m_jobsInFlight.erase(m_jobsInFlight.begin());
+			}
+		}
+
+		void BatchRenderer::Run(const std::vector<BatchJob> &jobs) {
+
+			const auto batchStart = std::chrono::steady_clock::now();
+			const uint64_t batchUploadStart = m_contextP->GetStats().bytesUploaded;
+			uint64_t batchFrames = 0u;
+
+			for (uint32_t i = 0; i < jobs.size(); i++) {
+
+				const BatchJob &job = jobs[i];
+				auto progress = std::make_unique<JobProgress>();
+				progress->jobIndex = i;
+				progress->start = std::chrono::steady_clock::now();
+
+				const uint64_t uploadStart = m_contextP->GetStats().bytesUploaded;
+				Scene *sceneP = GetScene(job.scene);
+
+				if (!sceneP) {
+					std::fprintf(stderr, "Job %u skipped - unknown scene \"%s\"\n", i, job.scene.c_str());
+					continue;
+				}
+
+				if (!m_contextP->SetRenderTarget(job.width, job.height)) {
+					std::fprintf(stderr, "Job %u skipped - cannot set a %ux%u render target\n", i, job.width, job.height);
+					continue;
+				}
+
+				if (job.outputPath.size()) {
+					FrameWriterSettings settings;
+					settings.outputPath = job.outputPath;
+					settings.format = job.outputFormat;
+					progress->writer = std::make_unique<FrameWriter>(settings);
+				}
+
+				FrameWriter *writerP = progress->writer.get();
+
+				for (uint32_t frame = 0; frame < job.frameCount; frame++) {
+
+					if (writerP && !m_contextP->ReadbackFrame([writerP](const FrameReadback &readback) { writerP->Submit(readback); })) {
+						progress->framesMissed++;
+					}
+
+					m_contextP->RunPass(sceneP->passIndex);
+					m_contextP->PresentFrame();
+
+					// Earlier jobs finish (and flush their output) while this one is rendering
+					RetireJobs(jobs, false);
+				}
+
+				const RenderStats stats = m_contextP->GetStats();
+				progress->lastFrame = stats.framesSubmitted;
+				progress->bytesUploaded = stats.bytesUploaded - uploadStart;
+				batchFrames += job.frameCount;
+				m_jobsInFlight.push_back(std::move(progress));
+
+				if (m_jobsInFlight.size() > s_maxJobsInFlight) {
+					RetireJobs(jobs, true);
+				}
+			}
+
+			RetireJobs(jobs, true);
+
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+			const double megabytes = (m_contextP->GetStats().bytesUploaded - batchUploadStart) / (1024.0 * 1024.0);
+
+			std::printf("Batch: %u jobs, %llu frames in %.3f s - %.1f frames/s, %.2f MB uploaded (%.1f MB/s)\n",
+				static_cast<uint32_t>(jobs.size()), static_cast<unsigned long long>(batchFrames),
+				seconds, batchFrames / seconds, megabytes, megabytes / seconds);
+		}
+	}
+}
@@ -0,0 +1,72 @@
+#ifndef BATCH_RENDERER_H_
+#define BATCH_RENDERER_H_
+
+#include <gpu/RenderContext.h>
+#include <gpu/ShaderProgram.h>
+#include <gpu/Buffer.h>
+#include <capture/FrameWriter.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace PixelMachine {
+	namespace App {
+
+		struct BatchJob {
+			std::string scene;
+			uint32_t width = 0u;
+			uint32_t height = 0u;
+			uint32_t frameCount = 0u;
+			// Frames are only read back when an output path is given
+			std::string outputPath;
+			Capture::FrameOutputFormat outputFormat = Capture::FrameOutputFormat::PNGSequence;
+		};
+
+		/* Parses a job manifest - one "<scene> <width> <height> <frames> [output [png|ppm|y4m]]" entry per line,
+		 lines starting with '#' are ignored. Returns false and reports the offending line on error */
+		bool LoadBatchManifest(const std::string &path, std::vector<BatchJob> &outJobs);
+
+		/// <summary>
+		/// Renders a list of jobs back to back on a headless render context.
+		/// Shaders, passes and vertex buffers of a scene are created on first
+		/// use and shared by every later job; jobs are not separated by a device
+		/// wait, so the tail of one job overlaps the start of the next.
+		/// </summary>
+		class BatchRenderer {
+		public:
+			BatchRenderer(GPU::RenderContext *contextP);
+			~BatchRenderer();
+			void Run(const std::vector<BatchJob> &jobs);
+
+		private:
+			struct Scene {
+				int passIndex = -1;
+				std::vector<GPU::Buffer *> buffers;
+			};
+
+			struct JobProgress {
+				uint32_t jobIndex = 0u;
+				uint64_t lastFrame = 0u;
+				uint64_t bytesUploaded = 0u;
+				uint32_t framesMissed = 0u;
+				std::chrono::steady_clock::time_point start;
+				std::unique_ptr<Capture::FrameWriter> writer;
+			};
+
+			Scene *GetScene(const std::string &name);
+			/* Reports and releases every job whose frames have all completed */
+			void RetireJobs(const std::vector<BatchJob> &jobs, const bool flush);
+
+			GPU::RenderContext *m_contextP = nullptr;
+			GPU::ShaderProgram *m_vertexShaderP = nullptr;
+			GPU::ShaderProgram *m_fragmentShaderP = nullptr;
+			std::map<std::string, Scene> m_scenes;
+			std::vector<std::unique_ptr<JobProgress>> m_jobsInFlight;
+		};
+	}
+}
+
+#endif // !BATCH_RENDERER_H_
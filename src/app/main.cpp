@@ -1,12 +1,20 @@
 #include <gpu/RenderContext.h>
 #include <gpu/ShaderProgram.h>
 #include <gpu/Buffer.h>
+#include <capture/FrameWriter.h>
+
+#include "BatchRenderer.h"
 
 #include <Windows.h>
 
 #include "Local.h"
 
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
 using namespace PixelMachine::GPU;
+using namespace PixelMachine::Capture;
 
 bool windowActive = true;
 
@@ -89,13 +97,107 @@ static HWND CreateSystemWindow(const wchar_t *name , const int windowWidth, cons
 	return systemWindowHandle;
 }
 
-int main() {
+/* Parses "--capture <path> [--capture-format png|ppm|y4m]" into <outSettings>, <outRequested> tells whether capture
+ was requested - returns false on an unknown format */
+static bool ParseCaptureSettings(int argc, char *argv[], FrameWriterSettings &outSettings, bool &outRequested) {
+
+	outRequested = false;
+
+	for (int i = 1; i + 1 < argc; i++) {
+		if (!strcmp(argv[i], "--capture")) {
+			outSettings.outputPath = argv[++i];
+			outRequested = true;
+		}
+		else if (!strcmp(argv[i], "--capture-format")) {
+			const char *format = argv[++i];
+			if (!strcmp(format, "ppm")) {
+				outSettings.format = FrameOutputFormat::PPMSequence;
+			}
+			else if (!strcmp(format, "y4m")) {
+				outSettings.format = FrameOutputFormat::Y4MStream;
+			}
+			else if (!strcmp(format, "png")) {
+				outSettings.format = FrameOutputFormat::PNGSequence;
+			}
+			else {
+				std::fprintf(stderr, "Unknown capture format \"%s\" - expected png, ppm or y4m\n", format);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/* Returns the path given with "--profile <trace.json>", null if profiling was not requested.
+ Profiling records timings as well as pipeline statistics and occlusion counts of every pass */
+static const char *ParseProfilePath(int argc, char *argv[]) {
+
+	for (int i = 1; i + 1 < argc; i++) {
+		if (!strcmp(argv[i], "--profile")) {
+			return argv[i + 1];
+		}
+	}
+
+	return nullptr;
+}
+
+/* Headless mode - "--batch <manifest>" renders every job of the manifest without opening a window */
+static int RunBatch(const char *manifestPath, const char *profilePath) {
+
+	std::vector<PixelMachine::App::BatchJob> jobs;
+
+	if (!PixelMachine::App::LoadBatchManifest(manifestPath, jobs)) {
+		return 1;
+	}
+
+	RenderContext::Initialize(nullptr);
+	RenderContext::Get()->SetProfiling(profilePath != nullptr);
+	RenderContext::Get()->SetPassQueries(profilePath != nullptr);
+
+	{
+		PixelMachine::App::BatchRenderer batchRenderer(RenderContext::Get());
+		batchRenderer.Run(jobs);
+	}
+
+	if (profilePath) {
+		RenderContext::Get()->WriteProfileTrace(profilePath);
+	}
+
+	RenderContext::Destroy();
+
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+
+	const char *profilePath = ParseProfilePath(argc, argv);
+
+	for (int i = 1; i + 1 < argc; i++) {
+		if (!strcmp(argv[i], "--batch")) {
+			return RunBatch(argv[i + 1], profilePath);
+		}
+	}
+
+	FrameWriterSettings captureSettings;
+	std::unique_ptr<FrameWriter> frameWriter;
+	bool captureRequested = false;
+
+	if (!ParseCaptureSettings(argc, argv, captureSettings, captureRequested)) {
+		return 1;
+	}
+
+	if (captureRequested) {
+		frameWriter = std::make_unique<FrameWriter>(captureSettings);
+	}
 
 	HWND windowHandle = CreateSystemWindow(L"PixelMachine", 1280, 720);
 	ShowWindow(windowHandle, SW_SHOW);
 
 	RenderContext::Initialize(windowHandle);
 	RenderContext *pContext = RenderContext::Get();
+	pContext->SetProfiling(profilePath != nullptr);
+	pContext->SetPassQueries(profilePath != nullptr);
 
 	ShaderProgram *vertexShaderProgram = ShaderProgram::CreateFromCompiled("VS", VS_PATH , ShaderProgramType::VertexShader);
 	ShaderProgram *fragShaderProgram = ShaderProgram::CreateFromCompiled("FS", FS_PATH, ShaderProgramType::FragmentShader);
@@ -154,10 +256,26 @@ int main() {
 			TranslateMessage(&msg);
 			DispatchMessage(&msg);
 		}
+		if (frameWriter) {
+			// Submit blocks while the writer is saturated, throttling the render loop instead of dropping frames
+			pContext->ReadbackFrame([&frameWriter](const FrameReadback &frame) { frameWriter->Submit(frame); });
+		}
 		pContext->RunPass(0);
 		pContext->PresentFrame();
 	}
 
+	if (frameWriter || profilePath) {
+		pContext->FlushReadbacks();
+	}
+
+	if (frameWriter) {
+		frameWriter->Finish();
+	}
+
+	if (profilePath) {
+		pContext->WriteProfileTrace(profilePath);
+	}
+
 	delete vertexBuffer2D;
 	delete vertexBuffer3D;
 	delete vertexShaderProgram;
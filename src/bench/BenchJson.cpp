@@ -0,0 +1,252 @@
+#include "BenchJson.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace PixelMachine {
+	namespace Bench {
+
+		/* Recursive descent over the input - positions past the end read as '\0' */
+		class JsonParser {
+		public:
+			JsonParser(const std::string &text) : m_text(text) {}
+
+			bool ParseDocument(JsonValue &outValue) {
+				if (!ParseValue(outValue, 0u)) {
+					return false;
+				}
+				SkipSpace();
+				return m_position == m_text.size();
+			}
+
+		private:
+			static constexpr uint32_t sm_maxDepth = 64u;
+
+			char Peek() const { return m_position < m_text.size() ? m_text[m_position] : '\0'; }
+
+			void SkipSpace() {
+				while (m_position < m_text.size() && std::strchr(" \t\r\n", m_text[m_position])) {
+					m_position++;
+				}
+			}
+
+			bool Expect(const char *literal) {
+				const size_t length = std::strlen(literal);
+				if (m_text.compare(m_position, length, literal) != 0) {
+					return false;
+				}
+				m_position += length;
+				return true;
+			}
+
+			bool ParseString(std::string &outString) {
+
+				if (Peek() != '"') {
+					return false;
+				}
+				m_position++;
+
+				while (m_position < m_text.size()) {
+
+					const char c = m_text[m_position++];
+
+					if (c == '"') {
+						return true;
+					}
+
+					if (c != '\\') {
+						outString.push_back(c);
+						continue;
+					}
+
+					const char escaped = Peek();
+					m_position++;
+
+					switch (escaped)
+					{
+					case 'n':	outString.push_back('\n'); break;
+					case 't':	outString.push_back('\t'); break;
+					case 'r':	outString.push_back('\r'); break;
+					case 'b':	outString.push_back('\b'); break;
+					case 'f':	outString.push_back('\f'); break;
+					case 'u':
+						// Reports only contain ASCII - other code points are replaced
+						if (m_position + 4u > m_text.size()) {
+							return false;
+						}
+						m_position += 4u;
+						outString.push_back('?');
+						break;
+					default:	outString.push_back(escaped); break;
+					}
+				}
+
+				return false;
+			}
+
+			bool ParseValue(JsonValue &outValue, const uint32_t depth) {
+
+				if (depth > sm_maxDepth) {
+					return false;
+				}
+
+				SkipSpace();
+				const char c = Peek();
+
+				if (c == '{') {
+					m_position++;
+					outValue.type = JsonValue::Type::Object;
+					SkipSpace();
+					if (Peek() == '}') {
+						m_position++;
+						return true;
+					}
+					while (true) {
+						std::pair<std::string, JsonValue> member;
+						SkipSpace();
+						if (!ParseString(member.first)) {
+							return false;
+						}
+						SkipSpace();
+						if (!Expect(":") || !ParseValue(member.second, depth + 1u)) {
+							return false;
+						}
+						outValue.object.push_back(std::move(member));
+						SkipSpace();
+						if (Expect("}")) {
+							return true;
+						}
+						if (!Expect(",")) {
+							return false;
+						}
+					}
+				}
+
+				if (c == '[') {
+					m_position++;
+					outValue.type = JsonValue::Type::Array;
+					SkipSpace();
+					if (Peek() == ']') {
+						m_position++;
+						return true;
+					}
+					while (true) {
+						outValue.array.emplace_back();
+						if (!ParseValue(outValue.array.back(), depth + 1u)) {
+							return false;
+						}
+						SkipSpace();
+						if (Expect("]")) {
+							return true;
+						}
+						if (!Expect(",")) {
+							return false;
+						}
+					}
+				}
+
+				if (c == '"') {
+					outValue.type = JsonValue::Type::String;
+					return ParseString(outValue.string);
+				}
+
+				if (Expect("true") || Expect("false")) {
+					outValue.type = JsonValue::Type::Bool;
+					outValue.boolean = m_text[m_position - 1u] == 'e' && m_text[m_position - 2u] == 'u';
+					return true;
+				}
+
+				if (Expect("null")) {
+					outValue.type = JsonValue::Type::Null;
+					return true;
+				}
+
+				const char *startP = m_text.c_str() + m_position;
+				char *endP = nullptr;
+				outValue.number = std::strtod(startP, &endP);
+
+				if (endP == startP) {
+					return false;
+				}
+
+				outValue.type = JsonValue::Type::Number;
+				m_position += endP - startP;
+				return true;
+			}
+
+			const std::string &m_text;
+			size_t m_position = 0u;
+		};
+
+		const JsonValue *JsonValue::Find(const std::string &key) const {
+
+			if (type != Type::Object) {
+				return nullptr;
+			}
+
+			for (auto &member : object) {
+				if (member.first == key) {
+					return &member.second;
+				}
+			}
+
+			return nullptr;
+		}
+
+		double JsonValue::GetNumber(std::initializer_list<const char *> path, const double fallback) const {
+
+			const JsonValue *valueP = this;
+
+			for (const char *key : path) {
+				valueP = valueP->Find(key);
+				if (!valueP) {
+					return fallback;
+				}
+			}
+
+			return valueP->type == Type::Number ? valueP->number : fallback;
+		}
+
+		bool ParseJson(const std::string &text, JsonValue &outValue) {
+			outValue = JsonValue();
+			return JsonParser(text).ParseDocument(outValue);
+		}
+
+		bool LoadJsonFile(const std::string &path, JsonValue &outValue) {
+
+			std::ifstream file(path, std::ios::binary);
+
+			if (!file.is_open()) {
+				return false;
+			}
+
+			std::stringstream stream;
+			stream << file.rdbuf();
+
+			return ParseJson(stream.str(), outValue);
+		}
+
+		std::string JsonQuote(const std::string &text) {
+
+			std::string result = "\"";
+
+			for (char c : text) {
+				if (c == '"' || c == '\\') {
+					result.push_back('\\');
+					result.push_back(c);
+				}
+				else if (static_cast<unsigned char>(c) < 0x20) {
+					result.push_back(' ');
+				}
+				else {
+					result.push_back(c);
+				}
+			}
+
+			result.push_back('"');
+			return result;
+		}
+	}
+}
@@ -0,0 +1,48 @@
+#ifndef BENCH_JSON_H_
+#define BENCH_JSON_H_
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace PixelMachine {
+	namespace Bench {
+
+		/// <summary>
+		/// Minimal JSON document model - just enough to read back the reports
+		/// written by the benchmarks for baseline comparisons.
+		/// </summary>
+		struct JsonValue {
+			enum Type {
+				Null,
+				Bool,
+				Number,
+				String,
+				Array,
+				Object
+			};
+
+			Type type = Type::Null;
+			bool boolean = false;
+			double number = 0.0;
+			std::string string;
+			std::vector<JsonValue> array;
+			std::vector<std::pair<std::string, JsonValue>> object;
+
+			/* Returns the member <key> of an object, null if missing or not an object */
+			const JsonValue *Find(const std::string &key) const;
+			/* Number of a nested member path such as {"cpuFrameMs", "p95"} - <fallback> if missing */
+			double GetNumber(std::initializer_list<const char *> path, const double fallback = 0.0) const;
+		};
+
+		/* Parses <text> into <outValue>, returns false on malformed input */
+		bool ParseJson(const std::string &text, JsonValue &outValue);
+		bool LoadJsonFile(const std::string &path, JsonValue &outValue);
+		/* Quoted and escaped JSON string */
+		std::string JsonQuote(const std::string &text);
+	}
+}
+
+#endif // !BENCH_JSON_H_
@@ -0,0 +1,329 @@
+#include <gpu/RenderContext.h>
+#include <gpu/ShaderProgram.h>
+
+#include "BenchScenes.h"
+#include "BenchReport.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace PixelMachine::GPU;
+using namespace PixelMachine::Bench;
+
+#ifndef PM_BENCH_SHADER_DIR
+#define PM_BENCH_SHADER_DIR "."
+#endif
+
+struct BenchSettings {
+	std::vector<SceneDescription> scenes;
+	uint32_t frames = 500u;
+	uint32_t warmupFrames = 16u;
+	uint32_t width = 1280u;
+	uint32_t height = 720u;
+	std::string shaderDir = PM_BENCH_SHADER_DIR;
+	std::string outputPath;
+	std::string baselinePath;
+	double threshold = 0.10;
+};
+
+static void PrintUsage() {
+	std::printf(
+		"PixelMachineBench - headless frame-time benchmarks\n"
+		"  --scene <kind>:<count>  triangles:N, submits:N, passes:N, uploads:N, queued:N, states:N, overdraw:N, msaa:N, textures:N or compressed:N (repeatable)\n"
+		"  --frames <count>        measured frames per scene (default 500)\n"
+		"  --warmup <count>        frames rendered before measuring (default 16)\n"
+		"  --size <W>x<H>          render target size (default 1280x720)\n"
+		"  --shaders <dir>         directory of VertexShader.spv and FragmentShader.spv\n"
+		"  --out <report.json>     writes the results as JSON\n"
+		"  --baseline <report.json> compares with an earlier report, exits with 2 on regressions\n"
+		"  --threshold <fraction>  allowed growth of a percentile before it regresses (default 0.10)\n"
+		"Runs on any Vulkan driver - for software rendering in CI select lavapipe with\n"
+		"VK_DRIVER_FILES (or VK_ICD_FILENAMES) pointing at lvp_icd.*.json\n");
+}
+
+/* Returns false on unknown or malformed arguments */
+static bool ParseSettings(int argc, char *argv[], BenchSettings &outSettings) {
+
+	for (int i = 1; i < argc; i++) {
+
+		const char *option = argv[i];
+
+		if (!strcmp(option, "--help") || !strcmp(option, "-h")) {
+			return false;
+		}
+
+		if (i + 1 >= argc) {
+			std::fprintf(stderr, "Missing value for %s\n", option);
+			return false;
+		}
+
+		const char *value = argv[++i];
+
+		if (!strcmp(option, "--scene")) {
+			SceneDescription description;
+			if (!ParseSceneDescription(value, description)) {
+				std::fprintf(stderr, "Invalid scene \"%s\"\n", value);
+				return false;
+			}
+			outSettings.scenes.push_back(description);
+		}
+		else if (!strcmp(option, "--frames")) {
+			outSettings.frames = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+		}
+		else if (!strcmp(option, "--warmup")) {
+			outSettings.warmupFrames = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+		}
+		else if (!strcmp(option, "--size")) {
+			if (std::sscanf(value, "%ux%u", &outSettings.width, &outSettings.height) != 2) {
+				std::fprintf(stderr, "Invalid size \"%s\"\n", value);
+				return false;
+			}
+		}
+		else if (!strcmp(option, "--shaders")) {
+			outSettings.shaderDir = value;
+		}
+		else if (!strcmp(option, "--out")) {
+			outSettings.outputPath = value;
+		}
+		else if (!strcmp(option, "--baseline")) {
+			outSettings.baselinePath = value;
+		}
+		else if (!strcmp(option, "--threshold")) {
+			outSettings.threshold = std::strtod(value, nullptr);
+		}
+		else {
+			std::fprintf(stderr, "Unknown option %s\n", option);
+			return false;
+		}
+	}
+
+	if (!outSettings.frames || !outSettings.width || !outSettings.height) {
+		std::fprintf(stderr, "Frame count and render target size must not be zero\n");
+		return false;
+	}
+
+	if (outSettings.scenes.empty()) {
+		for (auto &defaultScene : { "triangles:1", "triangles:10000", "submits:100", "passes:16", "uploads:8", "queued:100", "states:24", "overdraw:8", "msaa:10000", "textures:16", "compressed:16" }) {
+			SceneDescription description;
+			ParseSceneDescription(defaultScene, description);
+			outSettings.scenes.push_back(description);
+		}
+	}
+
+	return true;
+}
+
+/* Range of render frames (first, last] submitted during one benchmark frame */
+struct FrameRange {
+	uint64_t first = 0;
+	uint64_t last = 0;
+};
+
+struct FrameTimes {
+	double gpuUs = 0.0;
+	double gpuEndUs = 0.0;
+	double submitStartUs = -1.0;
+	bool hasGpu = false;
+};
+
+static SceneResult RunScene(RenderContext *contextP, BenchScene &scene, const std::string &name, const BenchSettings &settings) {
+
+	SceneResult result;
+	result.name = name;
+	result.frames = settings.frames;
+	result.setupMs = scene.GetSetupMs();
+	result.pipelinesCreated = scene.GetPipelinesCreated();
+
+	for (uint32_t i = 0; i < settings.warmupFrames; i++) {
+		scene.RenderFrame();
+	}
+
+	// Warmup events are dropped along with anything recorded before
+	contextP->FlushReadbacks();
+	std::vector<ProfileEvent> events;
+	contextP->TakeProfileHistory(events);
+	events.clear();
+
+	std::vector<FrameRange> ranges;
+	ranges.reserve(settings.frames);
+	result.cpuFrameMs.reserve(settings.frames);
+
+	const RenderStats startStats = contextP->GetStats();
+	const auto runStart = std::chrono::steady_clock::now();
+
+	for (uint32_t i = 0; i < settings.frames; i++) {
+
+		FrameRange range;
+		range.first = contextP->GetStats().framesSubmitted;
+
+		const auto frameStart = std::chrono::steady_clock::now();
+		scene.RenderFrame();
+		const auto frameEnd = std::chrono::steady_clock::now();
+
+		range.last = contextP->GetStats().framesSubmitted;
+		ranges.push_back(range);
+		result.cpuFrameMs.push_back(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+
+		// Drained every frame so the bounded history never drops events of heavy scenes
+		contextP->TakeProfileHistory(events);
+	}
+
+	contextP->FlushReadbacks();
+	result.totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+	contextP->TakeProfileHistory(events);
+
+	const RenderStats endStats = contextP->GetStats();
+	result.framesSubmitted = endStats.framesSubmitted - startStats.framesSubmitted;
+	result.bytesUploaded = endStats.bytesUploaded - startStats.bytesUploaded;
+	result.uploadSubmits = endStats.uploadSubmits - startStats.uploadSubmits;
+	result.commandsIssued = endStats.commandsIssued - startStats.commandsIssued;
+	result.commandsSkipped = endStats.commandsSkipped - startStats.commandsSkipped;
+
+	// GPU timings arrive once frames complete - group them by the render frame they belong to
+	std::unordered_map<uint64_t, FrameTimes> frameTimes;
+
+	for (auto &event : events) {
+
+		FrameTimes &times = frameTimes[event.frameNumber];
+
+		if (event.track == ProfileTrack::GPU) {
+			if (event.name == "Upload") {
+				continue;
+			}
+			times.gpuUs += event.durationUs;
+			times.gpuEndUs = std::max(times.gpuEndUs, event.startUs + event.durationUs);
+			times.hasGpu = true;
+		}
+		else if (event.name == "RunPass" && (times.submitStartUs < 0.0 || event.startUs < times.submitStartUs)) {
+			times.submitStartUs = event.startUs;
+		}
+	}
+
+	for (auto &range : ranges) {
+
+		double gpuUs = 0.0;
+		double gpuEndUs = 0.0;
+		double submitStartUs = -1.0;
+		bool complete = range.last > range.first;
+
+		for (uint64_t frame = range.first + 1u; frame <= range.last && complete; frame++) {
+
+			auto it = frameTimes.find(frame);
+
+			if (it == frameTimes.end() || !it->second.hasGpu) {
+				complete = false;
+				break;
+			}
+
+			gpuUs += it->second.gpuUs;
+			gpuEndUs = std::max(gpuEndUs, it->second.gpuEndUs);
+
+			if (it->second.submitStartUs >= 0.0 && (submitStartUs < 0.0 || it->second.submitStartUs < submitStartUs)) {
+				submitStartUs = it->second.submitStartUs;
+			}
+		}
+
+		if (!complete) {
+			continue;
+		}
+
+		result.gpuFrameMs.push_back(gpuUs / 1000.0);
+
+		if (submitStartUs >= 0.0) {
+			result.latencyMs.push_back(std::max(0.0, gpuEndUs - submitStartUs) / 1000.0);
+		}
+	}
+
+	return result;
+}
+
+static int RunBenchmarks(const BenchSettings &settings) {
+
+	RenderContext::Initialize(nullptr);
+	RenderContext *contextP = RenderContext::Get();
+
+	if (!contextP->SetRenderTarget(settings.width, settings.height)) {
+		std::fprintf(stderr, "Cannot create a %ux%u render target\n", settings.width, settings.height);
+		RenderContext::Destroy();
+		return 1;
+	}
+
+	contextP->SetProfiling(true);
+
+	BenchRunInfo info;
+	info.device = contextP->GetDeviceName();
+	info.width = settings.width;
+	info.height = settings.height;
+	info.warmupFrames = settings.warmupFrames;
+
+	std::printf("Device: %s, %ux%u, %u frames per scene\n", info.device.c_str(), info.width, info.height, settings.frames);
+
+	std::unique_ptr<ShaderProgram> vertexShader(ShaderProgram::CreateFromCompiled(
+		"VS", settings.shaderDir + "/VertexShader.spv", ShaderProgramType::VertexShader));
+	std::unique_ptr<ShaderProgram> fragmentShader(ShaderProgram::CreateFromCompiled(
+		"FS", settings.shaderDir + "/FragmentShader.spv", ShaderProgramType::FragmentShader));
+
+	std::vector<SceneResult> results;
+	uint32_t passIndex = 0u;
+
+	for (auto &description : settings.scenes) {
+
+		BenchScene scene(description, contextP, vertexShader.get(), fragmentShader.get(), passIndex);
+		passIndex += scene.GetPassCount();
+
+		results.push_back(RunScene(contextP, scene, description.GetName(), settings));
+		PrintResult(results.back());
+	}
+
+	vertexShader.reset();
+	fragmentShader.reset();
+	RenderContext::Destroy();
+
+	if (settings.outputPath.size() && !WriteReport(settings.outputPath, info, results)) {
+		return 1;
+	}
+
+	if (settings.baselinePath.size()) {
+
+		const int regressions = CompareWithBaseline(settings.baselinePath, info, results, settings.threshold);
+
+		if (regressions < 0) {
+			return 1;
+		}
+
+		if (regressions) {
+			std::printf("%d metrics regressed\n", regressions);
+			return 2;
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+
+	BenchSettings settings;
+
+	if (!ParseSettings(argc, argv, settings)) {
+		PrintUsage();
+		return 1;
+	}
+
+	try {
+		return RunBenchmarks(settings);
+	}
+	catch (std::runtime_error *errorP) {
+		std::fprintf(stderr, "Benchmark failed: %s\n", errorP->what());
+		delete errorP;
+	}
+	catch (const std::runtime_error &error) {
+		std::fprintf(stderr, "Benchmark failed: %s\n", error.what());
+	}
+
+	return 1;
+}
@@ -0,0 +1,191 @@
+#include "BenchReport.h"
+#include "BenchJson.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+
+namespace PixelMachine {
+	namespace Bench {
+
+		// Metrics compared against a baseline - GPU metrics are skipped when either run has no timestamps
+		static const char *s_comparedMetrics[] = { "cpuFrameMs", "gpuFrameMs" };
+		static const char *s_comparedPercentiles[] = { "p50", "p95", "p99" };
+
+		Percentiles ComputePercentiles(std::vector<double> values) {
+
+			Percentiles result;
+
+			if (values.empty()) {
+				return result;
+			}
+
+			std::sort(values.begin(), values.end());
+
+			auto rank = [&values](const double percentile) {
+				const size_t index = static_cast<size_t>(std::ceil(percentile * values.size()));
+				return values[std::clamp<size_t>(index, 1u, values.size()) - 1u];
+			};
+
+			result.samples = static_cast<uint32_t>(values.size());
+			result.mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+			result.p50 = rank(0.50);
+			result.p95 = rank(0.95);
+			result.p99 = rank(0.99);
+			result.max = values.back();
+
+			return result;
+		}
+
+		static void WritePercentiles(FILE *fileP, const char *name, const Percentiles &percentiles) {
+			std::fprintf(fileP, "      \"%s\": {\"samples\": %u, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}",
+				name, percentiles.samples, percentiles.mean, percentiles.p50, percentiles.p95, percentiles.p99, percentiles.max);
+		}
+
+		void PrintResult(const SceneResult &result) {
+
+			const Percentiles cpu = ComputePercentiles(result.cpuFrameMs);
+			const Percentiles gpu = ComputePercentiles(result.gpuFrameMs);
+			const Percentiles latency = ComputePercentiles(result.latencyMs);
+
+			std::printf("%-16s %6u frames in %.3f s (setup %.2f ms, %llu pipelines)\n",
+				result.name.c_str(), result.frames, result.totalSeconds, result.setupMs, static_cast<unsigned long long>(result.pipelinesCreated));
+			std::printf("  cpu ms      p50 %8.3f  p95 %8.3f  p99 %8.3f  max %8.3f\n", cpu.p50, cpu.p95, cpu.p99, cpu.max);
+
+			if (gpu.samples) {
+				std::printf("  gpu ms      p50 %8.3f  p95 %8.3f  p99 %8.3f  max %8.3f\n", gpu.p50, gpu.p95, gpu.p99, gpu.max);
+				std::printf("  latency ms  p50 %8.3f  p95 %8.3f  p99 %8.3f  max %8.3f\n", latency.p50, latency.p95, latency.p99, latency.max);
+			}
+			else {
+				std::printf("  gpu ms      n/a (no timestamp support)\n");
+			}
+
+			if (result.uploadSubmits) {
+				std::printf("  uploads     %llu submits, %.2f MB\n",
+					static_cast<unsigned long long>(result.uploadSubmits), result.bytesUploaded / (1024.0 * 1024.0));
+			}
+
+			if (result.commandsIssued || result.commandsSkipped) {
+				std::printf("  state cmds  %llu issued, %llu skipped\n",
+					static_cast<unsigned long long>(result.commandsIssued), static_cast<unsigned long long>(result.commandsSkipped));
+			}
+		}
+
+		bool WriteReport(const std::string &path, const BenchRunInfo &info, const std::vector<SceneResult> &results) {
+
+			FILE *fileP = std::fopen(path.c_str(), "w");
+
+			if (!fileP) {
+				std::fprintf(stderr, "Benchmark report %s could not be created\n", path.c_str());
+				return false;
+			}
+
+			std::fprintf(fileP, "{\n  \"device\": %s,\n", JsonQuote(info.device).c_str());
+			std::fprintf(fileP, "  \"width\": %u,\n  \"height\": %u,\n  \"warmupFrames\": %u,\n", info.width, info.height, info.warmupFrames);
+			std::fprintf(fileP, "  \"scenes\": [");
+
+			for (size_t i = 0; i < results.size(); i++) {
+
+				const SceneResult &result = results[i];
+
+				std::fprintf(fileP, "%s\n    {\n      \"name\": %s,\n", i ? "," : "", JsonQuote(result.name).c_str());
+				std::fprintf(fileP, "      \"frames\": %u,\n      \"framesSubmitted\": %llu,\n      \"setupMs\": %.4f,\n      \"totalSeconds\": %.6f,\n",
+					result.frames, static_cast<unsigned long long>(result.framesSubmitted), result.setupMs, result.totalSeconds);
+				std::fprintf(fileP, "      \"bytesUploaded\": %llu,\n      \"uploadSubmits\": %llu,\n",
+					static_cast<unsigned long long>(result.bytesUploaded), static_cast<unsigned long long>(result.uploadSubmits));
+				std::fprintf(fileP, "      \"commandsIssued\": %llu,\n      \"commandsSkipped\": %llu,\n",
+					static_cast<unsigned long long>(result.commandsIssued), static_cast<unsigned long long>(result.commandsSkipped));
+				std::fprintf(fileP, "      \"pipelinesCreated\": %llu,\n", static_cast<unsigned long long>(result.pipelinesCreated));
+
+				WritePercentiles(fileP, "cpuFrameMs", ComputePercentiles(result.cpuFrameMs));
+				std::fprintf(fileP, ",\n");
+				WritePercentiles(fileP, "gpuFrameMs", ComputePercentiles(result.gpuFrameMs));
+				std::fprintf(fileP, ",\n");
+				WritePercentiles(fileP, "latencyMs", ComputePercentiles(result.latencyMs));
+				std::fprintf(fileP, "\n    }");
+			}
+
+			std::fprintf(fileP, "\n  ]\n}\n");
+
+			return std::fclose(fileP) == 0;
+		}
+
+		int CompareWithBaseline(const std::string &path, const BenchRunInfo &info, const std::vector<SceneResult> &results, const double threshold) {
+
+			JsonValue baseline;
+
+			if (!LoadJsonFile(path, baseline)) {
+				std::fprintf(stderr, "Baseline %s could not be read\n", path.c_str());
+				return -1;
+			}
+
+			const JsonValue *deviceP = baseline.Find("device");
+
+			if (deviceP && deviceP->string != info.device) {
+				std::printf("Warning: baseline was recorded on \"%s\", this run uses \"%s\"\n", deviceP->string.c_str(), info.device.c_str());
+			}
+
+			if (baseline.GetNumber({ "width" }) != info.width || baseline.GetNumber({ "height" }) != info.height) {
+				std::printf("Warning: baseline resolution differs from this run\n");
+			}
+
+			const JsonValue *scenesP = baseline.Find("scenes");
+			int regressions = 0;
+
+			std::printf("Baseline comparison (threshold %.1f%%):\n", threshold * 100.0);
+
+			for (auto &result : results) {
+
+				const JsonValue *baseSceneP = nullptr;
+
+				if (scenesP) {
+					for (auto &scene : scenesP->array) {
+						const JsonValue *nameP = scene.Find("name");
+						if (nameP && nameP->string == result.name) {
+							baseSceneP = &scene;
+						}
+					}
+				}
+
+				if (!baseSceneP) {
+					std::printf("  %-16s not in baseline\n", result.name.c_str());
+					continue;
+				}
+
+				const Percentiles current[] = { ComputePercentiles(result.cpuFrameMs), ComputePercentiles(result.gpuFrameMs) };
+
+				for (uint32_t m = 0; m < 2u; m++) {
+
+					if (!current[m].samples || !baseSceneP->GetNumber({ s_comparedMetrics[m], "samples" })) {
+						continue;
+					}
+
+					const double values[] = { current[m].p50, current[m].p95, current[m].p99 };
+
+					for (uint32_t p = 0; p < 3u; p++) {
+
+						const double base = baseSceneP->GetNumber({ s_comparedMetrics[m], s_comparedPercentiles[p] });
+
+						if (base <= 0.0) {
+							continue;
+						}
+
+						const double change = (values[p] - base) / base;
+						const bool regressed = change > threshold;
+
+						std::printf("  %-16s %-10s %s %8.3f -> %8.3f ms (%+6.1f%%)%s\n",
+							result.name.c_str(), s_comparedMetrics[m], s_comparedPercentiles[p],
+							base, values[p], change * 100.0, regressed ? "  REGRESSION" : "");
+
+						if (regressed) {
+							regressions++;
+						}
+					}
+				}
+			}
+
+			return regressions;
+		}
+	}
+}
@@ -0,0 +1,60 @@
+#ifndef BENCH_REPORT_H_
+#define BENCH_REPORT_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace PixelMachine {
+	namespace Bench {
+
+		/* Distribution of a per-frame metric - nearest-rank percentiles */
+		struct Percentiles {
+			uint32_t samples = 0;
+			double mean = 0.0;
+			double p50 = 0.0;
+			double p95 = 0.0;
+			double p99 = 0.0;
+			double max = 0.0;
+		};
+
+		Percentiles ComputePercentiles(std::vector<double> values);
+
+		/* Measurements of a scene, per benchmark frame (one or more submitted render frames) */
+		struct SceneResult {
+			std::string name;
+			uint32_t frames = 0;
+			uint64_t framesSubmitted = 0;
+			double setupMs = 0.0;
+			double totalSeconds = 0.0;
+			// CPU wall time from the first call of a frame until its last submit returned
+			std::vector<double> cpuFrameMs;
+			// Sum of the GPU pass timestamps of a frame
+			std::vector<double> gpuFrameMs;
+			// First CPU submit of a frame until its last GPU pass finished
+			std::vector<double> latencyMs;
+			uint64_t bytesUploaded = 0;
+			uint64_t uploadSubmits = 0;
+			// State commands recorded and skipped by the command state cache
+			uint64_t commandsIssued = 0;
+			uint64_t commandsSkipped = 0;
+			// Graphics pipelines compiled while setting the scene up
+			uint64_t pipelinesCreated = 0;
+		};
+
+		struct BenchRunInfo {
+			std::string device;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t warmupFrames = 0;
+		};
+
+		void PrintResult(const SceneResult &result);
+		bool WriteReport(const std::string &path, const BenchRunInfo &info, const std::vector<SceneResult> &results);
+		/* Compares the CPU and GPU frame time percentiles with a report written earlier. A metric regresses when
+		 it grows by more than <threshold> (0.1 = 10%). Returns the number of regressions, -1 if the baseline is unreadable */
+		int CompareWithBaseline(const std::string &path, const BenchRunInfo &info, const std::vector<SceneResult> &results, const double threshold);
+	}
+}
+
+#endif // !BENCH_REPORT_H_
@@ -0,0 +1,381 @@
+#include "BenchScenes.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+using namespace PixelMachine::GPU;
+
+namespace PixelMachine {
+	namespace Bench {
+
+		// Vertices rewritten by every upload of the uploads scene - 96 KiB per SetData
+		static constexpr uint32_t s_uploadVertexCount = 4096u;
+		// Passes the draws of the queued scene alternate between
+		static constexpr uint32_t s_queuedPassCount = 4u;
+		// Cull modes x depth test x wireframe
+		static constexpr uint32_t s_stateVariantCount = 12u;
+		// Samples of the msaa scene - clamped to what the device supports
+		static constexpr uint32_t s_msaaSampleCount = 4u;
+		// Side of the textures of the textures scene - 256 KiB top level, mips generated on the GPU
+		static constexpr uint32_t s_textureSize = 256u;
+
+		std::string SceneDescription::GetName() const {
+
+			switch (kind)
+			{
+			case SceneKind::Triangles:	return "triangles:" + std::to_string(count);
+			case SceneKind::Submits:	return "submits:" + std::to_string(count);
+			case SceneKind::Passes:		return "passes:" + std::to_string(count);
+			case SceneKind::Uploads:	return "uploads:" + std::to_string(count);
+			case SceneKind::Queued:		return "queued:" + std::to_string(count);
+			case SceneKind::States:		return "states:" + std::to_string(count);
+			case SceneKind::Overdraw:	return "overdraw:" + std::to_string(count);
+			case SceneKind::Msaa:		return "msaa:" + std::to_string(count);
+			case SceneKind::Textures:	return "textures:" + std::to_string(count);
+			case SceneKind::Compressed:	return "compressed:" + std::to_string(count);
+			default: break;
+			}
+
+			return "unknown";
+		}
+
+		bool ParseSceneDescription(const std::string &text, SceneDescription &outDescription) {
+
+			const size_t separator = text.find(':');
+
+			if (separator == std::string::npos) {
+				return false;
+			}
+
+			const std::string kind = text.substr(0, separator);
+			const std::string count = text.substr(separator + 1u);
+
+			if (kind == "triangles") {
+				outDescription.kind = SceneKind::Triangles;
+			}
+			else if (kind == "submits") {
+				outDescription.kind = SceneKind::Submits;
+			}
+			else if (kind == "passes") {
+				outDescription.kind = SceneKind::Passes;
+			}
+			else if (kind == "uploads") {
+				outDescription.kind = SceneKind::Uploads;
+			}
+			else if (kind == "queued") {
+				outDescription.kind = SceneKind::Queued;
+			}
+			else if (kind == "states") {
+				outDescription.kind = SceneKind::States;
+			}
+			else if (kind == "overdraw") {
+				outDescription.kind = SceneKind::Overdraw;
+			}
+			else if (kind == "msaa") {
+				outDescription.kind = SceneKind::Msaa;
+			}
+			else if (kind == "textures") {
+				outDescription.kind = SceneKind::Textures;
+			}
+			else if (kind == "compressed") {
+				outDescription.kind = SceneKind::Compressed;
+			}
+			else {
+				return false;
+			}
+
+			char *endP = nullptr;
+			const unsigned long value = std::strtoul(count.c_str(), &endP, 10);
+
+			if (count.empty() || *endP != '\0' || !value || value > 0xFFFFFFu) {
+				return false;
+			}
+
+			outDescription.count = static_cast<uint32_t>(value);
+			return true;
+		}
+
+		BenchScene::BenchScene(
+			const SceneDescription &description,
+			RenderContext *contextP,
+			ShaderProgram *vertexShaderP,
+			ShaderProgram *fragmentShaderP,
+			const uint32_t firstPassIndex)
+			: m_description(description),
+			m_contextP(contextP),
+			m_vertexShaderP(vertexShaderP),
+			m_fragmentShaderP(fragmentShaderP),
+			m_firstPassIndex(firstPassIndex) {
+
+			const auto setupStart = std::chrono::steady_clock::now();
+			const uint64_t pipelinesBefore = m_contextP->GetStats().graphicsPipelines;
+
+			switch (m_description.kind)
+			{
+			case SceneKind::Triangles:
+				CreateTrianglePass(m_description.count, 0.0f);
+				break;
+
+			case SceneKind::Passes:
+				for (uint32_t i = 0; i < m_description.count; i++) {
+					CreateTrianglePass(1u, static_cast<float>(i) / m_description.count);
+				}
+				break;
+
+			case SceneKind::Uploads:
+				m_uploadBufferP = Buffer::Create(
+					BufferType::VertexBuffer,
+					ShaderProgramType::VertexShader,
+					BufferLayout({
+					{ BufferDataType::float3, "position" },
+					{ BufferDataType::float3, "color" } }),
+					s_uploadVertexCount);
+				m_uploadData.assign(s_uploadVertexCount * 6u, 0.5f);
+				CreateTrianglePass(1u, 0.0f);
+				break;
+
+			case SceneKind::Queued:
+				for (uint32_t i = 0; i < s_queuedPassCount; i++) {
+					CreateTrianglePass(1u, static_cast<float>(i) / s_queuedPassCount);
+				}
+				break;
+
+			case SceneKind::States:
+				// Render state combinations repeat - with dynamic state they all share one pipeline
+				for (uint32_t i = 0; i < m_description.count; i++) {
+					CreateTrianglePass(1u, static_cast<float>(i) / m_description.count, 1u + i % s_stateVariantCount);
+				}
+				break;
+
+			case SceneKind::Overdraw:
+				// Layers covering the same pixels - the depth pre-pass leaves one shaded fragment per pixel
+				for (uint32_t i = 0; i < m_description.count; i++) {
+					CreateTrianglePass(1u, static_cast<float>(i) / m_description.count, 0u, static_cast<float>(i) / m_description.count, true);
+				}
+				break;
+
+			case SceneKind::Msaa:
+				// Same work as the triangles scene - the difference is the cost of the multisampled attachments
+				m_sampleCount = s_msaaSampleCount;
+				CreateTrianglePass(m_description.count, 0.0f);
+				break;
+
+			case SceneKind::Textures:
+				{
+					TextureDesc desc;
+					desc.width = s_textureSize;
+					desc.height = s_textureSize;
+
+					for (uint32_t i = 0; i < m_description.count; i++) {
+						m_textures.push_back(Texture::Create(desc));
+					}
+
+					m_uploadData.assign(s_textureSize * s_textureSize, 0.5f);
+					CreateTrianglePass(1u, 0.0f);
+				}
+				break;
+
+			case SceneKind::Compressed:
+				{
+					// Same textures as the textures scene as BC7 - a quarter of the bytes, transcoded where BC7 is missing
+					TextureDesc desc;
+					desc.format = TextureFormat::TextureBC7;
+					desc.width = s_textureSize;
+					desc.height = s_textureSize;
+
+					for (uint32_t size = s_textureSize; size; size >>= 1u) {
+						// Mode 6 blocks, every byte but the mode set to a neutral grey
+						std::vector<uint8_t> level(GetTextureLevelSize(desc.format, size, size), 0x80u);
+						for (uint32_t i = 0; i < level.size(); i += 16u) {
+							level[i] = 0x40u;
+						}
+						m_textureLevels.push_back(std::move(level));
+					}
+
+					desc.mipLevels = m_textureLevels.size();
+
+					for (uint32_t i = 0; i < m_description.count; i++) {
+						m_textures.push_back(Texture::Create(desc));
+					}
+
+					CreateTrianglePass(1u, 0.0f);
+				}
+				break;
+
+			default:
+				CreateTrianglePass(1u, 0.0f);
+				break;
+			}
+
+			m_setupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setupStart).count();
+			m_pipelinesCreated = m_contextP->GetStats().graphicsPipelines - pipelinesBefore;
+		}
+
+		BenchScene::~BenchScene() {
+
+			// Passes keep referencing the buffers - wait until no frame uses them anymore
+			m_contextP->FlushReadbacks();
+
+			for (auto bufferP : m_buffers) {
+				delete bufferP;
+			}
+
+			delete m_uploadBufferP;
+
+			for (auto textureP : m_textures) {
+				delete textureP;
+			}
+		}
+
+		void BenchScene::CreateTrianglePass(
+			const uint32_t triangleCount,
+			const float colorShift,
+			const uint32_t stateVariant,
+			const float depth,
+			const bool depthPrePass) {
+
+			// Triangles are spread over a square grid covering the viewport
+			const uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(triangleCount))));
+			const float cell = 2.0f / columns;
+
+			std::vector<float> data3D;
+			std::vector<float> data2D;
+			data3D.reserve(triangleCount * 3u * 6u);
+			data2D.reserve(triangleCount * 3u * 5u);
+
+			for (uint32_t i = 0; i < triangleCount; i++) {
+
+				const float x = -1.0f + (i % columns) * cell;
+				const float y = -1.0f + (i / columns) * cell;
+				const float corners[3][2] = { { x + cell * 0.5f, y }, { x + cell, y + cell }, { x, y + cell } };
+
+				for (uint32_t v = 0; v < 3u; v++) {
+					const float shade = std::fmod(colorShift + v * 0.33f + static_cast<float>(i) / triangleCount, 1.0f);
+					data3D.insert(data3D.end(), { corners[v][0], corners[v][1], depth, shade, 1.0f - shade, 0.5f });
+					data2D.insert(data2D.end(), { corners[v][0], corners[v][1], shade, 0.5f, 1.0f - shade });
+				}
+			}
+
+			Buffer *vertexBuffer3D = Buffer::Create(
+				BufferType::VertexBuffer,
+				ShaderProgramType::VertexShader,
+				BufferLayout({
+				{ BufferDataType::float3, "position" },
+				{ BufferDataType::float3, "color" } }),
+				triangleCount * 3u);
+
+			Buffer *vertexBuffer2D = Buffer::Create(
+				BufferType::VertexBuffer,
+				ShaderProgramType::VertexShader,
+				BufferLayout({
+				{ BufferDataType::float2, "position" },
+				{ BufferDataType::float3, "color" } }),
+				triangleCount * 3u);
+
+			vertexBuffer3D->SetData(data3D.data());
+			vertexBuffer2D->SetData(data2D.data());
+
+			m_contextP->BeginPass();
+			m_vertexShaderP->Bind();
+			vertexBuffer3D->Bind();
+			vertexBuffer2D->Bind();
+			m_fragmentShaderP->Bind();
+
+			// Bound for the descriptor set only - the bench shaders do not sample them
+			for (auto textureP : m_textures) {
+				textureP->Bind();
+			}
+
+			if (stateVariant) {
+				const uint32_t variant = stateVariant - 1u;
+				m_contextP->SetCullMode(static_cast<CullMode>(variant % 3u));
+				m_contextP->SetDepthTesting((variant / 3u) % 2u);
+				m_contextP->SetWireframe((variant / 6u) % 2u);
+			}
+
+			if (depthPrePass) {
+				m_contextP->SetDepthPrePass(true);
+			}
+
+			if (m_sampleCount > 1u) {
+				m_contextP->SetMultisampling(m_sampleCount);
+			}
+
+			m_contextP->EndPass();
+
+			m_buffers.push_back(vertexBuffer3D);
+			m_buffers.push_back(vertexBuffer2D);
+			m_passCount++;
+		}
+
+		void BenchScene::RenderFrame() {
+
+			switch (m_description.kind)
+			{
+			case SceneKind::Submits:
+				// N runs of the same single-draw pass - measures the cost of a RunPass submit, not of a draw
+				for (uint32_t i = 0; i < m_description.count; i++) {
+					m_contextP->RunPass(m_firstPassIndex);
+				}
+				break;
+
+			case SceneKind::Passes:
+			case SceneKind::States:
+				for (uint32_t i = 0; i < m_passCount; i++) {
+					m_contextP->RunPass(m_firstPassIndex + i);
+				}
+				break;
+
+			case SceneKind::Uploads:
+				for (uint32_t i = 0; i < m_description.count; i++) {
+					m_uploadData[0] = static_cast<float>(i);
+					m_uploadBufferP->SetData(m_uploadData.data());
+				}
+				m_contextP->RunPass(m_firstPassIndex);
+				break;
+
+			case SceneKind::Queued:
+				// Worst order for binding - every draw switches pass, the queue sorts them back into groups
+				for (uint32_t i = 0; i < m_description.count; i++) {
+					m_contextP->QueueDraw(m_firstPassIndex + i % m_passCount, static_cast<float>(i) / m_description.count);
+				}
+				m_contextP->RunQueuedDraws();
+				break;
+
+			case SceneKind::Overdraw:
+				// Queued far to near on one layer - without the pre-pass every layer would be shaded
+				for (uint32_t i = 0; i < m_passCount; i++) {
+					m_contextP->QueueDraw(m_firstPassIndex + m_passCount - 1u - i);
+				}
+				m_contextP->RunQueuedDraws();
+				break;
+
+			case SceneKind::Textures:
+				// Every texture rewritten and its mip chain regenerated - batched into one submit ahead of the frame
+				for (uint32_t i = 0; i < m_textures.size(); i++) {
+					m_uploadData[0] = static_cast<float>(i);
+					m_textures[i]->SetData(m_uploadData.data());
+				}
+				m_contextP->RunPass(m_firstPassIndex);
+				break;
+
+			case SceneKind::Compressed:
+				// Prepared chains are uploaded level by level - nothing is generated on the GPU
+				for (auto textureP : m_textures) {
+					for (uint32_t level = 0; level < m_textureLevels.size(); level++) {
+						textureP->SetMipData(level, m_textureLevels[level].data());
+					}
+				}
+				m_contextP->RunPass(m_firstPassIndex);
+				break;
+
+			default:
+				m_contextP->RunPass(m_firstPassIndex);
+				break;
+			}
+
+			m_contextP->PresentFrame();
+		}
+	}
+}
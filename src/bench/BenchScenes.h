@@ -0,0 +1,93 @@
+#ifndef BENCH_SCENES_H_
+#define BENCH_SCENES_H_
+
+#include <gpu/RenderContext.h>
+#include <gpu/ShaderProgram.h>
+#include <gpu/Buffer.h>
+#include <gpu/Texture.h>
+
+#include <string>
+#include <vector>
+
+namespace PixelMachine {
+	namespace Bench {
+
+		enum SceneKind {
+			Triangles,
+			Submits,
+			Passes,
+			Uploads,
+			Queued,
+			States,
+			Overdraw,
+			Msaa,
+			Textures,
+			Compressed
+		};
+
+		/* Scripted workload - "<kind>:<count>" on the command line */
+		struct SceneDescription {
+			SceneKind kind = SceneKind::Triangles;
+			uint32_t count = 1u;
+
+			std::string GetName() const;
+		};
+
+		/* Parses "triangles:N", "submits:N", "passes:N", "uploads:N", "queued:N", "states:N", "overdraw:N", "msaa:N", "textures:N" or "compressed:N" - returns false on malformed input */
+		bool ParseSceneDescription(const std::string &text, SceneDescription &outDescription);
+
+		/// <summary>
+		/// Buffers and passes of a benchmark scene. Passes created by a scene stay registered with the
+		/// render context (it has no way to remove them), later scenes simply continue the pass indices.
+		/// </summary>
+		class BenchScene {
+		public:
+			BenchScene(
+				const SceneDescription &description,
+				GPU::RenderContext *contextP,
+				GPU::ShaderProgram *vertexShaderP,
+				GPU::ShaderProgram *fragmentShaderP,
+				const uint32_t firstPassIndex);
+			~BenchScene();
+
+			/* Records and submits the work of one frame */
+			void RenderFrame();
+			/* Passes the scene registered with the context */
+			uint32_t GetPassCount() const { return m_passCount; }
+			/* CPU time spent building the passes of the scene (pipeline creation) */
+			double GetSetupMs() const { return m_setupMs; }
+			/* Graphics pipelines compiled for the passes of the scene */
+			uint64_t GetPipelinesCreated() const { return m_pipelinesCreated; }
+
+		private:
+			/* Creates a pass drawing <triangleCount> triangles laid out on a grid at <depth>. A non-zero <stateVariant>
+			 picks one of the cull mode, depth test and wireframe combinations */
+			void CreateTrianglePass(
+				const uint32_t triangleCount,
+				const float colorShift,
+				const uint32_t stateVariant = 0u,
+				const float depth = 0.0f,
+				const bool depthPrePass = false);
+
+			SceneDescription m_description;
+			GPU::RenderContext *m_contextP = nullptr;
+			GPU::ShaderProgram *m_vertexShaderP = nullptr;
+			GPU::ShaderProgram *m_fragmentShaderP = nullptr;
+			uint32_t m_firstPassIndex = 0u;
+			uint32_t m_passCount = 0u;
+			// Sample count of the passes created
+			uint32_t m_sampleCount = 1u;
+			double m_setupMs = 0.0;
+			uint64_t m_pipelinesCreated = 0;
+
+			std::vector<GPU::Buffer *> m_buffers;
+			GPU::Buffer *m_uploadBufferP = nullptr;
+			std::vector<float> m_uploadData;
+			std::vector<GPU::Texture *> m_textures;
+			// Block compressed mip chain of the compressed scene, finest level first
+			std::vector<std::vector<uint8_t>> m_textureLevels;
+		};
+	}
+}
+
+#endif // !BENCH_SCENES_H_
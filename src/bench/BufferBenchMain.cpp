@@ -0,0 +1,328 @@
+#include <gpu/RenderContext.h>
+#include <gpu/Buffer.h>
+
+#include "BenchReport.h"
+#include "BenchJson.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+using namespace PixelMachine::GPU;
+using namespace PixelMachine::Bench;
+
+// Every operator new of the process, LibGPU included - driver allocations are counted by the allocation callbacks
+static std::atomic<uint64_t> s_hostAllocations = 0u;
+
+void *operator new(std::size_t size) {
+	s_hostAllocations.fetch_add(1u, std::memory_order_relaxed);
+	if (void *memoryP = std::malloc(size ? size : 1u)) {
+		return memoryP;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void *memoryP) noexcept {
+	std::free(memoryP);
+}
+
+void operator delete(void *memoryP, std::size_t) noexcept {
+	std::free(memoryP);
+}
+
+struct BufferBenchSettings {
+	uint64_t minSize = 64u;
+	uint64_t maxSize = 256ull * 1024u * 1024u;
+	double minSeconds = 0.25;
+	uint32_t minIterations = 3u;
+	uint32_t maxIterations = 10000u;
+	std::string outputPath;
+};
+
+enum BufferOperation {
+	Create,
+	SetDataHost,
+	SetDataStaging,
+	SetDataDirect
+};
+
+struct OperationResult {
+	std::string name;
+	uint64_t size = 0;
+	uint32_t iterations = 0;
+	Percentiles microseconds;
+	double megabytesPerSecond = 0.0;
+	double hostAllocationsPerOp = 0.0;
+	double memoryAllocationsPerOp = 0.0;
+	double driverAllocationsPerOp = 0.0;
+	double submitsPerOp = 0.0;
+};
+
+static void PrintUsage() {
+	std::printf(
+		"PixelMachineBufferBench - buffer creation and upload microbenchmarks\n"
+		"  --min-size <bytes>      smallest buffer (default 64)\n"
+		"  --max-size <bytes>      largest buffer (default 268435456)\n"
+		"  --min-time <seconds>    minimum measuring time per case (default 0.25)\n"
+		"  --max-iterations <n>    iteration cap per case (default 10000)\n"
+		"  --out <report.json>     writes the results as JSON\n"
+		"Sizes grow by 4x from the smallest to the largest buffer. For software rendering in CI\n"
+		"select lavapipe with VK_DRIVER_FILES (or VK_ICD_FILENAMES) pointing at lvp_icd.*.json\n");
+}
+
+static bool ParseSettings(int argc, char *argv[], BufferBenchSettings &outSettings) {
+
+	for (int i = 1; i < argc; i++) {
+
+		const char *option = argv[i];
+
+		if (i + 1 >= argc || !strcmp(option, "--help") || !strcmp(option, "-h")) {
+			return false;
+		}
+
+		const char *value = argv[++i];
+
+		if (!strcmp(option, "--min-size")) {
+			outSettings.minSize = std::strtoull(value, nullptr, 10);
+		}
+		else if (!strcmp(option, "--max-size")) {
+			outSettings.maxSize = std::strtoull(value, nullptr, 10);
+		}
+		else if (!strcmp(option, "--min-time")) {
+			outSettings.minSeconds = std::strtod(value, nullptr);
+		}
+		else if (!strcmp(option, "--max-iterations")) {
+			outSettings.maxIterations = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+		}
+		else if (!strcmp(option, "--out")) {
+			outSettings.outputPath = value;
+		}
+		else {
+			std::fprintf(stderr, "Unknown option %s\n", option);
+			return false;
+		}
+	}
+
+	// Buffer sizes are 32 bit and made of 4 byte elements
+	if (outSettings.minSize < 4u || outSettings.maxSize < outSettings.minSize || outSettings.maxSize > 0xFFFFFFFCull || !outSettings.maxIterations) {
+		std::fprintf(stderr, "Invalid buffer size range or iteration count\n");
+		return false;
+	}
+
+	return true;
+}
+
+static const char *GetTypeName(const BufferType type) {
+	switch (type)
+	{
+	case BufferType::VertexBuffer:	return "vertex";
+	case BufferType::IndexBuffer:	return "index";
+	case BufferType::UniformBuffer:	return "uniform";
+	case BufferType::StorageBuffer:	return "storage";
+	default: break;
+	}
+	return "unknown";
+}
+
+static Buffer *CreateBuffer(const BufferType type, const uint64_t size, const BufferUsage usage = BufferUsage::StaticUsage) {
+	return Buffer::Create(
+		type,
+		ShaderProgramType::VertexShader,
+		BufferLayout({ { BufferDataType::uint1, "value" } }),
+		static_cast<uint32_t>(size / 4u),
+		usage);
+}
+
+/* Repeats <operation> on buffers of <size> bytes until enough time was measured */
+static OperationResult RunOperation(
+	RenderContext *contextP,
+	const BufferOperation operation,
+	const BufferType type,
+	const uint64_t size,
+	const std::vector<uint8_t> &data,
+	const BufferBenchSettings &settings) {
+
+	OperationResult result;
+	result.size = size;
+
+	switch (operation)
+	{
+	case BufferOperation::Create:			result.name = std::string("create/") + GetTypeName(type); break;
+	case BufferOperation::SetDataHost:		result.name = "setdata/host"; break;
+	case BufferOperation::SetDataStaging:	result.name = "setdata/staging"; break;
+	case BufferOperation::SetDataDirect:	result.name = "setdata/dynamic"; break;
+	default: break;
+	}
+
+	// SetData cases reuse a single buffer, its creation is not measured
+	Buffer *bufferP = operation == BufferOperation::Create ? nullptr :
+		CreateBuffer(type, size, operation == BufferOperation::SetDataDirect ? BufferUsage::DynamicUsage : BufferUsage::StaticUsage);
+
+	if (bufferP) {
+		bufferP->SetData(data.data());
+	}
+
+	std::vector<double> samples;
+	samples.reserve(settings.maxIterations);
+
+	const RenderStats startStats = contextP->GetStats();
+	const uint64_t startHostAllocations = s_hostAllocations.load();
+	double measuredSeconds = 0.0;
+
+	while (samples.size() < settings.maxIterations && (samples.size() < settings.minIterations || measuredSeconds < settings.minSeconds)) {
+
+		const auto start = std::chrono::steady_clock::now();
+
+		if (operation == BufferOperation::Create) {
+			Buffer *createdP = CreateBuffer(type, size);
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			// Destruction only queues the release behind the frames submitted so far - the flush frees it right away,
+			// so created buffers do not pile up. Both are kept out of the sample
+			delete createdP;
+			contextP->FlushReadbacks();
+			samples.push_back(seconds * 1e6);
+			measuredSeconds += seconds;
+		}
+		else {
+			bufferP->SetData(data.data());
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			samples.push_back(seconds * 1e6);
+			measuredSeconds += seconds;
+		}
+	}
+
+	const uint64_t hostAllocations = s_hostAllocations.load() - startHostAllocations;
+	const RenderStats endStats = contextP->GetStats();
+
+	delete bufferP;
+
+	const double iterations = static_cast<double>(samples.size());
+
+	result.iterations = static_cast<uint32_t>(samples.size());
+	result.microseconds = ComputePercentiles(samples);
+	result.megabytesPerSecond = measuredSeconds > 0.0 ? (size * iterations) / (1024.0 * 1024.0) / measuredSeconds : 0.0;
+	// The vector of samples was reserved up front and does not count towards the measured allocations
+	result.hostAllocationsPerOp = hostAllocations / iterations;
+	result.memoryAllocationsPerOp = (endStats.memoryAllocations - startStats.memoryAllocations) / iterations;
+	result.driverAllocationsPerOp = (endStats.hostAllocations - startStats.hostAllocations) / iterations;
+	result.submitsPerOp = (endStats.uploadSubmits - startStats.uploadSubmits) / iterations;
+
+	return result;
+}
+
+static bool WriteResults(const std::string &path, const std::string &device, const std::vector<OperationResult> &results) {
+
+	FILE *fileP = std::fopen(path.c_str(), "w");
+
+	if (!fileP) {
+		std::fprintf(stderr, "Benchmark report %s could not be created\n", path.c_str());
+		return false;
+	}
+
+	std::fprintf(fileP, "{\n  \"device\": %s,\n  \"operations\": [", JsonQuote(device).c_str());
+
+	for (size_t i = 0; i < results.size(); i++) {
+
+		const OperationResult &result = results[i];
+
+		std::fprintf(fileP, "%s\n    {\"name\": %s, \"size\": %llu, \"iterations\": %u, ", i ? "," : "",
+			JsonQuote(result.name).c_str(), static_cast<unsigned long long>(result.size), result.iterations);
+		std::fprintf(fileP, "\"meanUs\": %.3f, \"p50Us\": %.3f, \"p95Us\": %.3f, \"p99Us\": %.3f, ",
+			result.microseconds.mean, result.microseconds.p50, result.microseconds.p95, result.microseconds.p99);
+		std::fprintf(fileP, "\"megabytesPerSecond\": %.3f, \"hostAllocationsPerOp\": %.3f, \"driverAllocationsPerOp\": %.3f, \"memoryAllocationsPerOp\": %.3f, \"submitsPerOp\": %.3f}",
+			result.megabytesPerSecond, result.hostAllocationsPerOp, result.driverAllocationsPerOp, result.memoryAllocationsPerOp, result.submitsPerOp);
+	}
+
+	std::fprintf(fileP, "\n  ]\n}\n");
+
+	return std::fclose(fileP) == 0;
+}
+
+static int RunBenchmarks(const BufferBenchSettings &settings) {
+
+	// Buffers need a device only - no render target is created
+	RenderContext::Initialize(nullptr);
+	RenderContext *contextP = RenderContext::Get();
+
+	const std::string device = contextP->GetDeviceName();
+	const std::vector<uint8_t> data(settings.maxSize, 0x5Au);
+	std::vector<OperationResult> results;
+
+	std::printf("Device: %s\n", device.c_str());
+	std::printf("%-16s %10s %7s %10s %10s %10s %10s %7s %7s %7s %7s\n",
+		"operation", "bytes", "iters", "mean us", "p50 us", "p95 us", "MB/s", "allocs", "driver", "vkmem", "submits");
+
+	for (uint64_t size = settings.minSize & ~3ull; size <= settings.maxSize; size *= 4u) {
+
+		const std::pair<BufferOperation, BufferType> cases[] = {
+			{ BufferOperation::Create, BufferType::VertexBuffer },
+			{ BufferOperation::Create, BufferType::IndexBuffer },
+			{ BufferOperation::Create, BufferType::UniformBuffer },
+			{ BufferOperation::Create, BufferType::StorageBuffer },
+			// Uniform buffers are the host visible VlkBuffer, the other types upload through VlkStagingBuffer
+			{ BufferOperation::SetDataHost, BufferType::UniformBuffer },
+			{ BufferOperation::SetDataStaging, BufferType::VertexBuffer },
+			// Written in place with resizable BAR, falls back to staging for sizes the BAR window cannot hold
+			{ BufferOperation::SetDataDirect, BufferType::VertexBuffer }
+		};
+
+		for (auto &operationCase : cases) {
+
+			results.push_back(RunOperation(contextP, operationCase.first, operationCase.second, size, data, settings));
+
+			const OperationResult &result = results.back();
+			std::printf("%-16s %10llu %7u %10.2f %10.2f %10.2f %10.1f %7.2f %7.2f %7.2f %7.2f\n",
+				result.name.c_str(), static_cast<unsigned long long>(result.size), result.iterations,
+				result.microseconds.mean, result.microseconds.p50, result.microseconds.p95, result.megabytesPerSecond,
+				result.hostAllocationsPerOp, result.driverAllocationsPerOp, result.memoryAllocationsPerOp, result.submitsPerOp);
+		}
+	}
+
+	const MemoryTelemetry telemetry = contextP->GetMemoryTelemetry();
+
+	std::printf("\n%-6s %6s %12s %12s %12s %12s\n", "heap", "local", "size MB", "budget MB", "usage MB", "peak MB");
+
+	for (auto &heap : telemetry.heaps) {
+		std::printf("%-6u %6s %12.1f %12.1f %12.1f %12.1f\n", heap.heapIndex, heap.deviceLocal ? "yes" : "no",
+			heap.size / (1024.0 * 1024.0), heap.budget / (1024.0 * 1024.0), heap.usage / (1024.0 * 1024.0), heap.peakAllocatedBytes / (1024.0 * 1024.0));
+	}
+
+	if (!telemetry.budgetSupported) {
+		std::printf("VK_EXT_memory_budget unavailable - budgets are heap sizes and usage counts own allocations only\n");
+	}
+
+	RenderContext::Destroy();
+
+	if (settings.outputPath.size() && !WriteResults(settings.outputPath, device, results)) {
+		return 1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+
+	BufferBenchSettings settings;
+
+	if (!ParseSettings(argc, argv, settings)) {
+		PrintUsage();
+		return 1;
+	}
+
+	try {
+		return RunBenchmarks(settings);
+	}
+	catch (std::runtime_error *errorP) {
+		std::fprintf(stderr, "Benchmark failed: %s\n", errorP->what());
+		delete errorP;
+	}
+	catch (const std::runtime_error &error) {
+		std::fprintf(stderr, "Benchmark failed: %s\n", error.what());
+	}
+
+	return 1;
+}
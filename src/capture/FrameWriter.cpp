@@ -0,0 +1,260 @@
+#include "FrameWriter.h"
+#include "ImageEncoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace PixelMachine {
+	namespace Capture {
+
+		FrameWriter::FrameWriter(const FrameWriterSettings &settings) :
+			m_settings(settings),
+			m_jobs(std::max(settings.queueDepth, 1u)),
+			m_pending(m_jobs.size()) {
+
+			if (m_settings.format == FrameOutputFormat::Y4MStream) {
+				m_streamFileP = std::fopen(m_settings.outputPath.c_str(), "wb");
+				if (!m_streamFileP) {
+					throw new std::runtime_error("FrameWriter creation failed - unable to open output stream.");
+				}
+				// Large stdio buffer so a batch of frames reaches the disk in few system calls
+				m_streamBuffer.resize(8u << 20u);
+				std::setvbuf(m_streamFileP, m_streamBuffer.data(), _IOFBF, m_streamBuffer.size());
+			}
+
+			uint32_t workerCount = m_settings.workerCount;
+			if (!workerCount) {
+				const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+				workerCount = hardwareThreads > 2u ? hardwareThreads - 2u : 1u;
+			}
+
+			for (uint32_t i = 0; i < workerCount; i++) {
+				m_workers.emplace_back(&FrameWriter::WorkerLoop, this);
+			}
+			m_writer = std::thread(&FrameWriter::WriterLoop, this);
+		}
+
+		FrameWriter::~FrameWriter() {
+
+			Finish();
+
+			if (m_streamFileP) {
+				std::fclose(m_streamFileP);
+			}
+		}
+
+		int32_t FrameWriter::FindJob(const JobState state, const uint64_t sequence) const {
+			for (int32_t i = 0; i < m_jobs.size(); i++) {
+				if (m_jobs[i].m_state == state && (state == JobState::Free || m_jobs[i].m_sequence == sequence)) {
+					return i;
+				}
+			}
+			return -1;
+		}
+
+		bool FrameWriter::Submit(const GPU::FrameReadback &frame, const bool wait) {
+
+			if (!frame.pixels || !frame.width || !frame.height) {
+				return false;
+			}
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			if (m_stopping) {
+				return false;
+			}
+
+			int32_t jobIndex = FindJob(JobState::Free, 0u);
+
+			if (jobIndex < 0) {
+				if (!wait) {
+					m_stats.framesDropped++;
+					return false;
+				}
+				const auto waitStart = std::chrono::steady_clock::now();
+				m_slotFreed.wait(lock, [&] { return (jobIndex = FindJob(JobState::Free, 0u)) >= 0; });
+				m_stats.submitWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+			}
+
+			FrameJob &job = m_jobs[jobIndex];
+			job.m_state = JobState::Copying;
+			job.m_sequence = m_nextSubmitSequence++;
+			m_copyingCount++;
+			m_stats.framesSubmitted++;
+			lock.unlock();
+
+			// Tightly packed copy - the readback memory is recycled as soon as the callback returns
+			const uint32_t rowSize = frame.width * 4u;
+			job.m_pixels.resize(static_cast<size_t>(rowSize) * frame.height);
+			for (uint32_t y = 0; y < frame.height; y++) {
+				std::memcpy(&job.m_pixels[static_cast<size_t>(y) * rowSize], frame.pixels + static_cast<size_t>(y) * frame.rowPitch, rowSize);
+			}
+
+			job.m_frame = frame;
+			job.m_frame.rowPitch = rowSize;
+			job.m_frame.pixels = job.m_pixels.data();
+
+			lock.lock();
+			job.m_state = JobState::Queued;
+			m_pending[(m_pendingHead + m_pendingCount) % m_pending.size()] = jobIndex;
+			m_pendingCount++;
+			m_copyingCount--;
+			m_workAvailable.notify_one();
+
+			return true;
+		}
+
+		void FrameWriter::WorkerLoop() {
+
+			ImageEncoder encoder;
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			while (true) {
+
+				// Workers only leave once no frame can still be queued by a Submit in progress
+				m_workAvailable.wait(lock, [&] { return m_pendingCount || (m_stopping && !m_copyingCount); });
+
+				if (!m_pendingCount) {
+					break;
+				}
+
+				FrameJob &job = m_jobs[m_pending[m_pendingHead]];
+				m_pendingHead = (m_pendingHead + 1u) % m_pending.size();
+				m_pendingCount--;
+				job.m_state = JobState::Encoding;
+				lock.unlock();
+
+				job.m_encoded.clear();
+				switch (m_settings.format)
+				{
+				case FrameOutputFormat::PPMSequence:	encoder.EncodePPM(job.m_frame, job.m_encoded); break;
+				case FrameOutputFormat::PNGSequence:	encoder.EncodePNG(job.m_frame, job.m_encoded, m_settings.compressionLevel); break;
+				case FrameOutputFormat::Y4MStream:		encoder.EncodeY4MFrame(job.m_frame, job.m_encoded); break;
+				default: break;
+				}
+
+				lock.lock();
+				job.m_state = JobState::Encoded;
+				m_jobEncoded.notify_one();
+			}
+		}
+
+		bool FrameWriter::WriteJob(const FrameJob &job) {
+
+			if (m_settings.format == FrameOutputFormat::Y4MStream) {
+
+				if (!m_streamWidth) {
+					m_streamWidth = job.m_frame.width;
+					m_streamHeight = job.m_frame.height;
+					std::fprintf(m_streamFileP, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", m_streamWidth, m_streamHeight, m_settings.frameRate);
+				}
+
+				// A raw stream cannot change resolution mid-way
+				if (job.m_frame.width != m_streamWidth || job.m_frame.height != m_streamHeight) {
+					return false;
+				}
+
+				return std::fwrite(job.m_encoded.data(), 1u, job.m_encoded.size(), m_streamFileP) == job.m_encoded.size();
+			}
+
+			char fileName[32];
+			std::snprintf(fileName, sizeof(fileName), "_%06llu.%s",
+				static_cast<unsigned long long>(job.m_sequence),
+				m_settings.format == FrameOutputFormat::PNGSequence ? "png" : "ppm");
+
+			std::FILE *fileP = std::fopen((m_settings.outputPath + fileName).c_str(), "wb");
+
+			if (!fileP) {
+				return false;
+			}
+
+			const bool written = std::fwrite(job.m_encoded.data(), 1u, job.m_encoded.size(), fileP) == job.m_encoded.size();
+			std::fclose(fileP);
+
+			return written;
+		}
+
+		void FrameWriter::WriterLoop() {
+
+			std::vector<uint32_t> batch;
+			batch.reserve(m_jobs.size());
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			while (true) {
+
+				m_jobEncoded.wait(lock, [&] {
+					return FindJob(JobState::Encoded, m_nextWriteSequence) >= 0 ||
+						(m_stopping && m_nextWriteSequence == m_nextSubmitSequence);
+				});
+
+				// Drain every frame that is ready in order, then hit the disk once for the whole batch
+				batch.clear();
+				for (int32_t i = FindJob(JobState::Encoded, m_nextWriteSequence); i >= 0; i = FindJob(JobState::Encoded, m_nextWriteSequence)) {
+					m_jobs[i].m_state = JobState::Writing;
+					m_nextWriteSequence++;
+					batch.push_back(i);
+				}
+
+				if (batch.empty()) {
+					break;
+				}
+
+				lock.unlock();
+
+				uint64_t bytesWritten = 0u;
+				uint64_t framesWritten = 0u;
+				for (auto index : batch) {
+					if (WriteJob(m_jobs[index])) {
+						bytesWritten += m_jobs[index].m_encoded.size();
+						framesWritten++;
+					}
+				}
+
+				if (m_streamFileP) {
+					std::fflush(m_streamFileP);
+				}
+
+				lock.lock();
+
+				for (auto index : batch) {
+					m_jobs[index].m_state = JobState::Free;
+				}
+
+				m_stats.framesWritten += framesWritten;
+				m_stats.framesDropped += batch.size() - framesWritten;
+				m_stats.bytesWritten += bytesWritten;
+				m_stats.writeBatches++;
+				m_slotFreed.notify_all();
+			}
+		}
+
+		void FrameWriter::Finish() {
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_stopping) {
+					return;
+				}
+				m_stopping = true;
+			}
+
+			m_workAvailable.notify_all();
+			for (auto &worker : m_workers) {
+				worker.join();
+			}
+
+			m_jobEncoded.notify_all();
+			m_writer.join();
+
+			m_workers.clear();
+		}
+
+		FrameWriterStats FrameWriter::GetStats() const {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_stats;
+		}
+	}
+}
@@ -0,0 +1,111 @@
+#ifndef FRAME_WRITER_H_
+#define FRAME_WRITER_H_
+
+#include <gpu/RenderContext.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace PixelMachine {
+	namespace Capture {
+
+		enum FrameOutputFormat {
+			PPMSequence,
+			PNGSequence,
+			Y4MStream
+		};
+
+		struct FrameWriterSettings {
+			FrameOutputFormat format = FrameOutputFormat::PNGSequence;
+			// File name prefix for image sequences (<path>_000000.png), target file for streams
+			std::string outputPath = "frame";
+			// 0 - use all hardware threads except the render and writer threads
+			uint32_t workerCount = 0u;
+			// Number of frames that may be queued before Submit applies backpressure
+			uint32_t queueDepth = 8u;
+			uint32_t compressionLevel = 1u;
+			uint32_t frameRate = 60u;
+		};
+
+		struct FrameWriterStats {
+			uint64_t framesSubmitted = 0u;
+			uint64_t framesWritten = 0u;
+			uint64_t framesDropped = 0u;
+			uint64_t bytesWritten = 0u;
+			uint64_t writeBatches = 0u;
+			double submitWaitMs = 0.0;
+		};
+
+		/// <summary>
+		/// Output stage for read-back frames. Frames are copied into a fixed pool
+		/// of slots, encoded on a worker pool and written to disk in submission
+		/// order by a single writer thread that drains every finished frame in
+		/// one batch. When all slots are busy Submit blocks the renderer.
+		/// </summary>
+		class FrameWriter {
+		public:
+			FrameWriter(const FrameWriterSettings &settings);
+			~FrameWriter();
+			/* Copies <frame> into a free slot and queues it for encoding. Blocks while every slot is busy,
+			 unless <wait> is false - then the frame is dropped and false is returned */
+			bool Submit(const GPU::FrameReadback &frame, const bool wait = true);
+			/* Waits until every submitted frame is written and stops all threads */
+			void Finish();
+			FrameWriterStats GetStats() const;
+
+		private:
+			enum JobState {
+				Free,
+				Copying,
+				Queued,
+				Encoding,
+				Encoded,
+				Writing
+			};
+
+			struct FrameJob {
+				JobState m_state = JobState::Free;
+				uint64_t m_sequence = 0u;
+				GPU::FrameReadback m_frame;
+				// Both buffers keep their capacity between frames
+				std::vector<uint8_t> m_pixels;
+				std::vector<uint8_t> m_encoded;
+			};
+
+			int32_t FindJob(const JobState state, const uint64_t sequence) const;
+			void WorkerLoop();
+			void WriterLoop();
+			bool WriteJob(const FrameJob &job);
+
+			FrameWriterSettings m_settings;
+			std::vector<FrameJob> m_jobs;
+			// Fixed-size ring of job indices waiting for a worker
+			std::vector<uint32_t> m_pending;
+			uint32_t m_pendingHead = 0u;
+			uint32_t m_pendingCount = 0u;
+			uint32_t m_copyingCount = 0u;
+			uint64_t m_nextSubmitSequence = 0u;
+			uint64_t m_nextWriteSequence = 0u;
+			bool m_stopping = false;
+
+			std::FILE *m_streamFileP = nullptr;
+			std::vector<char> m_streamBuffer;
+			uint32_t m_streamWidth = 0u;
+			uint32_t m_streamHeight = 0u;
+
+			FrameWriterStats m_stats;
+			mutable std::mutex m_mutex;
+			std::condition_variable m_slotFreed;
+			std::condition_variable m_workAvailable;
+			std::condition_variable m_jobEncoded;
+			std::vector<std::thread> m_workers;
+			std::thread m_writer;
+		};
+	}
+}
+
+#endif // !FRAME_WRITER_H_
@@ -0,0 +1,459 @@
+#include "ImageEncoder.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace PixelMachine {
+	namespace Capture {
+
+		static constexpr int32_t s_windowSize = 32768;
+		static constexpr int32_t s_windowMask = s_windowSize - 1;
+		static constexpr uint32_t s_hashBits = 15u;
+		static constexpr uint32_t s_minMatch = 3u;
+		static constexpr uint32_t s_maxMatch = 258u;
+
+		static const uint16_t s_lengthBase[29] = {
+			3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+			35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static const uint8_t s_lengthExtra[29] = {
+			0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+			3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static const uint16_t s_distanceBase[30] = {
+			1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+			257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		static const uint8_t s_distanceExtra[30] = {
+			0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+			7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		/* Deflate bit stream - bits are packed starting from the least significant bit */
+		class BitWriter {
+		public:
+			BitWriter(std::vector<uint8_t> &output) : m_output(output) {}
+
+			void Write(const uint32_t bits, const uint32_t count) {
+				m_buffer |= static_cast<uint64_t>(bits) << m_count;
+				m_count += count;
+				while (m_count >= 8u) {
+					m_output.push_back(static_cast<uint8_t>(m_buffer));
+					m_buffer >>= 8u;
+					m_count -= 8u;
+				}
+			}
+
+			/* Huffman codes are defined most significant bit first */
+			void WriteCode(const uint32_t code, const uint32_t length) {
+				uint32_t reversed = 0u;
+				for (uint32_t i = 0; i < length; i++) {
+					reversed = (reversed << 1u) | ((code >> i) & 1u);
+				}
+				Write(reversed, length);
+			}
+
+			void Flush() {
+				if (m_count) {
+					m_output.push_back(static_cast<uint8_t>(m_buffer));
+				}
+				m_buffer = 0u;
+				m_count = 0u;
+			}
+
+		private:
+			std::vector<uint8_t> &m_output;
+			uint64_t m_buffer = 0u;
+			uint32_t m_count = 0u;
+		};
+
+		/* Fixed Huffman literal/length alphabet (RFC 1951, 3.2.6) */
+		static void WriteFixedLiteral(BitWriter &writer, const uint32_t value) {
+			if (value < 144u) {
+				writer.WriteCode(0x30u + value, 8u);
+			}
+			else if (value < 256u) {
+				writer.WriteCode(0x190u + value - 144u, 9u);
+			}
+			else if (value < 280u) {
+				writer.WriteCode(value - 256u, 7u);
+			}
+			else {
+				writer.WriteCode(0xC0u + value - 280u, 8u);
+			}
+		}
+
+		static void WriteFixedMatch(BitWriter &writer, const uint32_t length, const uint32_t distance) {
+
+			uint32_t lengthSymbol = 28u;
+			while (s_lengthBase[lengthSymbol] > length) {
+				lengthSymbol--;
+			}
+
+			uint32_t distanceSymbol = 29u;
+			while (s_distanceBase[distanceSymbol] > distance) {
+				distanceSymbol--;
+			}
+
+			WriteFixedLiteral(writer, 257u + lengthSymbol);
+			writer.Write(length - s_lengthBase[lengthSymbol], s_lengthExtra[lengthSymbol]);
+			writer.WriteCode(distanceSymbol, 5u);
+			writer.Write(distance - s_distanceBase[distanceSymbol], s_distanceExtra[distanceSymbol]);
+		}
+
+		static uint32_t GetMaxChain(const uint32_t level) {
+			static const uint32_t chains[10] = { 4, 8, 16, 32, 64, 128, 256, 512, 1024, 4096 };
+			return chains[std::min(level, 9u)];
+		}
+
+		static inline uint32_t Hash3(const uint8_t *data) {
+			return ((data[0] << 10u) ^ (data[1] << 5u) ^ data[2]) & ((1u << s_hashBits) - 1u);
+		}
+
+		static inline void AppendU32BE(std::vector<uint8_t> &output, const uint32_t value) {
+			output.push_back(static_cast<uint8_t>(value >> 24u));
+			output.push_back(static_cast<uint8_t>(value >> 16u));
+			output.push_back(static_cast<uint8_t>(value >> 8u));
+			output.push_back(static_cast<uint8_t>(value));
+		}
+
+		static inline void AppendString(std::vector<uint8_t> &output, const char *text, const size_t size) {
+			output.insert(output.end(), text, text + size);
+		}
+
+		static inline void AppendChunk(std::vector<uint8_t> &output, const char type[4], const uint8_t *data, const uint32_t size) {
+			AppendU32BE(output, size);
+			const size_t typeOffset = output.size();
+			AppendString(output, type, 4u);
+			output.insert(output.end(), data, data + size);
+			AppendU32BE(output, ImageEncoder::Crc32(output.data() + typeOffset, size + 4u));
+		}
+
+		/* Converts a read-back pixel to RGB regardless of the channel order of the source */
+		static inline void LoadRGB(const GPU::FrameReadback &frame, const uint8_t *pixel, uint8_t rgb[3]) {
+			if (frame.format == GPU::FramePixelFormat::BGRA8) {
+				rgb[0] = pixel[2];
+				rgb[1] = pixel[1];
+				rgb[2] = pixel[0];
+			}
+			else {
+				rgb[0] = pixel[0];
+				rgb[1] = pixel[1];
+				rgb[2] = pixel[2];
+			}
+		}
+
+		static inline uint8_t Paeth(const int32_t a, const int32_t b, const int32_t c) {
+			const int32_t p = a + b - c;
+			const int32_t pa = std::abs(p - a);
+			const int32_t pb = std::abs(p - b);
+			const int32_t pc = std::abs(p - c);
+			if (pa <= pb && pa <= pc) {
+				return static_cast<uint8_t>(a);
+			}
+			return static_cast<uint8_t>(pb <= pc ? b : c);
+		}
+
+		ImageEncoder::ImageEncoder() :
+			m_hashHead(1u << s_hashBits),
+			m_hashPrev(s_windowSize) {}
+
+		uint32_t ImageEncoder::Crc32(const uint8_t *data, const size_t size, const uint32_t crc) {
+
+			static const std::array<uint32_t, 256> table = [] {
+				std::array<uint32_t, 256> result = {};
+				for (uint32_t i = 0; i < 256u; i++) {
+					uint32_t c = i;
+					for (uint32_t k = 0; k < 8u; k++) {
+						c = (c & 1u) ? 0xEDB88320u ^ (c >> 1u) : c >> 1u;
+					}
+					result[i] = c;
+				}
+				return result;
+			}();
+
+			uint32_t c = crc ^ 0xFFFFFFFFu;
+			for (size_t i = 0; i < size; i++) {
+				c = table[(c ^ data[i]) & 0xFFu] ^ (c >> 8u);
+			}
+			return c ^ 0xFFFFFFFFu;
+		}
+
+		uint32_t ImageEncoder::Adler32(const uint8_t *data, const size_t size, const uint32_t adler) {
+
+			constexpr uint32_t modulo = 65521u;
+			// Largest block that cannot overflow 32-bit sums before the modulo
+			constexpr size_t blockSize = 5552u;
+
+			uint32_t a = adler & 0xFFFFu;
+			uint32_t b = adler >> 16u;
+			size_t offset = 0;
+
+			while (offset < size) {
+				const size_t end = std::min(size, offset + blockSize);
+				for (; offset < end; offset++) {
+					a += data[offset];
+					b += a;
+				}
+				a %= modulo;
+				b %= modulo;
+			}
+
+			return (b << 16u) | a;
+		}
+
+		void ImageEncoder::EncodePPM(const GPU::FrameReadback &frame, std::vector<uint8_t> &output) {
+
+			char header[64];
+			const int headerSize = std::snprintf(header, sizeof(header), "P6\n%u %u\n255\n", frame.width, frame.height);
+			AppendString(output, header, headerSize);
+
+			size_t offset = output.size();
+			output.resize(offset + static_cast<size_t>(frame.width) * frame.height * 3u);
+
+			for (uint32_t y = 0; y < frame.height; y++) {
+				const uint8_t *row = frame.pixels + static_cast<size_t>(y) * frame.rowPitch;
+				for (uint32_t x = 0; x < frame.width; x++) {
+					LoadRGB(frame, row + x * 4u, &output[offset]);
+					offset += 3u;
+				}
+			}
+		}
+
+		void ImageEncoder::FilterRows(const GPU::FrameReadback &frame, const bool adaptive) {
+
+			const size_t rowSize = static_cast<size_t>(frame.width) * 3u;
+
+			m_rgb.resize(rowSize * frame.height);
+			m_filtered.resize((rowSize + 1u) * frame.height);
+			m_rowCandidates.resize(rowSize * 5u);
+
+			for (uint32_t y = 0; y < frame.height; y++) {
+				const uint8_t *row = frame.pixels + static_cast<size_t>(y) * frame.rowPitch;
+				uint8_t *rgb = &m_rgb[rowSize * y];
+				for (uint32_t x = 0; x < frame.width; x++) {
+					LoadRGB(frame, row + x * 4u, rgb + x * 3u);
+				}
+			}
+
+			for (uint32_t y = 0; y < frame.height; y++) {
+
+				const uint8_t *current = &m_rgb[rowSize * y];
+				uint8_t *filtered = &m_filtered[(rowSize + 1u) * y];
+
+				if (!adaptive) {
+					filtered[0] = 0u;
+					std::memcpy(filtered + 1u, current, rowSize);
+					continue;
+				}
+
+				const uint8_t *previous = y ? &m_rgb[rowSize * (y - 1u)] : nullptr;
+
+				// Candidate rows for filter types None, Sub, Up, Average and Paeth
+				uint8_t *candidates[5];
+				for (uint32_t f = 0; f < 5u; f++) {
+					candidates[f] = &m_rowCandidates[rowSize * f];
+				}
+
+				for (size_t i = 0; i < rowSize; i++) {
+					const int32_t a = i >= 3u ? current[i - 3u] : 0;
+					const int32_t b = previous ? previous[i] : 0;
+					const int32_t c = (previous && i >= 3u) ? previous[i - 3u] : 0;
+					candidates[0][i] = current[i];
+					candidates[1][i] = static_cast<uint8_t>(current[i] - a);
+					candidates[2][i] = static_cast<uint8_t>(current[i] - b);
+					candidates[3][i] = static_cast<uint8_t>(current[i] - ((a + b) >> 1));
+					candidates[4][i] = static_cast<uint8_t>(current[i] - Paeth(a, b, c));
+				}
+
+				// Minimum sum of absolute differences heuristic (PNG specification, 12.8)
+				uint32_t bestFilter = 0u;
+				uint64_t bestScore = UINT64_MAX;
+				for (uint32_t f = 0; f < 5u; f++) {
+					uint64_t score = 0u;
+					for (size_t i = 0; i < rowSize; i++) {
+						score += std::abs(static_cast<int8_t>(candidates[f][i]));
+					}
+					if (score < bestScore) {
+						bestScore = score;
+						bestFilter = f;
+					}
+				}
+
+				filtered[0] = static_cast<uint8_t>(bestFilter);
+				std::memcpy(filtered + 1u, candidates[bestFilter], rowSize);
+			}
+		}
+
+		void ImageEncoder::Deflate(const uint8_t *data, const size_t size, const uint32_t level, std::vector<uint8_t> &output) {
+
+			// zlib header - 32K window, deflate, fastest-compression hint
+			output.push_back(0x78u);
+			output.push_back(0x01u);
+
+			BitWriter writer(output);
+
+			// Single final block with the fixed Huffman tables
+			writer.Write(1u, 1u);
+			writer.Write(1u, 2u);
+
+			std::fill(m_hashHead.begin(), m_hashHead.end(), -1);
+
+			const uint32_t maxChain = GetMaxChain(level);
+			size_t position = 0;
+
+			auto insert = [&](const size_t at) {
+				const uint32_t hash = Hash3(data + at);
+				m_hashPrev[at & s_windowMask] = m_hashHead[hash];
+				m_hashHead[hash] = static_cast<int32_t>(at);
+			};
+
+			while (position < size) {
+
+				uint32_t bestLength = 0u;
+				uint32_t bestDistance = 0u;
+
+				if (position + s_minMatch <= size) {
+
+					const uint32_t maxLength = static_cast<uint32_t>(std::min<size_t>(s_maxMatch, size - position));
+					int32_t candidate = m_hashHead[Hash3(data + position)];
+					uint32_t chain = maxChain;
+
+					while (candidate >= 0 && position - candidate < s_windowSize && chain--) {
+
+						if (data[candidate + bestLength] == data[position + bestLength]) {
+							uint32_t length = 0u;
+							while (length < maxLength && data[candidate + length] == data[position + length]) {
+								length++;
+							}
+							if (length > bestLength) {
+								bestLength = length;
+								bestDistance = static_cast<uint32_t>(position - candidate);
+								if (length == maxLength) {
+									break;
+								}
+							}
+						}
+
+						const int32_t next = m_hashPrev[candidate & s_windowMask];
+						if (next >= candidate) {
+							break;
+						}
+						candidate = next;
+					}
+
+					insert(position);
+				}
+
+				if (bestLength >= s_minMatch) {
+					WriteFixedMatch(writer, bestLength, bestDistance);
+					for (size_t i = position + 1u; i < position + bestLength && i + s_minMatch <= size; i++) {
+						insert(i);
+					}
+					position += bestLength;
+				}
+				else {
+					WriteFixedLiteral(writer, data[position]);
+					position++;
+				}
+			}
+
+			// End of block
+			WriteFixedLiteral(writer, 256u);
+			writer.Flush();
+
+			AppendU32BE(output, Adler32(data, size));
+		}
+
+		void ImageEncoder::EncodePNG(const GPU::FrameReadback &frame, std::vector<uint8_t> &output, const uint32_t level) {
+
+			static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+			output.insert(output.end(), signature, signature + sizeof(signature));
+
+			uint8_t header[13] = {};
+			header[0] = static_cast<uint8_t>(frame.width >> 24u);
+			header[1] = static_cast<uint8_t>(frame.width >> 16u);
+			header[2] = static_cast<uint8_t>(frame.width >> 8u);
+			header[3] = static_cast<uint8_t>(frame.width);
+			header[4] = static_cast<uint8_t>(frame.height >> 24u);
+			header[5] = static_cast<uint8_t>(frame.height >> 16u);
+			header[6] = static_cast<uint8_t>(frame.height >> 8u);
+			header[7] = static_cast<uint8_t>(frame.height);
+			header[8] = 8u;		// Bit depth
+			header[9] = 2u;		// Truecolor (RGB)
+			AppendChunk(output, "IHDR", header, sizeof(header));
+
+			FilterRows(frame, level > 0u);
+
+			// IDAT is compressed in place after a placeholder length, avoiding a second copy of the stream
+			const size_t lengthOffset = output.size();
+			AppendU32BE(output, 0u);
+			AppendString(output, "IDAT", 4u);
+			Deflate(m_filtered.data(), m_filtered.size(), level, output);
+
+			const uint32_t dataSize = static_cast<uint32_t>(output.size() - lengthOffset - 8u);
+			output[lengthOffset + 0u] = static_cast<uint8_t>(dataSize >> 24u);
+			output[lengthOffset + 1u] = static_cast<uint8_t>(dataSize >> 16u);
+			output[lengthOffset + 2u] = static_cast<uint8_t>(dataSize >> 8u);
+			output[lengthOffset + 3u] = static_cast<uint8_t>(dataSize);
+			AppendU32BE(output, Crc32(output.data() + lengthOffset + 4u, dataSize + 4u));
+
+			AppendChunk(output, "IEND", nullptr, 0u);
+		}
+
+		void ImageEncoder::EncodeY4MFrame(const GPU::FrameReadback &frame, std::vector<uint8_t> &output) {
+
+			AppendString(output, "FRAME\n", 6u);
+
+			const uint32_t chromaWidth = (frame.width + 1u) / 2u;
+			const uint32_t chromaHeight = (frame.height + 1u) / 2u;
+			const size_t lumaSize = static_cast<size_t>(frame.width) * frame.height;
+			const size_t chromaSize = static_cast<size_t>(chromaWidth) * chromaHeight;
+
+			const size_t offset = output.size();
+			output.resize(offset + lumaSize + chromaSize * 2u);
+
+			uint8_t *lumaPlane = &output[offset];
+			uint8_t *cbPlane = lumaPlane + lumaSize;
+			uint8_t *crPlane = cbPlane + chromaSize;
+
+			for (uint32_t y = 0; y < frame.height; y++) {
+				const uint8_t *row = frame.pixels + static_cast<size_t>(y) * frame.rowPitch;
+				for (uint32_t x = 0; x < frame.width; x++) {
+					uint8_t rgb[3];
+					LoadRGB(frame, row + x * 4u, rgb);
+					lumaPlane[static_cast<size_t>(y) * frame.width + x] =
+						static_cast<uint8_t>((77 * rgb[0] + 150 * rgb[1] + 29 * rgb[2] + 128) >> 8);
+				}
+			}
+
+			for (uint32_t cy = 0; cy < chromaHeight; cy++) {
+				for (uint32_t cx = 0; cx < chromaWidth; cx++) {
+
+					// Average the 2x2 block, clamping at odd edges
+					int32_t sum[3] = { 0, 0, 0 };
+					for (uint32_t dy = 0; dy < 2u; dy++) {
+						const uint32_t y = std::min(cy * 2u + dy, frame.height - 1u);
+						const uint8_t *row = frame.pixels + static_cast<size_t>(y) * frame.rowPitch;
+						for (uint32_t dx = 0; dx < 2u; dx++) {
+							const uint32_t x = std::min(cx * 2u + dx, frame.width - 1u);
+							uint8_t rgb[3];
+							LoadRGB(frame, row + x * 4u, rgb);
+							sum[0] += rgb[0];
+							sum[1] += rgb[1];
+							sum[2] += rgb[2];
+						}
+					}
+
+					const int32_t r = (sum[0] + 2) >> 2;
+					const int32_t g = (sum[1] + 2) >> 2;
+					const int32_t b = (sum[2] + 2) >> 2;
+					const int32_t cb = ((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128;
+					const int32_t cr = ((128 * r - 107 * g - 21 * b + 128) >> 8) + 128;
+
+					cbPlane[static_cast<size_t>(cy) * chromaWidth + cx] = static_cast<uint8_t>(std::clamp(cb, 0, 255));
+					crPlane[static_cast<size_t>(cy) * chromaWidth + cx] = static_cast<uint8_t>(std::clamp(cr, 0, 255));
+				}
+			}
+		}
+	}
+}
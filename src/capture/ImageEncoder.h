@@ -0,0 +1,44 @@
+#ifndef IMAGE_ENCODER_H_
+#define IMAGE_ENCODER_H_
+
+#include <gpu/RenderContext.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace PixelMachine {
+	namespace Capture {
+
+		/// <summary>
+		/// Stateless-per-call image encoder. Each worker owns one instance so the
+		/// LZ77 match tables and row scratch are allocated once and reused for
+		/// every frame it encodes.
+		/// </summary>
+		class ImageEncoder {
+		public:
+			ImageEncoder();
+			/* Appends a binary PPM (P6) image to <output> */
+			void EncodePPM(const GPU::FrameReadback &frame, std::vector<uint8_t> &output);
+			/* Appends an RGB8 PNG image to <output>. <level> 0 stores rows unfiltered with the fastest match search */
+			void EncodePNG(const GPU::FrameReadback &frame, std::vector<uint8_t> &output, const uint32_t level);
+			/* Appends a Y4M "FRAME" record holding a 4:2:0 full-range BT.601 conversion of <frame> */
+			void EncodeY4MFrame(const GPU::FrameReadback &frame, std::vector<uint8_t> &output);
+
+			static uint32_t Crc32(const uint8_t *data, const size_t size, const uint32_t crc = 0u);
+			static uint32_t Adler32(const uint8_t *data, const size_t size, const uint32_t adler = 1u);
+
+		private:
+			void FilterRows(const GPU::FrameReadback &frame, const bool adaptive);
+			void Deflate(const uint8_t *data, const size_t size, const uint32_t level, std::vector<uint8_t> &output);
+
+			// Tightly packed RGB copy of the frame and its filtered scanlines (filter byte + row)
+			std::vector<uint8_t> m_rgb;
+			std::vector<uint8_t> m_filtered;
+			std::vector<uint8_t> m_rowCandidates;
+			std::vector<int32_t> m_hashHead;
+			std::vector<int32_t> m_hashPrev;
+		};
+	}
+}
+
+#endif // !IMAGE_ENCODER_H_
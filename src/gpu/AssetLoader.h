@@ -0,0 +1,81 @@
+#ifndef ASSET_LOADER_H_
+#define ASSET_LOADER_H_
+
+#include "Buffer.h"
+#include "FileReader.h"
+#include "ShaderProgram.h"
+#include "Texture.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		struct AssetLoaderStats {
+			// Loads waiting for staging memory or being read
+			uint32_t pendingLoads = 0;
+			uint64_t completedLoads = 0;
+			uint64_t cancelledLoads = 0;
+			uint64_t failedLoads = 0;
+			uint64_t loadedBytes = 0;
+			// Staging and heap memory of the reads in flight, and the limit it is kept within
+			uint64_t inFlightBytes = 0;
+			uint64_t inFlightLimit = 0;
+			bool usingIoUring = false;
+		};
+
+		/// <summary>
+		/// Loads file contents into textures, buffers and shader programs without blocking the render thread.
+		/// Reads are queued by priority and land straight in staging memory of the upload batcher, completed ones
+		/// are copied in the next upload batch - hundreds of files can be in flight while frames keep rendering.
+		/// Requests, cancellation, Update and the callbacks all belong to the render thread. Textures and buffers
+		/// must outlive their loads or have them cancelled first, the loader must be destroyed before the context.
+		/// </summary>
+		class AssetLoader {
+		public:
+			using LoadCallback = std::function<void(const LoadStatus status)>;
+			/* Receives the program created from the file - owned by the callee, null unless the load completed */
+			using ShaderLoadCallback = std::function<void(ShaderProgram *programP, const LoadStatus status)>;
+
+			/* Keeps at most <inFlightLimit> bytes of reads in flight - a single larger read is still issued alone */
+			static AssetLoader *Create(const uint64_t inFlightLimit = 64ull << 20u, const uint32_t queueDepth = 64u, const uint32_t threadCount = 4u);
+			/* Drops pending loads without calling their callbacks */
+			virtual ~AssetLoader() {};
+
+			/* Reads level <mipLevel> of every layer of <textureP>, stored as SetMipData takes it, at <offset> of <path>.
+			 The level must still be resident once the read completes, the load fails otherwise - returns the load id */
+			virtual uint64_t LoadTextureLevel(
+				Texture *textureP,
+				const uint32_t mipLevel,
+				const std::string &path,
+				const uint64_t offset,
+				const LoadPriority priority = LoadPriority::DefaultPriority,
+				LoadCallback callback = nullptr) = 0;
+			/* Reads the whole contents of <bufferP> at <offset> of <path> - returns the load id */
+			virtual uint64_t LoadBuffer(
+				Buffer *bufferP,
+				const std::string &path,
+				const uint64_t offset,
+				const LoadPriority priority = LoadPriority::DefaultPriority,
+				LoadCallback callback = nullptr) = 0;
+			/* Reads the compiled shader at <path> and creates program <name> of it - returns the load id */
+			virtual uint64_t LoadShaderProgram(
+				const std::string &name,
+				const std::string &path,
+				const ShaderProgramType type,
+				const LoadPriority priority,
+				ShaderLoadCallback callback) = 0;
+			/* Cancels a load whose callback has not run yet - it runs with LoadCancelled from the next Update, the
+			 target is no longer touched. Returns false when there is no such load */
+			virtual bool Cancel(const uint64_t id) = 0;
+			/* Render thread, once per frame - issues waiting reads, hands completed ones to the upload batcher and
+			 calls the callbacks of the loads finished since the last call */
+			virtual void Update() = 0;
+			virtual AssetLoaderStats GetStats() const = 0;
+		};
+	}
+}
+
+#endif // !ASSET_LOADER_H_
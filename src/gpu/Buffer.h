@@ -3,6 +3,7 @@
 
 #include "ShaderEnum.h"
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -12,7 +13,16 @@ namespace PixelMachine {
 		enum BufferType {
 			VertexBuffer,
 			IndexBuffer,
-			UniformBuffer
+			UniformBuffer,
+			// Read and written by shaders - compute results reach vertex shaders through storage buffer bindings,
+			// and can feed indirect arguments. Only vertex and index buffers feed vertex input
+			StorageBuffer
+		};
+
+		/* How often the contents of a buffer are rewritten */
+		enum BufferUsage {
+			StaticUsage,	// Written once or rarely - kept in device local memory behind a staging copy
+			DynamicUsage	// Rewritten every frame - written in place when the device exposes host visible VRAM, after the frames reading it
 		};
 
 		enum BufferDataType {
@@ -71,8 +81,12 @@ namespace PixelMachine {
 
 		class BufferLayout {
 		public:
+			BufferLayout() {};
 			BufferLayout(std::initializer_list<BufferAttribute> bufferAttributes)
-				: m_attributes(bufferAttributes.begin(), bufferAttributes.end()) {
+				: BufferLayout(std::vector<BufferAttribute>(bufferAttributes.begin(), bufferAttributes.end())) {};
+			/* Layout of attributes known only at run time - read from asset files */
+			BufferLayout(const std::vector<BufferAttribute> &bufferAttributes)
+				: m_attributes(bufferAttributes) {
 				uint32_t offset = 0;
 				for (auto &attribute : m_attributes) {
 					attribute.m_offset = offset;
@@ -92,17 +106,23 @@ namespace PixelMachine {
 		class Buffer {
 		public:
 			/* Creates a buffer object
-			 <bindStage> parameter is used only if <type> is BufferType::Uniform */
+			 <bindStage> parameter is used only if <type> is BufferType::Uniform or BufferType::StorageBuffer.
+			 Uniform and storage buffers take descriptor set 0 bindings in the order they are bound to a pass.
+			 Uniform buffers are always written in place, <usage> selects the upload path of the other types */
 			static Buffer *Create(
 				const BufferType type,
 				const ShaderProgramType bindStage,
 				const BufferLayout dataLayout,
-				const uint32_t elementCount);
+				const uint32_t elementCount,
+				const BufferUsage usage = BufferUsage::StaticUsage);
 			ShaderProgramType GetBindStage() const { return m_bindStage; };
 			BufferType GetType() const { return m_type; }
 			BufferLayout GetLayout() const { return m_dataLayout; }
 			virtual void Bind() const = 0;
 			virtual void SetData(const void *data) = 0;
+			/* Fills the buffer through <writer>, handed GetSize() bytes of the memory SetData copies into - loaders read
+			 or convert their source straight into it without an intermediate copy */
+			virtual void WriteData(const std::function<void(void *dataP)> &writer) = 0;
 			virtual uint32_t GetSize() const = 0;
 			virtual ~Buffer() {};
 		protected:
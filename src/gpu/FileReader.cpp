@@ -0,0 +1,469 @@
+#include "FileReader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define PM_IO_URING
+#include <linux/io_uring.h>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace PixelMachine {
+	namespace GPU {
+
+		// Largest single read handed to the kernel - longer reads continue where the previous part ended
+		static constexpr uint64_t s_maxReadPart = 1u << 30u;
+		// user_data of cancel submissions - read ids start at 1
+		static constexpr uint64_t s_cancelUserData = 0u;
+
+		FileReader::FileReader(const uint32_t queueDepth, const uint32_t threadCount, const bool allowIoUring) {
+
+			if (allowIoUring && SetupRing(std::max(queueDepth, 1u))) {
+				return;
+			}
+
+			for (uint32_t i = 0; i < std::max(threadCount, 1u); i++) {
+				m_workers.emplace_back(&FileReader::RunWorker, this);
+			}
+		}
+
+		FileReader::~FileReader() {
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			for (auto &queue : m_queued) {
+				for (auto id : queue) {
+					m_requests.erase(id);
+				}
+				queue.clear();
+			}
+
+			if (m_ringFd >= 0) {
+				lock.unlock();
+
+				// The kernel writes into the destinations until every issued read has completed
+				for (auto &request : m_requests) {
+					request.second.m_cancelled = true;
+					QueueRingCancel(request.first);
+				}
+
+				while (m_issuedCount) {
+					PollRing(true);
+				}
+
+				ReleaseRing();
+				return;
+			}
+
+			m_stopWorkers = true;
+			lock.unlock();
+			m_condition.notify_all();
+
+			for (auto &worker : m_workers) {
+				worker.join();
+			}
+		}
+
+		uint64_t FileReader::Read(const std::string &path, const uint64_t offset, const uint64_t size, void *destinationP, const LoadPriority priority) {
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			const uint64_t id = m_nextId++;
+
+			FileReadRequest &request = m_requests[id];
+			request.m_path = path;
+			request.m_offset = offset;
+			request.m_size = size;
+			request.m_destinationP = static_cast<uint8_t *>(destinationP);
+
+			m_queued[std::min(priority, LoadPriority::BackgroundPriority)].push_back(id);
+
+			lock.unlock();
+			m_condition.notify_one();
+
+			return id;
+		}
+
+		bool FileReader::Cancel(const uint64_t id) {
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			auto found = m_requests.find(id);
+
+			if (found == m_requests.end() || found->second.m_cancelled) {
+				return false;
+			}
+
+			// Not issued yet - nothing writes the destination, reported right away
+			if (!found->second.m_issued) {
+				for (auto &queue : m_queued) {
+					queue.erase(std::remove(queue.begin(), queue.end(), id), queue.end());
+				}
+				Finish(id, LoadStatus::LoadCancelled);
+				return true;
+			}
+
+			found->second.m_cancelled = true;
+
+			if (m_ringFd >= 0) {
+				QueueRingCancel(id);
+			}
+
+			return true;
+		}
+
+		void FileReader::Poll(std::vector<FileReadResult> &outResults) {
+
+			if (m_ringFd >= 0) {
+				PollRing(false);
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			outResults.insert(outResults.end(), m_results.begin(), m_results.end());
+			m_results.clear();
+		}
+
+		uint32_t FileReader::GetPendingCount() const {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_requests.size();
+		}
+
+		uint64_t FileReader::TakeQueued() {
+
+			for (auto &queue : m_queued) {
+				if (queue.size()) {
+					const uint64_t id = queue.front();
+					queue.pop_front();
+					return id;
+				}
+			}
+
+			return 0u;
+		}
+
+		void FileReader::Finish(const uint64_t id, const LoadStatus status) {
+
+			FileReadResult result;
+			result.id = id;
+			result.status = status;
+			m_results.push_back(result);
+
+			m_requests.erase(id);
+		}
+
+		void FileReader::RunWorker() {
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			while (true) {
+
+				m_condition.wait(lock, [this]() { return m_stopWorkers || std::any_of(std::begin(m_queued), std::end(m_queued), [](const std::deque<uint64_t> &queue) { return queue.size(); }); });
+
+				if (m_stopWorkers) {
+					return;
+				}
+
+				const uint64_t id = TakeQueued();
+				FileReadRequest &request = m_requests[id];
+				request.m_issued = true;
+
+				// Requests are only erased by the thread reporting them - the reference stays valid unlocked
+				lock.unlock();
+				const bool read = ReadRange(request.m_path, request.m_offset, request.m_size, request.m_destinationP);
+				lock.lock();
+
+				Finish(id, request.m_cancelled ? LoadStatus::LoadCancelled : (read ? LoadStatus::LoadComplete : LoadStatus::LoadFailed));
+			}
+		}
+
+		bool FileReader::ReadRange(const std::string &path, const uint64_t offset, const uint64_t size, void *destinationP) {
+
+			std::FILE *fileP = std::fopen(path.c_str(), "rb");
+
+			if (!fileP) {
+				return false;
+			}
+
+#ifdef _WIN32
+			const bool seeked = _fseeki64(fileP, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+			const bool seeked = fseeko(fileP, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+
+			const bool read = seeked && std::fread(destinationP, 1u, size, fileP) == size;
+			std::fclose(fileP);
+
+			return read;
+		}
+
+		bool FileReader::ReadFile(const std::string &path, std::vector<uint8_t> &outData) {
+
+			std::FILE *fileP = std::fopen(path.c_str(), "rb");
+
+			if (!fileP) {
+				return false;
+			}
+
+			std::fseek(fileP, 0, SEEK_END);
+			const long size = std::ftell(fileP);
+			std::fseek(fileP, 0, SEEK_SET);
+
+			outData.resize(size > 0 ? size : 0);
+			const bool read = size >= 0 && std::fread(outData.data(), 1u, outData.size(), fileP) == outData.size();
+			std::fclose(fileP);
+
+			return read;
+		}
+
+#ifdef PM_IO_URING
+		bool FileReader::SetupRing(const uint32_t queueDepth) {
+
+			io_uring_params params = {};
+			const int ringFd = static_cast<int>(syscall(__NR_io_uring_setup, queueDepth, &params));
+
+			// Kernels before 5.1 and seccomp profiles denying io_uring leave the thread pool
+			if (ringFd < 0) {
+				return false;
+			}
+
+			// IORING_OP_READ arrived with 5.6, along with the probe - 5.1 to 5.5 fail every read with -EINVAL and
+			// fail the probe as well, so they leave the thread pool too
+			alignas(io_uring_probe) uint8_t probeData[sizeof(io_uring_probe) + sizeof(io_uring_probe_op) * (IORING_OP_READ + 1u)] = {};
+			io_uring_probe *probeP = reinterpret_cast<io_uring_probe *>(probeData);
+			const int probed = static_cast<int>(syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probeP, IORING_OP_READ + 1u));
+
+			if (probed < 0 || probeP->last_op < IORING_OP_READ || !(probeP->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED)) {
+				close(ringFd);
+				return false;
+			}
+
+			m_ringFd = ringFd;
+			m_queueDepth = params.sq_entries;
+			m_submitRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+			m_completeRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+			m_submitEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+			if (params.features & IORING_FEAT_SINGLE_MMAP) {
+				m_submitRingSize = m_completeRingSize = std::max(m_submitRingSize, m_completeRingSize);
+			}
+
+			m_submitRingP = mmap(nullptr, m_submitRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+			m_completeRingP = params.features & IORING_FEAT_SINGLE_MMAP ? m_submitRingP :
+				mmap(nullptr, m_completeRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING);
+			m_submitEntriesP = mmap(nullptr, m_submitEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES);
+
+			if (m_submitRingP == MAP_FAILED || m_completeRingP == MAP_FAILED || m_submitEntriesP == MAP_FAILED) {
+				ReleaseRing();
+				return false;
+			}
+
+			uint8_t *submitRingP = static_cast<uint8_t *>(m_submitRingP);
+			m_submitHeadP = reinterpret_cast<uint32_t *>(submitRingP + params.sq_off.head);
+			m_submitTailP = reinterpret_cast<uint32_t *>(submitRingP + params.sq_off.tail);
+			m_submitArrayP = reinterpret_cast<uint32_t *>(submitRingP + params.sq_off.array);
+			m_submitMask = *reinterpret_cast<uint32_t *>(submitRingP + params.sq_off.ring_mask);
+
+			uint8_t *completeRingP = static_cast<uint8_t *>(m_completeRingP);
+			m_completeHeadP = reinterpret_cast<uint32_t *>(completeRingP + params.cq_off.head);
+			m_completeTailP = reinterpret_cast<uint32_t *>(completeRingP + params.cq_off.tail);
+			m_completeEntriesP = completeRingP + params.cq_off.cqes;
+			m_completeMask = *reinterpret_cast<uint32_t *>(completeRingP + params.cq_off.ring_mask);
+
+			return true;
+		}
+
+		void FileReader::ReleaseRing() {
+
+			if (m_submitEntriesP && m_submitEntriesP != MAP_FAILED) {
+				munmap(m_submitEntriesP, m_submitEntriesSize);
+			}
+			if (m_completeRingP && m_completeRingP != MAP_FAILED && m_completeRingP != m_submitRingP) {
+				munmap(m_completeRingP, m_completeRingSize);
+			}
+			if (m_submitRingP && m_submitRingP != MAP_FAILED) {
+				munmap(m_submitRingP, m_submitRingSize);
+			}
+
+			close(m_ringFd);
+			m_ringFd = -1;
+		}
+
+		bool FileReader::QueueRingRead(const uint64_t id, FileReadRequest &request) {
+
+			const uint32_t tail = *m_submitTailP;
+
+			// Full until the kernel consumes the unsubmitted entries
+			if (tail - std::atomic_ref<uint32_t>(*m_submitHeadP).load(std::memory_order_acquire) > m_submitMask) {
+				return false;
+			}
+
+			const uint32_t index = tail & m_submitMask;
+			io_uring_sqe &entry = static_cast<io_uring_sqe *>(m_submitEntriesP)[index];
+			std::memset(&entry, 0, sizeof(entry));
+			entry.opcode = IORING_OP_READ;
+			entry.fd = request.m_fd;
+			entry.addr = reinterpret_cast<uint64_t>(request.m_destinationP + request.m_readBytes);
+			entry.len = static_cast<uint32_t>(std::min(request.m_size - request.m_readBytes, s_maxReadPart));
+			entry.off = request.m_offset + request.m_readBytes;
+			entry.user_data = id;
+
+			m_submitArrayP[index] = index;
+			std::atomic_ref<uint32_t>(*m_submitTailP).store(tail + 1u, std::memory_order_release);
+			m_unsubmittedCount++;
+
+			return true;
+		}
+
+		void FileReader::QueueRingCancel(const uint64_t id) {
+
+			const uint32_t tail = *m_submitTailP;
+
+			// Best effort - without room the read simply completes and is reported cancelled
+			if (tail - std::atomic_ref<uint32_t>(*m_submitHeadP).load(std::memory_order_acquire) > m_submitMask) {
+				return;
+			}
+
+			const uint32_t index = tail & m_submitMask;
+			io_uring_sqe &entry = static_cast<io_uring_sqe *>(m_submitEntriesP)[index];
+			std::memset(&entry, 0, sizeof(entry));
+			entry.opcode = IORING_OP_ASYNC_CANCEL;
+			entry.fd = -1;
+			entry.addr = id;
+			entry.user_data = s_cancelUserData;
+
+			m_submitArrayP[index] = index;
+			std::atomic_ref<uint32_t>(*m_submitTailP).store(tail + 1u, std::memory_order_release);
+			m_unsubmittedCount++;
+		}
+
+		void FileReader::PollRing(const bool wait) {
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			// Continuations of short reads that found the submission queue full go first - they are already issued
+			while (m_continuedReads.size()) {
+
+				const uint64_t id = m_continuedReads.front();
+				FileReadRequest &request = m_requests[id];
+
+				if (request.m_cancelled) {
+					close(request.m_fd);
+					m_issuedCount--;
+					Finish(id, LoadStatus::LoadCancelled);
+				}
+				else if (!QueueRingRead(id, request)) {
+					break;
+				}
+
+				m_continuedReads.pop_front();
+			}
+
+			// Queued reads fill the free depth, each with its own descriptor
+			while (m_issuedCount < m_queueDepth && m_continuedReads.empty()) {
+
+				const uint64_t id = TakeQueued();
+
+				if (!id) {
+					break;
+				}
+
+				FileReadRequest &request = m_requests[id];
+				request.m_issued = true;
+				request.m_fd = open(request.m_path.c_str(), O_RDONLY | O_CLOEXEC);
+
+				if (request.m_fd < 0) {
+					Finish(id, LoadStatus::LoadFailed);
+					continue;
+				}
+
+				if (!request.m_size) {
+					close(request.m_fd);
+					Finish(id, LoadStatus::LoadComplete);
+					continue;
+				}
+
+				if (!QueueRingRead(id, request)) {
+					close(request.m_fd);
+					request.m_fd = -1;
+					request.m_issued = false;
+					m_queued[LoadPriority::CriticalPriority].push_front(id);
+					break;
+				}
+
+				m_issuedCount++;
+			}
+
+			if (m_unsubmittedCount || wait) {
+				const int submitted = static_cast<int>(syscall(__NR_io_uring_enter, m_ringFd, m_unsubmittedCount, wait ? 1u : 0u, wait ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0u));
+				m_unsubmittedCount -= submitted > 0 ? std::min<uint32_t>(submitted, m_unsubmittedCount) : 0u;
+			}
+
+			uint32_t head = *m_completeHeadP;
+			const uint32_t tail = std::atomic_ref<uint32_t>(*m_completeTailP).load(std::memory_order_acquire);
+
+			for (; head != tail; head++) {
+
+				const io_uring_cqe &completion = static_cast<const io_uring_cqe *>(m_completeEntriesP)[head & m_completeMask];
+
+				if (completion.user_data == s_cancelUserData) {
+					continue;
+				}
+
+				auto found = m_requests.find(completion.user_data);
+
+				if (found == m_requests.end()) {
+					continue;
+				}
+
+				FileReadRequest &request = found->second;
+
+				if (completion.res > 0) {
+					request.m_readBytes += static_cast<uint64_t>(completion.res);
+				}
+
+				// Short reads continue from where they ended, zero bytes means the file is shorter than the range.
+				// Without room in the submission queue (cancels take entries too) the continuation waits for the next poll
+				if (completion.res > 0 && request.m_readBytes < request.m_size && !request.m_cancelled) {
+					if (!QueueRingRead(found->first, request)) {
+						m_continuedReads.push_back(found->first);
+					}
+					continue;
+				}
+
+				close(request.m_fd);
+				m_issuedCount--;
+
+				if (request.m_cancelled) {
+					Finish(found->first, LoadStatus::LoadCancelled);
+				}
+				else {
+					Finish(found->first, request.m_readBytes == request.m_size ? LoadStatus::LoadComplete : LoadStatus::LoadFailed);
+				}
+			}
+
+			std::atomic_ref<uint32_t>(*m_completeHeadP).store(head, std::memory_order_release);
+
+			// Continued reads go out right away instead of waiting for the next poll
+			if (m_unsubmittedCount) {
+				const int submitted = static_cast<int>(syscall(__NR_io_uring_enter, m_ringFd, m_unsubmittedCount, 0u, 0u, nullptr, 0u));
+				m_unsubmittedCount -= submitted > 0 ? std::min<uint32_t>(submitted, m_unsubmittedCount) : 0u;
+			}
+		}
+#else
+		bool FileReader::SetupRing(const uint32_t) {
+			return false;
+		}
+
+		void FileReader::ReleaseRing() {}
+		bool FileReader::QueueRingRead(const uint64_t, FileReadRequest &) { return false; }
+		void FileReader::QueueRingCancel(const uint64_t) {}
+		void FileReader::PollRing(const bool) {}
+#endif
+	}
+}
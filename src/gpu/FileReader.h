@@ -0,0 +1,129 @@
+#ifndef FILE_READER_H_
+#define FILE_READER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		/* Queued reads are issued highest priority first, in request order within a priority */
+		enum LoadPriority {
+			CriticalPriority,
+			DefaultPriority,
+			BackgroundPriority,
+			LoadPriorityCount
+		};
+
+		enum LoadStatus {
+			LoadPending,
+			LoadComplete,
+			LoadCancelled,
+			LoadFailed
+		};
+
+		struct FileReadResult {
+			uint64_t id = 0;
+			LoadStatus status = LoadStatus::LoadPending;
+		};
+
+		/// <summary>
+		/// Asynchronous reads of file ranges into caller owned memory. Linux kernels with io_uring reads (5.6) get the
+		/// reads queued in the kernel without a thread per read, other systems (and sandboxes denying
+		/// io_uring) fall back to a pool of threads reading with blocking calls. Not thread safe - requests
+		/// and polling belong to one thread.
+		/// </summary>
+		class FileReader {
+		public:
+			/* Up to <queueDepth> reads are issued at once with io_uring, <threadCount> with the thread pool */
+			FileReader(const uint32_t queueDepth = 64u, const uint32_t threadCount = 4u, const bool allowIoUring = true);
+			FileReader(const FileReader &) = delete;
+			FileReader &operator=(const FileReader &) = delete;
+			/* Drops queued reads and waits for the issued ones */
+			~FileReader();
+
+			/* Queues a read of <size> bytes at <offset> of <path> into <destinationP>, which must stay valid
+			 until Poll reports the read - returns its id */
+			uint64_t Read(const std::string &path, const uint64_t offset, const uint64_t size, void *destinationP, const LoadPriority priority = LoadPriority::DefaultPriority);
+			/* Cancels a read not reported yet - returns false when there is none. Issued reads may still write
+			 the destination until they are reported, as cancelled */
+			bool Cancel(const uint64_t id);
+			/* Non-blocking - issues queued reads and appends the ones finished since the last call to <outResults> */
+			void Poll(std::vector<FileReadResult> &outResults);
+			/* Reads queued or issued, not reported yet */
+			uint32_t GetPendingCount() const;
+			bool IsUsingIoUring() const { return m_ringFd >= 0; }
+
+			/* Blocking read of the whole file at <path> - returns false when it cannot be read */
+			static bool ReadFile(const std::string &path, std::vector<uint8_t> &outData);
+
+		private:
+			struct FileReadRequest {
+				std::string m_path;
+				uint64_t m_offset = 0u;
+				uint64_t m_size = 0u;
+				uint8_t *m_destinationP = nullptr;
+				// Bytes read so far - io_uring reads may complete short and are continued
+				uint64_t m_readBytes = 0u;
+				int m_fd = -1;
+				bool m_issued = false;
+				bool m_cancelled = false;
+			};
+
+			/* Blocking read of <size> bytes at <offset> of <path> - thread pool and ReadFile */
+			static bool ReadRange(const std::string &path, const uint64_t offset, const uint64_t size, void *destinationP);
+			/* Takes the highest priority queued read, 0 when there is none */
+			uint64_t TakeQueued();
+			void Finish(const uint64_t id, const LoadStatus status);
+			void RunWorker();
+
+			bool SetupRing(const uint32_t queueDepth);
+			void ReleaseRing();
+			/* Issues queued reads up to the queue depth and reaps completions - io_uring only */
+			void PollRing(const bool wait);
+			/* Writes the submission of the next part of read <id> */
+			bool QueueRingRead(const uint64_t id, FileReadRequest &request);
+			void QueueRingCancel(const uint64_t id);
+
+			uint64_t m_nextId = 1u;
+			std::unordered_map<uint64_t, FileReadRequest> m_requests;
+			std::deque<uint64_t> m_queued[LoadPriority::LoadPriorityCount];
+			std::vector<FileReadResult> m_results;
+			// Issued reads whose continuation did not fit the submission queue - io_uring only
+			std::deque<uint64_t> m_continuedReads;
+			// Guards the requests, queues and results against the pool threads
+			mutable std::mutex m_mutex;
+			std::condition_variable m_condition;
+			std::vector<std::thread> m_workers;
+			bool m_stopWorkers = false;
+
+			// io_uring - ring file descriptor (-1 with the thread pool) and the mapped rings
+			int m_ringFd = -1;
+			uint32_t m_queueDepth = 0u;
+			uint32_t m_issuedCount = 0u;
+			uint32_t m_unsubmittedCount = 0u;
+			void *m_submitRingP = nullptr;
+			size_t m_submitRingSize = 0u;
+			void *m_completeRingP = nullptr;
+			size_t m_completeRingSize = 0u;
+			void *m_submitEntriesP = nullptr;
+			size_t m_submitEntriesSize = 0u;
+			uint32_t *m_submitHeadP = nullptr;
+			uint32_t *m_submitTailP = nullptr;
+			uint32_t *m_submitArrayP = nullptr;
+			uint32_t m_submitMask = 0u;
+			uint32_t *m_completeHeadP = nullptr;
+			uint32_t *m_completeTailP = nullptr;
+			void *m_completeEntriesP = nullptr;
+			uint32_t m_completeMask = 0u;
+		};
+	}
+}
+
+#endif // !FILE_READER_H_
@@ -0,0 +1,243 @@
+#include "MeshFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace PixelMachine {
+	namespace GPU {
+
+		static uint64_t AlignBlock(const uint64_t offset) {
+			return (offset + MeshFileBlockAlignment - 1u) & ~(MeshFileBlockAlignment - 1u);
+		}
+
+		static uint32_t GetIndexSize(const MeshIndexType indexType) {
+			return indexType == MeshIndexType::MeshIndexUInt16 ? 2u : 4u;
+		}
+
+		MeshFile::MeshFile(const std::string &path) : m_path(path) {
+
+#ifdef _WIN32
+			HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+			if (file == INVALID_HANDLE_VALUE) {
+				throw new std::runtime_error("MeshFile load failed - unable to open " + path + ".");
+			}
+
+			LARGE_INTEGER fileSize = {};
+			GetFileSizeEx(file, &fileSize);
+			m_mappingSize = static_cast<uint64_t>(fileSize.QuadPart);
+
+			// The mapping keeps the file open - the handle is not needed past this point
+			m_mappingHandleP = m_mappingSize ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+			CloseHandle(file);
+
+			if (m_mappingHandleP) {
+				m_mappingP = static_cast<const uint8_t *>(MapViewOfFile(m_mappingHandleP, FILE_MAP_READ, 0, 0, 0));
+			}
+#else
+			const int file = open(path.c_str(), O_RDONLY);
+
+			if (file < 0) {
+				throw new std::runtime_error("MeshFile load failed - unable to open " + path + ".");
+			}
+
+			struct stat fileStat = {};
+			fstat(file, &fileStat);
+			m_mappingSize = static_cast<uint64_t>(fileStat.st_size);
+
+			if (m_mappingSize) {
+				void *mappingP = mmap(nullptr, m_mappingSize, PROT_READ, MAP_PRIVATE, file, 0);
+				m_mappingP = mappingP != MAP_FAILED ? static_cast<const uint8_t *>(mappingP) : nullptr;
+			}
+
+			close(file);
+
+			// Blocks are read once front to back - read ahead aggressively
+			if (m_mappingP) {
+				madvise(const_cast<uint8_t *>(m_mappingP), m_mappingSize, MADV_SEQUENTIAL);
+				madvise(const_cast<uint8_t *>(m_mappingP), m_mappingSize, MADV_WILLNEED);
+			}
+#endif
+
+			bool valid = m_mappingP && m_mappingSize >= sizeof(MeshFileHeader);
+
+			if (valid) {
+				std::memcpy(&m_header, m_mappingP, sizeof(MeshFileHeader));
+				valid = m_header.magic == MeshFileMagic &&
+					m_header.version == MeshFileVersion &&
+					m_header.attributeCount &&
+					m_header.vertexCount &&
+					m_header.indexType <= MeshIndexType::MeshIndexUInt32;
+			}
+
+			const uint64_t tableSize = sizeof(MeshFileAttribute) * static_cast<uint64_t>(m_header.attributeCount) + sizeof(MeshSubmesh) * static_cast<uint64_t>(m_header.submeshCount);
+			valid = valid && sizeof(MeshFileHeader) + tableSize <= m_mappingSize;
+
+			std::vector<BufferAttribute> attributes;
+
+			for (uint32_t i = 0; valid && i < m_header.attributeCount; i++) {
+				MeshFileAttribute attribute;
+				std::memcpy(&attribute, m_mappingP + sizeof(MeshFileHeader) + sizeof(MeshFileAttribute) * i, sizeof(MeshFileAttribute));
+				attribute.name[sizeof(attribute.name) - 1u] = '\0';
+				valid = attribute.dataType <= BufferDataType::matrix4;
+				attributes.push_back(BufferAttribute(static_cast<BufferDataType>(attribute.dataType), attribute.name));
+			}
+
+			if (valid) {
+				m_layout = BufferLayout(attributes);
+				m_submeshes.resize(m_header.submeshCount);
+				std::memcpy(m_submeshes.data(), m_mappingP + sizeof(MeshFileHeader) + sizeof(MeshFileAttribute) * m_header.attributeCount, sizeof(MeshSubmesh) * m_submeshes.size());
+			}
+
+			// Blocks must lie within the file in the size the header implies - anything else is a truncated or foreign file.
+			// Compared by subtraction, crafted offsets near 2^64 must not wrap around the file size
+			const uint64_t vertexBytes = static_cast<uint64_t>(m_header.vertexCount) * m_header.vertexStride;
+			const uint64_t indexBytes = static_cast<uint64_t>(m_header.indexCount) * GetIndexSize(static_cast<MeshIndexType>(m_header.indexType));
+
+			valid = valid &&
+				m_header.vertexStride == m_layout.GetSize() &&
+				m_header.vertexOffset % MeshFileBlockAlignment == 0u &&
+				m_header.indexOffset % MeshFileBlockAlignment == 0u &&
+				m_header.vertexOffset <= m_mappingSize && vertexBytes <= m_mappingSize - m_header.vertexOffset &&
+				m_header.indexOffset <= m_mappingSize && indexBytes <= m_mappingSize - m_header.indexOffset;
+
+			for (auto &submesh : m_submeshes) {
+				valid = valid && static_cast<uint64_t>(submesh.firstIndex) + submesh.indexCount <= m_header.indexCount;
+			}
+
+			if (!valid) {
+				Unmap();
+				throw new std::runtime_error("MeshFile load failed - " + path + " is not a valid mesh file.");
+			}
+		}
+
+		MeshFile::~MeshFile() {
+			Unmap();
+		}
+
+		void MeshFile::Unmap() {
+
+#ifdef _WIN32
+			if (m_mappingP) {
+				UnmapViewOfFile(m_mappingP);
+			}
+			if (m_mappingHandleP) {
+				CloseHandle(m_mappingHandleP);
+			}
+#else
+			if (m_mappingP) {
+				munmap(const_cast<uint8_t *>(m_mappingP), m_mappingSize);
+			}
+#endif
+
+			m_mappingP = nullptr;
+			m_mappingHandleP = nullptr;
+		}
+
+		Buffer *MeshFile::CreateVertexBuffer(const BufferUsage usage) const {
+
+			Buffer *bufferP = Buffer::Create(BufferType::VertexBuffer, ShaderProgramType::VertexShader, m_layout, m_header.vertexCount, usage);
+
+			// Page faults on the mapping are the disk reads - no copy is made in between
+			bufferP->SetData(GetVertexData());
+			return bufferP;
+		}
+
+		Buffer *MeshFile::CreateIndexBuffer(const BufferUsage usage) const {
+
+			if (!m_header.indexCount) {
+				return nullptr;
+			}
+
+			Buffer *bufferP = Buffer::Create(
+				BufferType::IndexBuffer,
+				ShaderProgramType::VertexShader,
+				BufferLayout({ { BufferDataType::uint1, "index" } }),
+				m_header.indexCount,
+				usage);
+
+			if (GetIndexType() == MeshIndexType::MeshIndexUInt32) {
+				bufferP->SetData(GetIndexData());
+				return bufferP;
+			}
+
+			bufferP->WriteData([this](void *dataP) {
+				const uint16_t *indicesP = static_cast<const uint16_t *>(GetIndexData());
+				uint32_t *outputP = static_cast<uint32_t *>(dataP);
+				for (uint32_t i = 0; i < m_header.indexCount; i++) {
+					outputP[i] = indicesP[i];
+				}
+			});
+
+			return bufferP;
+		}
+
+		void MeshFile::Write(
+			const std::string &path,
+			const BufferLayout &layout,
+			const uint32_t vertexCount,
+			const void *vertexData,
+			const MeshIndexType indexType,
+			const uint32_t indexCount,
+			const void *indexData,
+			const std::vector<MeshSubmesh> &submeshes) {
+
+			std::vector<MeshFileAttribute> attributes(layout.GetAttributeCount());
+
+			for (uint32_t i = 0; i < attributes.size(); i++) {
+				const BufferAttribute attribute = layout.GetAttribute(i);
+				attributes[i].dataType = attribute.m_shaderDataType;
+				std::strncpy(attributes[i].name, attribute.m_name.c_str(), sizeof(attributes[i].name) - 1u);
+			}
+
+			MeshFileHeader header;
+			header.attributeCount = attributes.size();
+			header.vertexStride = layout.GetSize();
+			header.vertexCount = vertexCount;
+			header.indexType = indexType;
+			header.indexCount = indexCount;
+			header.submeshCount = submeshes.size();
+
+			const uint64_t vertexBytes = static_cast<uint64_t>(vertexCount) * header.vertexStride;
+			const uint64_t indexBytes = static_cast<uint64_t>(indexCount) * GetIndexSize(indexType);
+			const uint64_t tableEnd = sizeof(MeshFileHeader) + sizeof(MeshFileAttribute) * attributes.size() + sizeof(MeshSubmesh) * submeshes.size();
+
+			header.vertexOffset = AlignBlock(tableEnd);
+			header.indexOffset = AlignBlock(header.vertexOffset + vertexBytes);
+
+			std::FILE *fileP = std::fopen(path.c_str(), "wb");
+
+			if (!fileP) {
+				throw new std::runtime_error("MeshFile write failed - unable to open " + path + ".");
+			}
+
+			const uint8_t padding[MeshFileBlockAlignment] = {};
+
+			bool written = std::fwrite(&header, sizeof(header), 1u, fileP) == 1u &&
+				std::fwrite(attributes.data(), sizeof(MeshFileAttribute), attributes.size(), fileP) == attributes.size() &&
+				std::fwrite(submeshes.data(), sizeof(MeshSubmesh), submeshes.size(), fileP) == submeshes.size() &&
+				std::fwrite(padding, 1u, header.vertexOffset - tableEnd, fileP) == header.vertexOffset - tableEnd &&
+				std::fwrite(vertexData, 1u, vertexBytes, fileP) == vertexBytes &&
+				std::fwrite(padding, 1u, header.indexOffset - header.vertexOffset - vertexBytes, fileP) == header.indexOffset - header.vertexOffset - vertexBytes &&
+				(!indexBytes || std::fwrite(indexData, 1u, indexBytes, fileP) == indexBytes);
+
+			written = std::fclose(fileP) == 0 && written;
+
+			if (!written) {
+				throw new std::runtime_error("MeshFile write failed - unable to write " + path + ".");
+			}
+		}
+	}
+}
@@ -0,0 +1,110 @@
+#ifndef MESH_FILE_H_
+#define MESH_FILE_H_
+
+#include "Buffer.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		// "PMMS" read as a little endian uint32
+		static constexpr uint32_t MeshFileMagic = 0x534D4D50u;
+		static constexpr uint32_t MeshFileVersion = 1u;
+		// Vertex and index blocks start at multiples of this - copies out of the mapping stay aligned
+		static constexpr uint64_t MeshFileBlockAlignment = 16u;
+
+		enum MeshIndexType {
+			MeshIndexUInt16,
+			MeshIndexUInt32
+		};
+
+		/* Header of a .pmmesh file, little endian. Followed by <attributeCount> attributes, <submeshCount>
+		 submeshes, and the vertex and index blocks at their offsets */
+		struct MeshFileHeader {
+			uint32_t magic = MeshFileMagic;
+			uint32_t version = MeshFileVersion;
+			uint32_t attributeCount = 0u;
+			// Bytes per vertex - the size of the layout
+			uint32_t vertexStride = 0u;
+			uint32_t vertexCount = 0u;
+			uint32_t indexType = MeshIndexType::MeshIndexUInt32;
+			uint32_t indexCount = 0u;
+			uint32_t submeshCount = 0u;
+			uint64_t vertexOffset = 0u;
+			uint64_t indexOffset = 0u;
+		};
+
+		/* One vertex attribute - the BufferLayout of the vertices in attribute order */
+		struct MeshFileAttribute {
+			uint32_t dataType = BufferDataType::float3;
+			char name[28] = {};
+		};
+
+		/* Range of the index block drawn with one material - <vertexOffset> is added to its indices */
+		struct MeshSubmesh {
+			uint32_t firstIndex = 0u;
+			uint32_t indexCount = 0u;
+			int32_t vertexOffset = 0;
+			uint32_t materialIndex = 0u;
+		};
+
+		/// <summary>
+		/// Mesh container whose vertex and index blocks are stored exactly as the GPU reads them. The file is
+		/// memory mapped, nothing is parsed beyond the header - buffers are filled straight from the mapping, so
+		/// loading costs one copy into staging memory at the speed the disk delivers the pages.
+		/// </summary>
+		class MeshFile {
+		public:
+			/* Maps <path> and validates its header and blocks - throws when the file is missing or malformed */
+			MeshFile(const std::string &path);
+			MeshFile(const MeshFile &) = delete;
+			MeshFile &operator=(const MeshFile &) = delete;
+			~MeshFile();
+
+			const std::string &GetPath() const { return m_path; }
+			const BufferLayout &GetLayout() const { return m_layout; }
+			uint32_t GetVertexCount() const { return m_header.vertexCount; }
+			uint32_t GetIndexCount() const { return m_header.indexCount; }
+			MeshIndexType GetIndexType() const { return static_cast<MeshIndexType>(m_header.indexType); }
+			const std::vector<MeshSubmesh> &GetSubmeshes() const { return m_submeshes; }
+			/* Blocks within the mapping, valid for the lifetime of the file object */
+			const void *GetVertexData() const { return m_mappingP + m_header.vertexOffset; }
+			const void *GetIndexData() const { return m_mappingP + m_header.indexOffset; }
+
+			/* Creates a vertex buffer filled straight from the mapping */
+			Buffer *CreateVertexBuffer(const BufferUsage usage = BufferUsage::StaticUsage) const;
+			/* Creates an index buffer of uint32 indices - 16-bit indices are widened while they are copied into
+			 staging memory, as draws read 32-bit indices. Null when the mesh has no indices */
+			Buffer *CreateIndexBuffer(const BufferUsage usage = BufferUsage::StaticUsage) const;
+
+			/* Writes <vertexCount> vertices of <layout> and <indexCount> indices of <indexType> as a mesh of
+			 <submeshes> - throws on failure */
+			static void Write(
+				const std::string &path,
+				const BufferLayout &layout,
+				const uint32_t vertexCount,
+				const void *vertexData,
+				const MeshIndexType indexType,
+				const uint32_t indexCount,
+				const void *indexData,
+				const std::vector<MeshSubmesh> &submeshes);
+
+		private:
+			void Unmap();
+
+			std::string m_path;
+			MeshFileHeader m_header;
+			BufferLayout m_layout;
+			std::vector<MeshSubmesh> m_submeshes;
+			const uint8_t *m_mappingP = nullptr;
+			uint64_t m_mappingSize = 0u;
+			// File mapping object - Windows only
+			void *m_mappingHandleP = nullptr;
+		};
+	}
+}
+
+#endif // !MESH_FILE_H_
@@ -2,26 +2,278 @@
 #define RENDER_CONTEXT_H_
 
 #include <string>
+#include <functional>
+#include <cstdint>
+#include <vector>
 
 namespace PixelMachine {
 	namespace GPU {
 
+		class Buffer;
+
+		enum FramePixelFormat {
+			RGBA8,
+			BGRA8
+		};
+
+		/* Primitive assembled from the vertices of a graphics pass - values follow VkPrimitiveTopology */
+		enum PrimitiveType {
+			PointList,
+			LineList,
+			LineStrip,
+			TriangleList,
+			TriangleStrip,
+			TriangleFan
+		};
+
+		enum CullMode {
+			CullNone,
+			CullFront,
+			CullBack
+		};
+
+		/* Host copy of a rendered frame - <pixels> stays valid only for the duration of a readback callback */
+		struct FrameReadback {
+			uint64_t frameNumber = 0;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t rowPitch = 0;
+			FramePixelFormat format = FramePixelFormat::RGBA8;
+			const uint8_t *pixels = nullptr;
+		};
+
+		struct RenderStats {
+			uint64_t framesSubmitted = 0;
+			uint64_t framesCompleted = 0;
+			uint64_t bytesUploaded = 0;
+			uint64_t uploadSubmits = 0;
+			// Device memory allocations made for buffers
+			uint64_t memoryAllocations = 0;
+			uint64_t memoryBytesAllocated = 0;
+			// Host allocations the driver made through the allocation callbacks
+			uint64_t hostAllocations = 0;
+			// Buffer barriers recorded between passes accessing the same buffers
+			uint64_t bufferBarriers = 0;
+			// Compute passes submitted to the async compute queue and buffers moved between queue families
+			uint64_t asyncComputeSubmits = 0;
+			uint64_t queueOwnershipTransfers = 0;
+			// Indirect draws recorded - each may expand into any number of GPU generated draws
+			uint64_t indirectDraws = 0;
+			// Binds and dynamic state commands recorded, and the ones skipped as already set
+			uint64_t commandsIssued = 0;
+			uint64_t commandsSkipped = 0;
+			// Draws replayed from the draw queue, capacity of its per-frame arena and the heap blocks it ever took
+			uint64_t queuedDraws = 0;
+			uint64_t drawQueueArenaBytes = 0;
+			uint64_t drawQueueArenaBlocks = 0;
+			// Graphics pipelines compiled and passes that found a matching one already compiled
+			uint64_t graphicsPipelines = 0;
+			uint64_t pipelineReuses = 0;
+			// Depth-only draws of depth pre-passes
+			uint64_t depthPrePassDraws = 0;
+			// Transient attachments created (again on resize) and the ones backed by lazily allocated memory
+			uint64_t transientAttachments = 0;
+			uint64_t lazyAttachments = 0;
+			// Renderings resolving multisampled color into their target
+			uint64_t msaaResolves = 0;
+			// Sampler objects created and textures that found a matching one, staging memory of batched uploads
+			uint64_t samplers = 0;
+			uint64_t samplerReuses = 0;
+			uint64_t stagingBytes = 0;
+			// Block compressed texels decoded on the CPU for lack of device support
+			uint64_t transcodedTexels = 0;
+			// Pass descriptor sets rewritten as textures changed their resident mips
+			uint64_t descriptorRefreshes = 0;
+		};
+
+		/* Driver host memory of an object type within one allocation scope */
+		struct HostMemoryUsage {
+			std::string objectType;
+			std::string scope;
+			uint64_t liveBytes = 0;
+			uint64_t liveAllocations = 0;
+			uint64_t peakBytes = 0;
+			uint64_t totalAllocations = 0;
+			// Memory the driver allocated by other means and reported through the internal allocation callbacks
+			uint64_t internalBytes = 0;
+		};
+
+		enum ProfileTrack {
+			CPU,
+			GPU
+		};
+
+		/* Pipeline statistics and occlusion results of a pass */
+		struct PassCounters {
+			bool hasStatistics = false;
+			bool hasOcclusion = false;
+			uint64_t vertexInvocations = 0;
+			uint64_t clippingPrimitives = 0;
+			uint64_t fragmentInvocations = 0;
+			uint64_t samplesPassed = 0;
+		};
+
+		/* Timed scope of the frame profiler - times are in microseconds on a clock shared by both tracks */
+		struct ProfileEvent {
+			std::string name;
+			ProfileTrack track = ProfileTrack::CPU;
+			uint32_t threadIndex = 0;
+			uint64_t frameNumber = 0;
+			double startUs = 0.0;
+			double durationUs = 0.0;
+			// Filled for GPU pass events while pass queries are enabled
+			PassCounters counters;
+		};
+
+		/* Device memory categories kept apart by the memory telemetry - buffer categories follow BufferType */
+		enum MemoryCategory {
+			VertexBufferMemory,
+			IndexBufferMemory,
+			UniformBufferMemory,
+			StorageBufferMemory,
+			StagingMemory,
+			ReadbackMemory,
+			RenderTargetMemory,
+			TextureMemory,
+			MemoryCategoryCount
+		};
+
+		struct MemoryHeapTelemetry {
+			uint32_t heapIndex = 0;
+			bool deviceLocal = false;
+			uint64_t size = 0;
+			// Budget and process-wide usage reported by VK_EXT_memory_budget, heap size and own allocations without it
+			uint64_t budget = 0;
+			uint64_t usage = 0;
+			// Memory allocated by this context
+			uint64_t allocatedBytes = 0;
+			uint64_t peakAllocatedBytes = 0;
+			uint64_t softLimit = 0;
+		};
+
+		struct MemoryCategoryTelemetry {
+			uint64_t liveAllocations = 0;
+			uint64_t liveBytes = 0;
+			uint64_t peakBytes = 0;
+		};
+
+		struct MemoryTelemetry {
+			bool budgetSupported = false;
+			std::vector<MemoryHeapTelemetry> heaps;
+			MemoryCategoryTelemetry categories[MemoryCategory::MemoryCategoryCount];
+		};
+
+		/* A heap above its soft limit - eviction callbacks should try to release <bytesOverLimit> */
+		struct MemoryPressure {
+			uint32_t heapIndex = 0;
+			uint64_t usage = 0;
+			uint64_t softLimit = 0;
+			uint64_t bytesOverLimit = 0;
+		};
+
+		using ReadbackCallback = std::function<void(const FrameReadback &)>;
+		using MemoryEvictionCallback = std::function<void(const MemoryPressure &)>;
+
 		class RenderContext {
 		public:
+			/* Passing a null <windowHandle> creates a headless context rendering to an offscreen target */
 			static void Initialize(void *windowHandle);
 			static RenderContext *Get();
 			static void Destroy();
 
 			virtual void BeginPass() = 0;
+			/* Render state of the pass being built. Where the device supports extended dynamic state it is set
+			 while recording, passes differing only in it share one pipeline - otherwise every combination gets
+			 its own pipeline variant. <type> is a PrimitiveType */
 			virtual void SetPrimitiveType(const int type) = 0;
+			/* Widths other than 1 need the wideLines feature, ignored without it */
 			virtual void SetLineWidth(const float width) = 0;
+			/* Power of two sample count of the pass, clamped to what the device supports for color and depth
+			 attachments. Multisampled attachments are transient and resolved before the rendering ends, passes
+			 left at one sample pay nothing. Queued draws must share one sample count */
 			virtual void SetMultisampling(const int sampleCount) = 0;
+			/* Depth test and write, passing nearer fragments. Depth lives in a transient attachment managed by the
+			 context - cleared every frame and never stored */
 			virtual void SetDepthTesting(const bool enabled) = 0;
+			/* Lays down the depth of the pass being built in a depth-only draw ahead of all color draws of the
+			 frame, so its color draw shades visible fragments only. Implies depth testing */
+			virtual void SetDepthPrePass(const bool enabled) = 0;
+			virtual void SetCullMode(const CullMode mode) = 0;
+			/* Draws polygon edges only - needs the fillModeNonSolid feature, ignored without it */
+			virtual void SetWireframe(const bool enabled) = 0;
 			virtual void SetClearColor(const float rgb[3]) = 0;
 			virtual void SetViewport(const int xywh[4]) = 0;
+			/* Workgroup counts dispatched every run of the compute pass being built - a pass binding a compute
+			 shader is a compute pass. Storage buffers written by it are synchronized with later passes automatically */
+			virtual void Dispatch(const uint32_t groupCountX, const uint32_t groupCountY, const uint32_t groupCountZ) = 0;
+			/* Reads the workgroup counts (three uint32) from the storage buffer <argumentsP> at <offset> instead,
+			 so an earlier compute pass can size the dispatch */
+			virtual void DispatchIndirect(const Buffer *argumentsP, const uint32_t offset = 0u) = 0;
+			/* Runs the compute pass being built on a separate compute queue, overlapping the graphics work of
+			 other frames. Ignored on devices without a second compute queue family. Such passes cannot bind textures -
+			 these stay on the graphics queue their uploads are submitted to */
+			virtual void SetAsyncCompute(const bool enabled) = 0;
+			/* Draws the graphics pass being built from VkDrawIndexedIndirectCommands (five uint32 each) in the storage
+			 buffer <commandsP>, their number read from the uint32 at <countOffset> of <countP> and capped at
+			 <maxDrawCount>. Both are typically written by a culling compute pass, so recording cost does not grow
+			 with the scene. Indices come from the index buffer bound to the pass, commands may set a first instance -
+			 throws on devices without the indirect draw features this needs */
+			virtual void DrawIndexedIndirectCount(
+				const Buffer *commandsP,
+				const Buffer *countP,
+				const uint32_t maxDrawCount,
+				const uint32_t commandsOffset = 0u,
+				const uint32_t countOffset = 0u) = 0;
+			/* Zeroes the uint32 at <offset> of a storage buffer before every run of the pass being built - resets
+			 counters (draw counts) that compute passes append to with atomics */
+			virtual void ResetCounter(const Buffer *bufferP, const uint32_t offset = 0u) = 0;
 			virtual void RunPass(const int index) = 0;
+			/* Queues a draw of the graphics pass <index> for the next RunQueuedDraws. Draws are ordered by <layer>,
+			 then grouped by pipeline and descriptor set, then front to back by <depth> (0 near, 1 far) - callers
+			 need not sort them. Queued passes must not read what other queued passes write */
+			virtual void QueueDraw(const int index, const float depth = 0.0f, const uint8_t layer = 0u) = 0;
+			/* Renders every queued draw as one frame in a single render pass cleared with the color of the
+			 first draw, then empties the queue */
+			virtual void RunQueuedDraws() = 0;
 			virtual void PresentFrame() = 0;
 			virtual void EndPass() = 0;
+			/* Requests a host copy of the next rendered frame. <callback> is invoked from a later RunPass
+			 once the GPU copy has finished. Returns false if every readback slot is still in flight */
+			virtual bool ReadbackFrame(ReadbackCallback callback) = 0;
+			/* Blocks until all submitted frames are complete, delivers outstanding readbacks and frees the objects
+			 destroyed while those frames could still use them */
+			virtual void FlushReadbacks() = 0;
+			/* Resizes the offscreen target of a headless context - returns false when rendering to a window.
+			 Frames already in flight keep rendering to the previous target */
+			virtual bool SetRenderTarget(const uint32_t width, const uint32_t height) = 0;
+			virtual RenderStats GetStats() const = 0;
+			/* Breakdown of the host memory the driver allocated, per object type and allocation scope */
+			virtual void GetHostMemoryUsage(std::vector<HostMemoryUsage> &outUsage) const = 0;
+			/* Per-heap usage and budget (refreshed every frame), live allocations per category and peak watermarks */
+			virtual MemoryTelemetry GetMemoryTelemetry() const = 0;
+			/* Soft limit of every heap as a fraction of its budget (default 0.9). Eviction callbacks run when an
+			 allocation or the per-frame budget query finds a heap above it */
+			virtual void SetMemorySoftLimit(const float budgetFraction) = 0;
+			/* Returns an id for RemoveMemoryEvictionCallback. Callbacks run on the thread that detected the pressure */
+			virtual uint32_t AddMemoryEvictionCallback(MemoryEvictionCallback callback) = 0;
+			virtual void RemoveMemoryEvictionCallback(const uint32_t id) = 0;
+			/* Name of the adapter the context renders with */
+			virtual std::string GetDeviceName() const = 0;
+			/* Enables CPU scope timers and GPU timestamp queries. Results are collected without stalling,
+			 once the frames they belong to have completed */
+			virtual void SetProfiling(const bool enabled) = 0;
+			/* Enables pipeline statistics and occlusion queries around the draws of every pass. Results are
+			 attached to the GPU events of the profile history, collected the same way as timings. RunQueuedDraws
+			 nests an event per queued pass in its "Draw queue" event, plus one for the depth pre-pass draws of
+			 passes that have one - counters add up per pass name */
+			virtual void SetPassQueries(const bool enabled) = 0;
+			/* Copies the rolling history of profiled scopes, oldest first */
+			virtual void GetProfileHistory(std::vector<ProfileEvent> &outEvents) const = 0;
+			/* Moves the profile history to the end of <outEvents>, leaving it empty - appends, so long runs can drain
+			 it every frame into one vector and consume every event */
+			virtual void TakeProfileHistory(std::vector<ProfileEvent> &outEvents) = 0;
+			/* Writes the profile history as a Chrome trace (chrome://tracing, Perfetto) */
+			virtual bool WriteProfileTrace(const std::string &path) const = 0;
 
 			virtual ~RenderContext() {};
 		};
@@ -11,6 +11,8 @@ namespace PixelMachine {
 		class ShaderProgram {
 		public:
 			static ShaderProgram *CreateFromCompiled(const std::string name, const std::string compiledShaderPath, ShaderProgramType type);
+			/* Program of compiled <code> already in memory, <size> bytes */
+			static ShaderProgram *CreateFromCode(const std::string name, const void *code, const size_t size, ShaderProgramType type);
 			ShaderProgramType GetType() const { return m_type; }
 			virtual void Bind() const = 0;
 			virtual ~ShaderProgram() {};
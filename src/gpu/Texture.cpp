@@ -0,0 +1,35 @@
+#include "Texture.h"
+
+namespace PixelMachine {
+	namespace GPU {
+
+		bool IsCompressedFormat(const TextureFormat format) {
+			return format >= TextureFormat::TextureBC1;
+		}
+
+		uint32_t GetFormatBlockBytes(const TextureFormat format) {
+			switch (format)
+			{
+			case TextureFormat::TextureR8:			return 1u;
+			case TextureFormat::TextureRG8:			return 2u;
+			case TextureFormat::TextureRGBA8:
+			case TextureFormat::TextureRGBA8_SRGB:	return 4u;
+			case TextureFormat::TextureRGBA16F:		return 8u;
+			case TextureFormat::TextureBC1:
+			case TextureFormat::TextureBC1_SRGB:	return 8u;
+			default: break;
+			}
+			// RGBA32F and every 16 byte block format
+			return 16u;
+		}
+
+		uint64_t GetTextureLevelSize(const TextureFormat format, const uint32_t width, const uint32_t height) {
+
+			if (!IsCompressedFormat(format)) {
+				return static_cast<uint64_t>(width) * height * GetFormatBlockBytes(format);
+			}
+
+			return static_cast<uint64_t>((width + 3u) / 4u) * ((height + 3u) / 4u) * GetFormatBlockBytes(format);
+		}
+	}
+}
@@ -0,0 +1,123 @@
+#ifndef TEXTURE_H_
+#define TEXTURE_H_
+
+#include "ShaderEnum.h"
+
+#include <cstdint>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		enum TextureType {
+			Texture2D,
+			// <layers> 2D images sampled as one array
+			TextureArray,
+			// Six faces per layer (+X, -X, +Y, -Y, +Z, -Z) - more than one layer needs the imageCubeArray feature
+			TextureCube
+		};
+
+		enum TextureFormat {
+			TextureR8,
+			TextureRG8,
+			TextureRGBA8,
+			TextureRGBA8_SRGB,
+			TextureRGBA16F,
+			TextureRGBA32F,
+			// Block compressed - 4x4 texel blocks of 8 (BC1) or 16 bytes. Sampled natively where the device supports
+			// the format, transcoded to RGBA8 on upload otherwise (except ASTC). Mip levels are uploaded, not generated
+			TextureBC1,
+			TextureBC1_SRGB,
+			TextureBC3,
+			TextureBC3_SRGB,
+			// Two channels (RG) - normal maps
+			TextureBC5,
+			TextureBC7,
+			TextureBC7_SRGB,
+			TextureETC2_RGBA8,
+			TextureETC2_RGBA8_SRGB,
+			TextureASTC_4x4,
+			TextureASTC_4x4_SRGB
+		};
+
+		/* True for the block compressed formats */
+		bool IsCompressedFormat(const TextureFormat format);
+		/* Bytes of one 4x4 block of a compressed format, of one texel otherwise */
+		uint32_t GetFormatBlockBytes(const TextureFormat format);
+		/* Bytes of one <width> x <height> layer of <format>, rounded up to whole blocks */
+		uint64_t GetTextureLevelSize(const TextureFormat format, const uint32_t width, const uint32_t height);
+
+		enum TextureFilter {
+			NearestFilter,
+			LinearFilter
+		};
+
+		enum TextureAddressMode {
+			RepeatAddress,
+			MirroredRepeatAddress,
+			ClampToEdgeAddress
+		};
+
+		/* Sampling state - textures with equal sampler descriptions share one sampler object */
+		struct SamplerDesc {
+			TextureFilter minFilter = TextureFilter::LinearFilter;
+			TextureFilter magFilter = TextureFilter::LinearFilter;
+			TextureFilter mipFilter = TextureFilter::LinearFilter;
+			TextureAddressMode addressMode = TextureAddressMode::RepeatAddress;
+			// Values above 1 need the samplerAnisotropy feature, clamped to the device limit
+			float maxAnisotropy = 1.0f;
+		};
+
+		struct TextureDesc {
+			TextureType type = TextureType::Texture2D;
+			TextureFormat format = TextureFormat::TextureRGBA8;
+			uint32_t width = 1u;
+			uint32_t height = 1u;
+			// Array layers, or cubes of a cube texture
+			uint32_t layers = 1u;
+			// 0 - the full chain down to 1x1, a single level for compressed formats
+			uint32_t mipLevels = 0u;
+			// Finest level allocated at creation - coarser levels only until SetResidentMip streams finer ones in
+			uint32_t residentMip = 0u;
+			ShaderProgramType bindStage = ShaderProgramType::FragmentShader;
+			SamplerDesc sampler;
+		};
+
+		class Texture {
+		public:
+			/* Creates a texture in device local memory. Textures take descriptor set 0 bindings as combined
+			 image samplers after the uniform and storage buffers of a pass, in the order they are bound */
+			static Texture *Create(const TextureDesc &desc);
+			/* True when the device samples <format> directly - compressed formats are transcoded on upload otherwise */
+			static bool IsFormatSupported(const TextureFormat format);
+			const TextureDesc &GetDesc() const { return m_desc; }
+			/* Mip levels the texture was created with - less than requested when the format cannot be filtered */
+			virtual uint32_t GetMipLevels() const = 0;
+			virtual void Bind() const = 0;
+			/* Uploads the finest resident level of every layer (faces of a cube), tightly packed one after another, and
+			 generates the rest of the mip chain on the GPU (compressed formats only when transcoded). Returns without waiting for the copy - passes
+			 rendered later sample the new contents */
+			virtual void SetData(const void *data) = 0;
+			/* Uploads <mipLevel> of every layer, tightly packed - for mip chains prepared offline. No mips are generated.
+			 The level must be resident */
+			virtual void SetMipData(const uint32_t mipLevel, const void *data) = 0;
+			/* True once every upload issued so far has completed on the GPU */
+			virtual bool IsUploadComplete() const = 0;
+			/* True when compressed data is decoded to RGBA8 on upload as the device lacks the format */
+			virtual bool IsTranscoded() const = 0;
+			/* Finest level backed by memory - sampling clamps to it */
+			virtual uint32_t GetResidentMip() const = 0;
+			/* Device memory of the resident levels in bytes */
+			virtual uint64_t GetResidentSize() const = 0;
+			/* Reallocates the texture for the levels from <mipLevel> on. Levels resident before and after move on the
+			 GPU, levels becoming resident are uploaded from <levelData> - one pointer per level from <mipLevel> to the
+			 previous resident mip, packed as for SetMipData. Raising the resident mip evicts the finer levels */
+			virtual void SetResidentMip(const uint32_t mipLevel, const void *const *levelData = nullptr) = 0;
+			virtual ~Texture() {};
+		protected:
+			Texture(const TextureDesc &desc) : m_desc(desc) {};
+			TextureDesc m_desc;
+		};
+	}
+}
+
+#endif // !TEXTURE_H_
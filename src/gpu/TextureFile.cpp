@@ -0,0 +1,140 @@
+#include "TextureFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		/* Level count of a full chain down to 1x1 */
+		static uint32_t GetFullChainLevels(const uint32_t width, const uint32_t height) {
+			uint32_t levels = 1u;
+			for (uint32_t size = std::max(width, height); size > 1u; size >>= 1u) {
+				levels++;
+			}
+			return levels;
+		}
+
+		TextureFile::TextureFile(const std::string &path) : m_path(path) {
+
+			std::FILE *fileP = std::fopen(path.c_str(), "rb");
+
+			if (!fileP) {
+				throw new std::runtime_error("TextureFile load failed - unable to open " + path + ".");
+			}
+
+			TextureFileHeader header;
+			bool valid = std::fread(&header, sizeof(header), 1u, fileP) == 1u &&
+				header.magic == TextureFileMagic &&
+				header.version == TextureFileVersion &&
+				header.type <= TextureType::TextureCube &&
+				header.format <= TextureFormat::TextureASTC_4x4_SRGB &&
+				header.width && header.height && header.layers &&
+				header.mipLevels && header.mipLevels <= GetFullChainLevels(header.width, header.height);
+
+			if (valid) {
+				m_levels.resize(header.mipLevels);
+				valid = std::fread(m_levels.data(), sizeof(TextureFileLevel), m_levels.size(), fileP) == m_levels.size();
+			}
+
+			std::fseek(fileP, 0, SEEK_END);
+			const uint64_t fileSize = static_cast<uint64_t>(std::ftell(fileP));
+			std::fclose(fileP);
+
+			m_desc.type = static_cast<TextureType>(header.type);
+			m_desc.format = static_cast<TextureFormat>(header.format);
+			m_desc.width = header.width;
+			m_desc.height = header.height;
+			m_desc.layers = header.layers;
+			m_desc.mipLevels = header.mipLevels;
+
+			const uint32_t layerCount = m_desc.type == TextureType::TextureCube ? m_desc.layers * 6u : m_desc.layers;
+
+			// Level sizes follow from the format - anything else is a truncated or foreign file. Compared by
+			// subtraction, crafted offsets near 2^64 must not wrap around the file size
+			for (uint32_t i = 0; valid && i < m_levels.size(); i++) {
+				const uint64_t expectedSize = GetTextureLevelSize(m_desc.format, std::max(m_desc.width >> i, 1u), std::max(m_desc.height >> i, 1u)) * layerCount;
+				valid = m_levels[i].size == expectedSize && m_levels[i].offset <= fileSize && m_levels[i].size <= fileSize - m_levels[i].offset;
+			}
+
+			if (!valid) {
+				throw new std::runtime_error("TextureFile load failed - " + path + " is not a valid texture file.");
+			}
+		}
+
+		void TextureFile::ReadLevel(const uint32_t mipLevel, void *outputP) const {
+
+			std::FILE *fileP = std::fopen(m_path.c_str(), "rb");
+
+			const bool read = fileP &&
+				std::fseek(fileP, static_cast<long>(m_levels[mipLevel].offset), SEEK_SET) == 0 &&
+				std::fread(outputP, 1u, m_levels[mipLevel].size, fileP) == m_levels[mipLevel].size;
+
+			if (fileP) {
+				std::fclose(fileP);
+			}
+
+			if (!read) {
+				throw new std::runtime_error("TextureFile read failed - unable to read " + m_path + ".");
+			}
+		}
+
+		Texture *TextureFile::CreateTexture(const SamplerDesc &sampler, const uint32_t residentMip) const {
+
+			TextureDesc desc = m_desc;
+			desc.sampler = sampler;
+			desc.residentMip = std::min(residentMip, desc.mipLevels - 1u);
+
+			Texture *textureP = Texture::Create(desc);
+			std::vector<uint8_t> levelData;
+
+			for (uint32_t i = desc.residentMip; i < m_levels.size(); i++) {
+				levelData.resize(m_levels[i].size);
+				ReadLevel(i, levelData.data());
+				textureP->SetMipData(i, levelData.data());
+			}
+
+			return textureP;
+		}
+
+		void TextureFile::Write(const std::string &path, const TextureDesc &desc, const std::vector<std::vector<uint8_t>> &levels) {
+
+			TextureFileHeader header;
+			header.type = desc.type;
+			header.format = desc.format;
+			header.width = desc.width;
+			header.height = desc.height;
+			header.layers = desc.layers;
+			header.mipLevels = levels.size();
+
+			std::vector<TextureFileLevel> table(levels.size());
+			uint64_t offset = sizeof(TextureFileHeader) + sizeof(TextureFileLevel) * table.size();
+
+			for (uint32_t i = 0; i < levels.size(); i++) {
+				table[i].offset = offset;
+				table[i].size = levels[i].size();
+				offset += table[i].size;
+			}
+
+			std::FILE *fileP = std::fopen(path.c_str(), "wb");
+
+			if (!fileP) {
+				throw new std::runtime_error("TextureFile write failed - unable to open " + path + ".");
+			}
+
+			bool written = std::fwrite(&header, sizeof(header), 1u, fileP) == 1u &&
+				std::fwrite(table.data(), sizeof(TextureFileLevel), table.size(), fileP) == table.size();
+
+			for (uint32_t i = 0; written && i < levels.size(); i++) {
+				written = std::fwrite(levels[i].data(), 1u, levels[i].size(), fileP) == levels[i].size();
+			}
+
+			written = std::fclose(fileP) == 0 && written;
+
+			if (!written) {
+				throw new std::runtime_error("TextureFile write failed - unable to write " + path + ".");
+			}
+		}
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef TEXTURE_FILE_H_
+#define TEXTURE_FILE_H_
+
+#include "Texture.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		// "PMTX" read as a little endian uint32
+		static constexpr uint32_t TextureFileMagic = 0x58544D50u;
+		static constexpr uint32_t TextureFileVersion = 1u;
+
+		/* Header of a .pmtex file, little endian. Followed by <mipLevels> level entries and the level data */
+		struct TextureFileHeader {
+			uint32_t magic = TextureFileMagic;
+			uint32_t version = TextureFileVersion;
+			uint32_t type = 0u;
+			uint32_t format = 0u;
+			uint32_t width = 0u;
+			uint32_t height = 0u;
+			uint32_t layers = 0u;
+			uint32_t mipLevels = 0u;
+		};
+
+		/* One mip level - the data of every layer (faces of a cube), tightly packed one after another */
+		struct TextureFileLevel {
+			uint64_t offset = 0u;
+			uint64_t size = 0u;
+		};
+
+		/// <summary>
+		/// Texture container holding mip chains prepared offline, typically block compressed. Levels are stored
+		/// finest first and back to back, any range of them is read with a single read call.
+		/// </summary>
+		class TextureFile {
+		public:
+			/* Reads the header and level table of <path> - throws when the file is missing or malformed */
+			TextureFile(const std::string &path);
+
+			/* Format, extent and stored level count of the texture - the sampler is left at its defaults */
+			const TextureDesc &GetDesc() const { return m_desc; }
+			const std::string &GetPath() const { return m_path; }
+			const TextureFileLevel &GetLevel(const uint32_t mipLevel) const { return m_levels[mipLevel]; }
+			/* Reads <mipLevel> into <outputP>, GetLevel(mipLevel).size bytes */
+			void ReadLevel(const uint32_t mipLevel, void *outputP) const;
+			/* Creates a texture with the stored levels from <residentMip> on - sampled natively when the device supports
+			 the format, transcoded to RGBA8 otherwise */
+			Texture *CreateTexture(const SamplerDesc &sampler = SamplerDesc(), const uint32_t residentMip = 0u) const;
+
+			/* Writes <levels>, the data of every mip level finest first, as a texture of <desc> - throws on failure */
+			static void Write(const std::string &path, const TextureDesc &desc, const std::vector<std::vector<uint8_t>> &levels);
+
+		private:
+			std::string m_path;
+			TextureDesc m_desc;
+			std::vector<TextureFileLevel> m_levels;
+		};
+	}
+}
+
+#endif // !TEXTURE_FILE_H_
@@ -0,0 +1,333 @@
+#include "TextureStreamer.h"
+#include "TextureTranscoder.h"
+#include "RenderContext.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <tuple>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		// Share of the device local heap budget taken when no budget is given
+		static constexpr double s_defaultBudgetFraction = 0.5;
+
+		TextureStreamer::TextureStreamer(const uint64_t budgetBytes) : m_budgetBytes(budgetBytes) {
+
+			RenderContext *contextP = RenderContext::Get();
+			const MemoryTelemetry telemetry = contextP->GetMemoryTelemetry();
+			std::vector<bool> deviceLocalHeaps;
+
+			for (auto &heap : telemetry.heaps) {
+				deviceLocalHeaps.resize(std::max<size_t>(deviceLocalHeaps.size(), heap.heapIndex + 1u));
+				deviceLocalHeaps[heap.heapIndex] = heap.deviceLocal;
+				if (!budgetBytes && heap.deviceLocal) {
+					m_budgetBytes = std::max(m_budgetBytes, static_cast<uint64_t>(heap.budget * s_defaultBudgetFraction));
+				}
+			}
+
+			// Called from the frame on the render thread - evicted by the next Update
+			m_evictionCallbackId = contextP->AddMemoryEvictionCallback([this, deviceLocalHeaps](const MemoryPressure &pressure) {
+				if (pressure.heapIndex < deviceLocalHeaps.size() && deviceLocalHeaps[pressure.heapIndex]) {
+					m_pressureBytes = std::max(m_pressureBytes, pressure.bytesOverLimit);
+				}
+			});
+
+			m_worker = std::thread(&TextureStreamer::RunWorker, this);
+		}
+
+		TextureStreamer::~TextureStreamer() {
+
+			RenderContext::Get()->RemoveMemoryEvictionCallback(m_evictionCallbackId);
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stopWorker = true;
+			}
+
+			m_condition.notify_all();
+			m_worker.join();
+		}
+
+		void TextureStreamer::RunWorker() {
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			while (true) {
+
+				m_condition.wait(lock, [this]() { return m_stopWorker || m_queuedLoads.size(); });
+
+				if (m_stopWorker) {
+					return;
+				}
+
+				StreamLoad load = std::move(m_queuedLoads.front());
+				m_queuedLoads.pop_front();
+
+				// Files are read without holding the lock - Update and Remove only wait for queue changes
+				lock.unlock();
+
+				load.m_levels.resize(load.m_residentMip - load.m_firstMip);
+
+				try {
+					for (uint32_t level = load.m_firstMip; level < load.m_residentMip; level++) {
+						std::vector<uint8_t> &data = load.m_levels[level - load.m_firstMip];
+						data.resize(load.m_fileP->GetLevel(level).size);
+						load.m_fileP->ReadLevel(level, data.data());
+					}
+				}
+				catch (std::runtime_error *errorP) {
+					// A file changed or gone since it was added - the texture keeps its resident levels
+					delete errorP;
+					load.m_levels.clear();
+				}
+
+				lock.lock();
+				m_completedLoads.push_back(std::move(load));
+			}
+		}
+
+		Texture *TextureStreamer::Add(const std::string &path, const SamplerDesc &sampler, const uint32_t residentSize) {
+
+			StreamedTexture texture;
+			texture.m_fileP = std::make_shared<const TextureFile>(path);
+
+			// The coarse tail is small and created synchronously - the texture is always sampleable
+			const TextureDesc &desc = texture.m_fileP->GetDesc();
+			while (texture.m_coarseMip + 1u < desc.mipLevels && std::max(desc.width, desc.height) >> texture.m_coarseMip > residentSize) {
+				texture.m_coarseMip++;
+			}
+
+			texture.m_textureP.reset(texture.m_fileP->CreateTexture(sampler, texture.m_coarseMip));
+			texture.m_neededMip = texture.m_coarseMip;
+
+			Texture *textureP = texture.m_textureP.get();
+			m_textures[textureP] = std::move(texture);
+			return textureP;
+		}
+
+		void TextureStreamer::Remove(const Texture *textureP) {
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_queuedLoads.erase(
+					std::remove_if(m_queuedLoads.begin(), m_queuedLoads.end(), [textureP](const StreamLoad &load) { return load.m_textureP == textureP; }),
+					m_queuedLoads.end());
+			}
+
+			// A load being read is discarded by Update as the texture is gone
+			m_textures.erase(textureP);
+		}
+
+		void TextureStreamer::Request(const Texture *textureP, const float screenSize) {
+
+			auto found = m_textures.find(textureP);
+
+			if (found == m_textures.end()) {
+				return;
+			}
+
+			StreamedTexture &texture = found->second;
+			const TextureDesc &desc = textureP->GetDesc();
+
+			// One level per halving of the texels covering a pixel - finer levels would only alias
+			const float texels = static_cast<float>(std::max(desc.width, desc.height));
+			const float ratio = texels / std::max(screenSize, 1.0f);
+			const uint32_t mipLevel = ratio > 1.0f ? static_cast<uint32_t>(std::floor(std::log2(ratio))) : 0u;
+
+			texture.m_requestedMip = std::min({ texture.m_requestedMip, mipLevel, textureP->GetMipLevels() - 1u });
+			texture.m_lastUsedFrame = m_frameNumber;
+		}
+
+		uint64_t TextureStreamer::EstimateResidentSize(const StreamedTexture &texture, const uint32_t mipLevel) const {
+
+			const Texture *textureP = texture.m_textureP.get();
+			const TextureDesc &desc = textureP->GetDesc();
+			const TextureFormat format = textureP->IsTranscoded() ? TextureTranscoder::GetTranscodedFormat(desc.format) : desc.format;
+			const uint64_t layers = desc.type == TextureType::TextureCube ? desc.layers * 6u : desc.layers;
+
+			uint64_t size = 0u;
+
+			for (uint32_t level = mipLevel; level < textureP->GetMipLevels(); level++) {
+				size += GetTextureLevelSize(format, std::max(desc.width >> level, 1u), std::max(desc.height >> level, 1u)) * layers;
+			}
+
+			return size;
+		}
+
+		bool TextureStreamer::Evict(const uint64_t limit, const bool staleOnly, uint64_t &residentBytes) {
+
+			while (residentBytes > limit) {
+
+				// Levels finer than their texture needs go first, then the least recently used ones
+				StreamedTexture *victimP = nullptr;
+				std::tuple<bool, uint64_t> victimKey;
+
+				for (auto &entry : m_textures) {
+
+					StreamedTexture &texture = entry.second;
+					const uint32_t residentMip = texture.m_textureP->GetResidentMip();
+
+					if (residentMip >= texture.m_coarseMip || (staleOnly && texture.m_lastUsedFrame == m_frameNumber)) {
+						continue;
+					}
+
+					const std::tuple<bool, uint64_t> key(residentMip >= texture.m_neededMip, texture.m_lastUsedFrame);
+
+					if (!victimP || key < victimKey) {
+						victimP = &texture;
+						victimKey = key;
+					}
+				}
+
+				if (!victimP) {
+					return false;
+				}
+
+				Texture *textureP = victimP->m_textureP.get();
+				const uint32_t residentMip = textureP->GetResidentMip();
+				const uint32_t evictedMip = residentMip < victimP->m_neededMip ? std::min(victimP->m_neededMip, victimP->m_coarseMip) : residentMip + 1u;
+				const uint64_t residentSize = textureP->GetResidentSize();
+
+				textureP->SetResidentMip(evictedMip);
+
+				residentBytes = residentBytes - residentSize + textureP->GetResidentSize();
+				m_stats.evictedLevels += evictedMip - residentMip;
+			}
+
+			return true;
+		}
+
+		void TextureStreamer::Update() {
+
+			std::vector<StreamLoad> completedLoads;
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				completedLoads.swap(m_completedLoads);
+			}
+
+			for (auto &load : completedLoads) {
+
+				auto found = m_textures.find(load.m_textureP);
+
+				// Removed, or removed and added again, since the load was queued - every Add opens its own file
+				if (found == m_textures.end() || found->second.m_fileP != load.m_fileP) {
+					m_stats.discardedLoads++;
+					continue;
+				}
+
+				StreamedTexture &texture = found->second;
+				texture.m_loadingMip = ~0u;
+
+				// Evicted since the load was queued, or the read failed - its levels no longer continue the resident ones
+				if (texture.m_textureP->GetResidentMip() != load.m_residentMip || load.m_levels.empty()) {
+					m_stats.discardedLoads++;
+					continue;
+				}
+
+				std::vector<const void *> levelData;
+
+				for (auto &level : load.m_levels) {
+					levelData.push_back(level.data());
+				}
+
+				texture.m_textureP->SetResidentMip(load.m_firstMip, levelData.data());
+				m_stats.streamedLevels += load.m_residentMip - load.m_firstMip;
+			}
+
+			uint64_t residentBytes = 0u;
+			std::vector<StreamedTexture *> requested;
+
+			for (auto &entry : m_textures) {
+
+				StreamedTexture &texture = entry.second;
+
+				// Loads still being read keep their reservation
+				residentBytes += texture.m_loadingMip != ~0u ? EstimateResidentSize(texture, texture.m_loadingMip) : texture.m_textureP->GetResidentSize();
+
+				if (texture.m_requestedMip != ~0u) {
+					texture.m_neededMip = texture.m_requestedMip;
+					texture.m_requestedMip = ~0u;
+				}
+
+				if (texture.m_lastUsedFrame == m_frameNumber && texture.m_neededMip < texture.m_textureP->GetResidentMip() && texture.m_loadingMip == ~0u) {
+					requested.push_back(&texture);
+				}
+			}
+
+			// Pressure reported by the device comes on top of the budget
+			const uint64_t limit = m_budgetBytes - std::min(m_pressureBytes, m_budgetBytes);
+			m_pressureBytes = 0u;
+
+			Evict(limit, false, residentBytes);
+
+			// Textures furthest from the level they are drawn at load first
+			std::sort(requested.begin(), requested.end(), [](const StreamedTexture *aP, const StreamedTexture *bP) {
+				return aP->m_textureP->GetResidentMip() - aP->m_neededMip > bP->m_textureP->GetResidentMip() - bP->m_neededMip;
+			});
+
+			std::vector<StreamLoad> loads;
+
+			for (auto textureP : requested) {
+
+				const uint32_t residentMip = textureP->m_textureP->GetResidentMip();
+				const uint64_t residentSize = textureP->m_textureP->GetResidentSize();
+				uint32_t firstMip = residentMip;
+
+				// As many of the requested levels as the budget allows, coarsest first
+				while (firstMip > textureP->m_neededMip && residentBytes - residentSize + EstimateResidentSize(*textureP, firstMip - 1u) <= limit) {
+					firstMip--;
+				}
+
+				// Nothing fits - room is made by evicting textures not drawn this frame
+				if (firstMip == residentMip) {
+					const uint64_t required = EstimateResidentSize(*textureP, residentMip - 1u) - residentSize;
+					const uint64_t freeLimit = limit > required ? limit - required : 0u;
+
+					if (!Evict(freeLimit, true, residentBytes)) {
+						continue;
+					}
+
+					firstMip = residentMip - 1u;
+				}
+
+				// Reserved until the levels arrive
+				residentBytes = residentBytes - residentSize + EstimateResidentSize(*textureP, firstMip);
+				textureP->m_loadingMip = firstMip;
+
+				StreamLoad load;
+				load.m_textureP = textureP->m_textureP.get();
+				load.m_fileP = textureP->m_fileP;
+				load.m_firstMip = firstMip;
+				load.m_residentMip = residentMip;
+				loads.push_back(std::move(load));
+			}
+
+			if (loads.size()) {
+				std::lock_guard<std::mutex> lock(m_mutex);
+				for (auto &load : loads) {
+					m_queuedLoads.push_back(std::move(load));
+				}
+			}
+
+			m_condition.notify_one();
+			m_frameNumber++;
+		}
+
+		TextureStreamerStats TextureStreamer::GetStats() const {
+
+			TextureStreamerStats stats = m_stats;
+			stats.textures = m_textures.size();
+			stats.budgetBytes = m_budgetBytes;
+
+			for (auto &entry : m_textures) {
+				stats.residentBytes += entry.second.m_textureP->GetResidentSize();
+				stats.pendingLoads += entry.second.m_loadingMip != ~0u ? 1u : 0u;
+			}
+
+			return stats;
+		}
+	}
+}
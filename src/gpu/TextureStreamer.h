@@ -0,0 +1,113 @@
+#ifndef TEXTURE_STREAMER_H_
+#define TEXTURE_STREAMER_H_
+
+#include "Texture.h"
+#include "TextureFile.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		struct TextureStreamerStats {
+			uint32_t textures = 0;
+			// Device memory of the resident levels of every texture and the budget they are kept within
+			uint64_t residentBytes = 0;
+			uint64_t budgetBytes = 0;
+			// Levels read from disk and made resident, levels dropped to stay within the budget
+			uint64_t streamedLevels = 0;
+			uint64_t evictedLevels = 0;
+			// Loads queued or being read, and completed ones discarded as the texture changed meanwhile
+			uint32_t pendingLoads = 0;
+			uint64_t discardedLoads = 0;
+		};
+
+		/// <summary>
+		/// Keeps the mip levels of textures loaded from .pmtex files resident only as far as they are seen.
+		/// Textures start with their coarse tail, finer levels are read on a worker thread once a draw asks for
+		/// them and made resident by Update, least recently used levels are evicted whenever the resident total
+		/// exceeds the budget or the device reports memory pressure. The needed level is estimated from the
+		/// screen-space size a texture is drawn at.
+		/// </summary>
+		class TextureStreamer {
+		public:
+			/* A <budgetBytes> of 0 takes half the budget of the largest device local heap */
+			TextureStreamer(const uint64_t budgetBytes = 0u);
+			TextureStreamer(const TextureStreamer &) = delete;
+			TextureStreamer &operator=(const TextureStreamer &) = delete;
+			~TextureStreamer();
+
+			/* Creates a texture of the .pmtex file at <path> with the levels up to <residentSize> texels on the larger
+			 axis resident - throws when the file is missing or malformed. The texture is owned by the streamer */
+			Texture *Add(const std::string &path, const SamplerDesc &sampler = SamplerDesc(), const uint32_t residentSize = 64u);
+			/* Destroys <textureP>, discarding loads still pending for it */
+			void Remove(const Texture *textureP);
+			/* Marks <textureP> as used this frame, covering <screenSize> pixels on its larger axis - the largest size
+			 requested since the last Update decides the level streamed in */
+			void Request(const Texture *textureP, const float screenSize);
+			/* Render thread, once per frame - makes completed loads resident, evicts down to the budget and queues
+			 loads for the textures requested this frame, those furthest from the level they need first. A load that
+			 does not fit evicts textures not drawn this frame, or waits */
+			void Update();
+
+			void SetBudget(const uint64_t budgetBytes) { m_budgetBytes = budgetBytes; }
+			uint64_t GetBudget() const { return m_budgetBytes; }
+			TextureStreamerStats GetStats() const;
+
+		private:
+			struct StreamedTexture {
+				std::unique_ptr<Texture> m_textureP;
+				std::shared_ptr<const TextureFile> m_fileP;
+				// Never evicted below - the levels created with the texture
+				uint32_t m_coarseMip = 0u;
+				// Finest level requested since the last Update and the one last asked for
+				uint32_t m_requestedMip = ~0u;
+				uint32_t m_neededMip = 0u;
+				uint64_t m_lastUsedFrame = 0;
+				// First level of the load being read, ~0u when there is none
+				uint32_t m_loadingMip = ~0u;
+			};
+
+			/* Levels [m_firstMip, m_residentMip) of a texture read on the worker thread */
+			struct StreamLoad {
+				const Texture *m_textureP = nullptr;
+				std::shared_ptr<const TextureFile> m_fileP;
+				uint32_t m_firstMip = 0u;
+				uint32_t m_residentMip = 0u;
+				std::vector<std::vector<uint8_t>> m_levels;
+			};
+
+			void RunWorker();
+			/* Device memory <texture> would take with the levels from <mipLevel> on */
+			uint64_t EstimateResidentSize(const StreamedTexture &texture, const uint32_t mipLevel) const;
+			/* Evicts levels, least recently used first, until the resident total fits <limit> - <staleOnly> spares the
+			 textures requested this frame. Returns true when it fits */
+			bool Evict(const uint64_t limit, const bool staleOnly, uint64_t &residentBytes);
+
+			std::unordered_map<const Texture *, StreamedTexture> m_textures;
+			uint64_t m_budgetBytes = 0;
+			uint64_t m_frameNumber = 1;
+			TextureStreamerStats m_stats;
+			// Bytes asked for by eviction callbacks since the last Update
+			uint64_t m_pressureBytes = 0;
+			uint32_t m_evictionCallbackId = 0;
+
+			std::thread m_worker;
+			std::mutex m_mutex;
+			std::condition_variable m_condition;
+			std::deque<StreamLoad> m_queuedLoads;
+			std::vector<StreamLoad> m_completedLoads;
+			bool m_stopWorker = false;
+		};
+	}
+}
+
+#endif // !TEXTURE_STREAMER_H_
@@ -0,0 +1,640 @@
+#include "TextureTranscoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		// Below this many blocks per layer threads cost more than they save - small mips decode on the caller
+		static constexpr uint32_t s_minBlocksPerThread = 1024u;
+
+		// BC7 2 subset partitions - bit i set when texel i belongs to subset 1
+		static const uint16_t s_bc7Partitions2[64] = {
+			0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+			0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+			0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+			0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22 };
+
+		// BC7 3 subset partitions - subset of every texel
+		static const uint8_t s_bc7Partitions3[64][16] = {
+			{ 0,0,1,1,0,0,1,1,0,2,2,1,2,2,2,2 }, { 0,0,0,1,0,0,1,1,2,2,1,1,2,2,2,1 }, { 0,0,0,0,2,0,0,1,2,2,1,1,2,2,1,1 }, { 0,2,2,2,0,0,2,2,0,0,1,1,0,1,1,1 },
+			{ 0,0,0,0,0,0,0,0,1,1,2,2,1,1,2,2 }, { 0,0,1,1,0,0,1,1,0,0,2,2,0,0,2,2 }, { 0,0,2,2,0,0,2,2,1,1,1,1,1,1,1,1 }, { 0,0,1,1,0,0,1,1,2,2,1,1,2,2,1,1 },
+			{ 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2 }, { 0,0,0,0,1,1,1,1,1,1,1,1,2,2,2,2 }, { 0,0,0,0,1,1,1,1,2,2,2,2,2,2,2,2 }, { 0,0,1,2,0,0,1,2,0,0,1,2,0,0,1,2 },
+			{ 0,1,1,2,0,1,1,2,0,1,1,2,0,1,1,2 }, { 0,1,2,2,0,1,2,2,0,1,2,2,0,1,2,2 }, { 0,0,1,1,0,1,1,2,1,1,2,2,1,2,2,2 }, { 0,0,1,1,2,0,0,1,2,2,0,0,2,2,2,0 },
+			{ 0,0,0,1,0,0,1,1,0,1,1,2,1,1,2,2 }, { 0,1,1,1,0,0,1,1,2,0,0,1,2,2,0,0 }, { 0,0,0,0,1,1,2,2,1,1,2,2,1,1,2,2 }, { 0,0,2,2,0,0,2,2,0,0,2,2,1,1,1,1 },
+			{ 0,1,1,1,0,1,1,1,0,2,2,2,0,2,2,2 }, { 0,0,0,1,0,0,0,1,2,2,2,1,2,2,2,1 }, { 0,0,0,0,0,0,1,1,0,1,2,2,0,1,2,2 }, { 0,0,0,0,1,1,0,0,2,2,1,0,2,2,1,0 },
+			{ 0,1,2,2,0,1,2,2,0,0,1,1,0,0,0,0 }, { 0,0,1,2,0,0,1,2,1,1,2,2,2,2,2,2 }, { 0,1,1,0,1,2,2,1,1,2,2,1,0,1,1,0 }, { 0,0,0,0,0,1,1,0,1,2,2,1,1,2,2,1 },
+			{ 0,0,2,2,1,1,0,2,1,1,0,2,0,0,2,2 }, { 0,1,1,0,0,1,1,0,2,0,0,2,2,2,2,2 }, { 0,0,1,1,0,1,2,2,0,1,2,2,0,0,1,1 }, { 0,0,0,0,2,0,0,0,2,2,1,1,2,2,2,1 },
+			{ 0,0,0,0,0,0,0,2,1,1,2,2,1,2,2,2 }, { 0,2,2,2,0,0,2,2,0,0,1,2,0,0,1,1 }, { 0,0,1,1,0,0,1,2,0,0,2,2,0,2,2,2 }, { 0,1,2,0,0,1,2,0,0,1,2,0,0,1,2,0 },
+			{ 0,0,0,0,1,1,1,1,2,2,2,2,0,0,0,0 }, { 0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0 }, { 0,1,2,0,2,0,1,2,1,2,0,1,0,1,2,0 }, { 0,0,1,1,2,2,0,0,1,1,2,2,0,0,1,1 },
+			{ 0,0,1,1,1,1,2,2,2,2,0,0,0,0,1,1 }, { 0,1,0,1,0,1,0,1,2,2,2,2,2,2,2,2 }, { 0,0,0,0,0,0,0,0,2,1,2,1,2,1,2,1 }, { 0,0,2,2,1,1,2,2,0,0,2,2,1,1,2,2 },
+			{ 0,0,2,2,0,0,1,1,0,0,2,2,0,0,1,1 }, { 0,2,2,0,1,2,2,1,0,2,2,0,1,2,2,1 }, { 0,1,0,1,2,2,2,2,2,2,2,2,0,1,0,1 }, { 0,0,0,0,2,1,2,1,2,1,2,1,2,1,2,1 },
+			{ 0,1,0,1,0,1,0,1,0,1,0,1,2,2,2,2 }, { 0,2,2,2,0,1,1,1,0,2,2,2,0,1,1,1 }, { 0,0,0,2,1,1,1,2,0,0,0,2,1,1,1,2 }, { 0,0,0,0,2,1,1,2,2,1,1,2,2,1,1,2 },
+			{ 0,2,2,2,0,1,1,1,0,1,1,1,0,2,2,2 }, { 0,0,0,2,1,1,1,2,1,1,1,2,0,0,0,2 }, { 0,1,1,0,0,1,1,0,0,1,1,0,2,2,2,2 }, { 0,0,0,0,0,0,0,0,2,1,1,2,2,1,1,2 },
+			{ 0,1,1,0,0,1,1,0,2,2,2,2,2,2,2,2 }, { 0,0,2,2,0,0,1,1,0,0,1,1,0,0,2,2 }, { 0,0,2,2,1,1,2,2,1,1,2,2,0,0,2,2 }, { 0,0,0,0,0,0,0,0,0,0,0,0,2,1,1,2 },
+			{ 0,0,0,2,0,0,0,1,0,0,0,2,0,0,0,1 }, { 0,2,2,2,1,2,2,2,0,2,2,2,1,2,2,2 }, { 0,1,0,1,2,2,2,2,2,2,2,2,2,2,2,2 }, { 0,1,1,1,2,0,1,1,2,2,0,1,2,2,2,0 } };
+
+		// Texels storing one index bit less - the first texel of subset 1 (2 subsets), of subsets 1 and 2 (3 subsets)
+		static const uint8_t s_bc7Anchors2[64] = {
+			15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15, 15, 2, 8, 2, 2, 8, 8,15,  2, 8, 2, 2, 8, 8, 2, 2,
+			15,15, 6, 8, 2, 8,15,15,  2, 8, 2, 2, 2,15,15, 6,  6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15 };
+		static const uint8_t s_bc7Anchors3a[64] = {
+			 3, 3,15,15, 8, 3,15,15,  8, 8, 6, 6, 6, 5, 3, 3,  3, 3, 8,15, 3, 3, 6,10,  5, 8, 8, 6, 8, 5,15,15,
+			 8,15, 3, 5, 6,10, 8,15, 15, 3,15, 5,15,15,15,15,  3,15, 5, 5, 5, 8, 5,10,  5,10, 8,13,15,12, 3, 3 };
+		static const uint8_t s_bc7Anchors3b[64] = {
+			15, 8, 8, 3,15,15, 3, 8, 15,15,15,15,15,15,15, 8, 15, 8,15, 3,15, 8,15, 8,  3,15, 6,10,15,15,10, 8,
+			15, 3,15,10,10, 8, 9,10,  6,15, 8,15, 3, 6, 6, 8, 15, 3,15,15,15,15,15,15, 15,15,15,15, 3,15,15, 8 };
+
+		static const uint8_t s_bc7Weights2[4] = { 0, 21, 43, 64 };
+		static const uint8_t s_bc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+		static const uint8_t s_bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		/* Field widths of one BC7 mode */
+		struct Bc7Mode {
+			uint8_t subsets;
+			uint8_t partitionBits;
+			uint8_t rotationBits;
+			uint8_t indexSelectionBits;
+			uint8_t colorBits;
+			uint8_t alphaBits;
+			// P-bits - one per endpoint, or one shared by both endpoints of a subset
+			uint8_t endpointPBits;
+			uint8_t sharedPBits;
+			uint8_t indexBits;
+			uint8_t secondaryIndexBits;
+		};
+
+		static const Bc7Mode s_bc7Modes[8] = {
+			{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+			{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+			{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+			{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+			{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+			{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+			{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+			{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 } };
+
+		// ETC1/ETC2 intensity modifiers per table codeword, indexed by (msb << 1) | lsb of a texel
+		static const int32_t s_etcModifiers[8][4] = {
+			{ 2, 8, -2, -8 }, { 5, 17, -5, -17 }, { 9, 29, -9, -29 }, { 13, 42, -13, -42 },
+			{ 18, 60, -18, -60 }, { 24, 80, -24, -80 }, { 33, 106, -33, -106 }, { 47, 183, -47, -183 } };
+
+		// ETC2 T and H mode paint color distances
+		static const int32_t s_etcDistances[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+		// EAC modifiers per table index
+		static const int32_t s_eacModifiers[16][8] = {
+			{ -3, -6, -9, -15, 2, 5, 8, 14 }, { -3, -7, -10, -13, 2, 6, 9, 12 }, { -2, -5, -8, -13, 1, 4, 7, 12 }, { -2, -4, -6, -13, 1, 3, 5, 12 },
+			{ -3, -6, -8, -12, 2, 5, 7, 11 }, { -3, -7, -9, -11, 2, 6, 8, 10 }, { -4, -7, -8, -11, 3, 6, 7, 10 }, { -3, -5, -8, -11, 2, 4, 7, 10 },
+			{ -2, -6, -8, -10, 1, 5, 7, 9 }, { -2, -5, -8, -10, 1, 4, 7, 9 }, { -2, -4, -8, -10, 1, 3, 7, 9 }, { -2, -5, -7, -10, 1, 4, 6, 9 },
+			{ -3, -4, -7, -10, 2, 3, 6, 9 }, { -1, -2, -3, -10, 0, 1, 2, 9 }, { -4, -6, -8, -9, 3, 5, 7, 8 }, { -3, -5, -7, -9, 2, 4, 6, 8 } };
+
+		static inline uint8_t Clamp255(const int32_t value) {
+			return static_cast<uint8_t>(std::clamp(value, 0, 255));
+		}
+
+		static inline uint16_t ReadLE16(const uint8_t *data) {
+			return static_cast<uint16_t>(data[0] | (data[1] << 8u));
+		}
+
+		static inline uint64_t ReadBE64(const uint8_t *data) {
+			uint64_t value = 0;
+			for (uint32_t i = 0; i < 8u; i++) {
+				value = (value << 8u) | data[i];
+			}
+			return value;
+		}
+
+		/* BC1 color block - <fourColors> ignores the endpoint order selecting 3 colors and transparent black (BC3) */
+		static void DecodeBC1Color(const uint8_t *block, uint8_t *texels, const bool fourColors) {
+
+			const uint16_t c0 = ReadLE16(block);
+			const uint16_t c1 = ReadLE16(block + 2u);
+			uint32_t indices = block[4] | (block[5] << 8u) | (block[6] << 16u) | (static_cast<uint32_t>(block[7]) << 24u);
+
+			uint8_t palette[4][4];
+			const uint16_t endpoints[2] = { c0, c1 };
+
+			for (uint32_t i = 0; i < 2u; i++) {
+				const uint32_t r = (endpoints[i] >> 11u) & 31u;
+				const uint32_t g = (endpoints[i] >> 5u) & 63u;
+				const uint32_t b = endpoints[i] & 31u;
+				palette[i][0] = static_cast<uint8_t>((r << 3u) | (r >> 2u));
+				palette[i][1] = static_cast<uint8_t>((g << 2u) | (g >> 4u));
+				palette[i][2] = static_cast<uint8_t>((b << 3u) | (b >> 2u));
+				palette[i][3] = 255u;
+			}
+
+			for (uint32_t channel = 0; channel < 3u; channel++) {
+				const uint32_t a = palette[0][channel];
+				const uint32_t b = palette[1][channel];
+				if (c0 > c1 || fourColors) {
+					palette[2][channel] = static_cast<uint8_t>((2u * a + b) / 3u);
+					palette[3][channel] = static_cast<uint8_t>((a + 2u * b) / 3u);
+				}
+				else {
+					palette[2][channel] = static_cast<uint8_t>((a + b) / 2u);
+					palette[3][channel] = 0u;
+				}
+			}
+
+			palette[2][3] = 255u;
+			palette[3][3] = c0 > c1 || fourColors ? 255u : 0u;
+
+			for (uint32_t i = 0; i < 16u; i++, indices >>= 2u) {
+				std::memcpy(texels + i * 4u, palette[indices & 3u], 4u);
+			}
+		}
+
+		/* BC4 block (alpha of BC3, channels of BC5) written to every 4th byte of <texels> */
+		static void DecodeBC4Channel(const uint8_t *block, uint8_t *texels) {
+
+			const uint32_t a0 = block[0];
+			const uint32_t a1 = block[1];
+
+			uint8_t values[8] = { static_cast<uint8_t>(a0), static_cast<uint8_t>(a1) };
+
+			if (a0 > a1) {
+				for (uint32_t i = 1u; i < 7u; i++) {
+					values[i + 1u] = static_cast<uint8_t>(((7u - i) * a0 + i * a1) / 7u);
+				}
+			}
+			else {
+				for (uint32_t i = 1u; i < 5u; i++) {
+					values[i + 1u] = static_cast<uint8_t>(((5u - i) * a0 + i * a1) / 5u);
+				}
+				values[6] = 0u;
+				values[7] = 255u;
+			}
+
+			uint64_t indices = 0;
+			for (uint32_t i = 0; i < 6u; i++) {
+				indices |= static_cast<uint64_t>(block[2u + i]) << (8u * i);
+			}
+
+			for (uint32_t i = 0; i < 16u; i++, indices >>= 3u) {
+				texels[i * 4u] = values[indices & 7u];
+			}
+		}
+
+		/* Reads BC7 fields least significant bit first */
+		class Bc7BitReader {
+		public:
+			Bc7BitReader(const uint8_t *block) {
+				std::memcpy(&m_low, block, 8u);
+				std::memcpy(&m_high, block + 8u, 8u);
+			}
+
+			uint32_t Read(const uint32_t bitCount) {
+				if (!bitCount) {
+					return 0u;
+				}
+				uint64_t value = m_position < 64u ? m_low >> m_position : 0u;
+				if (m_position > 0u && m_position < 64u) {
+					value |= m_high << (64u - m_position);
+				}
+				else if (m_position >= 64u) {
+					value = m_high >> (m_position - 64u);
+				}
+				m_position += bitCount;
+				return static_cast<uint32_t>(value & ((1ull << bitCount) - 1u));
+			}
+
+		private:
+			uint64_t m_low = 0;
+			uint64_t m_high = 0;
+			uint32_t m_position = 0;
+		};
+
+		static void DecodeBC7(const uint8_t *block, uint8_t *texels) {
+
+			uint32_t modeIndex = 0;
+			while (modeIndex < 8u && !(block[0] & (1u << modeIndex))) {
+				modeIndex++;
+			}
+
+			// Reserved mode - decoded as transparent black
+			if (modeIndex == 8u) {
+				std::memset(texels, 0, 64u);
+				return;
+			}
+
+			const Bc7Mode &mode = s_bc7Modes[modeIndex];
+			Bc7BitReader reader(block);
+			reader.Read(modeIndex + 1u);
+
+			const uint32_t partition = reader.Read(mode.partitionBits);
+			const uint32_t rotation = reader.Read(mode.rotationBits);
+			const uint32_t indexSelection = reader.Read(mode.indexSelectionBits);
+
+			const uint32_t endpointCount = mode.subsets * 2u;
+			uint32_t endpoints[6][4] = {};
+
+			for (uint32_t channel = 0; channel < 3u; channel++) {
+				for (uint32_t i = 0; i < endpointCount; i++) {
+					endpoints[i][channel] = reader.Read(mode.colorBits);
+				}
+			}
+
+			for (uint32_t i = 0; i < endpointCount; i++) {
+				endpoints[i][3] = mode.alphaBits ? reader.Read(mode.alphaBits) : 255u;
+			}
+
+			uint32_t colorBits = mode.colorBits;
+			uint32_t alphaBits = mode.alphaBits;
+
+			if (mode.endpointPBits || mode.sharedPBits) {
+
+				uint32_t pBits[6] = {};
+
+				if (mode.endpointPBits) {
+					for (uint32_t i = 0; i < endpointCount; i++) {
+						pBits[i] = reader.Read(1u);
+					}
+				}
+				else {
+					for (uint32_t i = 0; i < mode.subsets; i++) {
+						pBits[i * 2u] = pBits[i * 2u + 1u] = reader.Read(1u);
+					}
+				}
+
+				for (uint32_t i = 0; i < endpointCount; i++) {
+					for (uint32_t channel = 0; channel < 4u; channel++) {
+						if (channel < 3u || alphaBits) {
+							endpoints[i][channel] = (endpoints[i][channel] << 1u) | pBits[i];
+						}
+					}
+				}
+
+				colorBits++;
+				alphaBits += alphaBits ? 1u : 0u;
+			}
+
+			// Expanded to 8 bits by replicating the high bits
+			for (uint32_t i = 0; i < endpointCount; i++) {
+				for (uint32_t channel = 0; channel < 4u; channel++) {
+					const uint32_t bits = channel < 3u ? colorBits : alphaBits;
+					if (bits) {
+						endpoints[i][channel] = ((endpoints[i][channel] << (8u - bits)) | (endpoints[i][channel] >> (2u * bits - 8u))) & 255u;
+					}
+				}
+			}
+
+			uint8_t subsets[16] = {};
+			uint32_t anchors[3] = { 0u, 0u, 0u };
+
+			if (mode.subsets == 2u) {
+				for (uint32_t i = 0; i < 16u; i++) {
+					subsets[i] = (s_bc7Partitions2[partition] >> i) & 1u;
+				}
+				anchors[1] = s_bc7Anchors2[partition];
+			}
+			else if (mode.subsets == 3u) {
+				std::memcpy(subsets, s_bc7Partitions3[partition], 16u);
+				anchors[1] = s_bc7Anchors3a[partition];
+				anchors[2] = s_bc7Anchors3b[partition];
+			}
+
+			uint32_t indices[16];
+			uint32_t secondaryIndices[16] = {};
+
+			for (uint32_t i = 0; i < 16u; i++) {
+				const bool anchor = i == anchors[subsets[i]];
+				indices[i] = reader.Read(mode.indexBits - (anchor ? 1u : 0u));
+			}
+
+			for (uint32_t i = 0; mode.secondaryIndexBits && i < 16u; i++) {
+				secondaryIndices[i] = reader.Read(mode.secondaryIndexBits - (i == 0u ? 1u : 0u));
+			}
+
+			auto getWeight = [](const uint32_t bits, const uint32_t index) -> uint32_t {
+				return bits == 2u ? s_bc7Weights2[index] : bits == 3u ? s_bc7Weights3[index] : s_bc7Weights4[index];
+			};
+
+			for (uint32_t i = 0; i < 16u; i++) {
+
+				const uint32_t *e0 = endpoints[subsets[i] * 2u];
+				const uint32_t *e1 = endpoints[subsets[i] * 2u + 1u];
+
+				uint32_t colorWeight = getWeight(mode.indexBits, indices[i]);
+				uint32_t alphaWeight = colorWeight;
+
+				if (mode.secondaryIndexBits) {
+					const uint32_t secondaryWeight = getWeight(mode.secondaryIndexBits, secondaryIndices[i]);
+					// Index selection swaps which index set drives color and alpha
+					if (indexSelection) {
+						alphaWeight = colorWeight;
+						colorWeight = secondaryWeight;
+					}
+					else {
+						alphaWeight = secondaryWeight;
+					}
+				}
+
+				uint8_t *texel = texels + i * 4u;
+
+				for (uint32_t channel = 0; channel < 4u; channel++) {
+					const uint32_t weight = channel < 3u ? colorWeight : alphaWeight;
+					texel[channel] = static_cast<uint8_t>(((64u - weight) * e0[channel] + weight * e1[channel] + 32u) >> 6u);
+				}
+
+				if (rotation) {
+					std::swap(texel[3], texel[rotation - 1u]);
+				}
+			}
+		}
+
+		/* Texel order of ETC blocks is column major */
+		static inline uint32_t GetEtcTexel(const uint32_t index) {
+			return (index & 3u) * 4u + (index >> 2u);
+		}
+
+		static void DecodeETC2Color(const uint8_t *block, uint8_t *texels) {
+
+			const uint64_t bits = ReadBE64(block);
+			auto field = [bits](const uint32_t high, const uint32_t count) -> int32_t {
+				return static_cast<int32_t>((bits >> (high + 1u - count)) & ((1ull << count) - 1u));
+			};
+			auto expand4 = [](const int32_t value) { return (value << 4) | value; };
+			auto expand5 = [](const int32_t value) { return (value << 3) | (value >> 2); };
+
+			const uint32_t msbs = static_cast<uint32_t>(bits >> 16u) & 0xFFFFu;
+			const uint32_t lsbs = static_cast<uint32_t>(bits) & 0xFFFFu;
+			const bool differential = field(33u, 1u);
+			const bool flip = field(32u, 1u);
+
+			int32_t base[2][3];
+
+			if (differential) {
+
+				const int32_t r = field(63u, 5u);
+				const int32_t g = field(55u, 5u);
+				const int32_t b = field(47u, 5u);
+				// 3 bit two's complement deltas
+				const int32_t dr = (field(58u, 3u) ^ 4) - 4;
+				const int32_t dg = (field(50u, 3u) ^ 4) - 4;
+				const int32_t db = (field(42u, 3u) ^ 4) - 4;
+
+				// Overflowing deltas select the ETC2 modes - T, H and planar
+				if (r + dr < 0 || r + dr > 31) {
+
+					const int32_t colors[2][3] = {
+						{ expand4((field(60u, 2u) << 2) | field(57u, 2u)), expand4(field(55u, 4u)), expand4(field(51u, 4u)) },
+						{ expand4(field(47u, 4u)), expand4(field(43u, 4u)), expand4(field(39u, 4u)) } };
+					const int32_t distance = s_etcDistances[(field(35u, 2u) << 1) | field(32u, 1u)];
+
+					uint8_t paint[4][3];
+					for (uint32_t channel = 0; channel < 3u; channel++) {
+						paint[0][channel] = static_cast<uint8_t>(colors[0][channel]);
+						paint[1][channel] = Clamp255(colors[1][channel] + distance);
+						paint[2][channel] = static_cast<uint8_t>(colors[1][channel]);
+						paint[3][channel] = Clamp255(colors[1][channel] - distance);
+					}
+
+					for (uint32_t i = 0; i < 16u; i++) {
+						const uint32_t index = (((msbs >> i) & 1u) << 1u) | ((lsbs >> i) & 1u);
+						std::memcpy(texels + GetEtcTexel(i) * 4u, paint[index], 3u);
+					}
+					return;
+				}
+
+				if (g + dg < 0 || g + dg > 31) {
+
+					const int32_t colors4[2][3] = {
+						{ field(62u, 4u), (field(58u, 3u) << 1) | field(52u, 1u), (field(51u, 1u) << 3) | field(49u, 3u) },
+						{ field(46u, 4u), field(42u, 4u), field(38u, 4u) } };
+					const int32_t value0 = (colors4[0][0] << 8) | (colors4[0][1] << 4) | colors4[0][2];
+					const int32_t value1 = (colors4[1][0] << 8) | (colors4[1][1] << 4) | colors4[1][2];
+					const int32_t distance = s_etcDistances[(field(34u, 1u) << 2) | (field(32u, 1u) << 1) | (value0 >= value1 ? 1 : 0)];
+
+					uint8_t paint[4][3];
+					for (uint32_t channel = 0; channel < 3u; channel++) {
+						paint[0][channel] = Clamp255(expand4(colors4[0][channel]) + distance);
+						paint[1][channel] = Clamp255(expand4(colors4[0][channel]) - distance);
+						paint[2][channel] = Clamp255(expand4(colors4[1][channel]) + distance);
+						paint[3][channel] = Clamp255(expand4(colors4[1][channel]) - distance);
+					}
+
+					for (uint32_t i = 0; i < 16u; i++) {
+						const uint32_t index = (((msbs >> i) & 1u) << 1u) | ((lsbs >> i) & 1u);
+						std::memcpy(texels + GetEtcTexel(i) * 4u, paint[index], 3u);
+					}
+					return;
+				}
+
+				if (b + db < 0 || b + db > 31) {
+
+					auto expand6 = [](const int32_t value) { return (value << 2) | (value >> 4); };
+					auto expand7 = [](const int32_t value) { return (value << 1) | (value >> 6); };
+
+					const int32_t origin[3] = {
+						expand6(field(62u, 6u)),
+						expand7((field(56u, 1u) << 6) | field(54u, 6u)),
+						expand6((field(48u, 1u) << 5) | (field(44u, 2u) << 3) | field(41u, 3u)) };
+					const int32_t horizontal[3] = {
+						expand6((field(38u, 5u) << 1) | field(32u, 1u)),
+						expand7(field(31u, 7u)),
+						expand6(field(24u, 6u)) };
+					const int32_t vertical[3] = {
+						expand6(field(18u, 6u)),
+						expand7(field(12u, 7u)),
+						expand6(field(5u, 6u)) };
+
+					for (int32_t y = 0; y < 4; y++) {
+						for (int32_t x = 0; x < 4; x++) {
+							uint8_t *texel = texels + (y * 4 + x) * 4;
+							for (uint32_t channel = 0; channel < 3u; channel++) {
+								texel[channel] = Clamp255((x * (horizontal[channel] - origin[channel]) + y * (vertical[channel] - origin[channel]) + 4 * origin[channel] + 2) >> 2);
+							}
+						}
+					}
+					return;
+				}
+
+				base[0][0] = expand5(r);
+				base[0][1] = expand5(g);
+				base[0][2] = expand5(b);
+				base[1][0] = expand5(r + dr);
+				base[1][1] = expand5(g + dg);
+				base[1][2] = expand5(b + db);
+			}
+			else {
+				base[0][0] = expand4(field(63u, 4u));
+				base[1][0] = expand4(field(59u, 4u));
+				base[0][1] = expand4(field(55u, 4u));
+				base[1][1] = expand4(field(51u, 4u));
+				base[0][2] = expand4(field(47u, 4u));
+				base[1][2] = expand4(field(43u, 4u));
+			}
+
+			const uint32_t tables[2] = { static_cast<uint32_t>(field(39u, 3u)), static_cast<uint32_t>(field(36u, 3u)) };
+
+			for (uint32_t i = 0; i < 16u; i++) {
+
+				const uint32_t x = i >> 2u;
+				const uint32_t y = i & 3u;
+				const uint32_t subBlock = flip ? (y >= 2u) : (x >= 2u);
+				const int32_t modifier = s_etcModifiers[tables[subBlock]][(((msbs >> i) & 1u) << 1u) | ((lsbs >> i) & 1u)];
+
+				uint8_t *texel = texels + (y * 4u + x) * 4u;
+				for (uint32_t channel = 0; channel < 3u; channel++) {
+					texel[channel] = Clamp255(base[subBlock][channel] + modifier);
+				}
+			}
+		}
+
+		/* EAC block - 8 bit alpha of ETC2 RGBA8 */
+		static void DecodeEACAlpha(const uint8_t *block, uint8_t *texels) {
+
+			const uint64_t bits = ReadBE64(block);
+			const int32_t base = block[0];
+			const int32_t multiplier = block[1] >> 4u;
+			const int32_t *modifiers = s_eacModifiers[block[1] & 15u];
+
+			for (uint32_t i = 0; i < 16u; i++) {
+				const uint32_t index = static_cast<uint32_t>(bits >> (45u - 3u * i)) & 7u;
+				texels[GetEtcTexel(i) * 4u + 3u] = Clamp255(base + modifiers[index] * multiplier);
+			}
+		}
+
+		static void DecodeBlock(const TextureFormat format, const uint8_t *block, uint8_t *texels) {
+			switch (format)
+			{
+			case TextureFormat::TextureBC1:
+			case TextureFormat::TextureBC1_SRGB:
+				DecodeBC1Color(block, texels, false);
+				break;
+			case TextureFormat::TextureBC3:
+			case TextureFormat::TextureBC3_SRGB:
+				DecodeBC1Color(block + 8u, texels, true);
+				DecodeBC4Channel(block, texels + 3u);
+				break;
+			case TextureFormat::TextureBC5:
+				for (uint32_t i = 0; i < 16u; i++) {
+					texels[i * 4u + 2u] = 0u;
+					texels[i * 4u + 3u] = 255u;
+				}
+				DecodeBC4Channel(block, texels);
+				DecodeBC4Channel(block + 8u, texels + 1u);
+				break;
+			case TextureFormat::TextureBC7:
+			case TextureFormat::TextureBC7_SRGB:
+				DecodeBC7(block, texels);
+				break;
+			case TextureFormat::TextureETC2_RGBA8:
+			case TextureFormat::TextureETC2_RGBA8_SRGB:
+				DecodeETC2Color(block + 8u, texels);
+				DecodeEACAlpha(block, texels);
+				break;
+			default:
+				break;
+			}
+		}
+
+		/* Decodes block rows [<firstRow>, <endRow>) of one layer */
+		static void DecodeBlockRows(
+			const TextureFormat format,
+			const uint32_t width,
+			const uint32_t height,
+			const uint32_t firstRow,
+			const uint32_t endRow,
+			const uint8_t *data,
+			uint8_t *outputP) {
+
+			const uint32_t blockBytes = GetFormatBlockBytes(format);
+			const uint32_t blocksX = (width + 3u) / 4u;
+
+			uint8_t texels[64];
+
+			for (uint32_t blockY = firstRow; blockY < endRow; blockY++) {
+				for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+
+					DecodeBlock(format, data + (static_cast<uint64_t>(blockY) * blocksX + blockX) * blockBytes, texels);
+
+					// Blocks at the right and bottom edges of levels not a multiple of 4 are clipped
+					const uint32_t columns = std::min(4u, width - blockX * 4u);
+					const uint32_t rows = std::min(4u, height - blockY * 4u);
+
+					for (uint32_t y = 0; y < rows; y++) {
+						std::memcpy(outputP + ((static_cast<uint64_t>(blockY) * 4u + y) * width + blockX * 4u) * 4u, texels + y * 16u, columns * 4u);
+					}
+				}
+			}
+		}
+
+		bool TextureTranscoder::CanTranscode(const TextureFormat format) {
+			return IsCompressedFormat(format) && format != TextureFormat::TextureASTC_4x4 && format != TextureFormat::TextureASTC_4x4_SRGB;
+		}
+
+		TextureFormat TextureTranscoder::GetTranscodedFormat(const TextureFormat format) {
+			switch (format)
+			{
+			case TextureFormat::TextureBC1_SRGB:
+			case TextureFormat::TextureBC3_SRGB:
+			case TextureFormat::TextureBC7_SRGB:
+			case TextureFormat::TextureETC2_RGBA8_SRGB:
+			case TextureFormat::TextureASTC_4x4_SRGB:
+				return TextureFormat::TextureRGBA8_SRGB;
+			default:
+				break;
+			}
+			return IsCompressedFormat(format) ? TextureFormat::TextureRGBA8 : format;
+		}
+
+		bool TextureTranscoder::Transcode(
+			const TextureFormat format,
+			const uint32_t width,
+			const uint32_t height,
+			const uint32_t layers,
+			const uint8_t *data,
+			uint8_t *outputP,
+			const uint32_t threadCount) {
+
+			if (!CanTranscode(format)) {
+				return false;
+			}
+
+			const uint32_t blockRows = (height + 3u) / 4u;
+			const uint32_t blocksPerLayer = ((width + 3u) / 4u) * blockRows;
+			const uint64_t layerSize = GetTextureLevelSize(format, width, height);
+			const uint64_t outputLayerSize = static_cast<uint64_t>(width) * height * 4u;
+
+			// Rows of all layers are split evenly - a worker may cross from one layer into the next
+			const uint32_t totalRows = blockRows * layers;
+			uint32_t workerCount = threadCount ? threadCount : std::max(std::thread::hardware_concurrency(), 1u);
+			workerCount = std::min(workerCount, std::max(blocksPerLayer * layers / s_minBlocksPerThread, 1u));
+			workerCount = std::min(workerCount, totalRows);
+
+			auto decodeRows = [&](const uint32_t first, const uint32_t end) {
+				for (uint32_t row = first; row < end;) {
+					const uint32_t layer = row / blockRows;
+					const uint32_t layerEnd = std::min(end, (layer + 1u) * blockRows);
+					DecodeBlockRows(
+						format, width, height,
+						row - layer * blockRows, layerEnd - layer * blockRows,
+						data + layer * layerSize,
+						outputP + layer * outputLayerSize);
+					row = layerEnd;
+				}
+			};
+
+			std::vector<std::thread> workers;
+
+			for (uint32_t i = 1u; i < workerCount; i++) {
+				workers.emplace_back(decodeRows, totalRows * i / workerCount, totalRows * (i + 1u) / workerCount);
+			}
+
+			// The calling thread takes the first share
+			decodeRows(0u, totalRows / workerCount);
+
+			for (auto &worker : workers) {
+				worker.join();
+			}
+
+			return true;
+		}
+	}
+}
@@ -0,0 +1,36 @@
+#ifndef TEXTURE_TRANSCODER_H_
+#define TEXTURE_TRANSCODER_H_
+
+#include "Texture.h"
+
+#include <cstdint>
+
+namespace PixelMachine {
+	namespace GPU {
+		/// <summary>
+		/// CPU decoder of block compressed texture data, the fallback for devices lacking a compressed format.
+		/// Decodes BC1, BC3, BC5, BC7 and ETC2 RGBA8 to RGBA8 - rows of blocks are spread over worker threads,
+		/// each block is decoded with table lookups only. ASTC has no decoder.
+		/// </summary>
+		class TextureTranscoder {
+		public:
+			/* True when <format> can be decoded */
+			static bool CanTranscode(const TextureFormat format);
+			/* Uncompressed format the decoded data is uploaded as - keeps the sRGB encoding of <format> */
+			static TextureFormat GetTranscodedFormat(const TextureFormat format);
+			/* Decodes <layers> tightly packed <width> x <height> layers of <format> blocks from <data> into tightly packed
+			 RGBA8 texels at <outputP>. <threadCount> 0 uses the hardware threads for large levels - returns false when
+			 the format has no decoder */
+			static bool Transcode(
+				const TextureFormat format,
+				const uint32_t width,
+				const uint32_t height,
+				const uint32_t layers,
+				const uint8_t *data,
+				uint8_t *outputP,
+				const uint32_t threadCount = 0u);
+		};
+	}
+}
+
+#endif // !TEXTURE_TRANSCODER_H_
@@ -1,3 +1,4 @@
 SET scriptsPath=%~dp0
 %VULKAN_SDK%\Bin\glslc.exe -fshader-stage=vertex %scriptsPath%\..\src\VertexShader.glsl -o %scriptsPath%\..\compiled\VertexShader.spv
-%VULKAN_SDK%\Bin\glslc.exe -fshader-stage=fragment %scriptsPath%\..\src\FragmentShader.glsl -o %scriptsPath%\..\compiled\FragmentShader.spv
\ No newline at end of file
+%VULKAN_SDK%\Bin\glslc.exe -fshader-stage=fragment %scriptsPath%\..\src\FragmentShader.glsl -o %scriptsPath%\..\compiled\FragmentShader.spv
+%VULKAN_SDK%\Bin\glslc.exe -fshader-stage=compute %scriptsPath%\..\src\CullShader.glsl -o %scriptsPath%\..\compiled\CullShader.spv
\ No newline at end of file
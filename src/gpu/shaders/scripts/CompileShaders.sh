@@ -0,0 +1,6 @@
+#!/bin/sh
+scriptsPath=$(dirname "$0")
+mkdir -p "$scriptsPath/../compiled"
+glslc -fshader-stage=vertex "$scriptsPath/../src/VertexShader.glsl" -o "$scriptsPath/../compiled/VertexShader.spv"
+glslc -fshader-stage=fragment "$scriptsPath/../src/FragmentShader.glsl" -o "$scriptsPath/../compiled/FragmentShader.spv"
+glslc -fshader-stage=compute "$scriptsPath/../src/CullShader.glsl" -o "$scriptsPath/../compiled/CullShader.spv"
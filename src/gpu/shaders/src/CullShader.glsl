@@ -0,0 +1,80 @@
+#version 450
+
+// Frustum culling for GPU-driven draws - one invocation per object. Visible objects append a
+// VkDrawIndexedIndirectCommand and bump the draw count read by DrawIndexedIndirectCount, which
+// the pass resets with ResetCounter. Bindings follow the bind order of the pass. Commands carry the
+// object index as first instance, which needs the drawIndirectFirstInstance device feature.
+
+layout(local_size_x = 64) in;
+
+struct ObjectData {
+    mat4 transform;
+    // Object space bounding sphere - xyz center, w radius
+    vec4 boundingSphere;
+    uint firstIndex;
+    uint indexCount;
+    int vertexOffset;
+    uint padding;
+};
+
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    // Object index - lets the vertex shader fetch the transform with gl_InstanceIndex
+    uint firstInstance;
+};
+
+layout(std140, set = 0, binding = 0) uniform CullParams {
+    // World space planes with normals pointing inside - xyz normal, w distance
+    vec4 frustumPlanes[6];
+    uint objectCount;
+    // Capacity of the command buffer - the maxDrawCount passed to DrawIndexedIndirectCount
+    uint maxDrawCount;
+} params;
+
+layout(std430, set = 0, binding = 1) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+layout(std430, set = 0, binding = 2) writeonly buffer DrawCommands {
+    DrawCommand commands[];
+};
+
+layout(std430, set = 0, binding = 3) buffer DrawCount {
+    uint drawCount;
+};
+
+void main() {
+    uint objectIndex = gl_GlobalInvocationID.x;
+
+    if (objectIndex >= params.objectCount) {
+        return;
+    }
+
+    ObjectData object = objects[objectIndex];
+
+    vec3 center = (object.transform * vec4(object.boundingSphere.xyz, 1.0)).xyz;
+    // The largest axis scale keeps the sphere conservative under non-uniform scaling
+    float scale = sqrt(max(max(
+        dot(object.transform[0].xyz, object.transform[0].xyz),
+        dot(object.transform[1].xyz, object.transform[1].xyz)),
+        dot(object.transform[2].xyz, object.transform[2].xyz)));
+    float radius = object.boundingSphere.w * scale;
+
+    for (int i = 0; i < 6; i++) {
+        if (dot(params.frustumPlanes[i].xyz, center) + params.frustumPlanes[i].w < -radius) {
+            return;
+        }
+    }
+
+    uint drawIndex = atomicAdd(drawCount, 1u);
+
+    // Objects past the capacity are dropped - the count may exceed it, the draw caps it at maxDrawCount
+    if (drawIndex >= params.maxDrawCount) {
+        return;
+    }
+
+    commands[drawIndex] = DrawCommand(object.indexCount, 1u, object.firstIndex, object.vertexOffset, objectIndex);
+}
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include <vulkan/VlkAdapter.h>
 
+#include <algorithm>
 #include <stdexcept>
 #include <vector>
 
@@ -55,6 +56,25 @@ VkPhysicalDeviceMemoryProperties PixelMachine::GPU::VlkAdapter::GetMemoryInfo()
 	return properties;
 }
 
+VkPhysicalDeviceProperties PixelMachine::GPU::VlkAdapter::GetProperties() const {
+
+	VkPhysicalDeviceProperties properties = {};
+	vkGetPhysicalDeviceProperties(m_vkPhysicalDevice, &properties);
+
+	return properties;
+}
+
+VkQueueFamilyProperties PixelMachine::GPU::VlkAdapter::GetQueueFamilyInfo(const uint32_t queueFamilyIndex) const {
+
+	uint32_t count = 0u;
+	vkGetPhysicalDeviceQueueFamilyProperties(m_vkPhysicalDevice, &count, nullptr);
+
+	std::vector<VkQueueFamilyProperties> families(count);
+	vkGetPhysicalDeviceQueueFamilyProperties(m_vkPhysicalDevice, &count, families.data());
+
+	return queueFamilyIndex < count ? families[queueFamilyIndex] : VkQueueFamilyProperties{};
+}
+
 VkPhysicalDevice PixelMachine::GPU::VlkAdapter::GetHandle() const {
 	return m_vkPhysicalDevice;
 }
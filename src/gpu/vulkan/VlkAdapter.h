@@ -16,6 +16,8 @@ namespace PixelMachine {
 			bool SurfaceFormatAvailable(const VkSurfaceKHR surface, const VkSurfaceFormatKHR surfaceFormat) const;
 			VkSurfaceCapabilitiesKHR GetSurfaceInfo(const VkSurfaceKHR surface) const;
 			VkPhysicalDeviceMemoryProperties GetMemoryInfo() const;
+			VkPhysicalDeviceProperties GetProperties() const;
+			VkQueueFamilyProperties GetQueueFamilyInfo(const uint32_t queueFamilyIndex) const;
 			VkPhysicalDevice GetHandle() const;
 
 		private:
@@ -0,0 +1,306 @@
+#include <vulkan/VlkAssetLoader.h>
+#include <vulkan/VlkRenderContext.h>
+#include <vulkan/VlkBuffer.h>
+#include <vulkan/VlkTexture.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		AssetLoader *AssetLoader::Create(const uint64_t inFlightLimit, const uint32_t queueDepth, const uint32_t threadCount) {
+			return new VlkAssetLoader(inFlightLimit, queueDepth, threadCount);
+		}
+
+		VlkAssetLoader::VlkAssetLoader(const uint64_t inFlightLimit, const uint32_t queueDepth, const uint32_t threadCount)
+			: m_inFlightLimit(inFlightLimit) {
+
+			m_uploadBatcherP = static_cast<VlkRenderContext *>(VlkRenderContext::Get())->GetUploadBatcher();
+			m_fileReaderP = new FileReader(queueDepth, threadCount);
+		}
+
+		VlkAssetLoader::~VlkAssetLoader() {
+
+			// Issued reads may still write their staging memory - it is returned once the reader has waited for them
+			delete m_fileReaderP;
+
+			for (auto &entry : m_loads) {
+				if (entry.second.m_staged && entry.second.m_readId) {
+					m_uploadBatcherP->Release(entry.second.m_staging);
+				}
+			}
+		}
+
+		uint64_t VlkAssetLoader::Enqueue(VlkAssetLoad &&load) {
+
+			const uint64_t id = m_nextId++;
+
+			m_waiting[load.m_priority].push_back(id);
+			m_loads[id] = std::move(load);
+
+			return id;
+		}
+
+		uint64_t VlkAssetLoader::LoadTextureLevel(
+			Texture *textureP,
+			const uint32_t mipLevel,
+			const std::string &path,
+			const uint64_t offset,
+			const LoadPriority priority,
+			LoadCallback callback) {
+
+			if (mipLevel >= textureP->GetMipLevels()) {
+				throw new std::runtime_error("VlkAssetLoader LoadTextureLevel failed - mip level out of range.");
+			}
+
+			const TextureDesc &desc = textureP->GetDesc();
+			const uint64_t layers = desc.type == TextureType::TextureCube ? desc.layers * 6u : desc.layers;
+
+			VlkAssetLoad load;
+			load.m_type = VlkAssetType::TextureAsset;
+			load.m_textureP = textureP;
+			load.m_mipLevel = mipLevel;
+			load.m_path = path;
+			load.m_offset = offset;
+			load.m_size = GetTextureLevelSize(desc.format, std::max(desc.width >> mipLevel, 1u), std::max(desc.height >> mipLevel, 1u)) * layers;
+			load.m_priority = priority;
+			load.m_callback = std::move(callback);
+			// Transcoded levels are decoded on the CPU
+			load.m_staged = !textureP->IsTranscoded();
+
+			return Enqueue(std::move(load));
+		}
+
+		uint64_t VlkAssetLoader::LoadBuffer(
+			Buffer *bufferP,
+			const std::string &path,
+			const uint64_t offset,
+			const LoadPriority priority,
+			LoadCallback callback) {
+
+			VlkAssetLoad load;
+			load.m_type = VlkAssetType::BufferAsset;
+			load.m_bufferP = bufferP;
+			load.m_path = path;
+			load.m_offset = offset;
+			load.m_size = bufferP->GetSize();
+			load.m_priority = priority;
+			load.m_callback = std::move(callback);
+			// Buffers the GPU reads in place are written by the CPU - read into heap memory, staging is slow to read back
+			load.m_staged = static_cast<VlkBuffer *>(bufferP)->IsStaged();
+
+			return Enqueue(std::move(load));
+		}
+
+		uint64_t VlkAssetLoader::LoadShaderProgram(
+			const std::string &name,
+			const std::string &path,
+			const ShaderProgramType type,
+			const LoadPriority priority,
+			ShaderLoadCallback callback) {
+
+			VlkAssetLoad load;
+			load.m_type = VlkAssetType::ShaderAsset;
+			load.m_name = name;
+			load.m_shaderType = type;
+			load.m_path = path;
+			load.m_priority = priority;
+			load.m_shaderCallback = std::move(callback);
+
+			// A missing file fails the load once it is read - only the size is needed up front
+			std::error_code error;
+			const uintmax_t fileSize = std::filesystem::file_size(path, error);
+			load.m_size = error ? 0u : static_cast<uint64_t>(fileSize);
+
+			return Enqueue(std::move(load));
+		}
+
+		bool VlkAssetLoader::Cancel(const uint64_t id) {
+
+			auto found = m_loads.find(id);
+
+			if (found == m_loads.end() || found->second.m_cancelled) {
+				return false;
+			}
+
+			VlkAssetLoad &load = found->second;
+			load.m_cancelled = true;
+
+			// Issued reads are reported by the reader, as cancelled or completed - either way the target is left alone
+			if (load.m_readId) {
+				m_fileReaderP->Cancel(load.m_readId);
+				return true;
+			}
+
+			std::deque<uint64_t> &waiting = m_waiting[load.m_priority];
+			waiting.erase(std::find(waiting.begin(), waiting.end(), id));
+			m_cancelledLoads.push_back(id);
+
+			return true;
+		}
+
+		void VlkAssetLoader::IssueWaiting() {
+
+			for (auto &waiting : m_waiting) {
+
+				while (waiting.size()) {
+
+					VlkAssetLoad &load = m_loads[waiting.front()];
+
+					// Lower priorities do not overtake a load waiting for room - one read is always let through
+					if (m_inFlightBytes && m_inFlightBytes + load.m_size > m_inFlightLimit) {
+						return;
+					}
+
+					void *destinationP = nullptr;
+
+					if (load.m_staged) {
+						load.m_staging = m_uploadBatcherP->AllocateHeld(load.m_size);
+						destinationP = load.m_staging.dataP;
+					}
+					else {
+						load.m_data.resize(load.m_size);
+						destinationP = load.m_data.data();
+					}
+
+					load.m_readId = m_fileReaderP->Read(load.m_path, load.m_offset, load.m_size, destinationP, load.m_priority);
+					m_readLoads[load.m_readId] = waiting.front();
+					m_inFlightBytes += load.m_size;
+
+					waiting.pop_front();
+				}
+			}
+		}
+
+		LoadStatus VlkAssetLoader::Upload(VlkAssetLoad &load, ShaderProgram *&outProgramP) {
+
+			try {
+				switch (load.m_type)
+				{
+				case VlkAssetType::TextureAsset:
+					// Evicted while it was read - the level has nowhere to go
+					if (load.m_mipLevel < load.m_textureP->GetResidentMip()) {
+						return LoadStatus::LoadFailed;
+					}
+					if (load.m_staged) {
+						static_cast<VlkTexture *>(load.m_textureP)->SetMipData(load.m_mipLevel, load.m_staging);
+					}
+					else {
+						load.m_textureP->SetMipData(load.m_mipLevel, load.m_data.data());
+					}
+					break;
+				case VlkAssetType::BufferAsset:
+					if (load.m_staged) {
+						static_cast<VlkStagingBuffer *>(load.m_bufferP)->SetStagedData(load.m_staging);
+					}
+					else {
+						// Written in place once the frames reading the buffer have completed
+						load.m_bufferP->SetData(load.m_data.data());
+					}
+					break;
+				case VlkAssetType::ShaderAsset:
+					if (load.m_data.empty()) {
+						return LoadStatus::LoadFailed;
+					}
+					outProgramP = ShaderProgram::CreateFromCode(load.m_name, load.m_data.data(), load.m_data.size(), load.m_shaderType);
+					break;
+				}
+			}
+			catch (std::runtime_error *errorP) {
+				delete errorP;
+				return LoadStatus::LoadFailed;
+			}
+
+			return LoadStatus::LoadComplete;
+		}
+
+		void VlkAssetLoader::Finish(VlkAssetLoad &load, LoadStatus status) {
+
+			ShaderProgram *programP = nullptr;
+
+			if (load.m_cancelled) {
+				status = LoadStatus::LoadCancelled;
+			}
+			else if (status == LoadStatus::LoadComplete) {
+				status = Upload(load, programP);
+			}
+
+			// Copies from the staging memory were recorded into the current batch - it is recycled after that one
+			if (load.m_readId) {
+				if (load.m_staged) {
+					m_uploadBatcherP->Release(load.m_staging);
+				}
+				m_inFlightBytes -= load.m_size;
+			}
+
+			switch (status)
+			{
+			case LoadStatus::LoadComplete:
+				m_stats.completedLoads++;
+				m_stats.loadedBytes += load.m_size;
+				break;
+			case LoadStatus::LoadCancelled:
+				m_stats.cancelledLoads++;
+				break;
+			default:
+				m_stats.failedLoads++;
+				break;
+			}
+
+			if (load.m_callback) {
+				load.m_callback(status);
+			}
+			if (load.m_shaderCallback) {
+				load.m_shaderCallback(programP, status);
+			}
+			else {
+				delete programP;
+			}
+		}
+
+		void VlkAssetLoader::Update() {
+
+			std::vector<FileReadResult> results;
+			m_fileReaderP->Poll(m_readResults);
+			results.swap(m_readResults);
+
+			std::vector<std::pair<VlkAssetLoad, LoadStatus>> finished;
+
+			for (auto id : m_cancelledLoads) {
+				finished.emplace_back(std::move(m_loads[id]), LoadStatus::LoadCancelled);
+				m_loads.erase(id);
+			}
+
+			m_cancelledLoads.clear();
+
+			for (auto &result : results) {
+				const uint64_t id = m_readLoads[result.id];
+				m_readLoads.erase(result.id);
+				finished.emplace_back(std::move(m_loads[id]), result.status);
+				m_loads.erase(id);
+			}
+
+			// Taken out of the map first - callbacks may queue or cancel loads
+			for (auto &load : finished) {
+				Finish(load.first, load.second);
+			}
+
+			// Room freed by the finished loads is used right away - submitted now, reported by the next Update
+			IssueWaiting();
+			m_fileReaderP->Poll(m_readResults);
+		}
+
+		AssetLoaderStats VlkAssetLoader::GetStats() const {
+
+			AssetLoaderStats stats = m_stats;
+			stats.pendingLoads = m_loads.size();
+			stats.inFlightBytes = m_inFlightBytes;
+			stats.inFlightLimit = m_inFlightLimit;
+			stats.usingIoUring = m_fileReaderP->IsUsingIoUring();
+
+			return stats;
+		}
+	}
+}
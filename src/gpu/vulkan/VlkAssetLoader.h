@@ -0,0 +1,109 @@
+#ifndef VLK_ASSET_LOADER_H_
+#define VLK_ASSET_LOADER_H_
+
+#include <AssetLoader.h>
+#include <FileReader.h>
+#include <vulkan/VlkUploadBatcher.h>
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace PixelMachine {
+	namespace GPU {
+		/// <summary>
+		/// Asset loader reading through a FileReader into held allocations of the upload batcher. Loads wait in
+		/// priority queues until the in-flight limit leaves room for their staging memory, completed reads record
+		/// their copies into the current upload batch and return the staging memory with it. Shader code,
+		/// compressed textures the device cannot sample and buffers the GPU reads in place are read into heap
+		/// memory instead - they are consumed on the CPU, and staging memory is slow to read back.
+		/// </summary>
+		class VlkAssetLoader : public AssetLoader {
+		public:
+			VlkAssetLoader(const uint64_t inFlightLimit, const uint32_t queueDepth, const uint32_t threadCount);
+			VlkAssetLoader(const VlkAssetLoader &) = delete;
+			VlkAssetLoader &operator=(const VlkAssetLoader &) = delete;
+			~VlkAssetLoader();
+
+			uint64_t LoadTextureLevel(
+				Texture *textureP,
+				const uint32_t mipLevel,
+				const std::string &path,
+				const uint64_t offset,
+				const LoadPriority priority = LoadPriority::DefaultPriority,
+				LoadCallback callback = nullptr) override;
+			uint64_t LoadBuffer(
+				Buffer *bufferP,
+				const std::string &path,
+				const uint64_t offset,
+				const LoadPriority priority = LoadPriority::DefaultPriority,
+				LoadCallback callback = nullptr) override;
+			uint64_t LoadShaderProgram(
+				const std::string &name,
+				const std::string &path,
+				const ShaderProgramType type,
+				const LoadPriority priority,
+				ShaderLoadCallback callback) override;
+			bool Cancel(const uint64_t id) override;
+			void Update() override;
+			AssetLoaderStats GetStats() const override;
+
+		private:
+			enum VlkAssetType {
+				TextureAsset,
+				BufferAsset,
+				ShaderAsset
+			};
+
+			struct VlkAssetLoad {
+				VlkAssetType m_type = VlkAssetType::TextureAsset;
+				Texture *m_textureP = nullptr;
+				uint32_t m_mipLevel = 0u;
+				Buffer *m_bufferP = nullptr;
+				std::string m_name;
+				ShaderProgramType m_shaderType = ShaderProgramType::VertexShader;
+				std::string m_path;
+				uint64_t m_offset = 0u;
+				uint64_t m_size = 0u;
+				LoadPriority m_priority = LoadPriority::DefaultPriority;
+				LoadCallback m_callback;
+				ShaderLoadCallback m_shaderCallback;
+				// Read into staging memory, or into <m_data> when consumed on the CPU
+				bool m_staged = false;
+				VlkStagingAllocation m_staging;
+				std::vector<uint8_t> m_data;
+				// FileReader id, 0 while waiting for room in flight
+				uint64_t m_readId = 0u;
+				bool m_cancelled = false;
+			};
+
+			/* Queues <load> - returns its id */
+			uint64_t Enqueue(VlkAssetLoad &&load);
+			/* Issues waiting loads, highest priority first, as far as the in-flight limit allows */
+			void IssueWaiting();
+			/* Uploads a completed read to its target - returns the status reported to the callback */
+			LoadStatus Upload(VlkAssetLoad &load, ShaderProgram *&outProgramP);
+			/* Returns the memory of <load>, updates the stats and calls its callback */
+			void Finish(VlkAssetLoad &load, LoadStatus status);
+
+			FileReader *m_fileReaderP = nullptr;
+			VlkUploadBatcher *m_uploadBatcherP = nullptr;
+			uint64_t m_nextId = 1u;
+			std::unordered_map<uint64_t, VlkAssetLoad> m_loads;
+			std::deque<uint64_t> m_waiting[LoadPriority::LoadPriorityCount];
+			// Load ids of the issued reads, by FileReader id
+			std::unordered_map<uint64_t, uint64_t> m_readLoads;
+			// Loads cancelled before their read was issued - reported by the next Update
+			std::vector<uint64_t> m_cancelledLoads;
+			// Reads reported while submitting the ones issued late in Update
+			std::vector<FileReadResult> m_readResults;
+			uint64_t m_inFlightLimit = 0u;
+			uint64_t m_inFlightBytes = 0u;
+			AssetLoaderStats m_stats;
+		};
+	}
+}
+
+#endif // !VLK_ASSET_LOADER_H_
@@ -1,18 +1,21 @@
 #include "VlkBuffer.h"
 #include "VlkDevice.h"
 #include "VlkRenderContext.h"
+#include "VlkProfiler.h"
 
+#include <cstring>
 #include <stdexcept>
 
 namespace PixelMachine {
 	namespace GPU {
 
-		/* Create a VkBuffer with VkDeviceMemory allocation - Returns handle to a new buffer (VK_NULL_HANDLE if failed) */
-		static VkBuffer CreateVkBuffer(
+		VkBuffer CreateVkBuffer(
 			const uint32_t size,
 			const uint32_t usageFlagBits,
-			const uint32_t memoryPropertyFlagBits,
-			VkDeviceMemory &outDeviceMemory) {
+			const VlkMemoryFlags &memoryFlags,
+			const MemoryCategory category,
+			VkDeviceMemory &outDeviceMemory,
+			VkMemoryPropertyFlags *outMemoryPropertiesP) {
 
 			VkBuffer buffer = VK_NULL_HANDLE;
 			VkBufferCreateInfo bufferInfo = {};
@@ -23,83 +26,115 @@ namespace PixelMachine {
 
 			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
 
-			vkCreateBuffer(deviceP->GetHandle(), &bufferInfo, nullptr, &buffer);
+			vkCreateBuffer(deviceP->GetHandle(), &bufferInfo, deviceP->GetAllocationCallbacks(VlkHostAllocator::BUFFER), &buffer);
 
 			VkMemoryRequirements memoryRequirements = {};
 			vkGetBufferMemoryRequirements(deviceP->GetHandle(), buffer, &memoryRequirements);
 
-			VkPhysicalDeviceMemoryProperties bufferMemoryProps = {};
-			vkGetPhysicalDeviceMemoryProperties(deviceP->GetActiveAdapter().GetHandle(), &bufferMemoryProps);
-
-			int memoryTypeIndex = -1;
-			for (int i = 0; i < bufferMemoryProps.memoryTypeCount; i++) {
-				if ((memoryRequirements.memoryTypeBits & (1 << i)) &&
-					(bufferMemoryProps.memoryTypes[i].propertyFlags & memoryPropertyFlagBits)) {
-					memoryTypeIndex = i;
-					break;
-				}
-			}
-
-			if (memoryTypeIndex == -1) {
-				vkDestroyBuffer(deviceP->GetHandle(), buffer, nullptr);
-				return buffer;
-			}
-
-			VkMemoryAllocateInfo memoryAllocateInfo = {};
-			memoryAllocateInfo.allocationSize = memoryRequirements.size;
-			memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
-			memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-
-			VkDeviceMemory bufferMemory = VK_NULL_HANDLE;
-			vkAllocateMemory(deviceP->GetHandle(), &memoryAllocateInfo, nullptr, &bufferMemory);
+			VkDeviceMemory bufferMemory = deviceP->AllocateMemory(memoryRequirements, memoryFlags, category, outMemoryPropertiesP);
 
 			if (!bufferMemory) {
-				vkDestroyBuffer(deviceP->GetHandle(), buffer, nullptr);
-				return buffer;
+				vkDestroyBuffer(deviceP->GetHandle(), buffer, deviceP->GetAllocationCallbacks(VlkHostAllocator::BUFFER));
+				return VK_NULL_HANDLE;
 			}
 
 			vkBindBufferMemory(deviceP->GetHandle(), buffer, bufferMemory, 0);
+			static_cast<VlkRenderContext *>(VlkRenderContext::Get())->RecordAllocation(memoryRequirements.size);
 
 			outDeviceMemory = bufferMemory;
 
 			return buffer;
 		}
 
-		static void ReleaseVkBuffer(VkBuffer &buffer, VkDeviceMemory &deviceMemory) {
+		void ReleaseVkBuffer(VkBuffer &buffer, VkDeviceMemory &deviceMemory) {
 
-			VkDevice device = PixelMachine::GPU::VlkRenderContext::GetVlkDevice()->GetHandle();
-
-			vkDeviceWaitIdle(device);
-
-			if (deviceMemory != VK_NULL_HANDLE) {
-				vkFreeMemory(device, deviceMemory, nullptr);
-				deviceMemory == VK_NULL_HANDLE;
-			}
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
 
-			if (buffer != VK_NULL_HANDLE) {
-				vkDestroyBuffer(device, buffer, nullptr);
-				buffer == VK_NULL_HANDLE;
-			}
+			// Frames in flight may still read the buffer
+			deviceP->DeferRelease([deviceP, buffer, deviceMemory]() {
+				if (deviceMemory != VK_NULL_HANDLE) {
+					deviceP->FreeMemory(deviceMemory);
+				}
+				if (buffer != VK_NULL_HANDLE) {
+					vkDestroyBuffer(deviceP->GetHandle(), buffer, deviceP->GetAllocationCallbacks(VlkHostAllocator::BUFFER));
+				}
+			});
 
+			buffer = VK_NULL_HANDLE;
+			deviceMemory = VK_NULL_HANDLE;
 		}
 
-		static VkBufferUsageFlagBits GetVkBufferUsage(BufferType bufferType) {
+		static VkBufferUsageFlags GetVkBufferUsage(BufferType bufferType) {
 			switch (bufferType)
 			{
 			case PixelMachine::GPU::VertexBuffer:		return VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
 			case PixelMachine::GPU::IndexBuffer:		return VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
 			case PixelMachine::GPU::UniformBuffer:		return VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+			case PixelMachine::GPU::StorageBuffer:
+				return VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
 			default: break;
 			}
+			return 0;
+		}
+
+		static MemoryCategory GetMemoryCategory(BufferType bufferType) {
+			switch (bufferType)
+			{
+			case PixelMachine::GPU::IndexBuffer:		return MemoryCategory::IndexBufferMemory;
+			case PixelMachine::GPU::UniformBuffer:		return MemoryCategory::UniformBufferMemory;
+			case PixelMachine::GPU::StorageBuffer:		return MemoryCategory::StorageBufferMemory;
+			default: break;
+			}
+			return MemoryCategory::VertexBufferMemory;
+		}
+
+		// Mapped buffers written by the CPU, in VRAM when the device exposes it to the host (resizable BAR)
+		static const VlkMemoryFlags s_mappedMemoryFlags = {
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			0 };
+		// Staging sources stay out of device local memory, which is left to the buffers the GPU reads
+		static const VlkMemoryFlags s_stagingMemoryFlags = {
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			0,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT };
+		static const VlkMemoryFlags s_gpuMemoryFlags = {
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			0,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT };
+
+		// Host visible device local heaps up to this size are the fixed PCIe BAR window, larger ones mean resizable BAR
+		static constexpr uint64_t s_barWindowSize = 256ull << 20u;
+
+		/* Whether dynamic vertex or index data of <size> bytes can be written straight to VRAM.
+		 With resizable BAR all of VRAM is host visible and any buffer goes there. Without it the host visible device
+		 local heap is a small window shared with the driver - only buffers of a fraction of it are placed there */
+		static bool CanWriteDirectly(const uint64_t size) {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+
+			const VlkMemoryFlags directFlags = { s_mappedMemoryFlags.required | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, 0 };
+			const int32_t memoryTypeIndex = deviceP->FindMemoryType(~0u, directFlags);
+
+			if (memoryTypeIndex == -1) {
+				return false;
+			}
+
+			const VkPhysicalDeviceMemoryProperties &memoryProps = deviceP->GetMemoryProperties();
+			const VkDeviceSize heapSize = memoryProps.memoryHeaps[memoryProps.memoryTypes[memoryTypeIndex].heapIndex].size;
+
+			return heapSize > s_barWindowSize || size <= heapSize / 8u;
 		}
 
 		Buffer *Buffer::Create(
 			const BufferType type,
 			const ShaderProgramType bindStage,
 			const BufferLayout dataLayout,
-			const uint32_t elementCount) {
+			const uint32_t elementCount,
+			const BufferUsage usage) {
 
-			if (type == BufferType::UniformBuffer) {
+			if (type == BufferType::UniformBuffer ||
+				(usage == BufferUsage::DynamicUsage && CanWriteDirectly(static_cast<uint64_t>(dataLayout.GetSize()) * elementCount))) {
 				return new PixelMachine::GPU::VlkBuffer(type, bindStage, dataLayout, elementCount);
 			}
 
@@ -113,8 +148,10 @@ namespace PixelMachine {
 			m_vkHostBuffer = CreateVkBuffer(
 				m_size,
 				GetVkBufferUsage(m_type),
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				m_vkHostMemory);
+				s_mappedMemoryFlags,
+				GetMemoryCategory(m_type),
+				m_vkHostMemory,
+				&m_memoryProperties);
 
 			if (!m_vkHostBuffer) {
 				throw new std::runtime_error("VlkBuffer creation failed.");
@@ -129,12 +166,22 @@ namespace PixelMachine {
 
 		VlkBuffer::~VlkBuffer() {
 			const VkDevice device = VlkRenderContext::GetVlkDevice()->GetHandle();
+			static_cast<VlkRenderContext *>(VlkRenderContext::Get())->ReleaseBufferState(m_vkHostBuffer);
 			vkUnmapMemory(device, m_vkHostMemory);
 			ReleaseVkBuffer(m_vkHostBuffer, m_vkHostMemory);
 		}
 
 		void VlkBuffer::SetData(const void *data) {
-			memcpy(m_mappedDataP, data, m_size);
+			WriteData([this, data](void *dataP) { memcpy(dataP, data, m_size); });
+		}
+
+		void VlkBuffer::WriteData(const std::function<void(void *dataP)> &writer) {
+			VlkRenderContext *contextP = static_cast<VlkRenderContext *>(VlkRenderContext::Get());
+			VlkCpuScope cpuScope(contextP->GetProfiler(), "SetData");
+			// Written in place - frames in flight reading the previous contents must finish first
+			contextP->SyncHostWrite(m_vkHostBuffer);
+			writer(m_mappedDataP);
+			contextP->RecordUpload(m_size, 0u);
 		}
 
 		void VlkBuffer::Bind() const {
@@ -150,7 +197,8 @@ namespace PixelMachine {
 			m_vkHostBuffer = CreateVkBuffer(
 				m_size,
 				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				s_stagingMemoryFlags,
+				MemoryCategory::StagingMemory,
 				m_vkHostMemory);
 
 			if (!m_vkHostBuffer) {
@@ -164,8 +212,10 @@ namespace PixelMachine {
 			m_vkGpuBuffer = CreateVkBuffer(
 				m_size,
 				VK_BUFFER_USAGE_TRANSFER_DST_BIT | GetVkBufferUsage(m_type),
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				m_vkGpuMemory);
+				s_gpuMemoryFlags,
+				GetMemoryCategory(m_type),
+				m_vkGpuMemory,
+				&m_memoryProperties);
 
 			if (!m_vkGpuBuffer) {
 				throw new std::runtime_error("VlkStagingBuffer creation failed.");
@@ -175,7 +225,7 @@ namespace PixelMachine {
 			cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 			cmdPoolInfo.queueFamilyIndex = vlkDeviceP->GetActiveQueue().second;
 
-			vkCreateCommandPool(vlkDeviceP->GetHandle(), &cmdPoolInfo, nullptr, &m_vkCommandPool);
+			vkCreateCommandPool(vlkDeviceP->GetHandle(), &cmdPoolInfo, vlkDeviceP->GetAllocationCallbacks(VlkHostAllocator::COMMAND_POOL), &m_vkCommandPool);
 
 			if (!m_vkCommandPool) {
 				throw new std::runtime_error("VlkStagingBuffer creation failed.");
@@ -192,14 +242,7 @@ namespace PixelMachine {
 				throw new std::runtime_error("VlkStagingBuffer creation failed.");
 			}
 
-			VkFenceCreateInfo fenceInfo = {};
-			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-
-			vkCreateFence(vlkDeviceP->GetHandle(), &fenceInfo, nullptr, &m_vkFence);
-
-			if (!m_vkFence) {
-				throw new std::runtime_error("VlkStagingBuffer creation failed.");
-			}
+			m_vkQueryPool = static_cast<VlkRenderContext *>(VlkRenderContext::Get())->GetProfiler()->CreateTimestampPool(2u);
 
 			VkCommandBufferBeginInfo bufferBeginInfo = {};
 			bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -211,43 +254,88 @@ namespace PixelMachine {
 			bufferCopy.srcOffset = 0;
 			bufferCopy.size = m_size;
 
+			if (m_vkQueryPool) {
+				vkCmdResetQueryPool(m_vkCommandBuffer, m_vkQueryPool, 0u, 2u);
+				vkCmdWriteTimestamp(m_vkCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_vkQueryPool, 0u);
+			}
+
+			// Submitted between frames - reads of frames already submitted finish before the overwrite
+			vkCmdPipelineBarrier(m_vkCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
 			vkCmdCopyBuffer(m_vkCommandBuffer, m_vkHostBuffer, m_vkGpuBuffer, 1u, &bufferCopy);
+
+			if (m_vkQueryPool) {
+				vkCmdWriteTimestamp(m_vkCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, m_vkQueryPool, 1u);
+			}
+
 			vkEndCommandBuffer(m_vkCommandBuffer);
 		}
 
 		VlkStagingBuffer::~VlkStagingBuffer() {
 
-			VkDevice device = VlkRenderContext::GetVlkDevice()->GetHandle();
-
-			if (m_vkFence) {
-				vkDestroyFence(device, m_vkFence, nullptr);
-			}
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+			VkDevice device = deviceP->GetHandle();
 
 			if (m_vkCommandBuffer) {
 				vkFreeCommandBuffers(device, m_vkCommandPool, 1u, &m_vkCommandBuffer);
 			}
 
 			if (m_vkCommandPool) {
-				vkDestroyCommandPool(device, m_vkCommandPool, nullptr);
+				vkDestroyCommandPool(device, m_vkCommandPool, deviceP->GetAllocationCallbacks(VlkHostAllocator::COMMAND_POOL));
 			}
 
+			if (m_vkQueryPool) {
+				vkDestroyQueryPool(device, m_vkQueryPool, deviceP->GetAllocationCallbacks(VlkHostAllocator::QUERY_POOL));
+			}
+
+			static_cast<VlkRenderContext *>(VlkRenderContext::Get())->ReleaseBufferState(m_vkGpuBuffer);
 			ReleaseVkBuffer(m_vkGpuBuffer, m_vkGpuMemory);
 		}
 
-		void VlkStagingBuffer::SetData(const void *data) {
+		void VlkStagingBuffer::WriteData(const std::function<void(void *dataP)> &writer) {
 
-			memcpy(m_mappedDataP, data, m_size);
+			VlkRenderContext *contextP = static_cast<VlkRenderContext *>(VlkRenderContext::Get());
+			VlkProfiler *profilerP = contextP->GetProfiler();
+			VlkCpuScope cpuScope(profilerP, "SetData");
 
-			VkSubmitInfo submitInfo = {};
-			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-			submitInfo.pCommandBuffers = &m_vkCommandBuffer;
-			submitInfo.commandBufferCount = 1u;
+			writer(m_mappedDataP);
 
 			VlkDevice *vlkDeviceP = VlkRenderContext::GetVlkDevice();
 
-			vkQueueSubmit(vlkDeviceP->GetActiveQueue().first, 1u, &submitInfo, m_vkFence);
-			vkWaitForFences(vlkDeviceP->GetHandle(), 1u, &m_vkFence, true, 1000);
-			vkResetFences(vlkDeviceP->GetHandle(), 1u, &m_vkFence);
+			contextP->SyncBufferUpload(m_vkGpuBuffer);
+
+			// The copy command buffer is reused by the next upload - waits for its timeline value
+			const double submitTimeUs = profilerP->GetTimeUs();
+			const uint64_t uploadValue = vlkDeviceP->Submit(VlkDevice::QueueType::GRAPHICS, m_vkCommandBuffer);
+			vlkDeviceP->GetTimeline(VlkDevice::QueueType::GRAPHICS).WaitFor(uploadValue);
+
+			profilerP->ResolveUpload(m_vkQueryPool, submitTimeUs);
+			contextP->RecordUpload(m_size, 1u);
+			// Passes reading the copy wait for the transfer
+			contextP->RecordBufferWrite(m_vkGpuBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+		}
+
+		void VlkStagingBuffer::SetStagedData(const VlkStagingAllocation &staging) {
+
+			VlkRenderContext *contextP = static_cast<VlkRenderContext *>(VlkRenderContext::Get());
+			VlkUploadBatcher *batcherP = contextP->GetUploadBatcher();
+			VkCommandBuffer commandBuffer = batcherP->GetCommandBuffer();
+
+			contextP->SyncBufferUpload(m_vkGpuBuffer);
+
+			// The batch runs ahead of the next frame - reads of frames already submitted finish before the overwrite
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+			VkBufferCopy bufferCopy = {};
+			bufferCopy.srcOffset = staging.offset;
+			bufferCopy.dstOffset = 0;
+			bufferCopy.size = m_size;
+
+			vkCmdCopyBuffer(commandBuffer, staging.buffer, m_vkGpuBuffer, 1u, &bufferCopy);
+
+			contextP->RecordUpload(m_size, 0u);
+			// Passes reading the copy wait for the transfer
+			contextP->RecordBufferWrite(m_vkGpuBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
 		}
 
 	}
@@ -2,12 +2,27 @@
 #define VLK_SHADER_BUFFER_H_
 
 #include <Buffer.h>
+#include <vulkan/VlkDevice.h>
+#include <vulkan/VlkUploadBatcher.h>
 
 #include <vulkan/vulkan.h>
 
 namespace PixelMachine {
 	namespace GPU {
 
+		/* Create a VkBuffer with VkDeviceMemory allocation - Returns handle to a new buffer (VK_NULL_HANDLE if failed).
+		 <outMemoryPropertiesP> receives the property flags of the memory type that was picked */
+		VkBuffer CreateVkBuffer(
+			const uint32_t size,
+			const uint32_t usageFlagBits,
+			const VlkMemoryFlags &memoryFlags,
+			const MemoryCategory category,
+			VkDeviceMemory &outDeviceMemory,
+			VkMemoryPropertyFlags *outMemoryPropertiesP = nullptr);
+
+		/* Releases both the buffer and its memory once the work submitted so far has completed */
+		void ReleaseVkBuffer(VkBuffer &buffer, VkDeviceMemory &deviceMemory);
+
 		class VlkBuffer : public Buffer {
 		public:
 			VlkBuffer(
@@ -21,11 +36,17 @@ namespace PixelMachine {
 				const BufferLayout dataLayout);
 			virtual ~VlkBuffer();
 			virtual void SetData(const void *data) override;
+			virtual void WriteData(const std::function<void(void *dataP)> &writer) override;
+			/* True when the GPU reads a device local copy written from staging memory, false when it reads the mapped memory */
+			virtual bool IsStaged() const { return false; }
 			void Bind() const override;
 			uint32_t GetSize() const override { return m_size; };
 			virtual VkBuffer GetHandle() const { return m_vkHostBuffer; };
+			/* True when the buffer the GPU reads lives in device local memory */
+			bool IsDeviceLocal() const { return m_memoryProperties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT; }
 		protected:
 			uint32_t m_size = 0;
+			VkMemoryPropertyFlags m_memoryProperties = 0;
 			void *m_mappedDataP = nullptr;
 			VkBuffer m_vkHostBuffer = VK_NULL_HANDLE;
 			VkDeviceMemory m_vkHostMemory = VK_NULL_HANDLE;
@@ -39,14 +60,19 @@ namespace PixelMachine {
 				const BufferLayout dataLayout,
 				const uint32_t elementCount);
 			~VlkStagingBuffer();
-			void SetData(const void *data) override;
+			void WriteData(const std::function<void(void *dataP)> &writer) override;
+			bool IsStaged() const override { return true; }
+			/* Uploads the whole buffer from staging memory filled by the caller - the copy joins the current upload
+			 batch, without waiting */
+			void SetStagedData(const VlkStagingAllocation &staging);
 			VkBuffer GetHandle() const override { return m_vkGpuBuffer; };
 		private:
 			VkBuffer m_vkGpuBuffer = VK_NULL_HANDLE;
 			VkDeviceMemory m_vkGpuMemory = VK_NULL_HANDLE;
 			VkCommandPool m_vkCommandPool = VK_NULL_HANDLE;
 			VkCommandBuffer m_vkCommandBuffer = VK_NULL_HANDLE;
-			VkFence m_vkFence = VK_NULL_HANDLE;
+			// Begin/end timestamps of the copy, null when the queue has no timestamp support
+			VkQueryPool m_vkQueryPool = VK_NULL_HANDLE;
 		};
 	}
 }
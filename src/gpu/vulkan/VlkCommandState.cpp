@@ -0,0 +1,176 @@
+#include <vulkan/VlkCommandState.h>
+#include <vulkan/VlkDevice.h>
+
+#include <algorithm>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		static bool operator==(const VkViewport &a, const VkViewport &b) {
+			return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height && a.minDepth == b.minDepth && a.maxDepth == b.maxDepth;
+		}
+
+		static bool operator==(const VkRect2D &a, const VkRect2D &b) {
+			return a.offset.x == b.offset.x && a.offset.y == b.offset.y && a.extent.width == b.extent.width && a.extent.height == b.extent.height;
+		}
+
+		void VlkCommandState::Reset(VkCommandBuffer commandBuffer) {
+			m_vkCommandBuffer = commandBuffer;
+			m_graphics = BindPointState();
+			m_compute = BindPointState();
+			m_vertexBufferCount = 0u;
+			m_indexBuffer = VK_NULL_HANDLE;
+			m_viewportSet = false;
+			m_scissorSet = false;
+			m_lineWidthSet = false;
+			m_renderStateSet = false;
+		}
+
+		bool VlkCommandState::Skip(const bool unchanged) {
+			unchanged ? m_skippedCount++ : m_issuedCount++;
+			return unchanged;
+		}
+
+		VlkCommandState::BindPointState &VlkCommandState::GetBindPoint(const VkPipelineBindPoint bindPoint) {
+			return bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE ? m_compute : m_graphics;
+		}
+
+		void VlkCommandState::BindPipeline(const VkPipelineBindPoint bindPoint, VkPipeline pipeline) {
+
+			BindPointState &state = GetBindPoint(bindPoint);
+
+			if (Skip(state.m_vkPipeline == pipeline)) {
+				return;
+			}
+
+			vkCmdBindPipeline(m_vkCommandBuffer, bindPoint, pipeline);
+			state.m_vkPipeline = pipeline;
+		}
+
+		void VlkCommandState::BindDescriptorSet(const VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet) {
+
+			BindPointState &state = GetBindPoint(bindPoint);
+
+			// A different layout may not be compatible with the bound set - bound again
+			if (Skip(state.m_vkDescriptorSet == descriptorSet && state.m_vkPipelineLayout == pipelineLayout)) {
+				return;
+			}
+
+			vkCmdBindDescriptorSets(m_vkCommandBuffer, bindPoint, pipelineLayout, 0u, 1u, &descriptorSet, 0u, nullptr);
+			state.m_vkPipelineLayout = pipelineLayout;
+			state.m_vkDescriptorSet = descriptorSet;
+		}
+
+		void VlkCommandState::BindVertexBuffers(const uint32_t count, const VkBuffer *buffersP, const VkDeviceSize *offsetsP) {
+
+			if (count > sm_maxVertexBindings) {
+				m_issuedCount++;
+				vkCmdBindVertexBuffers(m_vkCommandBuffer, 0u, count, buffersP, offsetsP);
+				m_vertexBufferCount = 0u;
+				return;
+			}
+
+			uint32_t first = count;
+			uint32_t last = 0u;
+
+			for (uint32_t i = 0; i < count; i++) {
+				if (i >= m_vertexBufferCount || m_vertexBuffers[i] != buffersP[i] || m_vertexOffsets[i] != offsetsP[i]) {
+					first = std::min(first, i);
+					last = i;
+				}
+			}
+
+			if (Skip(first == count)) {
+				return;
+			}
+
+			vkCmdBindVertexBuffers(m_vkCommandBuffer, first, last - first + 1u, buffersP + first, offsetsP + first);
+
+			for (uint32_t i = first; i <= last; i++) {
+				m_vertexBuffers[i] = buffersP[i];
+				m_vertexOffsets[i] = offsetsP[i];
+			}
+
+			m_vertexBufferCount = std::max(m_vertexBufferCount, count);
+		}
+
+		void VlkCommandState::BindIndexBuffer(VkBuffer buffer, const VkDeviceSize offset, const VkIndexType indexType) {
+
+			if (Skip(m_indexBuffer == buffer && m_indexOffset == offset && m_indexType == indexType)) {
+				return;
+			}
+
+			vkCmdBindIndexBuffer(m_vkCommandBuffer, buffer, offset, indexType);
+			m_indexBuffer = buffer;
+			m_indexOffset = offset;
+			m_indexType = indexType;
+		}
+
+		void VlkCommandState::SetViewport(const VkViewport &viewport) {
+
+			if (Skip(m_viewportSet && m_viewport == viewport)) {
+				return;
+			}
+
+			vkCmdSetViewportWithCount(m_vkCommandBuffer, 1u, &viewport);
+			m_viewport = viewport;
+			m_viewportSet = true;
+		}
+
+		void VlkCommandState::SetScissor(const VkRect2D &scissor) {
+
+			if (Skip(m_scissorSet && m_scissor == scissor)) {
+				return;
+			}
+
+			vkCmdSetScissorWithCount(m_vkCommandBuffer, 1u, &scissor);
+			m_scissor = scissor;
+			m_scissorSet = true;
+		}
+
+		void VlkCommandState::SetLineWidth(const float width) {
+
+			if (Skip(m_lineWidthSet && m_lineWidth == width)) {
+				return;
+			}
+
+			vkCmdSetLineWidth(m_vkCommandBuffer, width);
+			m_lineWidth = width;
+			m_lineWidthSet = true;
+		}
+
+		void VlkCommandState::SetRenderState(const VlkRenderState &state, const VlkDynamicStateSupport &support) {
+
+			// Dynamic state stays valid across pipeline binds - every graphics pipeline declares the same set
+			if (support.extendedDynamicState) {
+
+				if (!Skip(m_renderStateSet && m_renderState.topology == state.topology)) {
+					vkCmdSetPrimitiveTopology(m_vkCommandBuffer, state.topology);
+				}
+
+				if (!Skip(m_renderStateSet && m_renderState.cullMode == state.cullMode)) {
+					vkCmdSetCullMode(m_vkCommandBuffer, state.cullMode);
+				}
+
+				if (!Skip(m_renderStateSet && m_renderState.depthTest == state.depthTest)) {
+					vkCmdSetDepthTestEnable(m_vkCommandBuffer, state.depthTest);
+				}
+
+				if (!Skip(m_renderStateSet && m_renderState.depthWrite == state.depthWrite)) {
+					vkCmdSetDepthWriteEnable(m_vkCommandBuffer, state.depthWrite);
+				}
+			}
+
+			if (support.polygonMode && !Skip(m_renderStateSet && m_renderState.polygonMode == state.polygonMode)) {
+				support.vkCmdSetPolygonMode(m_vkCommandBuffer, state.polygonMode);
+			}
+
+			if (support.rasterizationSamples && !Skip(m_renderStateSet && m_renderState.samples == state.samples)) {
+				support.vkCmdSetRasterizationSamples(m_vkCommandBuffer, state.samples);
+			}
+
+			m_renderState = state;
+			m_renderStateSet = true;
+		}
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef VLK_COMMAND_STATE_H_
+#define VLK_COMMAND_STATE_H_
+
+#include <vulkan/VlkPipelineCache.h>
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+namespace PixelMachine {
+	namespace GPU {
+		struct VlkDynamicStateSupport;
+
+		/// <summary>
+		/// State bound in the command buffer being recorded. Binds and dynamic state matching
+		/// what is already set are not recorded again, counters keep the calls issued and skipped.
+		/// </summary>
+		class VlkCommandState {
+		public:
+			VlkCommandState() = default;
+
+			/* Forgets all bound state - a command buffer begins without any */
+			void Reset(VkCommandBuffer commandBuffer);
+			void BindPipeline(const VkPipelineBindPoint bindPoint, VkPipeline pipeline);
+			/* Binds <descriptorSet> as set 0 of <bindPoint> */
+			void BindDescriptorSet(const VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet);
+			/* Binds <count> vertex buffers from binding 0 - only the range of bindings that changed is recorded */
+			void BindVertexBuffers(const uint32_t count, const VkBuffer *buffersP, const VkDeviceSize *offsetsP);
+			void BindIndexBuffer(VkBuffer buffer, const VkDeviceSize offset, const VkIndexType indexType);
+			void SetViewport(const VkViewport &viewport);
+			void SetScissor(const VkRect2D &scissor);
+			void SetLineWidth(const float width);
+			/* Sets the parts of <state> the device supports as dynamic state - the rest is baked into the bound pipeline */
+			void SetRenderState(const VlkRenderState &state, const VlkDynamicStateSupport &support);
+
+			uint64_t GetIssuedCount() const { return m_issuedCount; }
+			uint64_t GetSkippedCount() const { return m_skippedCount; }
+
+		private:
+			struct BindPointState {
+				VkPipeline m_vkPipeline = VK_NULL_HANDLE;
+				VkPipelineLayout m_vkPipelineLayout = VK_NULL_HANDLE;
+				VkDescriptorSet m_vkDescriptorSet = VK_NULL_HANDLE;
+			};
+
+			/* Counts the call and returns true when it can be skipped */
+			bool Skip(const bool unchanged);
+			BindPointState &GetBindPoint(const VkPipelineBindPoint bindPoint);
+
+			// Vulkan guarantees at least 16 vertex input bindings
+			static constexpr uint32_t sm_maxVertexBindings = 16u;
+
+			VkCommandBuffer m_vkCommandBuffer = VK_NULL_HANDLE;
+			BindPointState m_graphics;
+			BindPointState m_compute;
+			VkBuffer m_vertexBuffers[sm_maxVertexBindings] = {};
+			VkDeviceSize m_vertexOffsets[sm_maxVertexBindings] = {};
+			uint32_t m_vertexBufferCount = 0u;
+			VkBuffer m_indexBuffer = VK_NULL_HANDLE;
+			VkDeviceSize m_indexOffset = 0u;
+			VkIndexType m_indexType = VK_INDEX_TYPE_UINT32;
+			// Dynamic state is undefined until first set
+			bool m_viewportSet = false;
+			bool m_scissorSet = false;
+			bool m_lineWidthSet = false;
+			bool m_renderStateSet = false;
+			VkViewport m_viewport = {};
+			VkRect2D m_scissor = {};
+			float m_lineWidth = 1.0f;
+			VlkRenderState m_renderState;
+			uint64_t m_issuedCount = 0u;
+			uint64_t m_skippedCount = 0u;
+		};
+	}
+}
+
+#endif // !VLK_COMMAND_STATE_H_
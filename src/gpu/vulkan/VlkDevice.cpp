@@ -1,8 +1,10 @@
 #include <vulkan/VlkDevice.h>
 
+#include <bit>
+#include <cstring>
 #include <stdexcept>
 
-static VkInstance CreateVkInstance() {
+static VkInstance CreateVkInstance(const VkAllocationCallbacks *allocatorP) {
 	
 	VkApplicationInfo vkAppInfo = {};
 	vkAppInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -14,11 +16,12 @@ static VkInstance CreateVkInstance() {
 	instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	instanceInfo.pApplicationInfo = &vkAppInfo;
 
-	const char khrSurfaceExtName[] = VK_KHR_SURFACE_EXTENSION_NAME;
-	const char khrWin32SurfaceExtName[] = VK_KHR_WIN32_SURFACE_EXTENSION_NAME;
+	// Without a presentation platform the instance is headless and needs no surface extensions
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 	const char *extensionsNames[] = {VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_WIN32_SURFACE_EXTENSION_NAME};
 	instanceInfo.ppEnabledExtensionNames = extensionsNames;
 	instanceInfo.enabledExtensionCount = 2u;
+#endif
 	instanceInfo.enabledLayerCount = 0u;
 
 #ifdef VK_ENABLE_VALIDATION
@@ -28,46 +31,152 @@ static VkInstance CreateVkInstance() {
 #endif
 
 	VkInstance result = VK_NULL_HANDLE;
-	vkCreateInstance(&instanceInfo, nullptr, &result);
+	vkCreateInstance(&instanceInfo, allocatorP, &result);
 
 	return result;
 }
 
-static VkDevice CreateVkDevice(VkPhysicalDevice physicalDevice, const uint32_t qfIndex) {
+static bool DeviceExtensionAvailable(VkPhysicalDevice physicalDevice, const char *extensionName) {
+
+	uint32_t count = 0u;
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, nullptr);
+
+	std::vector<VkExtensionProperties> extensions(count);
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, extensions.data());
+
+	for (auto &extension : extensions) {
+		if (!strcmp(extension.extensionName, extensionName)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Compute family other than <graphicsFamily> - families without graphics (dedicated async compute) come first */
+static std::optional<uint32_t> FindAsyncComputeFamily(VkPhysicalDevice physicalDevice, const uint32_t graphicsFamily) {
+
+	uint32_t familiesCount = 0u;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familiesCount, nullptr);
+
+	std::vector<VkQueueFamilyProperties> queueFamilyProperties(familiesCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familiesCount, queueFamilyProperties.data());
+
+	std::optional<uint32_t> result;
+
+	for (uint32_t i = 0; i < familiesCount; i++) {
+
+		if (i == graphicsFamily || !(queueFamilyProperties[i].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+			continue;
+		}
+
+		if (!(queueFamilyProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+			return i;
+		}
+
+		if (!result.has_value()) {
+			result = i;
+		}
+	}
+
+	return result;
+}
+
+static VkDevice CreateVkDevice(
+	VkPhysicalDevice physicalDevice,
+	const uint32_t qfIndex,
+	const std::optional<uint32_t> computeQfIndex,
+	const VkPhysicalDeviceFeatures &features,
+	const void *featureChainP,
+	const bool presentation,
+	const VkAllocationCallbacks *allocatorP) {
 
-	VkDeviceQueueCreateInfo queueInfo = {};
-	queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-	queueInfo.queueFamilyIndex = qfIndex;
-	queueInfo.queueCount = 1u;
 	float priority = 1.f;
-	queueInfo.pQueuePriorities = &priority;
+	VkDeviceQueueCreateInfo queueInfos[2] = {};
+
+	queueInfos[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	queueInfos[0].queueFamilyIndex = qfIndex;
+	queueInfos[0].queueCount = 1u;
+	queueInfos[0].pQueuePriorities = &priority;
+
+	if (computeQfIndex.has_value()) {
+		queueInfos[1] = queueInfos[0];
+		queueInfos[1].queueFamilyIndex = computeQfIndex.value();
+	}
 
 	VkDeviceCreateInfo deviceInfo = {};
 	deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	deviceInfo.pQueueCreateInfos = &queueInfo;
-	deviceInfo.queueCreateInfoCount = 1;
+	deviceInfo.pNext = featureChainP;
+	deviceInfo.pQueueCreateInfos = queueInfos;
+	deviceInfo.queueCreateInfoCount = computeQfIndex.has_value() ? 2u : 1u;
 
-	VkPhysicalDeviceFeatures features = {};
 	deviceInfo.pEnabledFeatures = &features;
 
-	std::vector<const char*> extensions = { 
-		VK_KHR_SWAPCHAIN_EXTENSION_NAME ,
+	std::vector<const char*> extensions;
+
+	// Headless devices (e.g. lavapipe in CI) may not expose a swapchain
+	if (presentation) {
+		extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	}
+
+	for (const char *optionalExtension : {
 		VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME,
-		VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME
-	};
+		VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME,
+		VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+		VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME }) {
+		if (DeviceExtensionAvailable(physicalDevice, optionalExtension)) {
+			extensions.push_back(optionalExtension);
+		}
+	}
 
 	deviceInfo.ppEnabledExtensionNames = extensions.data();
 	deviceInfo.enabledExtensionCount = extensions.size();
 
 	VkDevice vkDevice = VK_NULL_HANDLE;
-	vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &vkDevice);
+	vkCreateDevice(physicalDevice, &deviceInfo, allocatorP, &vkDevice);
 
 	return vkDevice;
 }
 
+/* Dynamic state usable on <device> - <enabledDynamicState3> holds the VK_EXT_extended_dynamic_state3 features it was created with */
+static PixelMachine::GPU::VlkDynamicStateSupport QueryDynamicStateSupport(
+	VkDevice device,
+	const PixelMachine::GPU::VlkAdapter &adapter,
+	const bool dynamicState3,
+	const VkPhysicalDeviceExtendedDynamicState3FeaturesEXT &enabledDynamicState3) {
+
+	PixelMachine::GPU::VlkDynamicStateSupport support;
+	support.extendedDynamicState = adapter.GetProperties().apiVersion >= VK_API_VERSION_1_3;
+
+	if (enabledDynamicState3.extendedDynamicState3PolygonMode) {
+		support.vkCmdSetPolygonMode = reinterpret_cast<PFN_vkCmdSetPolygonModeEXT>(vkGetDeviceProcAddr(device, "vkCmdSetPolygonModeEXT"));
+		support.polygonMode = support.vkCmdSetPolygonMode != nullptr;
+	}
+
+	if (enabledDynamicState3.extendedDynamicState3RasterizationSamples) {
+		support.vkCmdSetRasterizationSamples = reinterpret_cast<PFN_vkCmdSetRasterizationSamplesEXT>(vkGetDeviceProcAddr(device, "vkCmdSetRasterizationSamplesEXT"));
+		support.rasterizationSamples = support.vkCmdSetRasterizationSamples != nullptr;
+	}
+
+	if (support.extendedDynamicState && dynamicState3) {
+
+		VkPhysicalDeviceExtendedDynamicState3PropertiesEXT dynamicState3Properties = {};
+		dynamicState3Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_PROPERTIES_EXT;
+
+		VkPhysicalDeviceProperties2 properties = {};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &dynamicState3Properties;
+		vkGetPhysicalDeviceProperties2(adapter.GetHandle(), &properties);
+
+		support.unrestrictedTopology = dynamicState3Properties.dynamicPrimitiveTopologyUnrestricted;
+	}
+
+	return support;
+}
+
 PixelMachine::GPU::VlkDevice::VlkDevice() {
 
-	m_vkInstance = CreateVkInstance();
+	m_vkInstance = CreateVkInstance(GetAllocationCallbacks(VlkHostAllocator::INSTANCE));
 
 	if (m_vkInstance == VK_NULL_HANDLE) {
 		throw std::runtime_error("VlkDevice constructor failed - unable to create VkInstance.");
@@ -93,11 +202,12 @@ PixelMachine::GPU::VlkDevice::VlkDevice() {
 PixelMachine::GPU::VlkDevice::~VlkDevice() {
 
 	if (m_vkLogicalDevice) {
-		vkDestroyDevice(m_vkLogicalDevice, nullptr);
+		ReleaseAll();
+		vkDestroyDevice(m_vkLogicalDevice, GetAllocationCallbacks(VlkHostAllocator::DEVICE));
 	}
 
 	if (m_vkInstance) {
-		vkDestroyInstance(m_vkInstance, nullptr);
+		vkDestroyInstance(m_vkInstance, GetAllocationCallbacks(VlkHostAllocator::INSTANCE));
 	}
 }
 
@@ -119,11 +229,15 @@ std::optional<uint32_t> PixelMachine::GPU::VlkDevice::GetQueueFamilyIndex(const
 
 	uint32_t i = 0;
 	for (auto &properties : queueFamilyProperties) {
-		if (properties.queueFlags & queueFlags) {
+		if ((properties.queueFlags & queueFlags) == queueFlags) {
 			if (extraFlags & QFExtraFlags::WIN32_PRESENTATION) {
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 				if (!vkGetPhysicalDeviceWin32PresentationSupportKHR(m_vlkAdapters[adapterIndex].GetHandle(), i)) {
 					return std::nullopt;
 				}
+#else
+				return std::nullopt;
+#endif
 			}
 			return i;
 		}
@@ -133,33 +247,136 @@ std::optional<uint32_t> PixelMachine::GPU::VlkDevice::GetQueueFamilyIndex(const
 	return std::nullopt;
 }
 
-bool PixelMachine::GPU::VlkDevice::SetAdapter(const uint32_t index) {
+bool PixelMachine::GPU::VlkDevice::SetAdapter(const uint32_t index, QFExtraFlags extraFlags) {
 
 	if (index < 0 || index >= m_vlkAdapters.size()) {
 		return false;
 	}
 
-	auto qfIndex = GetQueueFamilyIndex(index ,VK_QUEUE_GRAPHICS_BIT, QFExtraFlags::WIN32_PRESENTATION);
+	// Compute passes record into the same queue as draws
+	auto qfIndex = GetQueueFamilyIndex(index, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT, extraFlags);
 
 	if (!qfIndex.has_value()) {
 		return false;
 	}
 
+	VkPhysicalDeviceFeatures supportedFeatures = {};
+	vkGetPhysicalDeviceFeatures(GetAdapter(index).GetHandle(), &supportedFeatures);
+
+	// Optional features - enabled only where the adapter has them
+	VkPhysicalDeviceFeatures features = {};
+	features.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+	features.occlusionQueryPrecise = supportedFeatures.occlusionQueryPrecise;
+	// GPU-driven draws - many commands per indirect draw, object index passed as first instance
+	features.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	features.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+	// Wireframe passes and wide lines - drawn filled and one pixel wide without them
+	features.fillModeNonSolid = supportedFeatures.fillModeNonSolid;
+	features.wideLines = supportedFeatures.wideLines;
+	// Anisotropic texture filtering - samplers fall back to isotropic without it
+	features.samplerAnisotropy = supportedFeatures.samplerAnisotropy;
+	// Cube textures with more than one layer
+	features.imageCubeArray = supportedFeatures.imageCubeArray;
+	// Block compressed textures - whichever families the adapter samples, the rest is transcoded on upload
+	features.textureCompressionBC = supportedFeatures.textureCompressionBC;
+	features.textureCompressionETC2 = supportedFeatures.textureCompressionETC2;
+	features.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
+
+	// Vulkan 1.2 features - timeline semaphores synchronize every submit, draw counts read from buffers
+	// Vulkan 1.3 features - dynamic rendering replaces render pass and framebuffer objects
+	if (GetAdapter(index).GetProperties().apiVersion < VK_API_VERSION_1_3) {
+		return false;
+	}
+
+	const bool dynamicState3 = DeviceExtensionAvailable(GetAdapter(index).GetHandle(), VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+
+	VkPhysicalDeviceExtendedDynamicState3FeaturesEXT supportedDynamicState3 = {};
+	supportedDynamicState3.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+
+	VkPhysicalDeviceVulkan13Features supportedFeatures13 = {};
+	supportedFeatures13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	supportedFeatures13.pNext = dynamicState3 ? &supportedDynamicState3 : nullptr;
+
+	VkPhysicalDeviceVulkan12Features supportedFeatures12 = {};
+	supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	supportedFeatures12.pNext = &supportedFeatures13;
+
+	VkPhysicalDeviceFeatures2 supportedFeatures2 = {};
+	supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supportedFeatures2.pNext = &supportedFeatures12;
+	vkGetPhysicalDeviceFeatures2(GetAdapter(index).GetHandle(), &supportedFeatures2);
+
+	if (!supportedFeatures12.timelineSemaphore || !supportedFeatures13.dynamicRendering) {
+		return false;
+	}
+
+	VkPhysicalDeviceVulkan12Features features12 = {};
+	features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	features12.timelineSemaphore = VK_TRUE;
+	features12.drawIndirectCount = supportedFeatures12.drawIndirectCount;
+
+	VkPhysicalDeviceVulkan13Features features13 = {};
+	features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	features13.dynamicRendering = VK_TRUE;
+	features12.pNext = &features13;
+
+	// Render state set while recording keeps one pipeline per shader and vertex layout combination
+	VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamicState3Features = {};
+	dynamicState3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+	dynamicState3Features.extendedDynamicState3PolygonMode = supportedDynamicState3.extendedDynamicState3PolygonMode;
+	dynamicState3Features.extendedDynamicState3RasterizationSamples = supportedDynamicState3.extendedDynamicState3RasterizationSamples;
+
+	if (dynamicState3) {
+		features13.pNext = &dynamicState3Features;
+	}
+
+	const std::optional<uint32_t> computeQfIndex = FindAsyncComputeFamily(GetAdapter(index).GetHandle(), qfIndex.value());
+
 	VkDevice newLogicalDevice = VK_NULL_HANDLE;
-	newLogicalDevice = CreateVkDevice(GetAdapter(index).GetHandle(), qfIndex.value());
+	newLogicalDevice = CreateVkDevice(
+		GetAdapter(index).GetHandle(),
+		qfIndex.value(),
+		computeQfIndex,
+		features,
+		&features12,
+		extraFlags & QFExtraFlags::WIN32_PRESENTATION,
+		GetAllocationCallbacks(VlkHostAllocator::DEVICE));
 
 	if (!newLogicalDevice) {
 		return false;
 	}
 
 	if (m_vkLogicalDevice) {
-		vkDestroyDevice(m_vkLogicalDevice, nullptr);
+		ReleaseAll();
+		vkDestroyDevice(m_vkLogicalDevice, GetAllocationCallbacks(VlkHostAllocator::DEVICE));
 	}
 
 	m_activeAdapterIndex = index;
 	m_vkLogicalDevice = newLogicalDevice;
+	m_enabledFeatures = features;
+	m_enabledFeatures12 = features12;
+	m_enabledFeatures12.pNext = nullptr;
+	m_dynamicStateSupport = QueryDynamicStateSupport(m_vkLogicalDevice, GetAdapter(index), dynamicState3, dynamicState3Features);
 	m_vkGPQueue.second = qfIndex.value();
 	vkGetDeviceQueue(m_vkLogicalDevice, qfIndex.value(), 0, &(m_vkGPQueue.first));
+
+	m_vkComputeQueue = { VK_NULL_HANDLE, VK_QUEUE_FAMILY_IGNORED };
+
+	if (computeQfIndex.has_value()) {
+		m_vkComputeQueue.second = computeQfIndex.value();
+		vkGetDeviceQueue(m_vkLogicalDevice, computeQfIndex.value(), 0, &(m_vkComputeQueue.first));
+	}
+
+	if (!m_graphicsTimeline.Create(m_vkLogicalDevice, GetAllocationCallbacks(VlkHostAllocator::SYNCHRONIZATION)) ||
+		!m_computeTimeline.Create(m_vkLogicalDevice, GetAllocationCallbacks(VlkHostAllocator::SYNCHRONIZATION))) {
+		throw new std::runtime_error("VlkDevice SetAdapter failed - cannot create timeline semaphores.");
+	}
+
+	m_vkMemoryProperties = GetAdapter(index).GetMemoryInfo();
+	m_vlkMemoryTracker.Initialize(
+		GetAdapter(index).GetHandle(),
+		m_vkMemoryProperties,
+		DeviceExtensionAvailable(GetAdapter(index).GetHandle(), VK_EXT_MEMORY_BUDGET_EXTENSION_NAME));
 	
 	return true;
 }
@@ -179,6 +396,97 @@ PixelMachine::GPU::VlkAdapter PixelMachine::GPU::VlkDevice::GetAdapter(const uin
 	return m_vlkAdapters[index];
 }
 
+int32_t PixelMachine::GPU::VlkDevice::FindMemoryType(const uint32_t memoryTypeBits, const VlkMemoryFlags &flags) const {
+
+	// Special purpose memory is only picked when asked for
+	const VkMemoryPropertyFlags specialFlags = (VK_MEMORY_PROPERTY_PROTECTED_BIT | VK_MEMORY_PROPERTY_DEVICE_COHERENT_BIT_AMD) & ~flags.required;
+
+	int32_t bestIndex = -1;
+	int32_t bestScore = 0;
+
+	for (uint32_t i = 0; i < m_vkMemoryProperties.memoryTypeCount; i++) {
+
+		const VkMemoryPropertyFlags typeFlags = m_vkMemoryProperties.memoryTypes[i].propertyFlags;
+
+		if (!(memoryTypeBits & (1u << i)) || (typeFlags & flags.required) != flags.required || (typeFlags & specialFlags)) {
+			continue;
+		}
+
+		// Preferred and avoided flags outweigh any number of unrequested ones, the fewest of which break ties
+		const int32_t score =
+			std::popcount(typeFlags & flags.preferred) * 16 -
+			std::popcount(typeFlags & flags.avoided) * 16 -
+			std::popcount(typeFlags & ~(flags.required | flags.preferred));
+
+		// Drivers list faster types first - equal scores keep the lower index
+		if (bestIndex == -1 || score > bestScore) {
+			bestIndex = static_cast<int32_t>(i);
+			bestScore = score;
+		}
+	}
+
+	return bestIndex;
+}
+
+VkDeviceMemory PixelMachine::GPU::VlkDevice::AllocateMemory(
+	const VkMemoryRequirements &requirements,
+	const VlkMemoryFlags &flags,
+	const MemoryCategory category,
+	VkMemoryPropertyFlags *outPropertiesP) {
+
+	uint32_t candidateBits = requirements.memoryTypeBits;
+
+	for (int32_t memoryTypeIndex = FindMemoryType(candidateBits, flags); memoryTypeIndex != -1; memoryTypeIndex = FindMemoryType(candidateBits, flags)) {
+
+		const uint32_t heapIndex = m_vkMemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+
+		// Eviction callbacks get the chance to make room before the heap goes over its soft limit
+		m_vlkMemoryTracker.CheckPressure(heapIndex, requirements.size);
+
+		VkMemoryAllocateInfo memoryAllocateInfo = {};
+		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memoryAllocateInfo.allocationSize = requirements.size;
+		memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		const VkResult result = vkAllocateMemory(m_vkLogicalDevice, &memoryAllocateInfo, GetAllocationCallbacks(VlkHostAllocator::DEVICE_MEMORY), &memory);
+
+		if (result == VK_SUCCESS && memory) {
+			m_vlkMemoryTracker.OnAllocate(memory, heapIndex, requirements.size, category);
+
+			if (outPropertiesP) {
+				*outPropertiesP = m_vkMemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+			}
+
+			return memory;
+		}
+
+		// Only an exhausted heap is worth retrying with the next ranked type
+		if (result != VK_ERROR_OUT_OF_DEVICE_MEMORY) {
+			break;
+		}
+
+		candidateBits &= ~(1u << memoryTypeIndex);
+	}
+
+	return VK_NULL_HANDLE;
+}
+
+void PixelMachine::GPU::VlkDevice::FreeMemory(VkDeviceMemory memory) {
+
+	if (!memory) {
+		return;
+	}
+
+	m_vlkMemoryTracker.OnFree(memory);
+	vkFreeMemory(m_vkLogicalDevice, memory, GetAllocationCallbacks(VlkHostAllocator::DEVICE_MEMORY));
+}
+
+void PixelMachine::GPU::VlkDevice::UpdateMemoryBudget() {
+	m_vlkMemoryTracker.UpdateBudget();
+	m_vlkMemoryTracker.CheckPressure();
+}
+
 VkDevice PixelMachine::GPU::VlkDevice::GetHandle() const {
 	return m_vkLogicalDevice;
 }
@@ -186,3 +494,91 @@ VkDevice PixelMachine::GPU::VlkDevice::GetHandle() const {
 VkInstance PixelMachine::GPU::VlkDevice::GetVkInstance() const {
 	return m_vkInstance;
 }
+
+uint64_t PixelMachine::GPU::VlkDevice::Submit(
+	const QueueType queue,
+	VkCommandBuffer commandBuffer,
+	const std::vector<VlkSemaphoreWait> &waits,
+	VkSemaphore signalSemaphore) {
+
+	std::vector<VkSemaphore> waitSemaphores;
+	std::vector<uint64_t> waitValues;
+	std::vector<VkPipelineStageFlags> waitStages;
+
+	for (auto &wait : waits) {
+		waitSemaphores.push_back(wait.semaphore);
+		waitValues.push_back(wait.value);
+		waitStages.push_back(wait.stages);
+	}
+
+	VlkTimeline &timeline = GetTimeline(queue);
+	const uint64_t signalValue = timeline.Advance();
+
+	VkSemaphore signalSemaphores[2] = { timeline.GetHandle(), signalSemaphore };
+	// Binary semaphores ignore their value
+	const uint64_t signalValues[2] = { signalValue, 0u };
+	const uint32_t signalCount = signalSemaphore ? 2u : 1u;
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.waitSemaphoreValueCount = waitValues.size();
+	timelineInfo.pWaitSemaphoreValues = waitValues.data();
+	timelineInfo.signalSemaphoreValueCount = signalCount;
+	timelineInfo.pSignalSemaphoreValues = signalValues;
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.commandBufferCount = 1u;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	submitInfo.waitSemaphoreCount = waitSemaphores.size();
+	submitInfo.pWaitSemaphores = waitSemaphores.data();
+	submitInfo.pWaitDstStageMask = waitStages.data();
+	submitInfo.signalSemaphoreCount = signalCount;
+	submitInfo.pSignalSemaphores = signalSemaphores;
+
+	vkQueueSubmit(queue == QueueType::COMPUTE ? m_vkComputeQueue.first : m_vkGPQueue.first, 1u, &submitInfo, VK_NULL_HANDLE);
+
+	return signalValue;
+}
+
+void PixelMachine::GPU::VlkDevice::DeferRelease(std::function<void()> release) {
+
+	DeferredRelease deferred;
+	deferred.m_graphicsValue = m_graphicsTimeline.GetSubmittedValue();
+	deferred.m_computeValue = m_computeTimeline.GetSubmittedValue();
+	deferred.m_release = std::move(release);
+
+	m_deferredReleases.push_back(std::move(deferred));
+}
+
+void PixelMachine::GPU::VlkDevice::CollectReleases() {
+
+	while (m_deferredReleases.size()) {
+
+		DeferredRelease &deferred = m_deferredReleases.front();
+
+		if (!m_graphicsTimeline.IsComplete(deferred.m_graphicsValue) || !m_computeTimeline.IsComplete(deferred.m_computeValue)) {
+			break;
+		}
+
+		// Moved out first - a release may queue further releases
+		std::function<void()> release = std::move(deferred.m_release);
+		m_deferredReleases.pop_front();
+		release();
+	}
+}
+
+void PixelMachine::GPU::VlkDevice::ReleaseAll() {
+
+	vkDeviceWaitIdle(m_vkLogicalDevice);
+
+	while (m_deferredReleases.size()) {
+		std::function<void()> release = std::move(m_deferredReleases.front().m_release);
+		m_deferredReleases.pop_front();
+		release();
+	}
+
+	m_graphicsTimeline.Destroy();
+	m_computeTimeline.Destroy();
+}
@@ -2,12 +2,37 @@
 #define VLK_DEVICE_H_
 
 #include <vulkan/VlkAdapter.h>
+#include <vulkan/VlkHostAllocator.h>
+#include <vulkan/VlkMemoryTracker.h>
+#include <vulkan/VlkTimeline.h>
 
+#include <deque>
+#include <functional>
 #include <vector>
 #include <optional>
 
 namespace PixelMachine {
 	namespace GPU {
+		/* Memory property flags a memory type must have, should have and should rather not have */
+		struct VlkMemoryFlags {
+			VkMemoryPropertyFlags required = 0;
+			VkMemoryPropertyFlags preferred = 0;
+			VkMemoryPropertyFlags avoided = 0;
+		};
+
+		/* Render state the device sets while recording instead of baking it into pipelines */
+		struct VlkDynamicStateSupport {
+			// Extended dynamic state (core in 1.3) - topology within its class, cull mode, depth test and write
+			bool extendedDynamicState = false;
+			// Topology may change class too, not only e.g. list to strip
+			bool unrestrictedTopology = false;
+			// VK_EXT_extended_dynamic_state3
+			bool polygonMode = false;
+			bool rasterizationSamples = false;
+			PFN_vkCmdSetPolygonModeEXT vkCmdSetPolygonMode = nullptr;
+			PFN_vkCmdSetRasterizationSamplesEXT vkCmdSetRasterizationSamples = nullptr;
+		};
+
 		/// <summary>
 		/// Main class that encapulates core Vulkan components
 		/// required to interact with the API.
@@ -19,24 +44,90 @@ namespace PixelMachine {
 				WIN32_PRESENTATION = 1,
 				OTHER = 1 << 1
 			};
+			enum QueueType {
+				GRAPHICS,
+				COMPUTE
+			};
 			VlkDevice();
 			~VlkDevice();
 			std::optional<uint32_t> GetQueueFamilyIndex(const uint32_t adapterIndex, VkQueueFlags queueFlags, QFExtraFlags extraFlags);
-			bool SetAdapter(const uint32_t index);
+			bool SetAdapter(const uint32_t index, QFExtraFlags extraFlags = QFExtraFlags::WIN32_PRESENTATION);
 			VlkAdapter GetAdapter(const uint32_t index) const;
 			VlkAdapter GetActiveAdapter() const;
 			uint32_t GetAdapterCount() const;
 			VkDevice GetHandle() const;
 			VkInstance GetVkInstance() const;
 			std::pair<VkQueue, uint32_t> GetActiveQueue() const { return m_vkGPQueue; };
+			/* Queue of a second compute capable family for async compute - a null queue if the adapter has none */
+			std::pair<VkQueue, uint32_t> GetAsyncComputeQueue() const { return m_vkComputeQueue; };
+			const VkPhysicalDeviceFeatures &GetEnabledFeatures() const { return m_enabledFeatures; }
+			const VkPhysicalDeviceVulkan12Features &GetEnabledFeatures12() const { return m_enabledFeatures12; }
+			const VlkDynamicStateSupport &GetDynamicStateSupport() const { return m_dynamicStateSupport; }
+			/* Allocation callbacks to pass when creating or destroying objects of <type> */
+			const VkAllocationCallbacks *GetAllocationCallbacks(const VlkHostAllocator::ObjectType type) const { return m_vlkHostAllocator.GetCallbacks(type); }
+			const VlkHostAllocator &GetHostAllocator() const { return m_vlkHostAllocator; }
+			/* Memory properties of the active adapter, cached by SetAdapter */
+			const VkPhysicalDeviceMemoryProperties &GetMemoryProperties() const { return m_vkMemoryProperties; }
+			/* Index of the best ranked memory type out of <memoryTypeBits> having all required flags, -1 if there is none */
+			int32_t FindMemoryType(const uint32_t memoryTypeBits, const VlkMemoryFlags &flags) const;
+			/* Allocates memory of the best ranked type for <requirements> and <flags>, accounted to <category>.
+			 Falls back to the next ranked type when a heap is exhausted and raises memory pressure first if the
+			 allocation would cross the soft limit of its heap. Returns VK_NULL_HANDLE on failure */
+			VkDeviceMemory AllocateMemory(
+				const VkMemoryRequirements &requirements,
+				const VlkMemoryFlags &flags,
+				const MemoryCategory category,
+				VkMemoryPropertyFlags *outPropertiesP = nullptr);
+			void FreeMemory(VkDeviceMemory memory);
+			/* Queries the heap budgets and raises memory pressure - called once per frame */
+			void UpdateMemoryBudget();
+			VlkMemoryTracker &GetMemoryTracker() { return m_vlkMemoryTracker; }
+			const VlkMemoryTracker &GetMemoryTracker() const { return m_vlkMemoryTracker; }
+			/* Timeline signaled by every submit to the graphics queue or to the async compute queue */
+			VlkTimeline &GetTimeline(const QueueType queue) { return queue == QueueType::COMPUTE ? m_computeTimeline : m_graphicsTimeline; }
+			/* Submits <commandBuffer> to <queue> signaling <signalSemaphore> (binary) and the next value of the queue
+			 timeline - returns that value */
+			uint64_t Submit(
+				const QueueType queue,
+				VkCommandBuffer commandBuffer,
+				const std::vector<VlkSemaphoreWait> &waits = {},
+				VkSemaphore signalSemaphore = VK_NULL_HANDLE);
+			/* Runs <release> once all work submitted so far on both queues has completed - objects the GPU may
+			 still use are destroyed through it instead of waiting for the device to go idle */
+			void DeferRelease(std::function<void()> release);
+			/* Runs the deferred releases whose submits have completed - called once per frame */
+			void CollectReleases();
 
 		private:
+			/* Release deferred until both timelines reach the values submitted when it was queued */
+			struct DeferredRelease {
+				uint64_t m_graphicsValue = 0;
+				uint64_t m_computeValue = 0;
+				std::function<void()> m_release;
+			};
+
+			/* Waits for the device to go idle, runs every deferred release and destroys the timelines */
+			void ReleaseAll();
+
+			// Declared first - outlives the instance and device allocating from it
+			VlkHostAllocator m_vlkHostAllocator;
 			VkInstance m_vkInstance = VK_NULL_HANDLE;
 			VkDevice m_vkLogicalDevice = VK_NULL_HANDLE;
 			std::vector<VlkAdapter> m_vlkAdapters;
 			uint32_t m_activeAdapterIndex = 0u;
+			VkPhysicalDeviceFeatures m_enabledFeatures = {};
+			VkPhysicalDeviceVulkan12Features m_enabledFeatures12 = {};
+			VlkDynamicStateSupport m_dynamicStateSupport;
+			VkPhysicalDeviceMemoryProperties m_vkMemoryProperties = {};
+			VlkMemoryTracker m_vlkMemoryTracker;
 			// Graphics & presentation queue
 			std::pair<VkQueue, uint32_t> m_vkGPQueue;
+			// Async compute queue
+			std::pair<VkQueue, uint32_t> m_vkComputeQueue = { VK_NULL_HANDLE, VK_QUEUE_FAMILY_IGNORED };
+			VlkTimeline m_graphicsTimeline;
+			VlkTimeline m_computeTimeline;
+			// Queued in submission order - both values only grow, releases complete front to back
+			std::deque<DeferredRelease> m_deferredReleases;
 
 		};
 	}
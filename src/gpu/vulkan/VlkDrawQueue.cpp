@@ -0,0 +1,91 @@
+#include <vulkan/VlkDrawQueue.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		uint64_t VlkDrawQueue::MakeSortKey(const uint8_t layer, const uint16_t pipelineId, const uint16_t materialId, const float depth) {
+
+			const uint64_t depthBits = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * 0xFFFFFFu);
+
+			return (static_cast<uint64_t>(layer) << 56u) |
+				(static_cast<uint64_t>(pipelineId) << 40u) |
+				(static_cast<uint64_t>(materialId) << 24u) |
+				depthBits;
+		}
+
+		void VlkDrawQueue::Push(const VlkDrawRecord &record) {
+
+			if (m_count == m_capacity) {
+
+				// The outgrown array stays in the arena until the frame ends
+				const uint32_t capacity = std::max(m_capacity * 2u, 256u);
+				VlkDrawRecord *recordsP = m_arena.Allocate<VlkDrawRecord>(capacity);
+
+				if (m_count) {
+					std::memcpy(recordsP, m_recordsP, sizeof(VlkDrawRecord) * m_count);
+				}
+
+				m_recordsP = recordsP;
+				m_capacity = capacity;
+			}
+
+			m_recordsP[m_count++] = record;
+		}
+
+		void VlkDrawQueue::Sort() {
+
+			if (m_count < 2u) {
+				return;
+			}
+
+			// LSD radix sort, one byte per pass - stable, so equal keys keep their push order
+			VlkDrawRecord *scratchP = m_arena.Allocate<VlkDrawRecord>(m_count);
+			VlkDrawRecord *srcP = m_recordsP;
+			VlkDrawRecord *dstP = scratchP;
+
+			for (uint32_t shift = 0; shift < 64u; shift += 8u) {
+
+				uint32_t histogram[256] = { 0 };
+
+				for (uint32_t i = 0; i < m_count; i++) {
+					histogram[(srcP[i].sortKey >> shift) & 0xFFu]++;
+				}
+
+				// Every key has the same byte - the pass would not move anything
+				if (histogram[(srcP[0].sortKey >> shift) & 0xFFu] == m_count) {
+					continue;
+				}
+
+				uint32_t offset = 0;
+
+				for (auto &bucket : histogram) {
+					const uint32_t count = bucket;
+					bucket = offset;
+					offset += count;
+				}
+
+				for (uint32_t i = 0; i < m_count; i++) {
+					dstP[histogram[(srcP[i].sortKey >> shift) & 0xFFu]++] = srcP[i];
+				}
+
+				std::swap(srcP, dstP);
+			}
+
+			// An odd number of passes leaves the result in the scratch array
+			if (srcP != m_recordsP) {
+				m_recordsP = srcP;
+				m_capacity = m_count;
+			}
+		}
+
+		void VlkDrawQueue::Reset() {
+			m_arena.Reset();
+			m_recordsP = nullptr;
+			m_count = 0;
+			m_capacity = 0;
+		}
+	}
+}
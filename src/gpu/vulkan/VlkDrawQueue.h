@@ -0,0 +1,47 @@
+#ifndef VLK_DRAW_QUEUE_H_
+#define VLK_DRAW_QUEUE_H_
+
+#include <vulkan/VlkLinearArena.h>
+
+#include <cstdint>
+
+namespace PixelMachine {
+	namespace GPU {
+		/* Draw of one graphics pass waiting in the queue */
+		struct VlkDrawRecord {
+			uint64_t sortKey = 0;
+			uint32_t passIndex = 0;
+		};
+
+		/// <summary>
+		/// Draws collected over a frame in a linear arena and radix sorted by a 64-bit key -
+		/// layer, pipeline, material (descriptor set) and depth from the most significant bits down.
+		/// Replaying them in key order keeps pipeline and descriptor set switches to a minimum.
+		/// </summary>
+		class VlkDrawQueue {
+		public:
+			VlkDrawQueue() = default;
+
+			/* <depth> in [0, 1] is quantized to 24 bits, near draws sort first */
+			static uint64_t MakeSortKey(const uint8_t layer, const uint16_t pipelineId, const uint16_t materialId, const float depth);
+
+			void Push(const VlkDrawRecord &record);
+			/* Sorts the queued records by key, keeping the push order of equal keys */
+			void Sort();
+			/* Empties the queue and releases the arena memory of the frame */
+			void Reset();
+
+			uint32_t GetCount() const { return m_count; }
+			const VlkDrawRecord *GetRecords() const { return m_recordsP; }
+			const VlkLinearArena &GetArena() const { return m_arena; }
+
+		private:
+			VlkLinearArena m_arena;
+			VlkDrawRecord *m_recordsP = nullptr;
+			uint32_t m_count = 0;
+			uint32_t m_capacity = 0;
+		};
+	}
+}
+
+#endif // !VLK_DRAW_QUEUE_H_
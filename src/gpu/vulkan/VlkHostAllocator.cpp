@@ -0,0 +1,265 @@
+#include <vulkan/VlkHostAllocator.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		/* Precedes every allocation handed to the driver */
+		struct AllocationHeader {
+			void *baseP;			// Pool block or malloc result
+			uint64_t size;
+			uint16_t headerSize;	// Distance from the block start to the returned pointer
+			uint8_t sizeClass;
+			uint8_t scope;
+			uint8_t type;
+		};
+
+		// Space reserved for the header - allocations with stricter alignment reserve one alignment unit instead
+		static constexpr size_t s_headerSpace = 32u;
+		static constexpr uint8_t s_unpooledClass = 0xFFu;
+
+		static_assert(sizeof(AllocationHeader) <= s_headerSpace, "Allocation header does not fit its reserved space.");
+
+		static const char *s_objectTypeNames[] = {
+			"Instance", "Device", "Surface", "Swapchain", "RenderPass", "Pipeline", "ShaderModule",
+			"CommandPool", "Synchronization", "QueryPool", "Descriptor", "Buffer", "Image", "Sampler", "DeviceMemory"
+		};
+
+		static const char *s_scopeNames[] = { "Command", "Object", "Cache", "Device", "Instance" };
+
+		static AllocationHeader *GetHeader(void *memoryP) {
+			return reinterpret_cast<AllocationHeader *>(static_cast<uint8_t *>(memoryP) - s_headerSpace);
+		}
+
+		static uint8_t *AlignPointer(void *pointerP, const size_t alignment) {
+			const uintptr_t address = reinterpret_cast<uintptr_t>(pointerP);
+			return reinterpret_cast<uint8_t *>((address + alignment - 1u) & ~(static_cast<uintptr_t>(alignment) - 1u));
+		}
+
+		VlkHostAllocator::VlkHostAllocator() {
+
+			static_assert(sizeof(s_objectTypeNames) / sizeof(s_objectTypeNames[0]) == ObjectType::OBJECT_TYPE_COUNT, "Missing object type name.");
+
+			for (uint32_t i = 0; i < ObjectType::OBJECT_TYPE_COUNT; i++) {
+				m_tags[i].allocatorP = this;
+				m_tags[i].type = static_cast<ObjectType>(i);
+
+				m_callbacks[i].pUserData = &m_tags[i];
+				m_callbacks[i].pfnAllocation = Allocate;
+				m_callbacks[i].pfnReallocation = Reallocate;
+				m_callbacks[i].pfnFree = Free;
+				m_callbacks[i].pfnInternalAllocation = InternalAllocation;
+				m_callbacks[i].pfnInternalFree = InternalFree;
+			}
+		}
+
+		VlkHostAllocator::~VlkHostAllocator() {
+			for (auto &scopePools : m_pools) {
+				for (auto &pool : scopePools) {
+					for (void *chunkP : pool.chunks) {
+						std::free(chunkP);
+					}
+				}
+			}
+		}
+
+		const VkAllocationCallbacks *VlkHostAllocator::GetCallbacks(const ObjectType type) const {
+			return &m_callbacks[type];
+		}
+
+		void VlkHostAllocator::GetUsage(std::vector<HostMemoryUsage> &outUsage) const {
+
+			outUsage.clear();
+
+			for (uint32_t type = 0; type < ObjectType::OBJECT_TYPE_COUNT; type++) {
+				for (uint32_t scope = 0; scope < sm_scopeCount; scope++) {
+
+					const UsageCounters &counters = m_counters[type * sm_scopeCount + scope];
+
+					if (!counters.totalAllocations.load() && !counters.internalBytes.load()) {
+						continue;
+					}
+
+					HostMemoryUsage usage;
+					usage.objectType = s_objectTypeNames[type];
+					usage.scope = s_scopeNames[scope];
+					usage.liveBytes = counters.liveBytes.load();
+					usage.liveAllocations = counters.liveAllocations.load();
+					usage.peakBytes = counters.peakBytes.load();
+					usage.totalAllocations = counters.totalAllocations.load();
+					usage.internalBytes = counters.internalBytes.load();
+					outUsage.push_back(usage);
+				}
+			}
+		}
+
+		void *VlkHostAllocator::AllocateBlock(const ObjectType type, const size_t size, const size_t alignment, const uint32_t scope) {
+
+			if (!size) {
+				return nullptr;
+			}
+
+			const size_t blockAlignment = std::max<size_t>(alignment, alignof(std::max_align_t));
+			const size_t headerSize = std::max(s_headerSpace, blockAlignment);
+			const size_t total = headerSize + size;
+
+			uint8_t *baseP = nullptr;
+			uint8_t *blockP = nullptr;
+			uint8_t sizeClass = s_unpooledClass;
+
+			if (blockAlignment <= sm_maxPooledAlignment && total <= (size_t(1u) << (sm_minBlockShift + sm_sizeClassCount - 1u))) {
+
+				sizeClass = 0u;
+				while ((size_t(1u) << (sm_minBlockShift + sizeClass)) < total) {
+					sizeClass++;
+				}
+
+				const size_t blockSize = size_t(1u) << (sm_minBlockShift + sizeClass);
+				SizeClassPool &pool = m_pools[scope][sizeClass];
+				std::lock_guard<std::mutex> lock(pool.mutex);
+
+				if (!pool.freeListP) {
+
+					void *chunkP = std::malloc(sm_chunkSize + sm_maxPooledAlignment);
+
+					if (!chunkP) {
+						return nullptr;
+					}
+
+					pool.chunks.push_back(chunkP);
+
+					// Blocks are aligned to their size up to the pooled alignment
+					uint8_t *firstP = AlignPointer(chunkP, sm_maxPooledAlignment);
+
+					for (size_t offset = sm_chunkSize; offset >= blockSize; offset -= blockSize) {
+						void *freeP = firstP + offset - blockSize;
+						*static_cast<void **>(freeP) = pool.freeListP;
+						pool.freeListP = freeP;
+					}
+				}
+
+				baseP = static_cast<uint8_t *>(pool.freeListP);
+				pool.freeListP = *static_cast<void **>(pool.freeListP);
+				blockP = baseP;
+			}
+			else {
+				baseP = static_cast<uint8_t *>(std::malloc(total + blockAlignment - 1u));
+
+				if (!baseP) {
+					return nullptr;
+				}
+
+				blockP = AlignPointer(baseP, blockAlignment);
+			}
+
+			uint8_t *memoryP = blockP + headerSize;
+			AllocationHeader *headerP = GetHeader(memoryP);
+			headerP->baseP = baseP;
+			headerP->size = size;
+			headerP->headerSize = static_cast<uint16_t>(headerSize);
+			headerP->sizeClass = sizeClass;
+			headerP->scope = static_cast<uint8_t>(scope);
+			headerP->type = static_cast<uint8_t>(type);
+
+			UsageCounters &counters = GetCounters(type, scope);
+			const uint64_t liveBytes = counters.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+			counters.liveAllocations.fetch_add(1u, std::memory_order_relaxed);
+			counters.totalAllocations.fetch_add(1u, std::memory_order_relaxed);
+			m_allocationCount.fetch_add(1u, std::memory_order_relaxed);
+
+			uint64_t peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+			while (peakBytes < liveBytes && !counters.peakBytes.compare_exchange_weak(peakBytes, liveBytes, std::memory_order_relaxed)) {}
+
+			return memoryP;
+		}
+
+		void VlkHostAllocator::FreeBlock(void *memoryP) {
+
+			if (!memoryP) {
+				return;
+			}
+
+			AllocationHeader *headerP = GetHeader(memoryP);
+
+			UsageCounters &counters = GetCounters(headerP->type, headerP->scope);
+			counters.liveBytes.fetch_sub(headerP->size, std::memory_order_relaxed);
+			counters.liveAllocations.fetch_sub(1u, std::memory_order_relaxed);
+
+			if (headerP->sizeClass == s_unpooledClass) {
+				std::free(headerP->baseP);
+				return;
+			}
+
+			SizeClassPool &pool = m_pools[headerP->scope][headerP->sizeClass];
+			void *blockP = headerP->baseP;
+
+			std::lock_guard<std::mutex> lock(pool.mutex);
+			*static_cast<void **>(blockP) = pool.freeListP;
+			pool.freeListP = blockP;
+		}
+
+		VKAPI_ATTR void *VKAPI_CALL VlkHostAllocator::Allocate(void *userDataP, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+			CallbackTag *tagP = static_cast<CallbackTag *>(userDataP);
+			return tagP->allocatorP->AllocateBlock(tagP->type, size, alignment, std::min<uint32_t>(scope, sm_scopeCount - 1u));
+		}
+
+		VKAPI_ATTR void *VKAPI_CALL VlkHostAllocator::Reallocate(void *userDataP, void *originalP, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+
+			CallbackTag *tagP = static_cast<CallbackTag *>(userDataP);
+
+			if (!originalP) {
+				return Allocate(userDataP, size, alignment, scope);
+			}
+
+			if (!size) {
+				tagP->allocatorP->FreeBlock(originalP);
+				return nullptr;
+			}
+
+			AllocationHeader *headerP = GetHeader(originalP);
+
+			// Shrinking or growing within the pool block keeps the allocation in place
+			if (headerP->sizeClass != s_unpooledClass && headerP->headerSize + size <= (size_t(1u) << (sm_minBlockShift + headerP->sizeClass))) {
+
+				UsageCounters &counters = tagP->allocatorP->GetCounters(headerP->type, headerP->scope);
+				counters.liveBytes.fetch_add(size - headerP->size, std::memory_order_relaxed);
+				headerP->size = size;
+
+				const uint64_t liveBytes = counters.liveBytes.load(std::memory_order_relaxed);
+				uint64_t peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+				while (peakBytes < liveBytes && !counters.peakBytes.compare_exchange_weak(peakBytes, liveBytes, std::memory_order_relaxed)) {}
+
+				return originalP;
+			}
+
+			void *memoryP = Allocate(userDataP, size, alignment, scope);
+
+			// Failed reallocations leave the original allocation untouched
+			if (!memoryP) {
+				return nullptr;
+			}
+
+			std::memcpy(memoryP, originalP, std::min<size_t>(size, headerP->size));
+			tagP->allocatorP->FreeBlock(originalP);
+
+			return memoryP;
+		}
+
+		VKAPI_ATTR void VKAPI_CALL VlkHostAllocator::Free(void *userDataP, void *memoryP) {
+			static_cast<CallbackTag *>(userDataP)->allocatorP->FreeBlock(memoryP);
+		}
+
+		VKAPI_ATTR void VKAPI_CALL VlkHostAllocator::InternalAllocation(void *userDataP, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope) {
+			CallbackTag *tagP = static_cast<CallbackTag *>(userDataP);
+			tagP->allocatorP->GetCounters(tagP->type, std::min<uint32_t>(scope, sm_scopeCount - 1u)).internalBytes.fetch_add(size, std::memory_order_relaxed);
+		}
+
+		VKAPI_ATTR void VKAPI_CALL VlkHostAllocator::InternalFree(void *userDataP, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope) {
+			CallbackTag *tagP = static_cast<CallbackTag *>(userDataP);
+			tagP->allocatorP->GetCounters(tagP->type, std::min<uint32_t>(scope, sm_scopeCount - 1u)).internalBytes.fetch_sub(size, std::memory_order_relaxed);
+		}
+	}
+}
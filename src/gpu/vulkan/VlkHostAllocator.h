@@ -0,0 +1,99 @@
+#ifndef VLK_HOST_ALLOCATOR_H_
+#define VLK_HOST_ALLOCATOR_H_
+
+#include <RenderContext.h>
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		/// <summary>
+		/// VkAllocationCallbacks implementation taking driver host allocations away from the global heap.
+		/// Small allocations are served from size-class pools, one set of pools (arena) per
+		/// VkSystemAllocationScope so short-lived command allocations do not fragment long-lived objects.
+		/// Pools lock per size class and keep their chunks until the allocator is destroyed.
+		/// Bytes and counts are tracked per object type and allocation scope.
+		/// </summary>
+		class VlkHostAllocator {
+		public:
+			/* Object types host allocations are accounted to - every type gets its own VkAllocationCallbacks */
+			enum ObjectType {
+				INSTANCE,
+				DEVICE,
+				SURFACE,
+				SWAPCHAIN,
+				RENDER_PASS,
+				PIPELINE,
+				SHADER_MODULE,
+				COMMAND_POOL,
+				SYNCHRONIZATION,
+				QUERY_POOL,
+				DESCRIPTOR,
+				BUFFER,
+				IMAGE,
+				SAMPLER,
+				DEVICE_MEMORY,
+				OBJECT_TYPE_COUNT
+			};
+
+			VlkHostAllocator();
+			~VlkHostAllocator();
+
+			/* Callbacks accounting allocations to <type> - valid for the lifetime of the allocator */
+			const VkAllocationCallbacks *GetCallbacks(const ObjectType type) const;
+			/* Live and peak usage per object type and scope, entries that never allocated are skipped */
+			void GetUsage(std::vector<HostMemoryUsage> &outUsage) const;
+			/* Allocations made through the callbacks since creation */
+			uint64_t GetAllocationCount() const { return m_allocationCount.load(std::memory_order_relaxed); }
+
+		private:
+			static constexpr uint32_t sm_scopeCount = 5u;			// VK_SYSTEM_ALLOCATION_SCOPE_COMMAND .. INSTANCE
+			static constexpr uint32_t sm_sizeClassCount = 7u;		// 64 B .. 4 KiB blocks
+			static constexpr uint32_t sm_minBlockShift = 6u;
+			static constexpr size_t sm_maxPooledAlignment = 64u;
+			static constexpr size_t sm_chunkSize = 64u * 1024u;
+
+			struct CallbackTag {
+				VlkHostAllocator *allocatorP = nullptr;
+				ObjectType type = ObjectType::INSTANCE;
+			};
+
+			struct SizeClassPool {
+				std::mutex mutex;
+				void *freeListP = nullptr;
+				std::vector<void *> chunks;
+			};
+
+			struct UsageCounters {
+				std::atomic<uint64_t> liveBytes = 0u;
+				std::atomic<uint64_t> liveAllocations = 0u;
+				std::atomic<uint64_t> peakBytes = 0u;
+				std::atomic<uint64_t> totalAllocations = 0u;
+				std::atomic<uint64_t> internalBytes = 0u;
+			};
+
+			static VKAPI_ATTR void *VKAPI_CALL Allocate(void *userDataP, size_t size, size_t alignment, VkSystemAllocationScope scope);
+			static VKAPI_ATTR void *VKAPI_CALL Reallocate(void *userDataP, void *originalP, size_t size, size_t alignment, VkSystemAllocationScope scope);
+			static VKAPI_ATTR void VKAPI_CALL Free(void *userDataP, void *memoryP);
+			static VKAPI_ATTR void VKAPI_CALL InternalAllocation(void *userDataP, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+			static VKAPI_ATTR void VKAPI_CALL InternalFree(void *userDataP, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+			void *AllocateBlock(const ObjectType type, const size_t size, const size_t alignment, const uint32_t scope);
+			void FreeBlock(void *memoryP);
+			UsageCounters &GetCounters(const uint32_t type, const uint32_t scope) { return m_counters[type * sm_scopeCount + scope]; }
+
+			CallbackTag m_tags[ObjectType::OBJECT_TYPE_COUNT];
+			VkAllocationCallbacks m_callbacks[ObjectType::OBJECT_TYPE_COUNT] = {};
+			SizeClassPool m_pools[sm_scopeCount][sm_sizeClassCount];
+			UsageCounters m_counters[ObjectType::OBJECT_TYPE_COUNT * sm_scopeCount];
+			std::atomic<uint64_t> m_allocationCount = 0u;
+		};
+	}
+}
+
+#endif // !VLK_HOST_ALLOCATOR_H_
@@ -0,0 +1,81 @@
+#include <vulkan/VlkLinearArena.h>
+
+#include <algorithm>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		VlkLinearArena::VlkLinearArena(const size_t blockSize) {
+			AddBlock(std::max<size_t>(blockSize, 256u));
+		}
+
+		VlkLinearArena::~VlkLinearArena() {
+			for (auto &block : m_blocks) {
+				delete[] block.m_dataP;
+			}
+		}
+
+		void VlkLinearArena::AddBlock(const size_t size) {
+
+			Block block;
+			block.m_dataP = new uint8_t[size];
+			block.m_size = size;
+
+			m_blocks.push_back(block);
+			m_blockAllocations++;
+		}
+
+		void *VlkLinearArena::Allocate(const size_t size, const size_t alignment) {
+
+			Block *blockP = &m_blocks.back();
+			uintptr_t address = reinterpret_cast<uintptr_t>(blockP->m_dataP) + m_offset;
+			size_t padding = (alignment - address % alignment) % alignment;
+
+			if (m_offset + padding + size > blockP->m_size) {
+
+				// Growing geometrically keeps the number of blocks of a frame logarithmic
+				m_usedBytes += m_offset;
+				m_offset = 0;
+				AddBlock(std::max(blockP->m_size * 2u, size + alignment));
+
+				blockP = &m_blocks.back();
+				address = reinterpret_cast<uintptr_t>(blockP->m_dataP);
+				padding = (alignment - address % alignment) % alignment;
+			}
+
+			void *dataP = blockP->m_dataP + m_offset + padding;
+			m_offset += padding + size;
+			return dataP;
+		}
+
+		void VlkLinearArena::Reset() {
+
+			if (m_blocks.size() > 1u) {
+
+				// The frame did not fit - replace the chain with one block holding all of it
+				const size_t capacity = GetCapacity();
+
+				for (auto &block : m_blocks) {
+					delete[] block.m_dataP;
+				}
+
+				m_blocks.clear();
+				AddBlock(capacity);
+			}
+
+			m_offset = 0;
+			m_usedBytes = 0;
+		}
+
+		size_t VlkLinearArena::GetCapacity() const {
+
+			size_t capacity = 0;
+
+			for (auto &block : m_blocks) {
+				capacity += block.m_size;
+			}
+
+			return capacity;
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef VLK_LINEAR_ARENA_H_
+#define VLK_LINEAR_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		/// <summary>
+		/// Bump allocator for data living one frame. Allocations are only released all at once by Reset.
+		/// A frame outgrowing the arena chains extra blocks, Reset folds them into a single block sized
+		/// for that frame - a steady workload stops touching the heap after its first frames.
+		/// </summary>
+		class VlkLinearArena {
+		public:
+			explicit VlkLinearArena(const size_t blockSize = 64u * 1024u);
+			VlkLinearArena(const VlkLinearArena &) = delete;
+			VlkLinearArena &operator=(const VlkLinearArena &) = delete;
+			~VlkLinearArena();
+
+			void *Allocate(const size_t size, const size_t alignment);
+			/* Uninitialized storage for <count> objects - destructors never run, so only trivial types are accepted */
+			template<typename T>
+			T *Allocate(const size_t count) {
+				static_assert(std::is_trivially_destructible<T>::value, "VlkLinearArena never destroys its objects.");
+				return static_cast<T *>(Allocate(sizeof(T) * count, alignof(T)));
+			}
+			/* Releases every allocation */
+			void Reset();
+
+			size_t GetUsedBytes() const { return m_usedBytes + m_offset; }
+			size_t GetCapacity() const;
+			/* Blocks allocated from the heap over the lifetime of the arena */
+			uint64_t GetBlockAllocations() const { return m_blockAllocations; }
+
+		private:
+			struct Block {
+				uint8_t *m_dataP = nullptr;
+				size_t m_size = 0;
+			};
+
+			void AddBlock(const size_t size);
+
+			std::vector<Block> m_blocks;
+			// Offset in the last block and the bytes taken from the blocks before it
+			size_t m_offset = 0;
+			size_t m_usedBytes = 0;
+			uint64_t m_blockAllocations = 0;
+		};
+	}
+}
+
+#endif // !VLK_LINEAR_ARENA_H_
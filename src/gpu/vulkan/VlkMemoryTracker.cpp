@@ -0,0 +1,205 @@
+#include <vulkan/VlkMemoryTracker.h>
+
+#include <algorithm>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		void VlkMemoryTracker::Initialize(VkPhysicalDevice physicalDevice, const VkPhysicalDeviceMemoryProperties &properties, const bool budgetSupported) {
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				m_vkPhysicalDevice = physicalDevice;
+				m_budgetSupported = budgetSupported;
+				m_heaps.assign(properties.memoryHeapCount, HeapState());
+				m_allocations.clear();
+
+				for (auto &category : m_categories) {
+					category = MemoryCategoryTelemetry();
+				}
+
+				for (uint32_t i = 0; i < properties.memoryHeapCount; i++) {
+					m_heaps[i].size = properties.memoryHeaps[i].size;
+					m_heaps[i].deviceLocal = properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+					m_heaps[i].budget = properties.memoryHeaps[i].size;
+				}
+			}
+
+			UpdateBudget();
+		}
+
+		void VlkMemoryTracker::UpdateBudget() {
+
+			if (!m_budgetSupported) {
+				return;
+			}
+
+			VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+			budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+			VkPhysicalDeviceMemoryProperties2 properties = {};
+			properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+			properties.pNext = &budgetProperties;
+
+			vkGetPhysicalDeviceMemoryProperties2(m_vkPhysicalDevice, &properties);
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			for (uint32_t i = 0; i < m_heaps.size(); i++) {
+				m_heaps[i].budget = budgetProperties.heapBudget[i];
+				m_heaps[i].queriedUsage = budgetProperties.heapUsage[i];
+				m_heaps[i].allocatedAtQuery = m_heaps[i].allocated;
+			}
+		}
+
+		uint64_t VlkMemoryTracker::GetHeapUsage(const HeapState &heap) const {
+
+			if (!m_budgetSupported) {
+				return heap.allocated;
+			}
+
+			// Driver usage lags until the next query - own allocations since then are added on top
+			const int64_t delta = static_cast<int64_t>(heap.allocated) - static_cast<int64_t>(heap.allocatedAtQuery);
+			return static_cast<uint64_t>(std::max<int64_t>(0, static_cast<int64_t>(heap.queriedUsage) + delta));
+		}
+
+		uint64_t VlkMemoryTracker::GetSoftLimit(const HeapState &heap) const {
+			return static_cast<uint64_t>(heap.budget * static_cast<double>(m_softLimitFraction));
+		}
+
+		void VlkMemoryTracker::OnAllocate(VkDeviceMemory memory, const uint32_t heapIndex, const uint64_t size, const MemoryCategory category) {
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (heapIndex >= m_heaps.size()) {
+				return;
+			}
+
+			Allocation allocation;
+			allocation.heapIndex = heapIndex;
+			allocation.size = size;
+			allocation.category = category;
+			m_allocations[memory] = allocation;
+
+			HeapState &heap = m_heaps[heapIndex];
+			heap.allocated += size;
+			heap.peakAllocated = std::max(heap.peakAllocated, heap.allocated);
+
+			MemoryCategoryTelemetry &telemetry = m_categories[category];
+			telemetry.liveAllocations++;
+			telemetry.liveBytes += size;
+			telemetry.peakBytes = std::max(telemetry.peakBytes, telemetry.liveBytes);
+		}
+
+		void VlkMemoryTracker::OnFree(VkDeviceMemory memory) {
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			auto it = m_allocations.find(memory);
+
+			if (it == m_allocations.end()) {
+				return;
+			}
+
+			const Allocation &allocation = it->second;
+			m_heaps[allocation.heapIndex].allocated -= allocation.size;
+
+			MemoryCategoryTelemetry &telemetry = m_categories[allocation.category];
+			telemetry.liveAllocations--;
+			telemetry.liveBytes -= allocation.size;
+
+			m_allocations.erase(it);
+		}
+
+		void VlkMemoryTracker::CheckPressure(const uint32_t heapIndex, const uint64_t additionalBytes) {
+
+			if (m_evicting.exchange(true)) {
+				return;
+			}
+
+			std::vector<MemoryPressure> pressures;
+			std::vector<MemoryEvictionCallback> callbacks;
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				for (uint32_t i = 0; i < m_heaps.size() && m_evictionCallbacks.size(); i++) {
+
+					const uint64_t usage = GetHeapUsage(m_heaps[i]) + (i == heapIndex ? additionalBytes : 0u);
+					const uint64_t softLimit = GetSoftLimit(m_heaps[i]);
+
+					if (usage > softLimit) {
+						MemoryPressure pressure;
+						pressure.heapIndex = i;
+						pressure.usage = usage;
+						pressure.softLimit = softLimit;
+						pressure.bytesOverLimit = usage - softLimit;
+						pressures.push_back(pressure);
+					}
+				}
+
+				if (pressures.size()) {
+					for (auto &callback : m_evictionCallbacks) {
+						callbacks.push_back(callback.second);
+					}
+				}
+			}
+
+			// Callbacks run unlocked so they can release memory
+			for (auto &pressure : pressures) {
+				for (auto &callback : callbacks) {
+					callback(pressure);
+				}
+			}
+
+			m_evicting = false;
+		}
+
+		MemoryTelemetry VlkMemoryTracker::GetTelemetry() const {
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			MemoryTelemetry telemetry;
+			telemetry.budgetSupported = m_budgetSupported;
+
+			for (uint32_t i = 0; i < m_heaps.size(); i++) {
+
+				const HeapState &heap = m_heaps[i];
+
+				MemoryHeapTelemetry heapTelemetry;
+				heapTelemetry.heapIndex = i;
+				heapTelemetry.deviceLocal = heap.deviceLocal;
+				heapTelemetry.size = heap.size;
+				heapTelemetry.budget = heap.budget;
+				heapTelemetry.usage = GetHeapUsage(heap);
+				heapTelemetry.allocatedBytes = heap.allocated;
+				heapTelemetry.peakAllocatedBytes = heap.peakAllocated;
+				heapTelemetry.softLimit = GetSoftLimit(heap);
+				telemetry.heaps.push_back(heapTelemetry);
+			}
+
+			std::copy(std::begin(m_categories), std::end(m_categories), std::begin(telemetry.categories));
+
+			return telemetry;
+		}
+
+		void VlkMemoryTracker::SetSoftLimit(const float budgetFraction) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_softLimitFraction = std::clamp(budgetFraction, 0.0f, 1.0f);
+		}
+
+		uint32_t VlkMemoryTracker::AddEvictionCallback(MemoryEvictionCallback callback) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_evictionCallbacks.emplace_back(m_nextCallbackId, std::move(callback));
+			return m_nextCallbackId++;
+		}
+
+		void VlkMemoryTracker::RemoveEvictionCallback(const uint32_t id) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_evictionCallbacks.erase(
+				std::remove_if(m_evictionCallbacks.begin(), m_evictionCallbacks.end(), [id](const auto &entry) { return entry.first == id; }),
+				m_evictionCallbacks.end());
+		}
+	}
+}
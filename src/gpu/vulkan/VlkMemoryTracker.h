@@ -0,0 +1,75 @@
+#ifndef VLK_MEMORY_TRACKER_H_
+#define VLK_MEMORY_TRACKER_H_
+
+#include <RenderContext.h>
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		/// <summary>
+		/// Accounts the device memory allocated through VlkDevice per heap and category,
+		/// keeps the heap budgets of VK_EXT_memory_budget and raises memory pressure
+		/// through eviction callbacks once a heap crosses its soft limit.
+		/// </summary>
+		class VlkMemoryTracker {
+		public:
+			VlkMemoryTracker() = default;
+
+			void Initialize(VkPhysicalDevice physicalDevice, const VkPhysicalDeviceMemoryProperties &properties, const bool budgetSupported);
+			/* Refreshes heap budgets and usage - a no-op without VK_EXT_memory_budget */
+			void UpdateBudget();
+			void OnAllocate(VkDeviceMemory memory, const uint32_t heapIndex, const uint64_t size, const MemoryCategory category);
+			void OnFree(VkDeviceMemory memory);
+			/* Invokes the eviction callbacks for every heap above its soft limit, counting <additionalBytes> on <heapIndex> */
+			void CheckPressure(const uint32_t heapIndex = ~0u, const uint64_t additionalBytes = 0u);
+
+			MemoryTelemetry GetTelemetry() const;
+			void SetSoftLimit(const float budgetFraction);
+			uint32_t AddEvictionCallback(MemoryEvictionCallback callback);
+			void RemoveEvictionCallback(const uint32_t id);
+
+		private:
+			struct HeapState {
+				uint64_t size = 0;
+				bool deviceLocal = false;
+				uint64_t budget = 0;
+				// Process usage at the last budget query and own allocations at that time
+				uint64_t queriedUsage = 0;
+				uint64_t allocatedAtQuery = 0;
+				uint64_t allocated = 0;
+				uint64_t peakAllocated = 0;
+			};
+
+			struct Allocation {
+				uint32_t heapIndex = 0;
+				uint64_t size = 0;
+				MemoryCategory category = MemoryCategory::VertexBufferMemory;
+			};
+
+			/* Usage estimate between budget queries - caller holds the mutex */
+			uint64_t GetHeapUsage(const HeapState &heap) const;
+			uint64_t GetSoftLimit(const HeapState &heap) const;
+
+			mutable std::mutex m_mutex;
+			VkPhysicalDevice m_vkPhysicalDevice = VK_NULL_HANDLE;
+			bool m_budgetSupported = false;
+			float m_softLimitFraction = 0.9f;
+			std::vector<HeapState> m_heaps;
+			MemoryCategoryTelemetry m_categories[MemoryCategory::MemoryCategoryCount];
+			std::unordered_map<VkDeviceMemory, Allocation> m_allocations;
+			std::vector<std::pair<uint32_t, MemoryEvictionCallback>> m_evictionCallbacks;
+			uint32_t m_nextCallbackId = 1u;
+			// Allocations made by eviction callbacks must not raise pressure again
+			std::atomic<bool> m_evicting = false;
+		};
+	}
+}
+
+#endif // !VLK_MEMORY_TRACKER_H_
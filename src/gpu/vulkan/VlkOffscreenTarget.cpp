@@ -0,0 +1,98 @@
+#include <vulkan/VlkOffscreenTarget.h>
+#include <vulkan/VlkRenderContext.h>
+#include <vulkan/VlkDevice.h>
+
+#include <stdexcept>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		static VkDeviceMemory AllocateImageMemory(VkImage image) {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+
+			VkMemoryRequirements memoryRequirements = {};
+			vkGetImageMemoryRequirements(deviceP->GetHandle(), image, &memoryRequirements);
+
+			VkDeviceMemory memory = deviceP->AllocateMemory(memoryRequirements, { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT }, MemoryCategory::RenderTargetMemory);
+
+			if (memory) {
+				vkBindImageMemory(deviceP->GetHandle(), image, memory, 0);
+			}
+
+			return memory;
+		}
+
+		VlkOffscreenTarget::VlkOffscreenTarget(VkFormat format, VkExtent2D extent, const uint32_t imageCount)
+			: m_format(format), m_extent(extent) {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+			VkDevice device = deviceP->GetHandle();
+
+			VkImageCreateInfo imageInfo = {};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = m_format;
+			imageInfo.extent = { m_extent.width, m_extent.height, 1u };
+			imageInfo.mipLevels = 1u;
+			imageInfo.arrayLayers = 1u;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			VkImageViewCreateInfo imageViewInfo = {};
+			imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			imageViewInfo.format = m_format;
+			imageViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			imageViewInfo.subresourceRange.levelCount = 1u;
+			imageViewInfo.subresourceRange.layerCount = 1u;
+
+			m_images.resize(imageCount, VK_NULL_HANDLE);
+			m_memory.resize(imageCount, VK_NULL_HANDLE);
+			m_views.resize(imageCount, VK_NULL_HANDLE);
+
+			for (uint32_t i = 0; i < imageCount; i++) {
+
+				vkCreateImage(device, &imageInfo, deviceP->GetAllocationCallbacks(VlkHostAllocator::IMAGE), &m_images[i]);
+
+				if (!m_images[i]) {
+					throw new std::runtime_error("VlkOffscreenTarget creation failed - unable to create an image.");
+				}
+
+				m_memory[i] = AllocateImageMemory(m_images[i]);
+
+				if (!m_memory[i]) {
+					throw new std::runtime_error("VlkOffscreenTarget creation failed - unable to allocate image memory.");
+				}
+
+				imageViewInfo.image = m_images[i];
+				vkCreateImageView(device, &imageViewInfo, deviceP->GetAllocationCallbacks(VlkHostAllocator::IMAGE), &m_views[i]);
+
+				if (!m_views[i]) {
+					throw new std::runtime_error("VlkOffscreenTarget creation failed - unable to create an image view.");
+				}
+			}
+		}
+
+		VlkOffscreenTarget::~VlkOffscreenTarget() {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+			VkDevice device = deviceP->GetHandle();
+
+			for (uint32_t i = 0; i < m_images.size(); i++) {
+				if (m_views[i]) {
+					vkDestroyImageView(device, m_views[i], deviceP->GetAllocationCallbacks(VlkHostAllocator::IMAGE));
+				}
+				if (m_images[i]) {
+					vkDestroyImage(device, m_images[i], deviceP->GetAllocationCallbacks(VlkHostAllocator::IMAGE));
+				}
+				if (m_memory[i]) {
+					deviceP->FreeMemory(m_memory[i]);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,42 @@
+#ifndef VLK_OFFSCREEN_TARGET_H_
+#define VLK_OFFSCREEN_TARGET_H_
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+namespace PixelMachine {
+	namespace GPU {
+		/// <summary>
+		/// Color target used in place of a swapchain when rendering headless.
+		/// Holds one image per frame in flight so consecutive frames (and their
+		/// readback copies) never touch the same image.
+		/// </summary>
+		class VlkOffscreenTarget {
+		public:
+			VlkOffscreenTarget(
+				VkFormat format,
+				VkExtent2D extent,
+				const uint32_t imageCount);
+			~VlkOffscreenTarget();
+			VkImage GetVkImage(const uint32_t index) const { return m_images[index]; }
+			VkImageView GetVkImageView(const uint32_t index) const { return m_views[index]; }
+			VkExtent2D GetExtent() const { return m_extent; }
+			VkFormat GetFormat() const { return m_format; }
+			uint32_t GetImagesCount() const { return m_images.size(); }
+			/* Frame number of the last submission that rendered into this target */
+			uint64_t GetLastUsedFrame() const { return m_lastUsedFrame; }
+			void SetLastUsedFrame(const uint64_t frameNumber) { m_lastUsedFrame = frameNumber; }
+
+		private:
+			uint64_t m_lastUsedFrame = 0;
+			VkFormat m_format = VK_FORMAT_UNDEFINED;
+			VkExtent2D m_extent = {};
+			std::vector<VkImage> m_images;
+			std::vector<VkDeviceMemory> m_memory;
+			std::vector<VkImageView> m_views;
+		};
+	}
+}
+
+#endif // !VLK_OFFSCREEN_TARGET_H_
@@ -0,0 +1,330 @@
+#include <vulkan/VlkPipelineCache.h>
+#include <vulkan/VlkRenderContext.h>
+#include <vulkan/VlkDevice.h>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		template<typename T>
+		static void AppendKey(std::string &key, const T &value) {
+			key.append(reinterpret_cast<const char *>(&value), sizeof(T));
+		}
+
+		/* First topology of the class of <topology> - dynamic topology must stay within the class the pipeline was built for */
+		static VkPrimitiveTopology GetTopologyClass(const VkPrimitiveTopology topology) {
+			switch (topology)
+			{
+			case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+				return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+			case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+			case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+				return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+			default:
+				break;
+			}
+			return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		}
+
+		VlkPipelineCache::VlkPipelineCache() {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+
+			VkPipelineCacheCreateInfo cacheInfo = {};
+			cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+			// Lets the driver reuse compiled shader stages between variants - pipelines still work without it
+			vkCreatePipelineCache(deviceP->GetHandle(), &cacheInfo, deviceP->GetAllocationCallbacks(VlkHostAllocator::PIPELINE), &m_vkPipelineCache);
+		}
+
+		VlkPipelineCache::~VlkPipelineCache() {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+
+			std::vector<VkPipeline> pipelines = m_retiredPipelines;
+			pipelines.reserve(m_pipelines.size() + m_retiredPipelines.size());
+
+			for (auto &entry : m_pipelines) {
+				pipelines.push_back(entry.second);
+			}
+
+			// Frames in flight may still draw with the pipelines
+			deviceP->DeferRelease([deviceP, pipelines, pipelineCache = m_vkPipelineCache]() {
+				VkDevice device = deviceP->GetHandle();
+				for (auto pipeline : pipelines) {
+					vkDestroyPipeline(device, pipeline, deviceP->GetAllocationCallbacks(VlkHostAllocator::PIPELINE));
+				}
+				if (pipelineCache) {
+					vkDestroyPipelineCache(device, pipelineCache, deviceP->GetAllocationCallbacks(VlkHostAllocator::PIPELINE));
+				}
+			});
+		}
+
+		VlkRenderState VlkPipelineCache::GetPipelineState(const VlkRenderState &state) const {
+
+			const VlkDynamicStateSupport &support = VlkRenderContext::GetVlkDevice()->GetDynamicStateSupport();
+			const VlkRenderState defaults;
+
+			VlkRenderState pipelineState = state;
+
+			if (support.extendedDynamicState) {
+				pipelineState.topology = support.unrestrictedTopology ? defaults.topology : GetTopologyClass(state.topology);
+				pipelineState.cullMode = defaults.cullMode;
+				pipelineState.depthTest = defaults.depthTest;
+				pipelineState.depthWrite = defaults.depthWrite;
+			}
+
+			if (support.polygonMode) {
+				pipelineState.polygonMode = defaults.polygonMode;
+			}
+
+			if (support.rasterizationSamples) {
+				pipelineState.samples = defaults.samples;
+			}
+
+			return pipelineState;
+		}
+
+		std::string VlkPipelineCache::MakeKey(const VlkGraphicsPipelineDesc &desc, const VlkRenderState &pipelineState) const {
+
+			std::string key;
+			key.reserve(256u);
+
+			AppendKey(key, desc.colorFormat);
+			AppendKey(key, desc.depthFormat);
+			AppendKey(key, desc.depthOnly);
+			AppendKey(key, pipelineState.topology);
+			AppendKey(key, pipelineState.cullMode);
+			AppendKey(key, pipelineState.polygonMode);
+			AppendKey(key, pipelineState.samples);
+			AppendKey(key, pipelineState.depthTest);
+			AppendKey(key, pipelineState.depthWrite);
+
+			AppendKey(key, desc.stages.size());
+			for (auto &stage : desc.stages) {
+				AppendKey(key, stage.stage);
+				AppendKey(key, stage.module);
+				key.append(stage.pName);
+				key.push_back('\0');
+			}
+
+			AppendKey(key, desc.vertexBindings.size());
+			for (auto &binding : desc.vertexBindings) {
+				AppendKey(key, binding.binding);
+				AppendKey(key, binding.stride);
+				AppendKey(key, binding.inputRate);
+			}
+
+			AppendKey(key, desc.vertexAttributes.size());
+			for (auto &attribute : desc.vertexAttributes) {
+				AppendKey(key, attribute.location);
+				AppendKey(key, attribute.binding);
+				AppendKey(key, attribute.format);
+				AppendKey(key, attribute.offset);
+			}
+
+			AppendKey(key, desc.descriptorBindings.size());
+			for (auto &binding : desc.descriptorBindings) {
+				AppendKey(key, binding.binding);
+				AppendKey(key, binding.descriptorType);
+				AppendKey(key, binding.descriptorCount);
+				AppendKey(key, binding.stageFlags);
+			}
+
+			return key;
+		}
+
+		VkPipeline VlkPipelineCache::GetGraphicsPipeline(const VlkGraphicsPipelineDesc &desc) {
+
+			const VlkRenderState pipelineState = GetPipelineState(desc.renderState);
+			std::string key = MakeKey(desc, pipelineState);
+
+			auto it = m_pipelines.find(key);
+
+			if (it != m_pipelines.end()) {
+				m_reuseCount++;
+				return it->second;
+			}
+
+			VkPipeline pipeline = Compile(desc, pipelineState);
+
+			if (pipeline) {
+				m_compiledCount++;
+				for (auto &stage : desc.stages) {
+					m_moduleKeys[stage.module].push_back(key);
+				}
+				m_pipelines.emplace(std::move(key), pipeline);
+			}
+
+			return pipeline;
+		}
+
+		void VlkPipelineCache::ReleaseModule(VkShaderModule module, const std::unordered_set<VkPipeline> &inUse) {
+
+			auto found = m_moduleKeys.find(module);
+
+			if (found == m_moduleKeys.end()) {
+				return;
+			}
+
+			std::vector<VkPipeline> unused;
+
+			// Pipelines of several stages are listed under each of their modules - only the first release retires them
+			for (auto &key : found->second) {
+				auto it = m_pipelines.find(key);
+				if (it != m_pipelines.end()) {
+					if (inUse.count(it->second)) {
+						m_retiredPipelines.push_back(it->second);
+					}
+					else {
+						unused.push_back(it->second);
+					}
+					m_pipelines.erase(it);
+				}
+			}
+
+			m_moduleKeys.erase(found);
+
+			if (unused.empty()) {
+				return;
+			}
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+
+			// Frames in flight may still draw with the pipelines
+			deviceP->DeferRelease([deviceP, unused]() {
+				for (auto pipeline : unused) {
+					vkDestroyPipeline(deviceP->GetHandle(), pipeline, deviceP->GetAllocationCallbacks(VlkHostAllocator::PIPELINE));
+				}
+			});
+		}
+
+		VkPipeline VlkPipelineCache::Compile(const VlkGraphicsPipelineDesc &desc, const VlkRenderState &pipelineState) const {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+			const VlkDynamicStateSupport &support = deviceP->GetDynamicStateSupport();
+
+			VkPipelineVertexInputStateCreateInfo vertexInputStateInfo = {};
+			vertexInputStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+			vertexInputStateInfo.vertexBindingDescriptionCount = desc.vertexBindings.size();
+			vertexInputStateInfo.pVertexBindingDescriptions = desc.vertexBindings.data();
+			vertexInputStateInfo.vertexAttributeDescriptionCount = desc.vertexAttributes.size();
+			vertexInputStateInfo.pVertexAttributeDescriptions = desc.vertexAttributes.data();
+
+			VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo = {};
+			inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+			inputAssemblyInfo.topology = pipelineState.topology;
+			inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
+
+			VkPipelineViewportStateCreateInfo viewportInfo = {};
+			viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+
+			VkPipelineRasterizationStateCreateInfo rasterInfo = {};
+			rasterInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+			rasterInfo.depthClampEnable = VK_FALSE;
+			rasterInfo.rasterizerDiscardEnable = VK_FALSE;
+			rasterInfo.polygonMode = pipelineState.polygonMode;
+			rasterInfo.lineWidth = 1.0f;
+			rasterInfo.cullMode = pipelineState.cullMode;
+			rasterInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
+			rasterInfo.depthBiasEnable = VK_FALSE;
+			rasterInfo.depthBiasConstantFactor = 0.0f;
+			rasterInfo.depthBiasClamp = 0.0f;
+			rasterInfo.depthBiasSlopeFactor = 0.0f;
+
+			VkPipelineMultisampleStateCreateInfo multisamplingInfo = {};
+			multisamplingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+			multisamplingInfo.sampleShadingEnable = VK_FALSE;
+			multisamplingInfo.rasterizationSamples = pipelineState.samples;
+			multisamplingInfo.minSampleShading = 1.0f;
+			multisamplingInfo.pSampleMask = nullptr;
+			multisamplingInfo.alphaToCoverageEnable = VK_FALSE;
+			multisamplingInfo.alphaToOneEnable = VK_FALSE;
+
+			// Ignored while rendering without a depth attachment
+			VkPipelineDepthStencilStateCreateInfo depthStencilInfo = {};
+			depthStencilInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+			depthStencilInfo.depthTestEnable = pipelineState.depthTest;
+			depthStencilInfo.depthWriteEnable = pipelineState.depthWrite;
+			depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+			depthStencilInfo.depthBoundsTestEnable = VK_FALSE;
+			depthStencilInfo.stencilTestEnable = VK_FALSE;
+
+			VkPipelineColorBlendAttachmentState colorBlendAttchState = {};
+			// Without a fragment stage color outputs are undefined, they must not be written
+			colorBlendAttchState.colorWriteMask = desc.depthOnly ? 0 : VK_COLOR_COMPONENT_R_BIT |
+				VK_COLOR_COMPONENT_G_BIT |
+				VK_COLOR_COMPONENT_B_BIT |
+				VK_COLOR_COMPONENT_A_BIT;
+			colorBlendAttchState.blendEnable = VK_FALSE;
+			colorBlendAttchState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+			colorBlendAttchState.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+			colorBlendAttchState.colorBlendOp = VK_BLEND_OP_ADD;
+			colorBlendAttchState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+			colorBlendAttchState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+			colorBlendAttchState.alphaBlendOp = VK_BLEND_OP_ADD;
+
+			VkPipelineColorBlendStateCreateInfo colorBlendInfo = {};
+			colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+			colorBlendInfo.logicOpEnable = VK_FALSE;
+			colorBlendInfo.attachmentCount = 1;
+			colorBlendInfo.pAttachments = &colorBlendAttchState;
+
+			std::vector<VkDynamicState> dynamicStates = {
+				VK_DYNAMIC_STATE_LINE_WIDTH,
+				VK_DYNAMIC_STATE_VIEWPORT_WITH_COUNT,
+				VK_DYNAMIC_STATE_SCISSOR_WITH_COUNT
+			};
+
+			if (support.extendedDynamicState) {
+				dynamicStates.insert(dynamicStates.end(), {
+					VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY,
+					VK_DYNAMIC_STATE_CULL_MODE,
+					VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE,
+					VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE });
+			}
+
+			if (support.polygonMode) {
+				dynamicStates.push_back(VK_DYNAMIC_STATE_POLYGON_MODE_EXT);
+			}
+
+			if (support.rasterizationSamples) {
+				dynamicStates.push_back(VK_DYNAMIC_STATE_RASTERIZATION_SAMPLES_EXT);
+			}
+
+			VkPipelineDynamicStateCreateInfo dynamicStateInfo = {};
+			dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+			dynamicStateInfo.dynamicStateCount = dynamicStates.size();
+			dynamicStateInfo.pDynamicStates = dynamicStates.data();
+
+			VkPipelineRenderingCreateInfo renderingInfo = {};
+			renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+			renderingInfo.colorAttachmentCount = 1u;
+			renderingInfo.pColorAttachmentFormats = &desc.colorFormat;
+			renderingInfo.depthAttachmentFormat = desc.depthFormat;
+
+			VkGraphicsPipelineCreateInfo pipelineInfo = {};
+			pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+			pipelineInfo.pNext = &renderingInfo;
+			pipelineInfo.stageCount = desc.stages.size();
+			pipelineInfo.pStages = desc.stages.data();
+			pipelineInfo.pVertexInputState = &vertexInputStateInfo;
+			pipelineInfo.pInputAssemblyState = &inputAssemblyInfo;
+			pipelineInfo.pViewportState = &viewportInfo;
+			pipelineInfo.pRasterizationState = &rasterInfo;
+			pipelineInfo.pMultisampleState = &multisamplingInfo;
+			pipelineInfo.pDepthStencilState = &depthStencilInfo;
+			pipelineInfo.pColorBlendState = &colorBlendInfo;
+			pipelineInfo.pDynamicState = &dynamicStateInfo;
+			pipelineInfo.layout = desc.pipelineLayout;
+			pipelineInfo.renderPass = VK_NULL_HANDLE;
+			pipelineInfo.subpass = 0;
+			pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+			pipelineInfo.basePipelineIndex = -1;
+
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			vkCreateGraphicsPipelines(deviceP->GetHandle(), m_vkPipelineCache, 1, &pipelineInfo, deviceP->GetAllocationCallbacks(VlkHostAllocator::PIPELINE), &pipeline);
+
+			return pipeline;
+		}
+	}
+}
@@ -0,0 +1,82 @@
+#ifndef VLK_PIPELINE_CACHE_H_
+#define VLK_PIPELINE_CACHE_H_
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace PixelMachine {
+	namespace GPU {
+		/* Fixed function state of a graphics pass - line width and viewport are always dynamic */
+		struct VlkRenderState {
+			VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+			VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+			VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+			VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+			// Depth test passing nearer or equal fragments, and depth write - off for draws after their depth pre-pass
+			bool depthTest = false;
+			bool depthWrite = false;
+		};
+
+		/* Everything a graphics pipeline is built from */
+		struct VlkGraphicsPipelineDesc {
+			std::vector<VkPipelineShaderStageCreateInfo> stages;
+			std::vector<VkVertexInputBindingDescription> vertexBindings;
+			std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+			// Bindings of descriptor set 0 - passes with identically defined layouts can share a pipeline
+			std::vector<VkDescriptorSetLayoutBinding> descriptorBindings;
+			VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+			// Dynamic rendering - the pipeline draws into any target of this format
+			VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+			VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+			// Depth pre-pass - color writes masked off, usually drawn with the vertex stage alone
+			bool depthOnly = false;
+			VlkRenderState renderState;
+		};
+
+		/// <summary>
+		/// Graphics pipelines shared between passes. Render state the device sets dynamically is
+		/// left out of the match, so passes differing only in it get the same pipeline - without
+		/// extended dynamic state every combination is compiled as a pipeline variant of its own.
+		/// </summary>
+		class VlkPipelineCache {
+		public:
+			VlkPipelineCache();
+			VlkPipelineCache(const VlkPipelineCache &) = delete;
+			VlkPipelineCache &operator=(const VlkPipelineCache &) = delete;
+			~VlkPipelineCache();
+
+			/* Pipeline drawing <desc>, compiled on first request. Returns VK_NULL_HANDLE on failure */
+			VkPipeline GetGraphicsPipeline(const VlkGraphicsPipelineDesc &desc);
+			/* <state> as baked into pipelines - states the device sets while recording are reset to defaults */
+			VlkRenderState GetPipelineState(const VlkRenderState &state) const;
+			/* Drops the pipelines built from <module> from the match before it is destroyed - a new module reusing
+			 the handle value must not find them. Dropped pipelines outside <inUse>, the ones passes draw with, are
+			 destroyed once the frames in flight are done with them - the others stay with their passes until the
+			 cache is destroyed */
+			void ReleaseModule(VkShaderModule module, const std::unordered_set<VkPipeline> &inUse);
+
+			uint64_t GetCompiledCount() const { return m_compiledCount; }
+			uint64_t GetReuseCount() const { return m_reuseCount; }
+
+		private:
+			std::string MakeKey(const VlkGraphicsPipelineDesc &desc, const VlkRenderState &pipelineState) const;
+			VkPipeline Compile(const VlkGraphicsPipelineDesc &desc, const VlkRenderState &pipelineState) const;
+
+			VkPipelineCache m_vkPipelineCache = VK_NULL_HANDLE;
+			std::unordered_map<std::string, VkPipeline> m_pipelines;
+			// Keys of the pipelines built from each shader module
+			std::unordered_map<VkShaderModule, std::vector<std::string>> m_moduleKeys;
+			// Pipelines of released modules, no longer matched but still drawn with by passes
+			std::vector<VkPipeline> m_retiredPipelines;
+			uint64_t m_compiledCount = 0;
+			uint64_t m_reuseCount = 0;
+		};
+	}
+}
+
+#endif // !VLK_PIPELINE_CACHE_H_
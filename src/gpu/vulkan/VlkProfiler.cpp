@@ -0,0 +1,455 @@
+#include <vulkan/VlkProfiler.h>
+#include <vulkan/VlkRenderContext.h>
+#include <vulkan/VlkDevice.h>
+
+#include <cstdio>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		static void WriteJsonString(std::FILE *fileP, const std::string &text) {
+
+			std::fputc('"', fileP);
+
+			for (char c : text) {
+				if (c == '"' || c == '\\') {
+					std::fputc('\\', fileP);
+				}
+				std::fputc(static_cast<unsigned char>(c) < 0x20 ? ' ' : c, fileP);
+			}
+
+			std::fputc('"', fileP);
+		}
+
+		// Results are written in flag bit order - see ResolveScopeQueries
+		static constexpr VkQueryPipelineStatisticFlags s_pipelineStatistics =
+			VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+		VlkProfiler::VlkProfiler(const uint32_t frameSlots) : m_epoch(std::chrono::steady_clock::now()), m_frames(frameSlots) {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+			VlkAdapter adapter = deviceP->GetActiveAdapter();
+			const VkPhysicalDeviceFeatures &features = deviceP->GetEnabledFeatures();
+
+			// Without the precise feature occlusion results are only guaranteed to be zero or non-zero
+			m_occlusionControl = features.occlusionQueryPrecise ? VK_QUERY_CONTROL_PRECISE_BIT : 0u;
+
+			for (auto &frame : m_frames) {
+				frame.m_vkOcclusionPool = CreateQueryPool(VK_QUERY_TYPE_OCCLUSION, sm_maxScopesPerFrame, 0u);
+				if (features.pipelineStatisticsQuery) {
+					frame.m_vkStatisticsPool = CreateQueryPool(VK_QUERY_TYPE_PIPELINE_STATISTICS, sm_maxScopesPerFrame, s_pipelineStatistics);
+				}
+			}
+
+			const uint32_t validBits = adapter.GetQueueFamilyInfo(deviceP->GetActiveQueue().second).timestampValidBits;
+
+			// Queues without valid bits cannot write timestamps - only CPU scopes are recorded then
+			if (!validBits) {
+				return;
+			}
+
+			m_timestampPeriod = adapter.GetProperties().limits.timestampPeriod;
+			m_timestampMask = validBits >= 64u ? ~0ull : (1ull << validBits) - 1ull;
+
+			for (auto &frame : m_frames) {
+				frame.m_vkQueryPool = CreateTimestampPool(sm_maxScopesPerFrame * 2u);
+			}
+		}
+
+		VlkProfiler::~VlkProfiler() {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+			VkDevice device = deviceP->GetHandle();
+
+			for (auto &frame : m_frames) {
+				for (VkQueryPool pool : { frame.m_vkQueryPool, frame.m_vkStatisticsPool, frame.m_vkOcclusionPool }) {
+					if (pool) {
+						vkDestroyQueryPool(device, pool, deviceP->GetAllocationCallbacks(VlkHostAllocator::QUERY_POOL));
+					}
+				}
+			}
+		}
+
+		VkQueryPool VlkProfiler::CreateQueryPool(const VkQueryType type, const uint32_t count, const VkQueryPipelineStatisticFlags statistics) const {
+
+			VkQueryPoolCreateInfo queryPoolInfo = {};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = type;
+			queryPoolInfo.queryCount = count;
+			queryPoolInfo.pipelineStatistics = statistics;
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			vkCreateQueryPool(deviceP->GetHandle(), &queryPoolInfo, deviceP->GetAllocationCallbacks(VlkHostAllocator::QUERY_POOL), &queryPool);
+
+			return queryPool;
+		}
+
+		VkQueryPool VlkProfiler::CreateTimestampPool(const uint32_t count) const {
+
+			if (!TimestampsSupported()) {
+				return VK_NULL_HANDLE;
+			}
+
+			return CreateQueryPool(VK_QUERY_TYPE_TIMESTAMP, count, 0u);
+		}
+
+		void VlkProfiler::BeginFrame(const uint32_t slot, VkCommandBuffer commandBuffer, const uint64_t frameNumber) {
+
+			ResolveFrame(slot);
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_currentFrame = frameNumber;
+			}
+
+			FrameQueries &frame = m_frames[slot];
+			frame.m_scopes.clear();
+			frame.m_queryCount = 0u;
+			frame.m_frameNumber = frameNumber;
+			frame.m_timestamps = m_enabled && frame.m_vkQueryPool;
+			frame.m_queries = m_queriesEnabled && (frame.m_vkStatisticsPool || frame.m_vkOcclusionPool);
+			frame.m_pending = frame.m_timestamps || frame.m_queries;
+
+			if (frame.m_timestamps) {
+				vkCmdResetQueryPool(commandBuffer, frame.m_vkQueryPool, 0u, sm_maxScopesPerFrame * 2u);
+			}
+
+			if (frame.m_queries) {
+				for (VkQueryPool pool : { frame.m_vkStatisticsPool, frame.m_vkOcclusionPool }) {
+					if (pool) {
+						vkCmdResetQueryPool(commandBuffer, pool, 0u, sm_maxScopesPerFrame);
+					}
+				}
+			}
+		}
+
+		void VlkProfiler::ResolveFrame(const uint32_t slot) {
+
+			FrameQueries &frame = m_frames[slot];
+
+			if (!frame.m_pending) {
+				return;
+			}
+
+			frame.m_pending = false;
+
+			if (frame.m_scopes.empty()) {
+				return;
+			}
+
+			uint64_t timestamps[sm_maxScopesPerFrame * 2u] = {};
+
+			// No wait flag - the frame fence has already been waited on, so results are available
+			const bool timestampsValid = frame.m_timestamps && vkGetQueryPoolResults(
+				VlkRenderContext::GetVlkDevice()->GetHandle(),
+				frame.m_vkQueryPool,
+				0u,
+				frame.m_queryCount,
+				sizeof(timestamps),
+				timestamps,
+				sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+
+			for (uint32_t i = 0; i < frame.m_scopes.size(); i++) {
+
+				const GpuScope &scope = frame.m_scopes[i];
+
+				ProfileEvent event;
+				event.name = scope.m_name;
+				event.track = ProfileTrack::GPU;
+				event.frameNumber = frame.m_frameNumber;
+
+				if (timestampsValid) {
+					const uint64_t begin = timestamps[scope.m_firstQuery] & m_timestampMask;
+					const uint64_t end = timestamps[scope.m_firstQuery + 1u] & m_timestampMask;
+					event.startUs = ToCpuTime(begin, frame.m_submitTimeUs);
+					event.durationUs = ((end - begin) & m_timestampMask) * m_timestampPeriod / 1000.0;
+				}
+				else {
+					event.startUs = frame.m_submitTimeUs;
+				}
+
+				if (scope.m_queried) {
+					ResolveScopeQueries(frame, i, event.counters);
+				}
+
+				if (timestampsValid || event.counters.hasStatistics || event.counters.hasOcclusion) {
+					AddEvent(std::move(event));
+				}
+			}
+		}
+
+		void VlkProfiler::ResolveScopeQueries(const FrameQueries &frame, const uint32_t scope, PassCounters &outCounters) const {
+
+			VkDevice device = VlkRenderContext::GetVlkDevice()->GetHandle();
+
+			if (frame.m_vkStatisticsPool) {
+				uint64_t statistics[3] = {};
+				if (vkGetQueryPoolResults(device, frame.m_vkStatisticsPool, scope, 1u, sizeof(statistics), statistics, sizeof(statistics), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+					outCounters.hasStatistics = true;
+					outCounters.vertexInvocations = statistics[0];
+					outCounters.clippingPrimitives = statistics[1];
+					outCounters.fragmentInvocations = statistics[2];
+				}
+			}
+
+			if (frame.m_vkOcclusionPool) {
+				uint64_t samplesPassed = 0u;
+				if (vkGetQueryPoolResults(device, frame.m_vkOcclusionPool, scope, 1u, sizeof(samplesPassed), &samplesPassed, sizeof(samplesPassed), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+					outCounters.hasOcclusion = true;
+					outCounters.samplesPassed = samplesPassed;
+				}
+			}
+		}
+
+		void VlkProfiler::MarkSubmit(const uint32_t slot) {
+			m_frames[slot].m_submitTimeUs = GetTimeUs();
+		}
+
+		int32_t VlkProfiler::BeginGpuScope(const uint32_t slot, VkCommandBuffer commandBuffer, const std::string &name) {
+
+			FrameQueries &frame = m_frames[slot];
+
+			if (!frame.m_pending || frame.m_scopes.size() >= sm_maxScopesPerFrame) {
+				return -1;
+			}
+
+			GpuScope scope;
+			scope.m_name = name;
+			scope.m_firstQuery = frame.m_queryCount;
+			frame.m_queryCount += 2u;
+			frame.m_scopes.push_back(scope);
+
+			if (frame.m_timestamps) {
+				vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.m_vkQueryPool, scope.m_firstQuery);
+			}
+
+			return frame.m_scopes.size() - 1;
+		}
+
+		void VlkProfiler::EndGpuScope(const uint32_t slot, VkCommandBuffer commandBuffer, const int32_t scope) {
+
+			if (scope < 0) {
+				return;
+			}
+
+			FrameQueries &frame = m_frames[slot];
+
+			if (frame.m_timestamps) {
+				vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.m_vkQueryPool, frame.m_scopes[scope].m_firstQuery + 1u);
+			}
+		}
+
+		void VlkProfiler::BeginScopeQueries(const uint32_t slot, VkCommandBuffer commandBuffer, const int32_t scope) {
+
+			FrameQueries &frame = m_frames[slot];
+
+			if (scope < 0 || !frame.m_queries) {
+				return;
+			}
+
+			if (frame.m_vkStatisticsPool) {
+				vkCmdBeginQuery(commandBuffer, frame.m_vkStatisticsPool, scope, 0u);
+			}
+			if (frame.m_vkOcclusionPool) {
+				vkCmdBeginQuery(commandBuffer, frame.m_vkOcclusionPool, scope, m_occlusionControl);
+			}
+
+			frame.m_scopes[scope].m_queried = true;
+		}
+
+		void VlkProfiler::EndScopeQueries(const uint32_t slot, VkCommandBuffer commandBuffer, const int32_t scope) {
+
+			FrameQueries &frame = m_frames[slot];
+
+			if (scope < 0 || !frame.m_scopes[scope].m_queried) {
+				return;
+			}
+
+			if (frame.m_vkStatisticsPool) {
+				vkCmdEndQuery(commandBuffer, frame.m_vkStatisticsPool, scope);
+			}
+			if (frame.m_vkOcclusionPool) {
+				vkCmdEndQuery(commandBuffer, frame.m_vkOcclusionPool, scope);
+			}
+		}
+
+		void VlkProfiler::ResolveUpload(VkQueryPool pool, const double submitTimeUs) {
+
+			if (!m_enabled || !pool) {
+				return;
+			}
+
+			uint64_t timestamps[2] = {};
+
+			// Skipped rather than waited for if the copy has not finished yet
+			VkResult result = vkGetQueryPoolResults(
+				VlkRenderContext::GetVlkDevice()->GetHandle(),
+				pool,
+				0u,
+				2u,
+				sizeof(timestamps),
+				timestamps,
+				sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT);
+
+			if (result != VK_SUCCESS) {
+				return;
+			}
+
+			const uint64_t begin = timestamps[0] & m_timestampMask;
+			const uint64_t end = timestamps[1] & m_timestampMask;
+
+			ProfileEvent event;
+			event.name = "Upload";
+			event.track = ProfileTrack::GPU;
+			event.startUs = ToCpuTime(begin, submitTimeUs);
+			event.durationUs = ((end - begin) & m_timestampMask) * m_timestampPeriod / 1000.0;
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				event.frameNumber = m_currentFrame;
+			}
+
+			AddEvent(std::move(event));
+		}
+
+		double VlkProfiler::ToCpuTime(const uint64_t timestamp, const double submitTimeUs) {
+
+			if (!m_gpuAnchored) {
+				m_gpuBaseTimestamp = timestamp;
+			}
+
+			const int64_t ticks = static_cast<int64_t>((timestamp - m_gpuBaseTimestamp) & m_timestampMask);
+			const double gpuUs = ticks * m_timestampPeriod / 1000.0;
+
+			// Work cannot start before it was submitted - pull the GPU clock forward when it would
+			if (!m_gpuAnchored || gpuUs + m_gpuOffsetUs < submitTimeUs) {
+				m_gpuOffsetUs = submitTimeUs - gpuUs;
+				m_gpuAnchored = true;
+			}
+
+			return gpuUs + m_gpuOffsetUs;
+		}
+
+		void VlkProfiler::AddCpuEvent(const char *name, const double startUs, const double endUs) {
+
+			ProfileEvent event;
+			event.name = name;
+			event.track = ProfileTrack::CPU;
+			event.startUs = startUs;
+			event.durationUs = endUs - startUs;
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				event.threadIndex = GetThreadIndex();
+				event.frameNumber = m_currentFrame;
+			}
+
+			AddEvent(std::move(event));
+		}
+
+		void VlkProfiler::AddEvent(ProfileEvent &&event) {
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_history.push_back(std::move(event));
+
+			if (m_history.size() > sm_historyCapacity) {
+				m_history.pop_front();
+			}
+		}
+
+		uint32_t VlkProfiler::GetThreadIndex() {
+			return m_threadIndices.emplace(std::this_thread::get_id(), m_threadIndices.size()).first->second;
+		}
+
+		double VlkProfiler::GetTimeUs() const {
+			return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_epoch).count();
+		}
+
+		void VlkProfiler::GetHistory(std::vector<ProfileEvent> &outEvents) const {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			outEvents.assign(m_history.begin(), m_history.end());
+		}
+
+		void VlkProfiler::TakeHistory(std::vector<ProfileEvent> &outEvents) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			outEvents.insert(outEvents.end(), std::make_move_iterator(m_history.begin()), std::make_move_iterator(m_history.end()));
+			m_history.clear();
+		}
+
+		bool VlkProfiler::WriteTrace(const std::string &path) const {
+
+			std::vector<ProfileEvent> events;
+			GetHistory(events);
+
+			std::FILE *fileP = std::fopen(path.c_str(), "wb");
+
+			if (!fileP) {
+				return false;
+			}
+
+			std::fprintf(fileP, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+			std::fprintf(fileP, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+			std::fprintf(fileP, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"GPU\"}}");
+
+			for (auto &event : events) {
+
+				std::fprintf(fileP, ",\n{\"name\":");
+				WriteJsonString(fileP, event.name);
+				std::fprintf(fileP, ",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu",
+					event.track == ProfileTrack::GPU ? 2u : 1u,
+					event.threadIndex,
+					event.startUs,
+					event.durationUs,
+					static_cast<unsigned long long>(event.frameNumber));
+
+				const PassCounters &counters = event.counters;
+
+				if (counters.hasStatistics) {
+					std::fprintf(fileP, ",\"vertexInvocations\":%llu,\"clippingPrimitives\":%llu,\"fragmentInvocations\":%llu",
+						static_cast<unsigned long long>(counters.vertexInvocations),
+						static_cast<unsigned long long>(counters.clippingPrimitives),
+						static_cast<unsigned long long>(counters.fragmentInvocations));
+				}
+				if (counters.hasOcclusion) {
+					std::fprintf(fileP, ",\"samplesPassed\":%llu", static_cast<unsigned long long>(counters.samplesPassed));
+				}
+				std::fprintf(fileP, "}}");
+
+				// Counter tracks graph the per-pass values over time
+				if (counters.hasStatistics || counters.hasOcclusion) {
+					std::fprintf(fileP, ",\n{\"name\":");
+					WriteJsonString(fileP, event.name + " counters");
+					std::fprintf(fileP, ",\"ph\":\"C\",\"pid\":2,\"ts\":%.3f,\"args\":{\"fragmentInvocations\":%llu,\"samplesPassed\":%llu}}",
+						event.startUs,
+						static_cast<unsigned long long>(counters.fragmentInvocations),
+						static_cast<unsigned long long>(counters.samplesPassed));
+				}
+			}
+
+			std::fprintf(fileP, "\n]}\n");
+
+			return std::fclose(fileP) == 0;
+		}
+
+		VlkCpuScope::VlkCpuScope(VlkProfiler *profilerP, const char *name) {
+			if (profilerP && profilerP->IsEnabled()) {
+				m_profilerP = profilerP;
+				m_name = name;
+				m_startUs = profilerP->GetTimeUs();
+			}
+		}
+
+		VlkCpuScope::~VlkCpuScope() {
+			if (m_profilerP) {
+				m_profilerP->AddCpuEvent(m_name, m_startUs, m_profilerP->GetTimeUs());
+			}
+		}
+	}
+}
@@ -0,0 +1,127 @@
+#ifndef VLK_PROFILER_H_
+#define VLK_PROFILER_H_
+
+#include <RenderContext.h>
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace PixelMachine {
+	namespace GPU {
+		/// <summary>
+		/// CPU/GPU frame profiler. GPU scopes are timestamp queries written into
+		/// a query pool per frame in flight; a pool is only read back once the
+		/// fence of its frame has been waited on, so collecting results never
+		/// stalls the queue. GPU ticks are mapped onto the CPU clock by anchoring
+		/// each frame to its submission time. Pipeline statistics and occlusion
+		/// queries share the scopes and the collection path of the timestamps -
+		/// the render context opens a queried scope per pass.
+		/// </summary>
+		class VlkProfiler {
+		public:
+			VlkProfiler(const uint32_t frameSlots);
+			~VlkProfiler();
+			void SetEnabled(const bool enabled) { m_enabled = enabled; }
+			bool IsEnabled() const { return m_enabled; }
+			bool TimestampsSupported() const { return m_timestampPeriod > 0.0; }
+			void SetQueriesEnabled(const bool enabled) { m_queriesEnabled = enabled; }
+			/* Collects the queries of <slot> (its frame must be complete) and resets them in <commandBuffer> */
+			void BeginFrame(const uint32_t slot, VkCommandBuffer commandBuffer, const uint64_t frameNumber);
+			/* Reads back the results of <slot> if its frame was profiled - the frame must be complete */
+			void ResolveFrame(const uint32_t slot);
+			/* Records the CPU time the frame of <slot> was handed to the queue */
+			void MarkSubmit(const uint32_t slot);
+			/* Returns the scope index to pass to EndGpuScope, -1 when not profiling */
+			int32_t BeginGpuScope(const uint32_t slot, VkCommandBuffer commandBuffer, const std::string &name);
+			void EndGpuScope(const uint32_t slot, VkCommandBuffer commandBuffer, const int32_t scope);
+			/* Pipeline statistics and occlusion queries of <scope> - must be begun and ended inside the same subpass */
+			void BeginScopeQueries(const uint32_t slot, VkCommandBuffer commandBuffer, const int32_t scope);
+			void EndScopeQueries(const uint32_t slot, VkCommandBuffer commandBuffer, const int32_t scope);
+			/* Query pool with <count> timestamps for command buffers recorded outside of a frame */
+			VkQueryPool CreateTimestampPool(const uint32_t count) const;
+			/* Reads back a begin/end timestamp pair of an upload submitted at <submitTimeUs> */
+			void ResolveUpload(VkQueryPool pool, const double submitTimeUs);
+			void AddCpuEvent(const char *name, const double startUs, const double endUs);
+			/* Microseconds since the profiler was created */
+			double GetTimeUs() const;
+			void GetHistory(std::vector<ProfileEvent> &outEvents) const;
+			void TakeHistory(std::vector<ProfileEvent> &outEvents);
+			bool WriteTrace(const std::string &path) const;
+
+		private:
+			struct GpuScope {
+				std::string m_name;
+				uint32_t m_firstQuery = 0;
+				bool m_queried = false;
+			};
+
+			struct FrameQueries {
+				VkQueryPool m_vkQueryPool = VK_NULL_HANDLE;
+				// One statistics and one occlusion query per scope, indexed like the scopes
+				VkQueryPool m_vkStatisticsPool = VK_NULL_HANDLE;
+				VkQueryPool m_vkOcclusionPool = VK_NULL_HANDLE;
+				std::vector<GpuScope> m_scopes;
+				uint32_t m_queryCount = 0;
+				uint64_t m_frameNumber = 0;
+				double m_submitTimeUs = 0.0;
+				bool m_pending = false;
+				bool m_timestamps = false;
+				bool m_queries = false;
+			};
+
+			VkQueryPool CreateQueryPool(const VkQueryType type, const uint32_t count, const VkQueryPipelineStatisticFlags statistics) const;
+			void ResolveScopeQueries(const FrameQueries &frame, const uint32_t scope, PassCounters &outCounters) const;
+
+			/* Converts a timestamp to CPU microseconds, re-anchoring when the GPU would appear to run before <submitTimeUs> */
+			double ToCpuTime(const uint64_t timestamp, const double submitTimeUs);
+			void AddEvent(ProfileEvent &&event);
+			uint32_t GetThreadIndex();
+
+			// Queued draws take a scope per pass they draw
+			static constexpr uint32_t sm_maxScopesPerFrame = 256u;
+			static constexpr size_t sm_historyCapacity = 16384u;
+
+			std::atomic<bool> m_enabled = false;
+			bool m_queriesEnabled = false;
+			VkQueryControlFlags m_occlusionControl = 0;
+			double m_timestampPeriod = 0.0;
+			uint64_t m_timestampMask = ~0ull;
+			uint64_t m_gpuBaseTimestamp = 0;
+			double m_gpuOffsetUs = 0.0;
+			bool m_gpuAnchored = false;
+			uint64_t m_currentFrame = 0;
+			std::chrono::steady_clock::time_point m_epoch;
+			std::vector<FrameQueries> m_frames;
+
+			// CPU scopes may close on any thread
+			mutable std::mutex m_mutex;
+			std::deque<ProfileEvent> m_history;
+			std::map<std::thread::id, uint32_t> m_threadIndices;
+		};
+
+		/// <summary>
+		/// Adds a CPU event covering its own lifetime - does nothing when the
+		/// profiler is missing or disabled.
+		/// </summary>
+		class VlkCpuScope {
+		public:
+			VlkCpuScope(VlkProfiler *profilerP, const char *name);
+			~VlkCpuScope();
+
+		private:
+			VlkProfiler *m_profilerP = nullptr;
+			const char *m_name = nullptr;
+			double m_startUs = 0.0;
+		};
+	}
+}
+
+#endif // !VLK_PROFILER_H_
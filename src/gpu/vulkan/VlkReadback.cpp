@@ -0,0 +1,198 @@
+#include <vulkan/VlkReadback.h>
+#include <vulkan/VlkRenderContext.h>
+#include <vulkan/VlkDevice.h>
+#include <vulkan/VlkBuffer.h>
+
+#include <stdexcept>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		static FramePixelFormat GetFramePixelFormat(VkFormat format) {
+			switch (format)
+			{
+			case VK_FORMAT_B8G8R8A8_SRGB:
+			case VK_FORMAT_B8G8R8A8_UNORM:	return FramePixelFormat::BGRA8;
+			default: break;
+			}
+			return FramePixelFormat::RGBA8;
+		}
+
+		VlkReadback::VlkReadback(const uint32_t slotCount) : m_slots(slotCount) {
+			if (!slotCount) {
+				throw new std::runtime_error("VlkReadback creation failed - at least one slot required.");
+			}
+		}
+
+		VlkReadback::~VlkReadback() {
+
+			VkDevice device = VlkRenderContext::GetVlkDevice()->GetHandle();
+
+			for (auto &slot : m_slots) {
+				if (slot.m_mappedDataP) {
+					vkUnmapMemory(device, slot.m_vkMemory);
+				}
+				if (slot.m_vkBuffer) {
+					ReleaseVkBuffer(slot.m_vkBuffer, slot.m_vkMemory);
+				}
+			}
+		}
+
+		bool VlkReadback::Request(ReadbackCallback callback) {
+
+			if (IsRequested() || !callback) {
+				return false;
+			}
+
+			for (int32_t i = 0; i < m_slots.size(); i++) {
+				if (m_slots[i].m_state == SlotState::Idle) {
+					m_slots[i].m_state = SlotState::Requested;
+					m_slots[i].m_callback = std::move(callback);
+					m_requestedSlot = i;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		bool VlkReadback::Reserve(Slot &slot, const uint32_t size) {
+
+			if (slot.m_capacity >= size) {
+				return true;
+			}
+
+			VkDevice device = VlkRenderContext::GetVlkDevice()->GetHandle();
+
+			// Slots only ever grow, so steady-state capture at a fixed extent never allocates
+			if (slot.m_vkBuffer) {
+				vkUnmapMemory(device, slot.m_vkMemory);
+				ReleaseVkBuffer(slot.m_vkBuffer, slot.m_vkMemory);
+				slot.m_mappedDataP = nullptr;
+				slot.m_capacity = 0;
+			}
+
+			slot.m_vkBuffer = CreateVkBuffer(
+				size,
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				// Read by the CPU - cached memory keeps the copy out of uncached reads
+				{ VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT },
+				MemoryCategory::ReadbackMemory,
+				slot.m_vkMemory);
+
+			if (!slot.m_vkBuffer) {
+				return false;
+			}
+
+			vkMapMemory(device, slot.m_vkMemory, 0, size, 0, &slot.m_mappedDataP);
+			slot.m_capacity = size;
+
+			return slot.m_mappedDataP != nullptr;
+		}
+
+		void VlkReadback::Record(
+			VkCommandBuffer commandBuffer,
+			VkImage image,
+			VkImageLayout layout,
+			VkExtent2D extent,
+			VkFormat format,
+			const uint64_t frameNumber) {
+
+			if (!IsRequested()) {
+				return;
+			}
+
+			Slot &slot = m_slots[m_requestedSlot];
+			m_requestedSlot = -1;
+
+			const uint32_t rowPitch = extent.width * 4u;
+
+			if (!Reserve(slot, rowPitch * extent.height)) {
+				slot.m_callback = nullptr;
+				slot.m_state = SlotState::Idle;
+				return;
+			}
+
+			VkImageMemoryBarrier imageBarrier = {};
+			imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			imageBarrier.oldLayout = layout;
+			imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.image = image;
+			imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			imageBarrier.subresourceRange.levelCount = 1u;
+			imageBarrier.subresourceRange.layerCount = 1u;
+
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0, 0u, nullptr, 0u, nullptr, 1u, &imageBarrier);
+
+			VkBufferImageCopy region = {};
+			region.bufferOffset = 0;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.layerCount = 1u;
+			region.imageExtent = { extent.width, extent.height, 1u };
+
+			vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.m_vkBuffer, 1u, &region);
+
+			imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			imageBarrier.dstAccessMask = 0;
+			imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			imageBarrier.newLayout = layout;
+
+			VkBufferMemoryBarrier bufferBarrier = {};
+			bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = slot.m_vkBuffer;
+			bufferBarrier.offset = 0;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+				0, 0u, nullptr, 1u, &bufferBarrier, 1u, &imageBarrier);
+
+			slot.m_frame.frameNumber = frameNumber;
+			slot.m_frame.width = extent.width;
+			slot.m_frame.height = extent.height;
+			slot.m_frame.rowPitch = rowPitch;
+			slot.m_frame.format = GetFramePixelFormat(format);
+			slot.m_frame.pixels = static_cast<const uint8_t *>(slot.m_mappedDataP);
+			slot.m_state = SlotState::InFlight;
+		}
+
+		void VlkReadback::Deliver(const uint64_t completedFrameNumber) {
+
+			// Deliver in submission order - slots are few, so a repeated scan is cheaper than sorting
+			while (true) {
+				Slot *nextSlotP = nullptr;
+				for (auto &slot : m_slots) {
+					if (slot.m_state == SlotState::InFlight &&
+						slot.m_frame.frameNumber <= completedFrameNumber &&
+						(!nextSlotP || slot.m_frame.frameNumber < nextSlotP->m_frame.frameNumber)) {
+						nextSlotP = &slot;
+					}
+				}
+
+				if (!nextSlotP) {
+					break;
+				}
+
+				nextSlotP->m_callback(nextSlotP->m_frame);
+				nextSlotP->m_callback = nullptr;
+				nextSlotP->m_state = SlotState::Idle;
+			}
+		}
+	}
+}
@@ -0,0 +1,61 @@
+#ifndef VLK_READBACK_H_
+#define VLK_READBACK_H_
+
+#include <RenderContext.h>
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+namespace PixelMachine {
+	namespace GPU {
+		/// <summary>
+		/// Ring of persistently mapped host buffers used to copy rendered
+		/// frames back to the CPU. Copies are recorded into the frame command
+		/// buffer and handed to the requester once the frame has completed,
+		/// so the render loop never waits for a readback.
+		/// </summary>
+		class VlkReadback {
+		public:
+			VlkReadback(const uint32_t slotCount);
+			~VlkReadback();
+			/* Reserves a slot for the next recorded frame - returns false if no slot is free */
+			bool Request(ReadbackCallback callback);
+			bool IsRequested() const { return m_requestedSlot >= 0; }
+			/* Records a copy of <image> into the reserved slot. <image> is expected in <layout> and is returned to it */
+			void Record(
+				VkCommandBuffer commandBuffer,
+				VkImage image,
+				VkImageLayout layout,
+				VkExtent2D extent,
+				VkFormat format,
+				const uint64_t frameNumber);
+			/* Invokes callbacks of all slots whose frame number is not greater than <completedFrameNumber> */
+			void Deliver(const uint64_t completedFrameNumber);
+
+		private:
+			enum SlotState {
+				Idle,
+				Requested,
+				InFlight
+			};
+
+			struct Slot {
+				SlotState m_state = SlotState::Idle;
+				VkBuffer m_vkBuffer = VK_NULL_HANDLE;
+				VkDeviceMemory m_vkMemory = VK_NULL_HANDLE;
+				void *m_mappedDataP = nullptr;
+				uint32_t m_capacity = 0;
+				ReadbackCallback m_callback;
+				FrameReadback m_frame;
+			};
+
+			bool Reserve(Slot &slot, const uint32_t size);
+
+			std::vector<Slot> m_slots;
+			int32_t m_requestedSlot = -1;
+		};
+	}
+}
+
+#endif // !VLK_READBACK_H_
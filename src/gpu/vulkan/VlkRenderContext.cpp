@@ -3,7 +3,16 @@
 #include <vulkan/VlkSwapchain.h>
 #include <vulkan/VlkShaderProgram.h>
 #include <vulkan/VlkBuffer.h>
-
+#include <vulkan/VlkReadback.h>
+#include <vulkan/VlkOffscreenTarget.h>
+#include <vulkan/VlkProfiler.h>
+#include <vulkan/VlkPipelineCache.h>
+#include <vulkan/VlkTransientAttachment.h>
+#include <vulkan/VlkTexture.h>
+#include <vulkan/VlkUploadBatcher.h>
+#include <vulkan/VlkSamplerCache.h>
+
+#include <algorithm>
 #include <stdexcept>
 
 namespace PixelMachine {
@@ -11,33 +20,43 @@ namespace PixelMachine {
 		
 		extern VlkRenderContext *s_vlkRenderContextP;
 
-		VlkRenderContext::VlkRenderContext(HWND windowHandle) {
+		VlkRenderContext::VlkRenderContext(void *windowHandle) {
 
 			if (!sm_vlkDeviceP) {
 				sm_vlkDeviceP = new VlkDevice();
 			}
 
-			VkWin32SurfaceCreateInfoKHR surfaceInfo = {};
-			surfaceInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
-			surfaceInfo.pNext = nullptr;
-			surfaceInfo.hinstance = GetModuleHandle(NULL);
-			surfaceInfo.hwnd = windowHandle;
-
-			vkCreateWin32SurfaceKHR(sm_vlkDeviceP->GetVkInstance(), &surfaceInfo, nullptr, &m_vkWinSurface);
-
-			if (!m_vkWinSurface) {
-				throw new std::runtime_error("VlkRenderContext init fail - cannot create VkSurface.");
-			}
-
 			m_vkWinSurfaceFormat.format = VkFormat::VK_FORMAT_B8G8R8A8_SRGB;
 			m_vkWinSurfaceFormat.colorSpace = VkColorSpaceKHR::VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
 
+			if (windowHandle) {
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+				VkWin32SurfaceCreateInfoKHR surfaceInfo = {};
+				surfaceInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
+				surfaceInfo.pNext = nullptr;
+				surfaceInfo.hinstance = GetModuleHandle(NULL);
+				surfaceInfo.hwnd = static_cast<HWND>(windowHandle);
+
+				vkCreateWin32SurfaceKHR(sm_vlkDeviceP->GetVkInstance(), &surfaceInfo, sm_vlkDeviceP->GetAllocationCallbacks(VlkHostAllocator::SURFACE), &m_vkWinSurface);
+#endif
+				if (!m_vkWinSurface) {
+					throw new std::runtime_error("VlkRenderContext init fail - cannot create VkSurface.");
+				}
+			}
+
+			// Adapters without the queues or the Vulkan 1.3 features the context needs are rejected by SetAdapter and skipped
 			bool adapterNotFound = true;
 			for (uint32_t i = 0; i < sm_vlkDeviceP->GetAdapterCount(); i++) {
 				VlkAdapter adapter = sm_vlkDeviceP->GetAdapter(i);
-				if (adapter.SurfaceFormatAvailable(m_vkWinSurface, m_vkWinSurfaceFormat) &&
-					adapter.PresentModeAvailable(m_vkWinSurface, VK_PRESENT_MODE_FIFO_KHR)) {
-					sm_vlkDeviceP->SetAdapter(i);
+				if (!m_vkWinSurface) {
+					if (sm_vlkDeviceP->SetAdapter(i, VlkDevice::QFExtraFlags::NONE)) {
+						adapterNotFound = false;
+						break;
+					}
+				}
+				else if (adapter.SurfaceFormatAvailable(m_vkWinSurface, m_vkWinSurfaceFormat) &&
+					adapter.PresentModeAvailable(m_vkWinSurface, VK_PRESENT_MODE_FIFO_KHR) &&
+					sm_vlkDeviceP->SetAdapter(i)) {
 					adapterNotFound = false;
 					break;
 				}
@@ -47,7 +66,15 @@ namespace PixelMachine {
 				throw new std::runtime_error("VlkRenderContext init fail - cannot find suitable physical device.");
 			}
 
-			m_vlkSwapchainP = new VlkSwapchain(m_vkWinSurface, m_vkWinSurfaceFormat, VK_PRESENT_MODE_FIFO_KHR);
+			if (m_vkWinSurface) {
+				m_vlkSwapchainP = new VlkSwapchain(m_vkWinSurface, m_vkWinSurfaceFormat, VK_PRESENT_MODE_FIFO_KHR);
+			}
+
+			m_depthFormat = VlkTransientAttachment::FindDepthFormat(sm_vlkDeviceP->GetActiveAdapter().GetHandle());
+
+			if (m_depthFormat == VK_FORMAT_UNDEFINED) {
+				throw new std::runtime_error("VlkRenderContext init fail - no depth attachment format supported.");
+			}
 
 			VkDevice device = sm_vlkDeviceP->GetHandle();
 
@@ -56,55 +83,134 @@ namespace PixelMachine {
 			commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 			commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
-			vkCreateCommandPool(device, &commandPoolInfo, nullptr, &m_vkCommandPool);
+			vkCreateCommandPool(device, &commandPoolInfo, sm_vlkDeviceP->GetAllocationCallbacks(VlkHostAllocator::COMMAND_POOL), &m_vkCommandPool);
+
+			m_frames.resize(sm_framesInFlight);
+			std::vector<VkCommandBuffer> commandBuffers(m_frames.size());
 
 			VkCommandBufferAllocateInfo commandBufferInfo = {};
 			commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 			commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-			commandBufferInfo.commandBufferCount = 1;
+			commandBufferInfo.commandBufferCount = commandBuffers.size();
 			commandBufferInfo.commandPool = m_vkCommandPool;
 
-			vkAllocateCommandBuffers(device, &commandBufferInfo, &m_vkCommandBuffer);
+			vkAllocateCommandBuffers(device, &commandBufferInfo, commandBuffers.data());
 
 			VkSemaphoreCreateInfo semaphoreInfo = {};
 			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-			m_renderDone.resize(m_vlkSwapchainP->GetImagesCount());
+			m_renderDone.resize(m_vlkSwapchainP ? m_vlkSwapchainP->GetImagesCount() : 0u);
 
 			for (auto &sem : m_renderDone) {
 				VkSemaphore semaphore = VK_NULL_HANDLE;
-				vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore);
+				vkCreateSemaphore(device, &semaphoreInfo, sm_vlkDeviceP->GetAllocationCallbacks(VlkHostAllocator::SYNCHRONIZATION), &semaphore);
 				sem = semaphore;
 			}
 
-			VkFenceCreateInfo fenceInfo = {};
-			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-			fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+			for (uint32_t i = 0; i < m_frames.size(); i++) {
+				m_frames[i].m_vkCommandBuffer = commandBuffers[i];
+				vkCreateSemaphore(device, &semaphoreInfo, sm_vlkDeviceP->GetAllocationCallbacks(VlkHostAllocator::SYNCHRONIZATION), &m_frames[i].m_vkImageAvailable);
+			}
+
+			// Async compute - its own command pool, ordered against graphics by the device timelines
+			if (sm_vlkDeviceP->GetAsyncComputeQueue().first) {
+
+				commandPoolInfo.queueFamilyIndex = sm_vlkDeviceP->GetAsyncComputeQueue().second;
+				vkCreateCommandPool(device, &commandPoolInfo, sm_vlkDeviceP->GetAllocationCallbacks(VlkHostAllocator::COMMAND_POOL), &m_vkComputeCommandPool);
+
+				m_computeFrames.resize(sm_framesInFlight);
+				std::vector<VkCommandBuffer> computeCommandBuffers(m_computeFrames.size());
+
+				commandBufferInfo.commandBufferCount = computeCommandBuffers.size();
+				commandBufferInfo.commandPool = m_vkComputeCommandPool;
 
-			vkCreateFence(device, &fenceInfo, nullptr, &m_vkCmdCompletedFence);
+				vkAllocateCommandBuffers(device, &commandBufferInfo, computeCommandBuffers.data());
+
+				for (uint32_t i = 0; i < m_computeFrames.size(); i++) {
+					m_computeFrames[i].m_vkCommandBuffer = computeCommandBuffers[i];
+				}
+
+				if (!m_vkComputeCommandPool) {
+					throw new std::runtime_error("VlkRenderContext init fail - cannot create async compute resources.");
+				}
+			}
 
+			// One extra slot lets a capture be requested every frame while the previous ones are in flight
+			m_vlkReadbackP = new VlkReadback(sm_framesInFlight + 1u);
+			m_vlkProfilerP = new VlkProfiler(sm_framesInFlight);
+			m_vlkPipelineCacheP = new VlkPipelineCache();
+			m_vlkUploadBatcherP = new VlkUploadBatcher();
+			m_vlkSamplerCacheP = new VlkSamplerCache();
 		}
 
 		VlkRenderContext::~VlkRenderContext() {
 
 			m_vlkPasses.clear();
 
+			if (m_vlkPipelineCacheP) {
+				delete m_vlkPipelineCacheP;
+			}
+
+			for (auto &entry : m_sampleTargets) {
+				delete entry.second.m_depthP;
+				delete entry.second.m_colorP;
+			}
+
+			// Submits uploads still being recorded before waiting for the device
+			if (m_vlkUploadBatcherP) {
+				delete m_vlkUploadBatcherP;
+			}
+
 			VkDevice device = sm_vlkDeviceP->GetHandle();
 
-			if (m_vkCmdCompletedFence) {
-				vkDestroyFence(device, m_vkCmdCompletedFence, nullptr);
+			vkDeviceWaitIdle(device);
+			sm_vlkDeviceP->CollectReleases();
+
+			if (m_vlkSamplerCacheP) {
+				delete m_vlkSamplerCacheP;
+			}
+
+			if (m_vlkReadbackP) {
+				delete m_vlkReadbackP;
+			}
+
+			if (m_vlkProfilerP) {
+				delete m_vlkProfilerP;
+			}
+
+			for (auto &frame : m_frames) {
+				if (frame.m_vkImageAvailable) {
+					vkDestroySemaphore(device, frame.m_vkImageAvailable, sm_vlkDeviceP->GetAllocationCallbacks(VlkHostAllocator::SYNCHRONIZATION));
+				}
+				if (frame.m_vkCommandBuffer) {
+					vkFreeCommandBuffers(device, m_vkCommandPool, 1, &frame.m_vkCommandBuffer);
+				}
 			}
 
 			for (auto &sem : m_renderDone) {
-				vkDestroySemaphore(device, sem, nullptr);
+				vkDestroySemaphore(device, sem, sm_vlkDeviceP->GetAllocationCallbacks(VlkHostAllocator::SYNCHRONIZATION));
+			}
+
+			for (auto &frame : m_computeFrames) {
+				if (frame.m_vkCommandBuffer) {
+					vkFreeCommandBuffers(device, m_vkComputeCommandPool, 1, &frame.m_vkCommandBuffer);
+				}
+			}
+
+			if (m_vkComputeCommandPool) {
+				vkDestroyCommandPool(device, m_vkComputeCommandPool, sm_vlkDeviceP->GetAllocationCallbacks(VlkHostAllocator::COMMAND_POOL));
+			}
+
+			if (m_vkCommandPool) {
+				vkDestroyCommandPool(device, m_vkCommandPool, sm_vlkDeviceP->GetAllocationCallbacks(VlkHostAllocator::COMMAND_POOL));
 			}
 
-			if (m_vkCommandBuffer) {
-				vkFreeCommandBuffers(device, m_vkCommandPool, 1, &m_vkCommandBuffer);
+			for (auto targetP : m_retiredTargets) {
+				delete targetP;
 			}
 
-			if (m_vkCommandBuffer) {
-				vkDestroyCommandPool(device, m_vkCommandPool, nullptr);
+			if (m_vlkTargetP) {
+				delete m_vlkTargetP;
 			}
 
 			if (m_vlkSwapchainP) {
@@ -112,7 +218,7 @@ namespace PixelMachine {
 			}
 
 			if (m_vkWinSurface) {
-				vkDestroySurfaceKHR(sm_vlkDeviceP->GetVkInstance(), m_vkWinSurface, nullptr);
+				vkDestroySurfaceKHR(sm_vlkDeviceP->GetVkInstance(), m_vkWinSurface, sm_vlkDeviceP->GetAllocationCallbacks(VlkHostAllocator::SURFACE));
 			}
 
 			if (sm_vlkDeviceP) {
@@ -121,58 +227,399 @@ namespace PixelMachine {
 			}
 		}
 
+		void VlkRenderContext::UpdateCompletedFrames() {
+
+			VlkTimeline &timeline = sm_vlkDeviceP->GetTimeline(VlkDevice::QueueType::GRAPHICS);
+
+			// Frames retire in submission order, so the newest completed frame covers all earlier ones
+			for (uint32_t i = 0; i < m_frames.size(); i++) {
+				if (m_frames[i].m_frameNumber > m_completedFrameNumber &&
+					timeline.IsComplete(m_frames[i].m_timelineValue)) {
+					m_completedFrameNumber = m_frames[i].m_frameNumber;
+					m_vlkProfilerP->ResolveFrame(i);
+				}
+			}
+		}
+
+		void VlkRenderContext::ReleaseRetiredTargets() {
+
+			for (auto it = m_retiredTargets.begin(); it != m_retiredTargets.end();) {
+				if ((*it)->GetLastUsedFrame() <= m_completedFrameNumber) {
+					delete *it;
+					it = m_retiredTargets.erase(it);
+				}
+				else {
+					it++;
+				}
+			}
+		}
+
+		VkFormat VlkRenderContext::GetColorFormat() const {
+			return m_vlkSwapchainP ? m_vlkSwapchainP->GetFormat() : m_vkWinSurfaceFormat.format;
+		}
+
+		/* Keeps <attachmentP> at <extent>, the previous one is released once the frames rendering with it complete */
+		static bool UpdateTransientAttachment(
+			VlkTransientAttachment *&attachmentP,
+			const VkFormat format,
+			const VkExtent2D extent,
+			const VkSampleCountFlagBits samples,
+			const VkImageUsageFlags usage) {
+
+			if (attachmentP && attachmentP->GetExtent().width == extent.width && attachmentP->GetExtent().height == extent.height) {
+				return false;
+			}
+
+			delete attachmentP;
+			attachmentP = new VlkTransientAttachment(format, extent, samples, usage);
+
+			return true;
+		}
+
+		VlkRenderContext::VlkSampleTargets &VlkRenderContext::GetSampleTargets(const VkSampleCountFlagBits samples, const VkExtent2D extent) {
+
+			VlkSampleTargets &targets = m_sampleTargets[samples];
+
+			if (UpdateTransientAttachment(targets.m_depthP, m_depthFormat, extent, samples, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) {
+				m_stats.transientAttachments++;
+				m_stats.lazyAttachments += targets.m_depthP->IsLazilyAllocated();
+			}
+
+			// Single sampled color renders straight into the target
+			if (samples != VK_SAMPLE_COUNT_1_BIT &&
+				UpdateTransientAttachment(targets.m_colorP, GetColorFormat(), extent, samples, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)) {
+				m_stats.transientAttachments++;
+				m_stats.lazyAttachments += targets.m_colorP->IsLazilyAllocated();
+			}
+
+			return targets;
+		}
+
+		static void RecordImageTransition(
+			VkCommandBuffer commandBuffer,
+			VkImage image,
+			const VkImageAspectFlags aspect,
+			const VkImageLayout oldLayout,
+			const VkImageLayout newLayout,
+			const VkPipelineStageFlags srcStages,
+			const VkAccessFlags srcAccess,
+			const VkPipelineStageFlags dstStages,
+			const VkAccessFlags dstAccess) {
+
+			VkImageMemoryBarrier imageBarrier = {};
+			imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageBarrier.srcAccessMask = srcAccess;
+			imageBarrier.dstAccessMask = dstAccess;
+			imageBarrier.oldLayout = oldLayout;
+			imageBarrier.newLayout = newLayout;
+			imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.image = image;
+			imageBarrier.subresourceRange.aspectMask = aspect;
+			imageBarrier.subresourceRange.levelCount = 1u;
+			imageBarrier.subresourceRange.layerCount = 1u;
+
+			vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0u, nullptr, 0u, nullptr, 1u, &imageBarrier);
+		}
+
 		void VlkRenderContext::RunPass(const int index) {
 
-			vkWaitForFences(sm_vlkDeviceP->GetHandle(), 1u, &m_vkCmdCompletedFence, VK_TRUE, UINT64_MAX);
-			vkResetFences(sm_vlkDeviceP->GetHandle(), 1u, &m_vkCmdCompletedFence);
-			vkResetCommandBuffer(m_vkCommandBuffer, 0);
+			VlkCpuScope cpuScope(m_vlkProfilerP, "RunPass");
+
+			VlkPass &pass = m_vlkPasses.at(index);
+			const bool computePass = pass.m_vkBindPoint == VK_PIPELINE_BIND_POINT_COMPUTE;
+
+			RefreshPassTextures(pass);
+
+			if (computePass && pass.m_asyncCompute && m_vkComputeCommandPool) {
+				RunAsyncCompute(pass);
+				return;
+			}
+
+			if (!computePass && !m_vlkSwapchainP && !m_vlkTargetP) {
+				throw new std::runtime_error("VlkRenderContext run fail - headless context has no render target set.");
+			}
+
+			const uint32_t frameSlot = BeginFrame();
+			VlkFrame &frame = m_frames[frameSlot];
+			VkCommandBuffer commandBuffer = frame.m_vkCommandBuffer;
+
+			// Barriers go ahead of rendering, they cannot be recorded inside it
+			std::vector<VlkSemaphoreWait> waits;
+			RecordPassBarriers(commandBuffer, pass, sm_vlkDeviceP->GetActiveQueue().second, GetNextGraphicsValue(), waits);
+
+			bool imageAcquired = false;
+
+			if (computePass) {
+				const int32_t passScope = m_vlkProfilerP->BeginGpuScope(frameSlot, commandBuffer, pass.m_name);
+				RecordDispatch(commandBuffer, pass);
+				m_vlkProfilerP->EndGpuScope(frameSlot, commandBuffer, passScope);
+			}
+			else {
+				VlkDrawRecord record;
+				record.passIndex = index;
+				imageAcquired = RecordDraw(commandBuffer, frame, frameSlot, &record, 1u, pass.m_name, false);
+			}
+
+			SubmitFrame(frameSlot, waits, imageAcquired);
+		}
+
+		void VlkRenderContext::QueueDraw(const int index, const float depth, const uint8_t layer) {
+
+			VlkPass &pass = m_vlkPasses.at(index);
+
+			if (pass.m_vkBindPoint != VK_PIPELINE_BIND_POINT_GRAPHICS) {
+				throw new std::runtime_error("VlkRenderContext queue draw fail - only graphics passes can be queued.");
+			}
+
+			// Queued draws render into the same attachments
+			if (m_drawQueue.GetCount() && m_vlkPasses[m_drawQueue.GetRecords()[0].passIndex].m_renderState.samples != pass.m_renderState.samples) {
+				throw new std::runtime_error("VlkRenderContext queue draw fail - queued passes must share one sample count.");
+			}
+
+			VlkDrawRecord record;
+			record.sortKey = VlkDrawQueue::MakeSortKey(layer, pass.m_pipelineSortId, pass.m_materialSortId, depth);
+			record.passIndex = index;
+			m_drawQueue.Push(record);
+		}
+
+		void VlkRenderContext::RunQueuedDraws() {
+
+			VlkCpuScope cpuScope(m_vlkProfilerP, "RunQueuedDraws");
+
+			const uint32_t drawCount = m_drawQueue.GetCount();
+
+			if (!drawCount) {
+				return;
+			}
+
+			if (!m_vlkSwapchainP && !m_vlkTargetP) {
+				throw new std::runtime_error("VlkRenderContext run fail - headless context has no render target set.");
+			}
+
+			m_drawQueue.Sort();
+			const VlkDrawRecord *recordsP = m_drawQueue.GetRecords();
+
+			for (uint32_t i = 0; i < drawCount; i++) {
+				RefreshPassTextures(m_vlkPasses[recordsP[i].passIndex]);
+			}
+
+			const uint32_t frameSlot = BeginFrame();
+			VlkFrame &frame = m_frames[frameSlot];
+			VkCommandBuffer commandBuffer = frame.m_vkCommandBuffer;
+
+			// Barriers of every queued pass, once each, all ahead of the single rendering instance
+			std::vector<VlkSemaphoreWait> waits;
+			const uint64_t signalValue = GetNextGraphicsValue();
+
+			for (uint32_t i = 0; i < drawCount; i++) {
+
+				VlkPass &pass = m_vlkPasses[recordsP[i].passIndex];
+
+				if (pass.m_barrierFrameNumber != m_frameNumber + 1u) {
+					pass.m_barrierFrameNumber = m_frameNumber + 1u;
+					RecordPassBarriers(commandBuffer, pass, sm_vlkDeviceP->GetActiveQueue().second, signalValue, waits);
+				}
+			}
+
+			const bool imageAcquired = RecordDraw(commandBuffer, frame, frameSlot, recordsP, drawCount, "Draw queue", true);
+
+			SubmitFrame(frameSlot, waits, imageAcquired);
+
+			m_stats.queuedDraws += drawCount;
+			m_drawQueue.Reset();
+		}
+
+		uint64_t VlkRenderContext::GetNextGraphicsValue() const {
+			return sm_vlkDeviceP->GetTimeline(VlkDevice::QueueType::GRAPHICS).GetSubmittedValue() + 1u;
+		}
+
+		uint32_t VlkRenderContext::BeginFrame() {
+
+			const uint32_t frameSlot = m_frameNumber % m_frames.size();
+			VlkFrame &frame = m_frames[frameSlot];
+
+			sm_vlkDeviceP->GetTimeline(VlkDevice::QueueType::GRAPHICS).WaitFor(frame.m_timelineValue);
+			vkResetCommandBuffer(frame.m_vkCommandBuffer, 0);
+
+			// Uploads recorded since the last frame go first in queue order - the frame sees them without a CPU wait.
+			// Submitted before any timeline value of the frame is handed out
+			m_vlkUploadBatcherP->Flush();
+
+			m_completedFrameNumber = std::max(m_completedFrameNumber, frame.m_frameNumber);
+			UpdateCompletedFrames();
+			m_vlkReadbackP->Deliver(m_completedFrameNumber);
+			ReleaseRetiredTargets();
+			sm_vlkDeviceP->CollectReleases();
+
+			// Budgets change with other processes - refreshed once per frame and checked against the soft limit
+			sm_vlkDeviceP->UpdateMemoryBudget();
+
+			VkCommandBuffer commandBuffer = frame.m_vkCommandBuffer;
 
 			VkCommandBufferBeginInfo beginInfo = {};
 			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 			beginInfo.flags = 0;
 			beginInfo.pInheritanceInfo = nullptr;
 
-			vkBeginCommandBuffer(m_vkCommandBuffer, &beginInfo);
+			vkBeginCommandBuffer(commandBuffer, &beginInfo);
+			m_commandState.Reset(commandBuffer);
+			m_vlkProfilerP->BeginFrame(frameSlot, commandBuffer, m_frameNumber + 1u);
 
-			VlkPass &pass = m_vlkPasses.at(index);
-			VkClearValue clearColor = { pass.m_clearColor[0], pass.m_clearColor[1], pass.m_clearColor[2], 1.0f };
-			VkRect2D renderArea = {}; // Viewport = Render Area = Scissor Rectangle
+			return frameSlot;
+		}
+
+		void VlkRenderContext::SubmitFrame(const uint32_t frameSlot, std::vector<VlkSemaphoreWait> &waits, const bool imageAcquired) {
+
+			VlkFrame &frame = m_frames[frameSlot];
+			VkCommandBuffer commandBuffer = frame.m_vkCommandBuffer;
+
+			vkEndCommandBuffer(commandBuffer);
+
+			VkSemaphore renderDone = VK_NULL_HANDLE;
+
+			// Acquire and present only take binary semaphores
+			if (imageAcquired) {
+				VlkSemaphoreWait imageWait;
+				imageWait.semaphore = frame.m_vkImageAvailable;
+				imageWait.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+				waits.push_back(imageWait);
+				renderDone = m_renderDone[m_frameIndex];
+				m_presentPending = true;
+			}
+
+			m_vlkProfilerP->MarkSubmit(frameSlot);
+			frame.m_timelineValue = sm_vlkDeviceP->Submit(VlkDevice::QueueType::GRAPHICS, commandBuffer, waits, renderDone);
 
-			VkRenderPassBeginInfo renderPassBeginInfo = {};
+			m_frameNumber++;
+			frame.m_frameNumber = m_frameNumber;
+		}
+
+		bool VlkRenderContext::RecordDraw(
+			VkCommandBuffer commandBuffer,
+			VlkFrame &frame,
+			const uint32_t frameSlot,
+			const VlkDrawRecord *recordsP,
+			const uint32_t recordCount,
+			const std::string &scopeName,
+			const bool queued) {
+
+			// The first draw decides the clear color and target
+			VlkPass &firstPass = m_vlkPasses[recordsP[0].passIndex];
+
+			VkRect2D renderArea = {}; // Viewport = Render Area = Scissor Rectangle
+			VkImage targetImage = VK_NULL_HANDLE;
+			VkImageView targetView = VK_NULL_HANDLE;
+			VkImageLayout targetLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkFormat targetFormat = GetColorFormat();
 
-			if (pass.m_renderToScreen) {
-				m_frameIndex = m_vlkSwapchainP->GetImage(&renderPassBeginInfo.framebuffer);
+			if (firstPass.m_renderToScreen && m_vlkSwapchainP) {
+				m_frameIndex = m_vlkSwapchainP->GetImage(frame.m_vkImageAvailable);
 
 				VlkAdapter activeAdapter = sm_vlkDeviceP->GetActiveAdapter();
 				VkSurfaceCapabilitiesKHR surfaceCaps = activeAdapter.GetSurfaceInfo(m_vkWinSurface);
 				renderArea.extent.width = surfaceCaps.currentExtent.width;
 				renderArea.extent.height = surfaceCaps.currentExtent.height;
 				renderArea.offset = { 0 };
+
+				targetImage = m_vlkSwapchainP->GetVkImage(m_frameIndex);
+				targetView = m_vlkSwapchainP->GetVkImageView(m_frameIndex);
+				targetLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+			}
+			else if (firstPass.m_renderToScreen && m_vlkTargetP) {
+				// Image slot follows the frame slot, so its previous use has already completed
+				m_frameIndex = m_frameNumber % m_vlkTargetP->GetImagesCount();
+				renderArea.extent = m_vlkTargetP->GetExtent();
+				renderArea.offset = { 0 };
+
+				targetImage = m_vlkTargetP->GetVkImage(m_frameIndex);
+				targetView = m_vlkTargetP->GetVkImageView(m_frameIndex);
+				// Frames stay in transfer layout so they can be read back without an extra transition
+				targetLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				m_vlkTargetP->SetLastUsedFrame(m_frameNumber + 1u);
 			}
 			//else - Set render area according to a target texture extents
 
-			renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassBeginInfo.renderPass = m_vlkSwapchainP->GetVkRenderPass();
-			renderPassBeginInfo.renderArea = renderArea;
-			renderPassBeginInfo.clearValueCount = 1u;
-			renderPassBeginInfo.pClearValues = &clearColor;
+			// Previous contents are cleared - the transition waits for the image acquire at the same stage
+			if (targetImage) {
+				RecordImageTransition(
+					commandBuffer,
+					targetImage,
+					VK_IMAGE_ASPECT_COLOR_BIT,
+					VK_IMAGE_LAYOUT_UNDEFINED,
+					VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+					VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0u,
+					VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+			}
 
+			VkRenderingAttachmentInfo colorAttachment = {};
+			colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+			colorAttachment.imageView = targetView;
+			colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			colorAttachment.resolveMode = VK_RESOLVE_MODE_NONE;
+			colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			colorAttachment.clearValue.color = { { firstPass.m_clearColor[0], firstPass.m_clearColor[1], firstPass.m_clearColor[2], 1.0f } };
+
+			// Every draw of the rendering shares the sample count of the first one
+			const VkSampleCountFlagBits samples = firstPass.m_renderState.samples;
+
+			// Depth is only tested within the frame - cleared on load, never stored, so tilers keep it on chip
+			VkRenderingAttachmentInfo depthAttachment = {};
+			depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+			depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			depthAttachment.resolveMode = VK_RESOLVE_MODE_NONE;
+			depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			depthAttachment.clearValue.depthStencil = { 1.0f, 0u };
+
+			if (targetImage) {
+				VlkSampleTargets &sampleTargets = GetSampleTargets(samples, renderArea.extent);
+				VlkTransientAttachment *depthP = sampleTargets.m_depthP;
+				depthAttachment.imageView = depthP->GetVkImageView();
+
+				// Multisampled color is resolved into the target at the end of the rendering and then discarded,
+				// so the full sample image never leaves tile memory
+				if (sampleTargets.m_colorP) {
+					colorAttachment.imageView = sampleTargets.m_colorP->GetVkImageView();
+					colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+					colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+					colorAttachment.resolveImageView = targetView;
+					colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+					RecordImageTransition(
+						commandBuffer,
+						sampleTargets.m_colorP->GetVkImage(),
+						VK_IMAGE_ASPECT_COLOR_BIT,
+						VK_IMAGE_LAYOUT_UNDEFINED,
+						VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+						VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+						VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+					m_stats.msaaResolves++;
+				}
 
-			vkCmdBeginRenderPass(m_vkCommandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-			vkCmdBindPipeline(m_vkCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pass.m_vkPipeline);
+				// One image per sample count serves every frame - depth writes of the previous frame complete before the clear
+				RecordImageTransition(
+					commandBuffer,
+					depthP->GetVkImage(),
+					depthP->GetAspect(),
+					VK_IMAGE_LAYOUT_UNDEFINED,
+					VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+					VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+					VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+			}
 
-			std::vector<VkBuffer> vbs;
+			VkRenderingInfo renderingInfo = {};
+			renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+			renderingInfo.renderArea = renderArea;
+			renderingInfo.layerCount = 1u;
+			renderingInfo.colorAttachmentCount = 1u;
+			renderingInfo.pColorAttachments = &colorAttachment;
+			renderingInfo.pDepthAttachment = depthAttachment.imageView ? &depthAttachment : nullptr;
 
-			for (auto buffer : pass.m_buffers) {
-				if (buffer->GetType() == BufferType::VertexBuffer) {
-					vbs.push_back(buffer->GetHandle());
-				}
-			}
+			const int32_t passScope = m_vlkProfilerP->BeginGpuScope(frameSlot, commandBuffer, scopeName);
 
-			if (vbs.size()) {
-				std::vector<VkDeviceSize> offsets(vbs.size());
-				vkCmdBindVertexBuffers(m_vkCommandBuffer, 0, vbs.size(), vbs.data(), offsets.data());
-			}
+			vkCmdBeginRendering(commandBuffer, &renderingInfo);
 
 			VkViewport viewport = {};
 			viewport.x = 0.0f;
@@ -180,223 +627,1194 @@ namespace PixelMachine {
 			viewport.width = renderArea.extent.width;
 			viewport.height = renderArea.extent.height;
 
-			vkCmdSetViewportWithCount(m_vkCommandBuffer, 1u, &viewport);
-			vkCmdSetScissorWithCount(m_vkCommandBuffer, 1u, &renderArea);
-			vkCmdDraw(m_vkCommandBuffer, 3u, 1u, 0u, 0u);
-			vkCmdEndRenderPass(m_vkCommandBuffer);
-			vkEndCommandBuffer(m_vkCommandBuffer);
+			m_commandState.SetViewport(viewport);
+			m_commandState.SetScissor(renderArea);
 
-			VkSubmitInfo submitInfo{};
-			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			// A single pass is queried in its own scope. Queued draws query each run of records of the same pass in
+			// a nested scope named after it - its depth pre-pass draws get a second one, so counters add up per pass
 
-			VkSemaphore imageAvailable = m_vlkSwapchainP->GetImageAvailableSemaphore();
-			VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-			submitInfo.waitSemaphoreCount = 1u;
-			submitInfo.pWaitSemaphores = &imageAvailable;
-			submitInfo.pWaitDstStageMask = waitStages;
-			submitInfo.commandBufferCount = 1u;
-			submitInfo.pCommandBuffers = &m_vkCommandBuffer;
-			submitInfo.signalSemaphoreCount = 1u;
-			submitInfo.pSignalSemaphores = &m_renderDone[m_frameIndex];
+			if (!queued) {
+				m_vlkProfilerP->BeginScopeQueries(frameSlot, commandBuffer, passScope);
+			}
 
-			vkQueueSubmit(sm_vlkDeviceP->GetActiveQueue().first, 1, &submitInfo, m_vkCmdCompletedFence);
-		}
+			auto recordRuns = [&](const bool depthPrePass) {
+				for (uint32_t i = 0; i < recordCount;) {
 
-		void VlkRenderContext::PresentFrame() {
+					VlkPass &pass = m_vlkPasses[recordsP[i].passIndex];
+					uint32_t runEnd = i + 1u;
 
-			VkPresentInfoKHR presentInfo{};
-			presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-			presentInfo.waitSemaphoreCount = 1u;
-			presentInfo.pWaitSemaphores = &m_renderDone[m_frameIndex];
-			presentInfo.swapchainCount = 1u;
-			VkSwapchainKHR swapchain = m_vlkSwapchainP->GetHandle();
-			presentInfo.pSwapchains = &swapchain;
-			presentInfo.pImageIndices = &m_frameIndex;
+					while (runEnd < recordCount && recordsP[runEnd].passIndex == recordsP[i].passIndex) {
+						runEnd++;
+					}
 
-			vkQueuePresentKHR(sm_vlkDeviceP->GetActiveQueue().first, &presentInfo);
-		}
+					if (depthPrePass && !pass.m_vkDepthPipeline) {
+						i = runEnd;
+						continue;
+					}
 
-		VkFormat GetVkFormat(BufferDataType shaderDataType) {
-			switch (shaderDataType)
-			{
-			case BufferDataType::int1:		return VK_FORMAT_R32_SINT;
-			case BufferDataType::int2:		return VK_FORMAT_R32G32_SINT;
-			case BufferDataType::int3:		return VK_FORMAT_R32G32B32_SINT;
-			case BufferDataType::int4:		return VK_FORMAT_R32G32B32A32_SINT;
-			case BufferDataType::uint1:		return VK_FORMAT_R32_UINT;
-			case BufferDataType::uint2:		return VK_FORMAT_R32G32_UINT;
-			case BufferDataType::uint3:		return VK_FORMAT_R32G32B32_UINT;
-			case BufferDataType::uint4:		return VK_FORMAT_R32G32B32A32_UINT;
-			case BufferDataType::float1:	return VK_FORMAT_R32_SFLOAT;
-			case BufferDataType::float2:	return VK_FORMAT_R32G32_SFLOAT;
-			case BufferDataType::float3:	return VK_FORMAT_R32G32B32_SFLOAT;
-			case BufferDataType::float4:	return VK_FORMAT_R32G32B32A32_SFLOAT;
-			default: break;
-			}
-			return VK_FORMAT_UNDEFINED;
-		}
+					const int32_t runScope = queued ? m_vlkProfilerP->BeginGpuScope(frameSlot, commandBuffer, pass.m_name) : -1;
+					m_vlkProfilerP->BeginScopeQueries(frameSlot, commandBuffer, runScope);
 
-		void VlkRenderContext::EndPass() {
+					for (; i < runEnd; i++) {
+						if (depthPrePass) {
+							RecordPassDraw(commandBuffer, pass, pass.m_vkDepthPipeline, pass.m_depthRenderState);
+							m_stats.depthPrePassDraws++;
+						}
+						else {
+							RecordPassDraw(commandBuffer, pass, pass.m_vkPipeline, pass.m_renderState);
+						}
+					}
 
-			if (!m_vlkPasses.size())
-				return;
+					m_vlkProfilerP->EndScopeQueries(frameSlot, commandBuffer, runScope);
+					m_vlkProfilerP->EndGpuScope(frameSlot, commandBuffer, runScope);
+				}
+			};
 
-			VlkPass &newPass = *m_vlkPasses.rbegin();
+			// Depth pre-passes go first, the color draws of every pass then find the final depth laid down
+			recordRuns(true);
+			// Records arrive sorted, consecutive draws of the same pass find everything already bound
+			recordRuns(false);
 
-			std::vector<const VlkBuffer*> vbos;
+			if (!queued) {
+				m_vlkProfilerP->EndScopeQueries(frameSlot, commandBuffer, passScope);
+			}
 
-			for (auto buffer : newPass.m_buffers) {
-				if (buffer->GetType() == BufferType::VertexBuffer) {
-					vbos.push_back(buffer);
-				}
+			vkCmdEndRendering(commandBuffer);
+
+			// Later accesses (readback copy, present) synchronize with the color output stage
+			if (targetImage) {
+				RecordImageTransition(
+					commandBuffer,
+					targetImage,
+					VK_IMAGE_ASPECT_COLOR_BIT,
+					VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+					targetLayout,
+					VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+					VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0u);
 			}
 
-			std::vector<VkVertexInputBindingDescription> vtxBindings(vbos.size());
-			std::vector<VkVertexInputAttributeDescription> vtxAttributeDescs;
-			uint32_t location = 0;
+			m_vlkProfilerP->EndGpuScope(frameSlot, commandBuffer, passScope);
+
+			if (targetImage && m_vlkReadbackP->IsRequested()) {
+				const int32_t readbackScope = m_vlkProfilerP->BeginGpuScope(frameSlot, commandBuffer, "Readback");
+				m_vlkReadbackP->Record(
+					commandBuffer,
+					targetImage,
+					targetLayout,
+					renderArea.extent,
+					targetFormat,
+					m_frameNumber + 1u);
+				m_vlkProfilerP->EndGpuScope(frameSlot, commandBuffer, readbackScope);
+			}
 
-			for (uint32_t i = 0; i < vtxBindings.size(); i++) {
+			return firstPass.m_renderToScreen && m_vlkSwapchainP;
+		}
 
-				vtxBindings[i].binding = i;
-				vtxBindings[i].stride = vbos[i]->GetLayout().GetSize();
-				vtxBindings[i].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		void VlkRenderContext::RecordPassDraw(VkCommandBuffer commandBuffer, VlkPass &pass, VkPipeline pipeline, const VlkRenderState &renderState) {
 
-				for (uint32_t j = 0; j < vbos[i]->GetLayout().GetAttributeCount(); j++) {
+			m_commandState.BindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
-					VkVertexInputAttributeDescription vtxAttributeDesc = {};
-					BufferAttribute attribute = vbos[i]->GetLayout().GetAttribute(j);
-					vtxAttributeDesc.binding = i;
-					vtxAttributeDesc.location = location;
-					vtxAttributeDesc.offset = attribute.m_offset;
-					vtxAttributeDesc.format = GetVkFormat(attribute.m_shaderDataType);
-					vtxAttributeDescs.push_back(vtxAttributeDesc);
-					location++;
-				}
+			if (pass.m_vkDescriptorSet) {
+				m_commandState.BindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, pass.m_vkPipelineLayout, pass.m_vkDescriptorSet);
+			}
 
+			if (pass.m_vkVertexBuffers.size()) {
+				m_commandState.BindVertexBuffers(pass.m_vkVertexBuffers.size(), pass.m_vkVertexBuffers.data(), pass.m_vertexOffsets.data());
 			}
 
-			VkPipelineVertexInputStateCreateInfo vertexInputStateInfo = {};
-			vertexInputStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-			vertexInputStateInfo.vertexBindingDescriptionCount = vtxBindings.size();
-			vertexInputStateInfo.pVertexBindingDescriptions = vtxBindings.data();
-			vertexInputStateInfo.vertexAttributeDescriptionCount = vtxAttributeDescs.size();
-			vertexInputStateInfo.pVertexAttributeDescriptions = vtxAttributeDescs.data();
-	
-			VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo = {};
-			inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-			inputAssemblyInfo.topology = VkPrimitiveTopology(newPass.m_primitiveTopology);
-			inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
+			// Widths other than 1 need the wideLines feature
+			m_commandState.SetLineWidth(sm_vlkDeviceP->GetEnabledFeatures().wideLines ? pass.m_lineWidth : 1.0f);
+			m_commandState.SetRenderState(renderState, sm_vlkDeviceP->GetDynamicStateSupport());
+
+			if (pass.m_drawCommandsP) {
+				m_commandState.BindIndexBuffer(pass.m_indexBufferP->GetHandle(), 0u, VK_INDEX_TYPE_UINT32);
+				vkCmdDrawIndexedIndirectCount(
+					commandBuffer,
+					pass.m_drawCommandsP->GetHandle(),
+					pass.m_drawCommandsOffset,
+					pass.m_drawCountP->GetHandle(),
+					pass.m_drawCountOffset,
+					pass.m_maxDrawCount,
+					sizeof(VkDrawIndexedIndirectCommand));
+				m_stats.indirectDraws++;
+			}
+			else {
+				vkCmdDraw(commandBuffer, pass.m_vertexCount, 1u, 0u, 0u);
+			}
+		}
 
-			VkViewport viewport = {};
-			viewport.minDepth = 0.0f;
-			viewport.maxDepth = 1.0f;
-			
-			VkPipelineViewportStateCreateInfo viewportInfo = {};
-			viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-
-			VkPipelineRasterizationStateCreateInfo rasterInfo = {};
-			rasterInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-			rasterInfo.depthClampEnable = VK_FALSE;
-			rasterInfo.rasterizerDiscardEnable = VK_FALSE;
-			rasterInfo.polygonMode = VK_POLYGON_MODE_FILL; // This should be set according to a primitive type
-			rasterInfo.lineWidth = newPass.m_lineWidth;
-			rasterInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-			rasterInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
-			rasterInfo.depthBiasEnable = VK_FALSE;
-			rasterInfo.depthBiasConstantFactor = 0.0f;
-			rasterInfo.depthBiasClamp = 0.0f;
-			rasterInfo.depthBiasSlopeFactor = 0.0f;
-
-			VkPipelineMultisampleStateCreateInfo multisamplingInfo = {};
-			multisamplingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-			multisamplingInfo.sampleShadingEnable = VK_FALSE;
-			multisamplingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-			multisamplingInfo.minSampleShading = 1.0f;
-			multisamplingInfo.pSampleMask = nullptr;
-			multisamplingInfo.alphaToCoverageEnable = VK_FALSE;
-			multisamplingInfo.alphaToOneEnable = VK_FALSE;
-			
-			VkPipelineColorBlendAttachmentState colorBlendAttchState = {};
-			colorBlendAttchState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
-				VK_COLOR_COMPONENT_G_BIT |
-				VK_COLOR_COMPONENT_B_BIT |
-				VK_COLOR_COMPONENT_A_BIT;
-			colorBlendAttchState.blendEnable = VK_FALSE;
-			colorBlendAttchState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-			colorBlendAttchState.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-			colorBlendAttchState.colorBlendOp = VK_BLEND_OP_ADD;
-			colorBlendAttchState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-			colorBlendAttchState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-			colorBlendAttchState.alphaBlendOp = VK_BLEND_OP_ADD;
-
-			VkPipelineColorBlendStateCreateInfo colorBlendInfo = {};
-			colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-			colorBlendInfo.logicOpEnable = VK_FALSE;
-			colorBlendInfo.attachmentCount = 1;
-			colorBlendInfo.pAttachments = &colorBlendAttchState;
+		void VlkRenderContext::RunAsyncCompute(VlkPass &pass) {
 
-			VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-			pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+			VlkTimeline &computeTimeline = sm_vlkDeviceP->GetTimeline(VlkDevice::QueueType::COMPUTE);
 
-			VkGraphicsPipelineCreateInfo pipelineInfo = {};
-			pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-			pipelineInfo.stageCount = newPass.m_shaderStagesInfo.size();
-			pipelineInfo.pStages = newPass.m_shaderStagesInfo.data();
-			pipelineInfo.pVertexInputState = &vertexInputStateInfo;
-			pipelineInfo.pInputAssemblyState = &inputAssemblyInfo;
-			pipelineInfo.pViewportState = &viewportInfo;
-			pipelineInfo.pRasterizationState = &rasterInfo;
-			pipelineInfo.pMultisampleState = &multisamplingInfo;
-			pipelineInfo.pDepthStencilState = nullptr;
-			pipelineInfo.pColorBlendState = &colorBlendInfo;
-			pipelineInfo.renderPass = m_vlkSwapchainP->GetVkRenderPass();
-			pipelineInfo.subpass = 0;
-			pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-			pipelineInfo.basePipelineIndex = -1;
-			
-			VkPipelineDynamicStateCreateInfo dynamicStateInfo = {};
-			dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-			dynamicStateInfo.dynamicStateCount = 3;
-			VkDynamicState dynamicStates[3] = { 
-				VK_DYNAMIC_STATE_LINE_WIDTH,
-				VK_DYNAMIC_STATE_VIEWPORT_WITH_COUNT,
-				VK_DYNAMIC_STATE_SCISSOR_WITH_COUNT
-			};
-			dynamicStateInfo.pDynamicStates = dynamicStates;
-			pipelineInfo.pDynamicState = &dynamicStateInfo;
-			
-			VkDevice device = VlkRenderContext::GetVlkDevice()->GetHandle();
+			VlkComputeFrame &frame = m_computeFrames[m_computeFrameNumber % m_computeFrames.size()];
+			m_computeFrameNumber++;
 
-			vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &newPass.m_vkPipelineLayout);
+			// The slot was last submitted <sm_framesInFlight> async passes ago - usually long complete
+			computeTimeline.WaitFor(frame.m_timelineValue);
+			sm_vlkDeviceP->CollectReleases();
+			vkResetCommandBuffer(frame.m_vkCommandBuffer, 0);
 
-			pipelineInfo.layout = newPass.m_vkPipelineLayout;
+			VkCommandBufferBeginInfo beginInfo = {};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+			vkBeginCommandBuffer(frame.m_vkCommandBuffer, &beginInfo);
+			m_commandState.Reset(frame.m_vkCommandBuffer);
+
+			// Not GPU profiled - timestamp queries belong to the graphics frames
+			std::vector<VlkSemaphoreWait> waits;
+			RecordPassBarriers(frame.m_vkCommandBuffer, pass, sm_vlkDeviceP->GetAsyncComputeQueue().second, computeTimeline.GetSubmittedValue() + 1u, waits);
+			RecordDispatch(frame.m_vkCommandBuffer, pass);
 
-			vkCreateGraphicsPipelines(device, nullptr, 1, &pipelineInfo, nullptr, &newPass.m_vkPipeline);
+			vkEndCommandBuffer(frame.m_vkCommandBuffer);
 
+			frame.m_timelineValue = sm_vlkDeviceP->Submit(VlkDevice::QueueType::COMPUTE, frame.m_vkCommandBuffer, waits);
+			m_stats.asyncComputeSubmits++;
 		}
 
-		VlkRenderContext::VlkPass::~VlkPass() {
+		uint64_t VlkRenderContext::SubmitOwnershipRelease(const uint32_t srcFamily, const std::vector<VkBufferMemoryBarrier> &releases, const VkPipelineStageFlags srcStages) {
 
-			VkDevice device = VlkRenderContext::GetVlkDevice()->GetHandle();
+			VkDevice device = sm_vlkDeviceP->GetHandle();
+			const bool fromCompute = srcFamily == sm_vlkDeviceP->GetAsyncComputeQueue().second;
+			VkCommandPool commandPool = fromCompute ? m_vkComputeCommandPool : m_vkCommandPool;
 
-			vkDeviceWaitIdle(device);
+			VkCommandBufferAllocateInfo commandBufferInfo = {};
+			commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			commandBufferInfo.commandBufferCount = 1u;
+			commandBufferInfo.commandPool = commandPool;
 
-			if (m_vkPipeline) {
-				vkDestroyPipeline(device, m_vkPipeline, nullptr);
-			}
-			if (m_vkPipelineLayout) {
-				vkDestroyPipelineLayout(device, m_vkPipelineLayout, nullptr);
-			}
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			vkAllocateCommandBuffers(device, &commandBufferInfo, &commandBuffer);
+
+			VkCommandBufferBeginInfo beginInfo = {};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
+			vkBeginCommandBuffer(commandBuffer, &beginInfo);
+			// Queue order puts the release after every earlier use of the buffers on their owning queue
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				srcStages ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0, 0u, nullptr, releases.size(), releases.data(), 0u, nullptr);
+			vkEndCommandBuffer(commandBuffer);
+
+			const uint64_t releaseValue = sm_vlkDeviceP->Submit(fromCompute ? VlkDevice::QueueType::COMPUTE : VlkDevice::QueueType::GRAPHICS, commandBuffer);
+
+			sm_vlkDeviceP->DeferRelease([device, commandPool, commandBuffer]() {
+				vkFreeCommandBuffers(device, commandPool, 1u, &commandBuffer);
+			});
+
+			return releaseValue;
 		}
 
-		void VlkRenderContext::BindShaderProgram(const VlkShaderProgram *shaderProgram) {
+		void VlkRenderContext::RecordDispatch(VkCommandBuffer commandBuffer, VlkPass &pass) {
 
-			if (!shaderProgram || !m_vlkPasses.size()) {
-				return;
+			m_commandState.BindPipeline(VK_PIPELINE_BIND_POINT_COMPUTE, pass.m_vkPipeline);
+
+			if (pass.m_vkDescriptorSet) {
+				m_commandState.BindDescriptorSet(VK_PIPELINE_BIND_POINT_COMPUTE, pass.m_vkPipelineLayout, pass.m_vkDescriptorSet);
 			}
 
-			VkPipelineShaderStageCreateInfo shaderInfo = {};
+			if (pass.m_indirectBufferP) {
+				vkCmdDispatchIndirect(commandBuffer, pass.m_indirectBufferP->GetHandle(), pass.m_indirectOffset);
+			}
+			else {
+				vkCmdDispatch(commandBuffer, pass.m_groupCount[0], pass.m_groupCount[1], pass.m_groupCount[2]);
+			}
+		}
+
+		void VlkRenderContext::RecordPassBarriers(VkCommandBuffer commandBuffer, const VlkPass &pass, const uint32_t family, const uint64_t signalValue, std::vector<VlkSemaphoreWait> &outWaits) {
+
+			if (pass.m_counterResets.size()) {
+
+				RecordBufferBarriers(commandBuffer, pass.m_counterAccesses, family, signalValue, outWaits);
+
+				for (auto &reset : pass.m_counterResets) {
+					vkCmdFillBuffer(commandBuffer, reset.first->GetHandle(), reset.second, sizeof(uint32_t), 0u);
+				}
+			}
+
+			// Counters just reset are seen as transfer writes, the pass waits for them like for uploads
+			RecordBufferBarriers(commandBuffer, pass.m_bufferAccesses, family, signalValue, outWaits);
+		}
+
+		void VlkRenderContext::RecordBufferBarriers(VkCommandBuffer commandBuffer, const std::vector<VlkBufferAccess> &accesses, const uint32_t family, const uint64_t signalValue, std::vector<VlkSemaphoreWait> &outWaits) {
+
+			static const VkAccessFlags writeAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT;
+
+			std::vector<VkBufferMemoryBarrier> barriers;
+			VkPipelineStageFlags srcStages = 0;
+			VkPipelineStageFlags dstStages = 0;
+
+			// Only two families exist, so every release comes from the other one
+			std::vector<VkBufferMemoryBarrier> releases;
+			std::vector<VkBufferMemoryBarrier> acquires;
+			VkPipelineStageFlags releaseStages = 0;
+			VkPipelineStageFlags acquireStages = 0;
+			uint32_t srcFamily = VK_QUEUE_FAMILY_IGNORED;
+
+			for (auto &access : accesses) {
+
+				VlkBufferState &state = m_bufferStates[access.m_vkBuffer];
+				VkPipelineStageFlags waitStages = 0;
+
+				if (state.m_ownerFamily != VK_QUEUE_FAMILY_IGNORED && state.m_ownerFamily != family) {
+
+					// Exclusive buffers keep their contents across families through a release on the owning queue
+					// and a matching acquire here, ordered by the timeline of the owning queue
+					VkBufferMemoryBarrier barrier = {};
+					barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+					barrier.srcAccessMask = state.m_writeAccess;
+					barrier.dstAccessMask = 0;
+					barrier.srcQueueFamilyIndex = state.m_ownerFamily;
+					barrier.dstQueueFamilyIndex = family;
+					barrier.buffer = access.m_vkBuffer;
+					barrier.offset = 0u;
+					barrier.size = VK_WHOLE_SIZE;
+					releases.push_back(barrier);
+
+					barrier.srcAccessMask = 0;
+					barrier.dstAccessMask = access.m_access;
+					acquires.push_back(barrier);
+
+					srcFamily = state.m_ownerFamily;
+					releaseStages |= state.m_writeStages | state.m_readStages;
+					acquireStages |= access.m_stages;
+
+					// The acquire made the contents visible to this access - later stages of this queue wait on it
+					state.m_writeStages = access.m_stages;
+					state.m_writeAccess = 0;
+					state.m_readStages = 0;
+				}
+				else if (access.m_write) {
+					// Write after write and write after read
+					waitStages = state.m_writeStages | state.m_readStages;
+				}
+				else if ((state.m_readStages & access.m_stages) != access.m_stages) {
+					// Read after write - stages that already waited for the write do not wait again
+					waitStages = state.m_writeStages;
+				}
+
+				if (waitStages) {
+					VkBufferMemoryBarrier barrier = {};
+					barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+					barrier.srcAccessMask = state.m_writeAccess;
+					barrier.dstAccessMask = access.m_access;
+					barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.buffer = access.m_vkBuffer;
+					barrier.offset = 0u;
+					barrier.size = VK_WHOLE_SIZE;
+					barriers.push_back(barrier);
+
+					srcStages |= waitStages;
+					dstStages |= access.m_stages;
+				}
+
+				if (access.m_write) {
+					state.m_writeStages = access.m_stages;
+					state.m_writeAccess = access.m_access & writeAccessMask;
+					state.m_readStages = 0;
+				}
+				else {
+					state.m_readStages |= access.m_stages;
+				}
+
+				state.m_ownerFamily = family;
+				state.m_lastUseValue = signalValue;
+			}
+
+			if (acquires.size()) {
+				// The wait stages match the acquire source stages, chaining the semaphore wait into the barrier
+				const bool fromCompute = srcFamily == sm_vlkDeviceP->GetAsyncComputeQueue().second;
+
+				VlkSemaphoreWait wait;
+				wait.semaphore = sm_vlkDeviceP->GetTimeline(fromCompute ? VlkDevice::QueueType::COMPUTE : VlkDevice::QueueType::GRAPHICS).GetHandle();
+				wait.value = SubmitOwnershipRelease(srcFamily, releases, releaseStages);
+				wait.stages = acquireStages;
+				outWaits.push_back(wait);
+
+				vkCmdPipelineBarrier(commandBuffer, acquireStages, acquireStages, 0, 0u, nullptr, acquires.size(), acquires.data(), 0u, nullptr);
+				m_stats.queueOwnershipTransfers += acquires.size();
+			}
+
+			if (barriers.size()) {
+				vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0u, nullptr, barriers.size(), barriers.data(), 0u, nullptr);
+				m_stats.bufferBarriers += barriers.size();
+			}
+		}
+
+		void VlkRenderContext::SyncBufferUpload(VkBuffer buffer) {
+
+			auto it = m_bufferStates.find(buffer);
+
+			if (it == m_bufferStates.end() || !m_vkComputeCommandPool || it->second.m_ownerFamily != sm_vlkDeviceP->GetAsyncComputeQueue().second) {
+				return;
+			}
+
+			sm_vlkDeviceP->GetTimeline(VlkDevice::QueueType::COMPUTE).WaitFor(it->second.m_lastUseValue);
+		}
+
+		void VlkRenderContext::SyncHostWrite(VkBuffer buffer) {
+
+			auto it = m_bufferStates.find(buffer);
+
+			if (it == m_bufferStates.end() || !it->second.m_lastUseValue) {
+				return;
+			}
+
+			// Usually long complete - frames in flight only hold it up when they read the buffer themselves
+			const bool computeOwned = m_vkComputeCommandPool && it->second.m_ownerFamily == sm_vlkDeviceP->GetAsyncComputeQueue().second;
+			sm_vlkDeviceP->GetTimeline(computeOwned ? VlkDevice::QueueType::COMPUTE : VlkDevice::QueueType::GRAPHICS).WaitFor(it->second.m_lastUseValue);
+		}
+
+		void VlkRenderContext::RecordBufferWrite(VkBuffer buffer, const VkPipelineStageFlags stages, const VkAccessFlags access) {
+			VlkBufferState &state = m_bufferStates[buffer];
+			state.m_writeStages = stages;
+			state.m_writeAccess = access;
+			state.m_readStages = 0;
+			// Uploads replace the whole contents on the graphics queue - no ownership transfer is needed to take it over
+			state.m_ownerFamily = sm_vlkDeviceP->GetActiveQueue().second;
+			state.m_lastUseValue = 0u;
+		}
+
+		void VlkRenderContext::ReleaseBufferState(VkBuffer buffer) {
+			m_bufferStates.erase(buffer);
+		}
+
+		void VlkRenderContext::PresentFrame() {
+
+			VlkCpuScope cpuScope(m_vlkProfilerP, "PresentFrame");
+
+			// Compute passes and passes not rendering to the screen leave nothing to present
+			if (!m_vlkSwapchainP || !m_presentPending) {
+				return;
+			}
+
+			m_presentPending = false;
+
+			VkPresentInfoKHR presentInfo{};
+			presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+			presentInfo.waitSemaphoreCount = 1u;
+			presentInfo.pWaitSemaphores = &m_renderDone[m_frameIndex];
+			presentInfo.swapchainCount = 1u;
+			VkSwapchainKHR swapchain = m_vlkSwapchainP->GetHandle();
+			presentInfo.pSwapchains = &swapchain;
+			presentInfo.pImageIndices = &m_frameIndex;
+
+			vkQueuePresentKHR(sm_vlkDeviceP->GetActiveQueue().first, &presentInfo);
+		}
+
+		bool VlkRenderContext::ReadbackFrame(ReadbackCallback callback) {
+
+			if (m_vlkSwapchainP && !m_vlkSwapchainP->ReadbackSupported()) {
+				return false;
+			}
+
+			return m_vlkReadbackP->Request(std::move(callback));
+		}
+
+		void VlkRenderContext::FlushReadbacks() {
+
+			uint64_t lastFrameValue = 0u;
+
+			for (auto &frame : m_frames) {
+				lastFrameValue = std::max(lastFrameValue, frame.m_timelineValue);
+			}
+
+			sm_vlkDeviceP->GetTimeline(VlkDevice::QueueType::GRAPHICS).WaitFor(lastFrameValue);
+
+			m_completedFrameNumber = m_frameNumber;
+			m_vlkReadbackP->Deliver(m_completedFrameNumber);
+			ReleaseRetiredTargets();
+			sm_vlkDeviceP->CollectReleases();
+
+			for (uint32_t i = 0; i < m_frames.size(); i++) {
+				m_vlkProfilerP->ResolveFrame(i);
+			}
+		}
+
+		bool VlkRenderContext::SetRenderTarget(const uint32_t width, const uint32_t height) {
+
+			if (m_vlkSwapchainP || !width || !height) {
+				return false;
+			}
+
+			if (m_vlkTargetP) {
+				VkExtent2D extent = m_vlkTargetP->GetExtent();
+				if (extent.width == width && extent.height == height) {
+					return true;
+				}
+				// Frames in flight may still render into it - released once they complete
+				m_retiredTargets.push_back(m_vlkTargetP);
+				m_vlkTargetP = nullptr;
+			}
+
+			// Reuse a retired target of the same size instead of allocating a new one
+			for (auto it = m_retiredTargets.begin(); it != m_retiredTargets.end(); it++) {
+				VkExtent2D extent = (*it)->GetExtent();
+				if (extent.width == width && extent.height == height) {
+					m_vlkTargetP = *it;
+					m_retiredTargets.erase(it);
+					return true;
+				}
+			}
+
+			m_vlkTargetP = new VlkOffscreenTarget(m_vkWinSurfaceFormat.format, { width, height }, sm_framesInFlight);
+
+			return true;
+		}
+
+		RenderStats VlkRenderContext::GetStats() const {
+			RenderStats stats = m_stats;
+			stats.framesSubmitted = m_frameNumber;
+			stats.framesCompleted = m_completedFrameNumber;
+			stats.hostAllocations = sm_vlkDeviceP->GetHostAllocator().GetAllocationCount();
+			stats.commandsIssued = m_commandState.GetIssuedCount();
+			stats.commandsSkipped = m_commandState.GetSkippedCount();
+			stats.drawQueueArenaBytes = m_drawQueue.GetArena().GetCapacity();
+			stats.drawQueueArenaBlocks = m_drawQueue.GetArena().GetBlockAllocations();
+			stats.graphicsPipelines = m_vlkPipelineCacheP->GetCompiledCount();
+			stats.pipelineReuses = m_vlkPipelineCacheP->GetReuseCount();
+			stats.samplers = m_vlkSamplerCacheP->GetCreatedCount();
+			stats.samplerReuses = m_vlkSamplerCacheP->GetReuseCount();
+			stats.stagingBytes = m_vlkUploadBatcherP->GetStagingCapacity();
+			return stats;
+		}
+
+		void VlkRenderContext::GetHostMemoryUsage(std::vector<HostMemoryUsage> &outUsage) const {
+			sm_vlkDeviceP->GetHostAllocator().GetUsage(outUsage);
+		}
+
+		MemoryTelemetry VlkRenderContext::GetMemoryTelemetry() const {
+			return sm_vlkDeviceP->GetMemoryTracker().GetTelemetry();
+		}
+
+		void VlkRenderContext::SetMemorySoftLimit(const float budgetFraction) {
+			sm_vlkDeviceP->GetMemoryTracker().SetSoftLimit(budgetFraction);
+		}
+
+		uint32_t VlkRenderContext::AddMemoryEvictionCallback(MemoryEvictionCallback callback) {
+			return sm_vlkDeviceP->GetMemoryTracker().AddEvictionCallback(std::move(callback));
+		}
+
+		void VlkRenderContext::RemoveMemoryEvictionCallback(const uint32_t id) {
+			sm_vlkDeviceP->GetMemoryTracker().RemoveEvictionCallback(id);
+		}
+
+		std::string VlkRenderContext::GetDeviceName() const {
+			return sm_vlkDeviceP->GetActiveAdapter().GetProperties().deviceName;
+		}
+
+		void VlkRenderContext::SetProfiling(const bool enabled) {
+			m_vlkProfilerP->SetEnabled(enabled);
+		}
+
+		void VlkRenderContext::SetPassQueries(const bool enabled) {
+			m_vlkProfilerP->SetQueriesEnabled(enabled);
+		}
+
+		void VlkRenderContext::GetProfileHistory(std::vector<ProfileEvent> &outEvents) const {
+			m_vlkProfilerP->GetHistory(outEvents);
+		}
+
+		void VlkRenderContext::TakeProfileHistory(std::vector<ProfileEvent> &outEvents) {
+			m_vlkProfilerP->TakeHistory(outEvents);
+		}
+
+		bool VlkRenderContext::WriteProfileTrace(const std::string &path) const {
+			return m_vlkProfilerP->WriteTrace(path);
+		}
+
+		void VlkRenderContext::RecordUpload(const uint64_t bytes, const uint32_t submits) {
+			m_stats.bytesUploaded += bytes;
+			m_stats.uploadSubmits += submits;
+		}
+
+		void VlkRenderContext::RecordAllocation(const uint64_t bytes) {
+			m_stats.memoryAllocations++;
+			m_stats.memoryBytesAllocated += bytes;
+		}
+
+		VkFormat GetVkFormat(BufferDataType shaderDataType) {
+			switch (shaderDataType)
+			{
+			case BufferDataType::int1:		return VK_FORMAT_R32_SINT;
+			case BufferDataType::int2:		return VK_FORMAT_R32G32_SINT;
+			case BufferDataType::int3:		return VK_FORMAT_R32G32B32_SINT;
+			case BufferDataType::int4:		return VK_FORMAT_R32G32B32A32_SINT;
+			case BufferDataType::uint1:		return VK_FORMAT_R32_UINT;
+			case BufferDataType::uint2:		return VK_FORMAT_R32G32_UINT;
+			case BufferDataType::uint3:		return VK_FORMAT_R32G32B32_UINT;
+			case BufferDataType::uint4:		return VK_FORMAT_R32G32B32A32_UINT;
+			case BufferDataType::float1:	return VK_FORMAT_R32_SFLOAT;
+			case BufferDataType::float2:	return VK_FORMAT_R32G32_SFLOAT;
+			case BufferDataType::float3:	return VK_FORMAT_R32G32B32_SFLOAT;
+			case BufferDataType::float4:	return VK_FORMAT_R32G32B32A32_SFLOAT;
+			default: break;
+			}
+			return VK_FORMAT_UNDEFINED;
+		}
+
+		template<typename Handle>
+		static uint16_t GetSortId(std::unordered_map<Handle, uint16_t> &ids, Handle handle) {
+			// Ids wrap after 65536 handles - draws then only sort less tightly
+			return ids.emplace(handle, static_cast<uint16_t>(ids.size())).first->second;
+		}
+
+		void VlkRenderContext::EndPass() {
+
+			VlkCpuScope cpuScope(m_vlkProfilerP, "EndPass");
+
+			if (!m_vlkPasses.size())
+				return;
+
+			VlkPass &newPass = *m_vlkPasses.rbegin();
+			newPass.m_name = "Pass " + std::to_string(m_vlkPasses.size() - 1u);
+
+			VkDevice device = VlkRenderContext::GetVlkDevice()->GetHandle();
+
+			CreatePassLayout(newPass);
+
+			if (newPass.m_vkBindPoint == VK_PIPELINE_BIND_POINT_COMPUTE) {
+
+				if (newPass.m_shaderStagesInfo.size() != 1u) {
+					throw new std::runtime_error("VlkRenderContext EndPass failed - a compute pass takes a single compute shader.");
+				}
+				// Textures are owned by the graphics queue and uploaded by batches only it waits for
+				if (newPass.m_asyncCompute && newPass.m_textures.size()) {
+					throw new std::runtime_error("VlkRenderContext EndPass failed - async compute passes cannot bind textures.");
+				}
+				// Compute shaders read buffers through descriptors only - vertex and index buffers have no binding there
+				for (auto buffer : newPass.m_buffers) {
+					if (buffer->GetType() == BufferType::VertexBuffer || buffer->GetType() == BufferType::IndexBuffer) {
+						throw new std::runtime_error("VlkRenderContext EndPass failed - compute passes cannot bind vertex or index buffers.");
+					}
+				}
+
+				VkComputePipelineCreateInfo computePipelineInfo = {};
+				computePipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+				computePipelineInfo.stage = newPass.m_shaderStagesInfo[0];
+				computePipelineInfo.layout = newPass.m_vkPipelineLayout;
+				computePipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+				computePipelineInfo.basePipelineIndex = -1;
+
+				vkCreateComputePipelines(device, nullptr, 1, &computePipelineInfo, sm_vlkDeviceP->GetAllocationCallbacks(VlkHostAllocator::PIPELINE), &newPass.m_vkPipeline);
+
+				if (!newPass.m_vkPipeline) {
+					throw new std::runtime_error("VlkRenderContext EndPass failed - cannot create compute pipeline.");
+				}
+
+				return;
+			}
+
+			if (newPass.m_drawCommandsP && !newPass.m_indexBufferP) {
+				throw new std::runtime_error("VlkRenderContext EndPass failed - indexed indirect draws need an index buffer bound to the pass.");
+			}
+
+			std::vector<const VlkBuffer*> vbos;
+
+			for (auto buffer : newPass.m_buffers) {
+				if (buffer->GetType() == BufferType::VertexBuffer) {
+					vbos.push_back(buffer);
+				}
+			}
+
+			if (vbos.size()) {
+				newPass.m_vertexCount = UINT32_MAX;
+				for (auto buffer : vbos) {
+					newPass.m_vertexCount = std::min(newPass.m_vertexCount, buffer->GetSize() / buffer->GetLayout().GetSize());
+					newPass.m_vkVertexBuffers.push_back(buffer->GetHandle());
+				}
+				newPass.m_vertexOffsets.assign(vbos.size(), 0u);
+			}
+
+			std::vector<VkVertexInputBindingDescription> vtxBindings(vbos.size());
+			std::vector<VkVertexInputAttributeDescription> vtxAttributeDescs;
+			uint32_t location = 0;
+
+			for (uint32_t i = 0; i < vtxBindings.size(); i++) {
+
+				vtxBindings[i].binding = i;
+				vtxBindings[i].stride = vbos[i]->GetLayout().GetSize();
+				vtxBindings[i].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+				for (uint32_t j = 0; j < vbos[i]->GetLayout().GetAttributeCount(); j++) {
+
+					VkVertexInputAttributeDescription vtxAttributeDesc = {};
+					BufferAttribute attribute = vbos[i]->GetLayout().GetAttribute(j);
+					vtxAttributeDesc.binding = i;
+					vtxAttributeDesc.location = location;
+					vtxAttributeDesc.offset = attribute.m_offset;
+					vtxAttributeDesc.format = GetVkFormat(attribute.m_shaderDataType);
+					// Matrices have no vertex format - they are passed as one vector attribute per column
+					if (vtxAttributeDesc.format == VK_FORMAT_UNDEFINED) {
+						throw new std::runtime_error("VlkRenderContext EndPass failed - vertex attribute " + attribute.m_name + " has no vertex format.");
+					}
+					vtxAttributeDescs.push_back(vtxAttributeDesc);
+					location++;
+				}
+
+			}
+
+			VlkGraphicsPipelineDesc pipelineDesc;
+			pipelineDesc.stages = newPass.m_shaderStagesInfo;
+			pipelineDesc.vertexBindings = std::move(vtxBindings);
+			pipelineDesc.vertexAttributes = std::move(vtxAttributeDescs);
+			pipelineDesc.descriptorBindings = newPass.m_descriptorBindings;
+			pipelineDesc.pipelineLayout = newPass.m_vkPipelineLayout;
+			pipelineDesc.colorFormat = GetColorFormat();
+			pipelineDesc.depthFormat = m_depthFormat;
+
+			// The color draw only tests against the depth its pre-pass laid down
+			if (newPass.m_depthPrePass) {
+				newPass.m_renderState.depthTest = true;
+				newPass.m_renderState.depthWrite = false;
+			}
+
+			pipelineDesc.renderState = newPass.m_renderState;
+
+			// Shared with every pass differing only in dynamic state - owned by the pipeline cache
+			newPass.m_vkPipeline = m_vlkPipelineCacheP->GetGraphicsPipeline(pipelineDesc);
+
+			if (!newPass.m_vkPipeline) {
+				throw new std::runtime_error("VlkRenderContext EndPass failed - cannot create graphics pipeline.");
+			}
+
+			if (newPass.m_depthPrePass) {
+
+				// Depth only needs the vertex stage
+				VlkGraphicsPipelineDesc depthDesc = pipelineDesc;
+				depthDesc.depthOnly = true;
+				depthDesc.renderState.depthWrite = true;
+				depthDesc.stages.erase(
+					std::remove_if(depthDesc.stages.begin(), depthDesc.stages.end(), [](const VkPipelineShaderStageCreateInfo &stage) { return stage.stage != VK_SHADER_STAGE_VERTEX_BIT; }),
+					depthDesc.stages.end());
+
+				newPass.m_depthRenderState = depthDesc.renderState;
+				newPass.m_vkDepthPipeline = m_vlkPipelineCacheP->GetGraphicsPipeline(depthDesc);
+
+				if (!newPass.m_vkDepthPipeline) {
+					throw new std::runtime_error("VlkRenderContext EndPass failed - cannot create depth pre-pass pipeline.");
+				}
+			}
+
+			newPass.m_pipelineSortId = GetSortId(m_pipelineSortIds, newPass.m_vkPipeline);
+			newPass.m_materialSortId = GetSortId(m_materialSortIds, newPass.m_vkDescriptorSet);
+		}
+
+		static VkShaderStageFlags GetVkShaderStage(const ShaderProgramType type) {
+			switch (type)
+			{
+			case ShaderProgramType::VertexShader:	return VK_SHADER_STAGE_VERTEX_BIT;
+			case ShaderProgramType::FragmentShader:	return VK_SHADER_STAGE_FRAGMENT_BIT;
+			case ShaderProgramType::ComputeShader:	return VK_SHADER_STAGE_COMPUTE_BIT;
+			default: break;
+			}
+			return VK_SHADER_STAGE_ALL_GRAPHICS;
+		}
+
+		static VkPipelineStageFlags GetVkPipelineStage(const ShaderProgramType type) {
+			switch (type)
+			{
+			case ShaderProgramType::VertexShader:	return VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+			case ShaderProgramType::FragmentShader:	return VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			case ShaderProgramType::ComputeShader:	return VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			default: break;
+			}
+			return VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		}
+
+		void VlkRenderContext::CreatePassLayout(VlkPass &pass) {
+
+			VkDevice device = sm_vlkDeviceP->GetHandle();
+			const bool computePass = pass.m_vkBindPoint == VK_PIPELINE_BIND_POINT_COMPUTE;
+
+			std::vector<VkDescriptorSetLayoutBinding> bindings;
+			std::vector<VkDescriptorBufferInfo> bufferInfos;
+
+			auto addAccess = [&pass](const VlkBufferAccess &access) {
+				// A buffer bound in several roles gets a single barrier covering all of them
+				for (auto &existing : pass.m_bufferAccesses) {
+					if (existing.m_vkBuffer == access.m_vkBuffer) {
+						existing.m_stages |= access.m_stages;
+						existing.m_access |= access.m_access;
+						existing.m_write |= access.m_write;
+						return;
+					}
+				}
+				pass.m_bufferAccesses.push_back(access);
+			};
+
+			for (auto bufferP : pass.m_buffers) {
+
+				VlkBufferAccess access;
+				access.m_vkBuffer = bufferP->GetHandle();
+
+				const BufferType type = bufferP->GetType();
+
+				if (type == BufferType::VertexBuffer && !computePass) {
+					access.m_stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+					access.m_access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+				}
+				else if (type == BufferType::IndexBuffer && !computePass) {
+					// The first index buffer bound feeds indexed draws
+					if (!pass.m_indexBufferP) {
+						pass.m_indexBufferP = bufferP;
+					}
+					access.m_stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+					access.m_access = VK_ACCESS_INDEX_READ_BIT;
+				}
+				else if (type == BufferType::UniformBuffer || type == BufferType::StorageBuffer) {
+
+					const bool uniform = type == BufferType::UniformBuffer;
+
+					VkDescriptorSetLayoutBinding binding = {};
+					binding.binding = bindings.size();
+					binding.descriptorType = uniform ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+					binding.descriptorCount = 1u;
+					binding.stageFlags = computePass ? VK_SHADER_STAGE_COMPUTE_BIT : GetVkShaderStage(bufferP->GetBindStage());
+					bindings.push_back(binding);
+
+					VkDescriptorBufferInfo bufferInfo = {};
+					bufferInfo.buffer = access.m_vkBuffer;
+					bufferInfo.offset = 0u;
+					bufferInfo.range = VK_WHOLE_SIZE;
+					bufferInfos.push_back(bufferInfo);
+
+					// Storage buffers are taken as written by compute passes and read-only in graphics passes
+					access.m_stages = computePass ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : GetVkPipelineStage(bufferP->GetBindStage());
+					access.m_access = uniform ? VK_ACCESS_UNIFORM_READ_BIT : VK_ACCESS_SHADER_READ_BIT;
+					access.m_write = !uniform && computePass;
+
+					if (access.m_write) {
+						access.m_access |= VK_ACCESS_SHADER_WRITE_BIT;
+					}
+				}
+				else {
+					continue;
+				}
+
+				addAccess(access);
+			}
+
+			for (auto indirectBufferP : { pass.m_indirectBufferP, pass.m_drawCommandsP, pass.m_drawCountP }) {
+				if (indirectBufferP) {
+					VlkBufferAccess access;
+					access.m_vkBuffer = indirectBufferP->GetHandle();
+					access.m_stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+					access.m_access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+					addAccess(access);
+				}
+			}
+
+			pass.m_counterAccesses.clear();
+
+			for (auto &reset : pass.m_counterResets) {
+
+				const VkBuffer counterBuffer = reset.first->GetHandle();
+
+				if (std::none_of(pass.m_counterAccesses.begin(), pass.m_counterAccesses.end(), [counterBuffer](const VlkBufferAccess &access) { return access.m_vkBuffer == counterBuffer; })) {
+					VlkBufferAccess access;
+					access.m_vkBuffer = counterBuffer;
+					access.m_stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+					access.m_access = VK_ACCESS_TRANSFER_WRITE_BIT;
+					access.m_write = true;
+					pass.m_counterAccesses.push_back(access);
+				}
+			}
+
+			// Textures follow the buffers - uploads leave them in SHADER_READ_ONLY_OPTIMAL, ordered by the graphics queue
+			for (auto textureP : pass.m_textures) {
+
+				VkDescriptorSetLayoutBinding binding = {};
+				binding.binding = bindings.size();
+				binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				binding.descriptorCount = 1u;
+				binding.stageFlags = computePass ? VK_SHADER_STAGE_COMPUTE_BIT : GetVkShaderStage(textureP->GetDesc().bindStage);
+				bindings.push_back(binding);
+			}
+
+			pass.m_descriptorBindings = bindings;
+
+			if (bindings.size()) {
+
+				VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+				setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+				setLayoutInfo.bindingCount = bindings.size();
+				setLayoutInfo.pBindings = bindings.data();
+
+				vkCreateDescriptorSetLayout(device, &setLayoutInfo, sm_vlkDeviceP->GetAllocationCallbacks(VlkHostAllocator::DESCRIPTOR), &pass.m_vkDescriptorSetLayout);
+
+				pass.m_descriptorBufferInfos = bufferInfos;
+				CreatePassDescriptorSet(pass);
+			}
+
+			VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+			pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+			pipelineLayoutInfo.setLayoutCount = pass.m_vkDescriptorSetLayout ? 1u : 0u;
+			pipelineLayoutInfo.pSetLayouts = &pass.m_vkDescriptorSetLayout;
+
+			vkCreatePipelineLayout(device, &pipelineLayoutInfo, sm_vlkDeviceP->GetAllocationCallbacks(VlkHostAllocator::PIPELINE), &pass.m_vkPipelineLayout);
+		}
+
+		void VlkRenderContext::CreatePassDescriptorSet(VlkPass &pass) {
+
+			VkDevice device = sm_vlkDeviceP->GetHandle();
+
+			std::vector<VkDescriptorPoolSize> poolSizes;
+
+			for (auto &binding : pass.m_descriptorBindings) {
+
+				auto poolSize = std::find_if(poolSizes.begin(), poolSizes.end(), [&binding](const VkDescriptorPoolSize &size) { return size.type == binding.descriptorType; });
+
+				if (poolSize == poolSizes.end()) {
+					poolSizes.push_back({ binding.descriptorType, 1u });
+				}
+				else {
+					poolSize->descriptorCount++;
+				}
+			}
+
+			VkDescriptorPoolCreateInfo poolInfo = {};
+			poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+			poolInfo.maxSets = 1u;
+			poolInfo.poolSizeCount = poolSizes.size();
+			poolInfo.pPoolSizes = poolSizes.data();
+
+			pass.m_vkDescriptorPool = VK_NULL_HANDLE;
+			pass.m_vkDescriptorSet = VK_NULL_HANDLE;
+
+			vkCreateDescriptorPool(device, &poolInfo, sm_vlkDeviceP->GetAllocationCallbacks(VlkHostAllocator::DESCRIPTOR), &pass.m_vkDescriptorPool);
+
+			if (pass.m_vkDescriptorSetLayout && pass.m_vkDescriptorPool) {
+				VkDescriptorSetAllocateInfo setInfo = {};
+				setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+				setInfo.descriptorPool = pass.m_vkDescriptorPool;
+				setInfo.descriptorSetCount = 1u;
+				setInfo.pSetLayouts = &pass.m_vkDescriptorSetLayout;
+
+				vkAllocateDescriptorSets(device, &setInfo, &pass.m_vkDescriptorSet);
+			}
+
+			if (!pass.m_vkDescriptorSet) {
+				throw new std::runtime_error("VlkRenderContext EndPass failed - cannot create descriptor set.");
+			}
+
+			std::vector<VkDescriptorImageInfo> imageInfos;
+			pass.m_textureVersions.clear();
+
+			for (auto textureP : pass.m_textures) {
+				VkDescriptorImageInfo imageInfo = {};
+				imageInfo.sampler = textureP->GetVkSampler();
+				imageInfo.imageView = textureP->GetVkImageView();
+				imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				imageInfos.push_back(imageInfo);
+				pass.m_textureVersions.push_back(textureP->GetImageVersion());
+			}
+
+			// Buffers never change for the lifetime of the pass - the set is rewritten only when a texture reallocates its image
+			std::vector<VkWriteDescriptorSet> writes(pass.m_descriptorBindings.size());
+			const size_t bufferCount = pass.m_descriptorBufferInfos.size();
+
+			for (uint32_t i = 0; i < writes.size(); i++) {
+				writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				writes[i].dstSet = pass.m_vkDescriptorSet;
+				writes[i].dstBinding = pass.m_descriptorBindings[i].binding;
+				writes[i].descriptorCount = 1u;
+				writes[i].descriptorType = pass.m_descriptorBindings[i].descriptorType;
+				if (i < bufferCount) {
+					writes[i].pBufferInfo = &pass.m_descriptorBufferInfos[i];
+				}
+				else {
+					writes[i].pImageInfo = &imageInfos[i - bufferCount];
+				}
+			}
+
+			vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0u, nullptr);
+		}
+
+		void VlkRenderContext::RefreshPassTextures(VlkPass &pass) {
+
+			bool changed = false;
+
+			for (uint32_t i = 0; i < pass.m_textures.size(); i++) {
+				changed |= pass.m_textures[i]->GetImageVersion() != pass.m_textureVersions[i];
+			}
+
+			if (!changed) {
+				return;
+			}
+
+			// Frames already submitted keep sampling the old images through the old set - the sort id stays with the pass
+			sm_vlkDeviceP->DeferRelease([deviceP = sm_vlkDeviceP, descriptorPool = pass.m_vkDescriptorPool]() {
+				vkDestroyDescriptorPool(deviceP->GetHandle(), descriptorPool, deviceP->GetAllocationCallbacks(VlkHostAllocator::DESCRIPTOR));
+			});
+
+			CreatePassDescriptorSet(pass);
+			m_stats.descriptorRefreshes++;
+		}
+
+		void VlkRenderContext::Dispatch(const uint32_t groupCountX, const uint32_t groupCountY, const uint32_t groupCountZ) {
+
+			if (!m_vlkPasses.size()) {
+				return;
+			}
+
+			const uint32_t groupCount[3] = { groupCountX, groupCountY, groupCountZ };
+			const VkPhysicalDeviceLimits &limits = sm_vlkDeviceP->GetActiveAdapter().GetProperties().limits;
+
+			for (uint32_t i = 0; i < 3u; i++) {
+				if (groupCount[i] > limits.maxComputeWorkGroupCount[i]) {
+					throw new std::runtime_error("VlkRenderContext Dispatch failed - workgroup count exceeds the device limit.");
+				}
+			}
+
+			VlkPass &newPass = *m_vlkPasses.rbegin();
+			std::copy(std::begin(groupCount), std::end(groupCount), std::begin(newPass.m_groupCount));
+			newPass.m_indirectBufferP = nullptr;
+		}
+
+		void VlkRenderContext::DispatchIndirect(const Buffer *argumentsP, const uint32_t offset) {
+
+			if (!m_vlkPasses.size() || !argumentsP) {
+				return;
+			}
+
+			// VkDispatchIndirectCommand - three uint32 at a 4 byte aligned offset
+			if (argumentsP->GetType() != BufferType::StorageBuffer || offset % 4u || offset + 12u > argumentsP->GetSize()) {
+				throw new std::runtime_error("VlkRenderContext DispatchIndirect failed - arguments must be 12 bytes of a storage buffer at a 4 byte aligned offset.");
+			}
+
+			VlkPass &newPass = *m_vlkPasses.rbegin();
+			newPass.m_indirectBufferP = static_cast<const VlkBuffer *>(argumentsP);
+			newPass.m_indirectOffset = offset;
+		}
+
+		void VlkRenderContext::DrawIndexedIndirectCount(
+			const Buffer *commandsP,
+			const Buffer *countP,
+			const uint32_t maxDrawCount,
+			const uint32_t commandsOffset,
+			const uint32_t countOffset) {
+
+			if (!m_vlkPasses.size() || !commandsP || !countP) {
+				return;
+			}
+
+			if (!sm_vlkDeviceP->GetEnabledFeatures12().drawIndirectCount) {
+				throw new std::runtime_error("VlkRenderContext DrawIndexedIndirectCount failed - the device does not support drawIndirectCount.");
+			}
+
+			if (maxDrawCount > 1u && !sm_vlkDeviceP->GetEnabledFeatures().multiDrawIndirect) {
+				throw new std::runtime_error("VlkRenderContext DrawIndexedIndirectCount failed - the device does not support multiDrawIndirect.");
+			}
+
+			// Culling passes write the object index as first instance
+			if (!sm_vlkDeviceP->GetEnabledFeatures().drawIndirectFirstInstance) {
+				throw new std::runtime_error("VlkRenderContext DrawIndexedIndirectCount failed - the device does not support drawIndirectFirstInstance.");
+			}
+
+			const VkPhysicalDeviceLimits &limits = sm_vlkDeviceP->GetActiveAdapter().GetProperties().limits;
+			const uint64_t commandsEnd = commandsOffset + static_cast<uint64_t>(maxDrawCount) * sizeof(VkDrawIndexedIndirectCommand);
+
+			if (maxDrawCount > limits.maxDrawIndirectCount) {
+				throw new std::runtime_error("VlkRenderContext DrawIndexedIndirectCount failed - draw count exceeds the device limit.");
+			}
+
+			if (commandsP->GetType() != BufferType::StorageBuffer || countP->GetType() != BufferType::StorageBuffer ||
+				commandsOffset % 4u || countOffset % 4u ||
+				commandsEnd > commandsP->GetSize() || countOffset + 4u > countP->GetSize()) {
+				throw new std::runtime_error("VlkRenderContext DrawIndexedIndirectCount failed - commands and count must lie in storage buffers at 4 byte aligned offsets.");
+			}
+
+			VlkPass &newPass = *m_vlkPasses.rbegin();
+			newPass.m_drawCommandsP = static_cast<const VlkBuffer *>(commandsP);
+			newPass.m_drawCountP = static_cast<const VlkBuffer *>(countP);
+			newPass.m_drawCommandsOffset = commandsOffset;
+			newPass.m_drawCountOffset = countOffset;
+			newPass.m_maxDrawCount = maxDrawCount;
+		}
+
+		void VlkRenderContext::ResetCounter(const Buffer *bufferP, const uint32_t offset) {
+
+			if (!m_vlkPasses.size() || !bufferP) {
+				return;
+			}
+
+			if (bufferP->GetType() != BufferType::StorageBuffer || offset % 4u || offset + 4u > bufferP->GetSize()) {
+				throw new std::runtime_error("VlkRenderContext ResetCounter failed - counters are 4 byte aligned uint32 of a storage buffer.");
+			}
+
+			m_vlkPasses.rbegin()->m_counterResets.emplace_back(static_cast<const VlkBuffer *>(bufferP), offset);
+		}
+
+		void VlkRenderContext::SetPrimitiveType(const int type) {
+
+			if (!m_vlkPasses.size()) {
+				return;
+			}
+
+			if (type < PrimitiveType::PointList || type > PrimitiveType::TriangleFan) {
+				throw new std::runtime_error("VlkRenderContext SetPrimitiveType failed - unknown primitive type.");
+			}
+
+			// PrimitiveType follows VkPrimitiveTopology
+			m_vlkPasses.rbegin()->m_renderState.topology = static_cast<VkPrimitiveTopology>(type);
+		}
+
+		void VlkRenderContext::SetLineWidth(const float width) {
+
+			if (!m_vlkPasses.size()) {
+				return;
+			}
+
+			const float *rangeP = sm_vlkDeviceP->GetActiveAdapter().GetProperties().limits.lineWidthRange;
+			m_vlkPasses.rbegin()->m_lineWidth = std::clamp(width, rangeP[0], rangeP[1]);
+		}
+
+		void VlkRenderContext::SetMultisampling(const int sampleCount) {
+
+			if (!m_vlkPasses.size()) {
+				return;
+			}
+
+			if (sampleCount < 1 || sampleCount > 64 || (sampleCount & (sampleCount - 1))) {
+				throw new std::runtime_error("VlkRenderContext SetMultisampling failed - sample count must be a power of two up to 64.");
+			}
+
+			// Color and depth attachments are multisampled alike
+			const VkPhysicalDeviceLimits &limits = sm_vlkDeviceP->GetActiveAdapter().GetProperties().limits;
+			const VkSampleCountFlags supported = limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts;
+			uint32_t samples = static_cast<uint32_t>(sampleCount);
+
+			while (samples > 1u && !(supported & samples)) {
+				samples >>= 1u;
+			}
+
+			m_vlkPasses.rbegin()->m_renderState.samples = static_cast<VkSampleCountFlagBits>(samples);
+		}
+
+		void VlkRenderContext::SetDepthTesting(const bool enabled) {
+
+			if (!m_vlkPasses.size()) {
+				return;
+			}
+
+			m_vlkPasses.rbegin()->m_renderState.depthTest = enabled;
+			m_vlkPasses.rbegin()->m_renderState.depthWrite = enabled;
+		}
+
+		void VlkRenderContext::SetDepthPrePass(const bool enabled) {
+
+			if (!m_vlkPasses.size()) {
+				return;
+			}
+
+			m_vlkPasses.rbegin()->m_depthPrePass = enabled;
+		}
+
+		void VlkRenderContext::SetCullMode(const CullMode mode) {
+
+			if (!m_vlkPasses.size()) {
+				return;
+			}
+
+			VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+
+			switch (mode)
+			{
+			case CullMode::CullFront:	cullMode = VK_CULL_MODE_FRONT_BIT; break;
+			case CullMode::CullBack:	cullMode = VK_CULL_MODE_BACK_BIT; break;
+			default: break;
+			}
+
+			m_vlkPasses.rbegin()->m_renderState.cullMode = cullMode;
+		}
+
+		void VlkRenderContext::SetWireframe(const bool enabled) {
+
+			if (!m_vlkPasses.size()) {
+				return;
+			}
+
+			const bool supported = sm_vlkDeviceP->GetEnabledFeatures().fillModeNonSolid;
+			m_vlkPasses.rbegin()->m_renderState.polygonMode = enabled && supported ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL;
+		}
+
+		void VlkRenderContext::SetClearColor(const float rgb[3]) {
+
+			if (!m_vlkPasses.size()) {
+				return;
+			}
+
+			std::copy(rgb, rgb + 3, m_vlkPasses.rbegin()->m_clearColor);
+		}
+
+		void VlkRenderContext::SetAsyncCompute(const bool enabled) {
+
+			if (!m_vlkPasses.size()) {
+				return;
+			}
+
+			if (enabled && m_vlkPasses.rbegin()->m_textures.size()) {
+				throw new std::runtime_error("VlkRenderContext SetAsyncCompute failed - async compute passes cannot bind textures.");
+			}
+
+			m_vlkPasses.rbegin()->m_asyncCompute = enabled;
+		}
+
+		VlkRenderContext::VlkPass::~VlkPass() {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+
+			// Graphics pipelines are owned by the pipeline cache
+			VkPipeline ownedPipeline = m_vkBindPoint == VK_PIPELINE_BIND_POINT_COMPUTE ? m_vkPipeline : VK_NULL_HANDLE;
+
+			// Frames in flight may still use the pipeline and descriptor set
+			deviceP->DeferRelease([deviceP, pipeline = ownedPipeline, pipelineLayout = m_vkPipelineLayout, descriptorPool = m_vkDescriptorPool, setLayout = m_vkDescriptorSetLayout]() {
+				VkDevice device = deviceP->GetHandle();
+				if (pipeline) {
+					vkDestroyPipeline(device, pipeline, deviceP->GetAllocationCallbacks(VlkHostAllocator::PIPELINE));
+				}
+				if (pipelineLayout) {
+					vkDestroyPipelineLayout(device, pipelineLayout, deviceP->GetAllocationCallbacks(VlkHostAllocator::PIPELINE));
+				}
+				// Destroying the pool frees its set
+				if (descriptorPool) {
+					vkDestroyDescriptorPool(device, descriptorPool, deviceP->GetAllocationCallbacks(VlkHostAllocator::DESCRIPTOR));
+				}
+				if (setLayout) {
+					vkDestroyDescriptorSetLayout(device, setLayout, deviceP->GetAllocationCallbacks(VlkHostAllocator::DESCRIPTOR));
+				}
+			});
+
+		}
+
+		void VlkRenderContext::ReleaseShaderModule(VkShaderModule module) {
+
+			std::unordered_set<VkPipeline> inUse;
+
+			for (auto &pass : m_vlkPasses) {
+				if (pass.m_vkBindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS) {
+					inUse.insert(pass.m_vkPipeline);
+					inUse.insert(pass.m_vkDepthPipeline);
+				}
+			}
+
+			m_vlkPipelineCacheP->ReleaseModule(module, inUse);
+		}
+
+		void VlkRenderContext::BindShaderProgram(const VlkShaderProgram *shaderProgram) {
+
+			if (!shaderProgram || !m_vlkPasses.size()) {
+				return;
+			}
+
+			VkPipelineShaderStageCreateInfo shaderInfo = {};
 			shaderInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 			shaderInfo.pName = "main";
 			shaderInfo.module = shaderProgram->GetHandle();
@@ -419,11 +1837,20 @@ namespace PixelMachine {
 			VlkPass &newPass = *m_vlkPasses.rbegin();
 			newPass.m_shaderStagesInfo.push_back(shaderInfo);
 
+			if (shaderInfo.stage == VK_SHADER_STAGE_COMPUTE_BIT) {
+				newPass.m_vkBindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+			}
+
 		}
 
 		void VlkRenderContext::BindBuffer(const VlkBuffer *buffer) {
 			VlkPass &newPass = *m_vlkPasses.rbegin();
 			newPass.m_buffers.push_back(buffer);
 		}
+
+		void VlkRenderContext::BindTexture(const VlkTexture *texture) {
+			VlkPass &newPass = *m_vlkPasses.rbegin();
+			newPass.m_textures.push_back(texture);
+		}
 	}
 }
\ No newline at end of file
@@ -2,9 +2,14 @@
 #define VLK_RENDER_CONTEXT_H_
 
 #include <RenderContext.h>
+#include <vulkan/VlkTimeline.h>
+#include <vulkan/VlkCommandState.h>
+#include <vulkan/VlkDrawQueue.h>
 
 #include <vulkan/vulkan.h>
+#include <deque>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace PixelMachine {
@@ -13,54 +18,271 @@ namespace PixelMachine {
 		class VlkShaderProgram;
 		class VlkDevice;
 		class VlkSwapchain;
+		class VlkReadback;
+		class VlkOffscreenTarget;
+		class VlkTransientAttachment;
+		class VlkTexture;
+		class VlkUploadBatcher;
+		class VlkSamplerCache;
+		class VlkProfiler;
 		class VlkRenderContext : public RenderContext {
 		public:
-			VlkRenderContext(HWND windowHandle);
+			/* Renders to an offscreen target instead of a swapchain when <windowHandle> is null.
+			 Window handles are only accepted on platforms with a presentation surface (Win32) */
+			VlkRenderContext(void *windowHandle);
 			~VlkRenderContext();
-			void BeginPass() override { m_vlkPasses.push_back(VlkPass()); };
-			void SetPrimitiveType(const int type) override {};
-			void SetLineWidth(const float width) override {};
-			void SetMultisampling(const int sampleCount) override {};
-			void SetDepthTesting(const bool enabled) override {};
-			void SetClearColor(const float rgb[3]) override {};
+			void BeginPass() override { m_vlkPasses.emplace_back(); };
+			void SetPrimitiveType(const int type) override;
+			void SetLineWidth(const float width) override;
+			void SetMultisampling(const int sampleCount) override;
+			void SetDepthTesting(const bool enabled) override;
+			void SetDepthPrePass(const bool enabled) override;
+			void SetCullMode(const CullMode mode) override;
+			void SetWireframe(const bool enabled) override;
+			void SetClearColor(const float rgb[3]) override;
 			void SetViewport(const int xywh[4]) override {};
+			void Dispatch(const uint32_t groupCountX, const uint32_t groupCountY, const uint32_t groupCountZ) override;
+			void DispatchIndirect(const Buffer *argumentsP, const uint32_t offset = 0u) override;
+			void SetAsyncCompute(const bool enabled) override;
+			void DrawIndexedIndirectCount(
+				const Buffer *commandsP,
+				const Buffer *countP,
+				const uint32_t maxDrawCount,
+				const uint32_t commandsOffset = 0u,
+				const uint32_t countOffset = 0u) override;
+			void ResetCounter(const Buffer *bufferP, const uint32_t offset = 0u) override;
 			void RunPass(const int index) override;
+			void QueueDraw(const int index, const float depth = 0.0f, const uint8_t layer = 0u) override;
+			void RunQueuedDraws() override;
 			void PresentFrame() override;
 			void EndPass() override;
+			bool ReadbackFrame(ReadbackCallback callback) override;
+			void FlushReadbacks() override;
+			bool SetRenderTarget(const uint32_t width, const uint32_t height) override;
+			RenderStats GetStats() const override;
+			void GetHostMemoryUsage(std::vector<HostMemoryUsage> &outUsage) const override;
+			MemoryTelemetry GetMemoryTelemetry() const override;
+			void SetMemorySoftLimit(const float budgetFraction) override;
+			uint32_t AddMemoryEvictionCallback(MemoryEvictionCallback callback) override;
+			void RemoveMemoryEvictionCallback(const uint32_t id) override;
+			std::string GetDeviceName() const override;
+			void SetProfiling(const bool enabled) override;
+			void SetPassQueries(const bool enabled) override;
+			void GetProfileHistory(std::vector<ProfileEvent> &outEvents) const override;
+			void TakeProfileHistory(std::vector<ProfileEvent> &outEvents) override;
+			bool WriteProfileTrace(const std::string &path) const override;
 			static VlkDevice *GetVlkDevice();
+			VlkProfiler *GetProfiler() const { return m_vlkProfilerP; }
+			VlkUploadBatcher *GetUploadBatcher() const { return m_vlkUploadBatcherP; }
+			VlkSamplerCache *GetSamplerCache() const { return m_vlkSamplerCacheP; }
+
+			/* Accounts host to device transfers issued by buffers */
+			void RecordUpload(const uint64_t bytes, const uint32_t submits);
+			/* Accounts device memory allocated for buffers */
+			void RecordAllocation(const uint64_t bytes);
+			/* Accounts compressed texels decoded on the CPU as the device lacks their format */
+			void RecordTranscode(const uint64_t texels) { m_stats.transcodedTexels += texels; }
+			/* Marks <buffer> as written outside of passes (uploads) - the next pass accessing it waits for the write */
+			void RecordBufferWrite(VkBuffer buffer, const VkPipelineStageFlags stages, const VkAccessFlags access);
+			/* Blocks until async compute work using <buffer> has completed - uploads overwrite it on the graphics queue */
+			void SyncBufferUpload(VkBuffer buffer);
+			/* Blocks until every submitted pass using <buffer> has completed - the CPU is about to overwrite its mapped memory */
+			void SyncHostWrite(VkBuffer buffer);
+			/* Drops the barrier state of a buffer being destroyed */
+			void ReleaseBufferState(VkBuffer buffer);
 
 			void BindShaderProgram(const VlkShaderProgram *shaderProgram);
+			/* Called before <module> is destroyed - cached pipelines built from it stop matching new passes, and are
+			 destroyed once no pass draws with them */
+			void ReleaseShaderModule(VkShaderModule module);
 			void BindBuffer(const VlkBuffer *buffer);
+			void BindTexture(const VlkTexture *texture);
 
 		private:
 
+			/* Pipeline stages and accesses of one buffer in a pass */
+			struct VlkBufferAccess {
+				VkBuffer m_vkBuffer = VK_NULL_HANDLE;
+				VkPipelineStageFlags m_stages = 0;
+				VkAccessFlags m_access = 0;
+				bool m_write = false;
+			};
+
+			/* Last unsynchronized write of a buffer and the stages that read it since */
+			struct VlkBufferState {
+				VkPipelineStageFlags m_writeStages = 0;
+				VkAccessFlags m_writeAccess = 0;
+				VkPipelineStageFlags m_readStages = 0;
+				// Queue family owning the buffer and the timeline value of its last submit using it
+				uint32_t m_ownerFamily = VK_QUEUE_FAMILY_IGNORED;
+				uint64_t m_lastUseValue = 0;
+			};
+
+			/* Command buffer of the async compute queue, reused once its timeline reaches <m_timelineValue> */
+			struct VlkComputeFrame {
+				VkCommandBuffer m_vkCommandBuffer = VK_NULL_HANDLE;
+				uint64_t m_timelineValue = 0;
+			};
+
 			struct VlkPass {
 				VkPipeline m_vkPipeline = VK_NULL_HANDLE;
 				VkPipelineLayout m_vkPipelineLayout = VK_NULL_HANDLE;
+				VkPipelineBindPoint m_vkBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+				// Uniform and storage buffers, bound in set 0
+				std::vector<VkDescriptorSetLayoutBinding> m_descriptorBindings;
+				VkDescriptorSetLayout m_vkDescriptorSetLayout = VK_NULL_HANDLE;
+				VkDescriptorPool m_vkDescriptorPool = VK_NULL_HANDLE;
+				VkDescriptorSet m_vkDescriptorSet = VK_NULL_HANDLE;
 				std::vector<const VlkBuffer*> m_buffers;
+				// Combined image samplers, bound in set 0 after the buffers
+				std::vector<const VlkTexture*> m_textures;
+				// Buffer descriptors and the image versions the set was last written with
+				std::vector<VkDescriptorBufferInfo> m_descriptorBufferInfos;
+				std::vector<uint64_t> m_textureVersions;
+				// Vertex buffer handles in binding order, gathered once by EndPass
+				std::vector<VkBuffer> m_vkVertexBuffers;
+				std::vector<VkDeviceSize> m_vertexOffsets;
+				std::vector<VlkBufferAccess> m_bufferAccesses;
 				std::vector<VkPipelineShaderStageCreateInfo> m_shaderStagesInfo;
 				bool m_renderToScreen = true;
-				bool m_depthTest = false;
-				float m_lineWidth = 0.5;
-				uint32_t m_primitiveTopology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-				uint32_t m_msaaSamples = 1u;
+				// Fixed function state - set dynamically where the device allows, baked into the pipeline otherwise
+				VlkRenderState m_renderState;
+				float m_lineWidth = 1.0f;
+				// Depth pre-pass - depth-only pipeline (shared, owned by the pipeline cache) and its render state
+				bool m_depthPrePass = false;
+				VkPipeline m_vkDepthPipeline = VK_NULL_HANDLE;
+				VlkRenderState m_depthRenderState;
+				// Vertices drawn per run - the element count of the smallest bound vertex buffer
+				uint32_t m_vertexCount = 3u;
+				// Compute passes - workgroup counts, read from <m_indirectBufferP> when set
+				uint32_t m_groupCount[3] = { 1u, 1u, 1u };
+				const VlkBuffer *m_indirectBufferP = nullptr;
+				uint32_t m_indirectOffset = 0u;
+				bool m_asyncCompute = false;
+				// GPU-driven draws - commands and count written by an earlier compute pass
+				const VlkBuffer *m_indexBufferP = nullptr;
+				const VlkBuffer *m_drawCommandsP = nullptr;
+				const VlkBuffer *m_drawCountP = nullptr;
+				uint32_t m_drawCommandsOffset = 0u;
+				uint32_t m_drawCountOffset = 0u;
+				uint32_t m_maxDrawCount = 0u;
+				// Counters zeroed ahead of every run and the transfer writes doing it
+				std::vector<std::pair<const VlkBuffer*, uint32_t>> m_counterResets;
+				std::vector<VlkBufferAccess> m_counterAccesses;
 				float m_clearColor[3] = { 0 };
 				float m_viewportRect[4] = { 0 };
+				// Draw queue - sort key ids of the pipeline and descriptor set, frame whose barriers are recorded
+				uint16_t m_pipelineSortId = 0u;
+				uint16_t m_materialSortId = 0u;
+				uint64_t m_barrierFrameNumber = 0;
+				// GPU profiler scope name
+				std::string m_name;
 
 				~VlkPass();
 			};
 
+			/* Transient attachments of one sample count - multisampled color is resolved into the target */
+			struct VlkSampleTargets {
+				VlkTransientAttachment *m_depthP = nullptr;
+				VlkTransientAttachment *m_colorP = nullptr;
+			};
+
+			/* Per frame-in-flight resources, reused every <sm_framesInFlight> frames once the graphics
+			 timeline reaches <m_timelineValue> */
+			struct VlkFrame {
+				VkCommandBuffer m_vkCommandBuffer = VK_NULL_HANDLE;
+				VkSemaphore m_vkImageAvailable = VK_NULL_HANDLE;
+				uint64_t m_frameNumber = 0;
+				uint64_t m_timelineValue = 0;
+			};
+
+			/* Non-blocking check of frames in flight - advances <m_completedFrameNumber> */
+			void UpdateCompletedFrames();
+			/* Destroys offscreen targets no longer referenced by any frame in flight */
+			void ReleaseRetiredTargets();
+			/* Records the barriers <accesses> need against earlier passes and uploads on queue <family>.
+			 Buffers owned by the other family are released there and acquired here - the submit signaling
+			 <signalValue> must wait for <outWaits> */
+			void RecordBufferBarriers(VkCommandBuffer commandBuffer, const std::vector<VlkBufferAccess> &accesses, const uint32_t family, const uint64_t signalValue, std::vector<VlkSemaphoreWait> &outWaits);
+			/* Counter resets of <pass> followed by the barriers of its buffers */
+			void RecordPassBarriers(VkCommandBuffer commandBuffer, const VlkPass &pass, const uint32_t family, const uint64_t signalValue, std::vector<VlkSemaphoreWait> &outWaits);
+			/* Submits the release half of queue family ownership transfers - returns the timeline value to wait for */
+			uint64_t SubmitOwnershipRelease(const uint32_t srcFamily, const std::vector<VkBufferMemoryBarrier> &releases, const VkPipelineStageFlags srcStages);
+			/* Waits until the next frame slot is free, collects completed work and begins its command buffer - returns the slot */
+			uint32_t BeginFrame();
+			/* Ends and submits the command buffer of <frameSlot>, also waiting for the acquired swapchain image */
+			void SubmitFrame(const uint32_t frameSlot, std::vector<VlkSemaphoreWait> &waits, const bool imageAcquired);
+			/* Graphics timeline value the frame being recorded will signal */
+			uint64_t GetNextGraphicsValue() const;
+			/* Records one dynamic rendering instance drawing the passes of <recordsP> in order, cleared with the color of the
+			 first one. <queued> draws query each pass in a nested scope - returns true if a swapchain image was acquired */
+			bool RecordDraw(
+				VkCommandBuffer commandBuffer,
+				VlkFrame &frame,
+				const uint32_t frameSlot,
+				const VlkDrawRecord *recordsP,
+				const uint32_t recordCount,
+				const std::string &scopeName,
+				const bool queued);
+			/* Binds <pipeline> with the resources of <pass> and records its draw */
+			void RecordPassDraw(VkCommandBuffer commandBuffer, VlkPass &pass, VkPipeline pipeline, const VlkRenderState &renderState);
+			void RecordDispatch(VkCommandBuffer commandBuffer, VlkPass &pass);
+			/* Runs a compute pass on the async compute queue, outside of the graphics frames */
+			void RunAsyncCompute(VlkPass &pass);
+			/* Descriptor set, buffer accesses and pipeline layout of the pass being ended */
+			void CreatePassLayout(VlkPass &pass);
+			/* Creates the descriptor pool and set of <pass> and writes its buffers and textures */
+			void CreatePassDescriptorSet(VlkPass &pass);
+			/* Rewrites the descriptors of <pass> into a new set when a texture reallocated its image - called before a frame records the pass */
+			void RefreshPassTextures(VlkPass &pass);
+			/* Format of the color target - pipelines declare it instead of a render pass */
+			VkFormat GetColorFormat() const;
+			/* Attachments of <samples> sized to <extent>, recreated when the target extent changes */
+			VlkSampleTargets &GetSampleTargets(const VkSampleCountFlagBits samples, const VkExtent2D extent);
+
+			static constexpr uint32_t sm_framesInFlight = 2u;
+
 			static VlkDevice *sm_vlkDeviceP;
 			VkSurfaceKHR m_vkWinSurface = VK_NULL_HANDLE;
 			VkSurfaceFormatKHR m_vkWinSurfaceFormat = {};
 			VlkSwapchain *m_vlkSwapchainP = nullptr;
-			std::vector<VlkPass> m_vlkPasses;
+			// Headless rendering - current target and the ones still used by frames in flight
+			VlkOffscreenTarget *m_vlkTargetP = nullptr;
+			std::vector<VlkOffscreenTarget *> m_retiredTargets;
+			// Passes are never relocated, their pipelines are owned by the pass
+			std::deque<VlkPass> m_vlkPasses;
 			VkCommandPool m_vkCommandPool = VK_NULL_HANDLE;
-			VkCommandBuffer m_vkCommandBuffer = VK_NULL_HANDLE;
-			VkFence m_vkCmdCompletedFence = VK_NULL_HANDLE;
+			std::vector<VlkFrame> m_frames;
+			// Bound state of the command buffer being recorded
+			VlkCommandState m_commandState;
+			// Draws queued for the next RunQueuedDraws and the dense sort ids handed out to pipelines and descriptor sets
+			VlkDrawQueue m_drawQueue;
+			std::unordered_map<VkPipeline, uint16_t> m_pipelineSortIds;
+			std::unordered_map<VkDescriptorSet, uint16_t> m_materialSortIds;
+			// Async compute - only created when the device has a second compute queue family
+			VkCommandPool m_vkComputeCommandPool = VK_NULL_HANDLE;
+			std::vector<VlkComputeFrame> m_computeFrames;
+			uint64_t m_computeFrameNumber = 0;
+			VlkReadback *m_vlkReadbackP = nullptr;
+			VlkProfiler *m_vlkProfilerP = nullptr;
+			// Graphics pipelines shared between passes
+			VlkPipelineCache *m_vlkPipelineCacheP = nullptr;
+			// Texture uploads submitted ahead of the next frame and samplers shared between textures
+			VlkUploadBatcher *m_vlkUploadBatcherP = nullptr;
+			VlkSamplerCache *m_vlkSamplerCacheP = nullptr;
+			// Attachments shared by all frames per sample count - transient, cleared and discarded within every frame
+			VkFormat m_depthFormat = VK_FORMAT_UNDEFINED;
+			std::unordered_map<VkSampleCountFlagBits, VlkSampleTargets> m_sampleTargets;
 
 			uint32_t m_frameIndex = 0;
+			// Number of frames submitted so far and the newest one known to be finished by the GPU
+			uint64_t m_frameNumber = 0;
+			uint64_t m_completedFrameNumber = 0;
+			RenderStats m_stats;
 			std::vector<VkSemaphore> m_renderDone;
+			// Set while a rendered swapchain image waits for PresentFrame
+			bool m_presentPending = false;
+			std::unordered_map<VkBuffer, VlkBufferState> m_bufferStates;
 
 		};
 	}
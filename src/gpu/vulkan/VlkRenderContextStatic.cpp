@@ -15,9 +15,13 @@ namespace PixelMachine {
 			return new VlkShaderProgram(name, compiledShaderPath, type);
 		}
 
+		ShaderProgram *ShaderProgram::CreateFromCode(const std::string name, const void *code, const size_t size, ShaderProgramType type) {
+			return new VlkShaderProgram(name, code, size, type);
+		}
+
 		void RenderContext::Initialize(void *windowHandle) {
 			if (!s_vlkRenderContextP) {
-				s_vlkRenderContextP = new VlkRenderContext(static_cast<HWND>(windowHandle));
+				s_vlkRenderContextP = new VlkRenderContext(windowHandle);
 			}
 		}
 
@@ -31,6 +35,7 @@ namespace PixelMachine {
 		void RenderContext::Destroy() {
 			if (s_vlkRenderContextP) {
 				delete s_vlkRenderContextP;
+				s_vlkRenderContextP = nullptr;
 			}
 		}
 
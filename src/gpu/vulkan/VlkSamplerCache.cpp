@@ -0,0 +1,80 @@
+#include <vulkan/VlkSamplerCache.h>
+#include <vulkan/VlkRenderContext.h>
+#include <vulkan/VlkDevice.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		static VkSamplerAddressMode GetVkAddressMode(const TextureAddressMode mode) {
+			switch (mode)
+			{
+			case TextureAddressMode::MirroredRepeatAddress:	return VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+			case TextureAddressMode::ClampToEdgeAddress:	return VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			default: break;
+			}
+			return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		}
+
+		VlkSamplerCache::~VlkSamplerCache() {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+
+			for (auto &entry : m_samplers) {
+				vkDestroySampler(deviceP->GetHandle(), entry.second, deviceP->GetAllocationCallbacks(VlkHostAllocator::SAMPLER));
+			}
+		}
+
+		VkSampler VlkSamplerCache::GetSampler(const SamplerDesc &desc, const uint32_t mipLevels) {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+
+			// Anisotropy is matched after clamping, requests above the limit all get the same sampler
+			const float maxAnisotropy = deviceP->GetEnabledFeatures().samplerAnisotropy ?
+				std::clamp(desc.maxAnisotropy, 1.0f, deviceP->GetActiveAdapter().GetProperties().limits.maxSamplerAnisotropy) : 1.0f;
+			const uint32_t anisotropy = static_cast<uint32_t>(std::lround(maxAnisotropy * 16.0f));
+
+			const uint64_t key =
+				static_cast<uint64_t>(desc.minFilter) |
+				static_cast<uint64_t>(desc.magFilter) << 2u |
+				static_cast<uint64_t>(desc.mipFilter) << 4u |
+				static_cast<uint64_t>(desc.addressMode) << 6u |
+				static_cast<uint64_t>(anisotropy) << 8u |
+				static_cast<uint64_t>(mipLevels) << 32u;
+
+			auto it = m_samplers.find(key);
+
+			if (it != m_samplers.end()) {
+				m_reuseCount++;
+				return it->second;
+			}
+
+			VkSamplerCreateInfo samplerInfo = {};
+			samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+			samplerInfo.minFilter = desc.minFilter == TextureFilter::NearestFilter ? VK_FILTER_NEAREST : VK_FILTER_LINEAR;
+			samplerInfo.magFilter = desc.magFilter == TextureFilter::NearestFilter ? VK_FILTER_NEAREST : VK_FILTER_LINEAR;
+			samplerInfo.mipmapMode = desc.mipFilter == TextureFilter::NearestFilter ? VK_SAMPLER_MIPMAP_MODE_NEAREST : VK_SAMPLER_MIPMAP_MODE_LINEAR;
+			samplerInfo.addressModeU = GetVkAddressMode(desc.addressMode);
+			samplerInfo.addressModeV = samplerInfo.addressModeU;
+			samplerInfo.addressModeW = samplerInfo.addressModeU;
+			samplerInfo.anisotropyEnable = maxAnisotropy > 1.0f;
+			samplerInfo.maxAnisotropy = maxAnisotropy;
+			samplerInfo.compareEnable = VK_FALSE;
+			samplerInfo.minLod = 0.0f;
+			samplerInfo.maxLod = static_cast<float>(mipLevels);
+			samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+			samplerInfo.unnormalizedCoordinates = VK_FALSE;
+
+			VkSampler sampler = VK_NULL_HANDLE;
+			vkCreateSampler(deviceP->GetHandle(), &samplerInfo, deviceP->GetAllocationCallbacks(VlkHostAllocator::SAMPLER), &sampler);
+
+			if (sampler) {
+				m_samplers.emplace(key, sampler);
+			}
+
+			return sampler;
+		}
+	}
+}
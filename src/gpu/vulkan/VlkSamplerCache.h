@@ -0,0 +1,37 @@
+#ifndef VLK_SAMPLER_CACHE_H_
+#define VLK_SAMPLER_CACHE_H_
+
+#include <Texture.h>
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <unordered_map>
+
+namespace PixelMachine {
+	namespace GPU {
+		/// <summary>
+		/// Sampler objects shared between textures. Devices allow only a limited number of samplers
+		/// (maxSamplerAllocationCount), while most textures sample the same few ways.
+		/// </summary>
+		class VlkSamplerCache {
+		public:
+			VlkSamplerCache() = default;
+			VlkSamplerCache(const VlkSamplerCache &) = delete;
+			VlkSamplerCache &operator=(const VlkSamplerCache &) = delete;
+			~VlkSamplerCache();
+
+			/* Sampler for <desc> covering <mipLevels> levels, created on first request. Returns VK_NULL_HANDLE on failure */
+			VkSampler GetSampler(const SamplerDesc &desc, const uint32_t mipLevels);
+
+			uint64_t GetCreatedCount() const { return m_samplers.size(); }
+			uint64_t GetReuseCount() const { return m_reuseCount; }
+
+		private:
+			std::unordered_map<uint64_t, VkSampler> m_samplers;
+			uint64_t m_reuseCount = 0;
+		};
+	}
+}
+
+#endif // !VLK_SAMPLER_CACHE_H_
@@ -2,12 +2,14 @@
 #define VLK_SHADER_PROGRAM_H_
 
 #include <ShaderProgram.h>
+#include <FileReader.h>
 
 #include <vulkan/VlkRenderContext.h>
 #include <vulkan/VlkDevice.h>
 #include <vulkan/vulkan.h>
 
-#include <fstream>
+#include <stdexcept>
+#include <vector>
 
 namespace PixelMachine {
 	namespace GPU {
@@ -15,34 +17,27 @@ namespace PixelMachine {
 		class VlkShaderProgram : public ShaderProgram {
 		public:
 			VlkShaderProgram(const std::string name, const std::string compiledShaderPath, ShaderProgramType type) : ShaderProgram(name, type, 0) {
-				
-				std::ifstream file(compiledShaderPath, std::ios::ate | std::ios::binary);
 
-				if (!file.is_open()) {
+				std::vector<uint8_t> code;
+
+				if (!FileReader::ReadFile(compiledShaderPath, code)) {
 					throw std::runtime_error("VlkShaderProgram construction fail - file not found.");
 				}
 
-				size_t fileSize = static_cast<size_t>(file.tellg());
-				std::vector<char> buffer(fileSize);
-
-				file.seekg(0);
-				file.read(buffer.data(), fileSize);
-				file.close();
-
-				VkShaderModuleCreateInfo shaderModuleCI = {};
-				shaderModuleCI.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-				shaderModuleCI.codeSize = buffer.size();
-				shaderModuleCI.pCode = reinterpret_cast<const uint32_t *>(buffer.data());
-
-				VkDevice device = VlkRenderContext::GetVlkDevice()->GetHandle();
-				vkCreateShaderModule(device, &shaderModuleCI, nullptr, &m_vkShaderModule);
+				CreateModule(code.data(), code.size());
+			};
 
+			/* Module of SPIR-V <code> already in memory - read asynchronously by the asset loader */
+			VlkShaderProgram(const std::string name, const void *code, const size_t size, ShaderProgramType type) : ShaderProgram(name, type, 0) {
+				CreateModule(code, size);
 			};
 
 			~VlkShaderProgram() {
 				if (m_vkShaderModule) {
-					VkDevice device = VlkRenderContext::GetVlkDevice()->GetHandle();
-					vkDestroyShaderModule(device, m_vkShaderModule, nullptr);
+					// Pipelines outlive the module - its handle value may be reused by the next module created
+					static_cast<VlkRenderContext *>(VlkRenderContext::Get())->ReleaseShaderModule(m_vkShaderModule);
+					VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+					vkDestroyShaderModule(deviceP->GetHandle(), m_vkShaderModule, deviceP->GetAllocationCallbacks(VlkHostAllocator::SHADER_MODULE));
 				}
 			};
 
@@ -54,6 +49,29 @@ namespace PixelMachine {
 			};
 
 		private:
+			void CreateModule(const void *code, const size_t size) {
+
+				// SPIR-V is a stream of 32-bit words
+				if (!size || size % sizeof(uint32_t)) {
+					throw new std::runtime_error("VlkShaderProgram construction fail - code is not SPIR-V.");
+				}
+
+				m_size = size;
+
+				VkShaderModuleCreateInfo shaderModuleCI = {};
+				shaderModuleCI.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+				shaderModuleCI.codeSize = size;
+				shaderModuleCI.pCode = static_cast<const uint32_t *>(code);
+
+				VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+				const VkResult result = vkCreateShaderModule(deviceP->GetHandle(), &shaderModuleCI, deviceP->GetAllocationCallbacks(VlkHostAllocator::SHADER_MODULE), &m_vkShaderModule);
+
+				if (result != VK_SUCCESS || !m_vkShaderModule) {
+					m_vkShaderModule = VK_NULL_HANDLE;
+					throw new std::runtime_error("VlkShaderProgram construction fail - cannot create shader module.");
+				}
+			}
+
 			VkShaderModule m_vkShaderModule = VK_NULL_HANDLE;
 		};
 
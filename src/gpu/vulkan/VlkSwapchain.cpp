@@ -4,58 +4,12 @@
 
 #include <stdexcept>
 
-static VkRenderPass CreateVkRenderPass(VkFormat imageFormat) {
-
-	VkAttachmentDescription attchDesc = {};
-	attchDesc.format = imageFormat;
-	attchDesc.samples = VK_SAMPLE_COUNT_1_BIT;
-	attchDesc.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	attchDesc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	attchDesc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	attchDesc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	attchDesc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	attchDesc.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-	VkAttachmentReference attchRef = {};
-	attchRef.attachment = 0;
-	attchRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	VkSubpassDescription subpassDesc = {};
-	subpassDesc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpassDesc.colorAttachmentCount = 1;
-	subpassDesc.pColorAttachments = &attchRef;
-
-	VkSubpassDependency subpassDep = {};
-	subpassDep.srcSubpass = VK_SUBPASS_EXTERNAL;
-	subpassDep.dstSubpass = 0;
-	subpassDep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpassDep.srcAccessMask = 0;
-	subpassDep.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpassDep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-	VkRenderPassCreateInfo renderPassInfo = {};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassInfo.attachmentCount = 1;
-	renderPassInfo.pAttachments = &attchDesc;
-	renderPassInfo.subpassCount = 1;
-	renderPassInfo.pSubpasses = &subpassDesc;
-	renderPassInfo.dependencyCount = 1;
-	renderPassInfo.pDependencies = &subpassDep;
-
-	auto device = PixelMachine::GPU::VlkRenderContext::GetVlkDevice()->GetHandle();
-
-	VkRenderPass result = VK_NULL_HANDLE;
-	vkCreateRenderPass(device, &renderPassInfo, nullptr, &result);
-
-	return result;
-}
-
 static VkSwapchainKHR CreateVkSwapchain(VkSurfaceKHR surface, VkSurfaceFormatKHR surfaceFormat, VkPresentModeKHR presentMode) {
 
 	VkSwapchainCreateInfoKHR swapchainInfo = {};
 	swapchainInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
 	swapchainInfo.pNext = nullptr;
-	swapchainInfo.flags = NULL;
+	swapchainInfo.flags = 0;
 	swapchainInfo.surface = surface;
 
 	PixelMachine::GPU::VlkDevice *device = PixelMachine::GPU::VlkRenderContext::GetVlkDevice();
@@ -72,6 +26,10 @@ static VkSwapchainKHR CreateVkSwapchain(VkSurfaceKHR surface, VkSurfaceFormatKHR
 	swapchainInfo.presentMode = presentMode;
 
 	swapchainInfo.imageUsage = VkImageUsageFlagBits::VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	if (caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) {
+		// Allows frame readback straight from the presented image
+		swapchainInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
 	swapchainInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	swapchainInfo.queueFamilyIndexCount = 0;
 	swapchainInfo.pQueueFamilyIndices = nullptr;
@@ -81,20 +39,15 @@ static VkSwapchainKHR CreateVkSwapchain(VkSurfaceKHR surface, VkSurfaceFormatKHR
 	swapchainInfo.oldSwapchain = VK_NULL_HANDLE;
 
 	VkSwapchainKHR result = VK_NULL_HANDLE;
-	vkCreateSwapchainKHR(device->GetHandle(), &swapchainInfo, nullptr, &result);
+	vkCreateSwapchainKHR(device->GetHandle(), &swapchainInfo, device->GetAllocationCallbacks(PixelMachine::GPU::VlkHostAllocator::SWAPCHAIN), &result);
 
 	return result;
 }
 
 PixelMachine::GPU::VlkSwapchain::VlkSwapchain(VkSurfaceKHR surface, VkSurfaceFormatKHR surfaceFormat, VkPresentModeKHR presentMode)
 	: m_vkSurfaceFormat(surfaceFormat),
-	m_vkRenderPass(CreateVkRenderPass(surfaceFormat.format)),
 	m_vkSwapchain(CreateVkSwapchain(surface, surfaceFormat, presentMode)) {
 
-	if (!m_vkRenderPass) {
-		throw new std::runtime_error("VlkSwapchain constructor failed - unable to create a render pass.");
-	}
-
 	if (!m_vkSwapchain) {
 		throw new std::runtime_error("VlkSwapchain constructor failed - unable to create a swapchain.");
 	}
@@ -106,6 +59,7 @@ PixelMachine::GPU::VlkSwapchain::VlkSwapchain(VkSurfaceKHR surface, VkSurfaceFor
 
 	std::vector<VkImage> swapchainImages(imageCount);
 	vkGetSwapchainImagesKHR(device->GetHandle(), m_vkSwapchain, &imageCount, swapchainImages.data());
+	m_images = swapchainImages;
 
 	VkImageViewCreateInfo imageViewInfo = {
 		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -126,74 +80,35 @@ PixelMachine::GPU::VlkSwapchain::VlkSwapchain(VkSurfaceKHR surface, VkSurfaceFor
 	for (uint32_t i = 0; i < m_frameViews.size(); i++) {
 		imageViewInfo.image = swapchainImages[i];
 		VkImageView frameView = VK_NULL_HANDLE;
-		vkCreateImageView(device->GetHandle(), &imageViewInfo, nullptr, &frameView);
+		vkCreateImageView(device->GetHandle(), &imageViewInfo, device->GetAllocationCallbacks(VlkHostAllocator::IMAGE), &frameView);
 		m_frameViews[i] = frameView;
 	}
 
-	VkFramebufferCreateInfo framebufferInfo = {};
 	VkSurfaceCapabilitiesKHR caps = device->GetActiveAdapter().GetSurfaceInfo(surface);
-
-	framebufferInfo.width = caps.currentExtent.width;
-	framebufferInfo.height = caps.currentExtent.height;
-	framebufferInfo.layers = 1;
-	framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-	framebufferInfo.attachmentCount = 1;
-	framebufferInfo.renderPass = m_vkRenderPass;
-
-	m_framebuffers.resize(m_frameViews.size());
-
-	for (uint32_t i = 0; i < m_frameViews.size(); i++) {
-
-		VkImageView attachments[] = { m_frameViews[i] };
-		framebufferInfo.pAttachments = attachments;
-
-		VkFramebuffer framebuffer = VK_NULL_HANDLE;
-		vkCreateFramebuffer(device->GetHandle(), &framebufferInfo, nullptr, &framebuffer);
-
-		m_framebuffers[i] = framebuffer;
-	}
-
-	VkSemaphoreCreateInfo semaphoreInfo = {};
-	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-
-	vkCreateSemaphore(device->GetHandle(), &semaphoreInfo, nullptr, &m_vkImageAvailableSemaphore);
-
+	m_readbackSupported = caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 }
 
 PixelMachine::GPU::VlkSwapchain::~VlkSwapchain() {
 
-	VkDevice device = VlkRenderContext::GetVlkDevice()->GetHandle();
-
-	vkDestroySemaphore(device, m_vkImageAvailableSemaphore, nullptr);
-
-	for (auto fb : m_framebuffers) {
-		vkDestroyFramebuffer(device, fb, nullptr);
-	}
+	VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+	VkDevice device = deviceP->GetHandle();
 
 	for (auto view : m_frameViews) {
-		vkDestroyImageView(device, view, nullptr);
+		vkDestroyImageView(device, view, deviceP->GetAllocationCallbacks(VlkHostAllocator::IMAGE));
 	}
 
 	if (m_vkSwapchain) {
-		vkDestroySwapchainKHR(device, m_vkSwapchain, nullptr);
-	}
-
-	if (m_vkRenderPass) {
-		vkDestroyRenderPass(device, m_vkRenderPass, nullptr);
+		vkDestroySwapchainKHR(device, m_vkSwapchain, deviceP->GetAllocationCallbacks(VlkHostAllocator::SWAPCHAIN));
 	}
 
 }
 
-uint32_t PixelMachine::GPU::VlkSwapchain::GetImage(VkFramebuffer *outFramebuffer) const {
+uint32_t PixelMachine::GPU::VlkSwapchain::GetImage(VkSemaphore imageAvailable) const {
 
 	VkDevice device = VlkRenderContext::GetVlkDevice()->GetHandle();
 
 	uint32_t index = 0u;
-	vkAcquireNextImageKHR(device, m_vkSwapchain, UINT64_MAX, m_vkImageAvailableSemaphore, NULL, &index);
-
-	if (outFramebuffer) {
-		*outFramebuffer = m_framebuffers[index];
-	}
+	vkAcquireNextImageKHR(device, m_vkSwapchain, UINT64_MAX, imageAvailable, NULL, &index);
 
 	return index;
 }
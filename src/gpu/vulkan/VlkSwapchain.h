@@ -12,19 +12,21 @@ namespace PixelMachine {
 			VlkSwapchain() {};
 			VlkSwapchain(VkSurfaceKHR surface, VkSurfaceFormatKHR surfaceFormat, VkPresentModeKHR presentMode);
 			~VlkSwapchain();
-			VkRenderPass GetVkRenderPass() const { return m_vkRenderPass; }
-			uint32_t GetImage(VkFramebuffer *outFramebuffer) const;
-			VkSemaphore GetImageAvailableSemaphore() const { return m_vkImageAvailableSemaphore; }
+			/* Acquires the next swapchain image, <imageAvailable> is signaled once it can be rendered to */
+			uint32_t GetImage(VkSemaphore imageAvailable) const;
+			VkImage GetVkImage(const uint32_t index) const { return m_images[index]; }
+			VkImageView GetVkImageView(const uint32_t index) const { return m_frameViews[index]; }
+			VkFormat GetFormat() const { return m_vkSurfaceFormat.format; }
 			VkSwapchainKHR GetHandle() const { return m_vkSwapchain; }
-			uint32_t GetImagesCount() const { return m_framebuffers.size(); }
+			uint32_t GetImagesCount() const { return m_images.size(); }
+			bool ReadbackSupported() const { return m_readbackSupported; }
 
 		private:
 			VkSurfaceFormatKHR m_vkSurfaceFormat = {};
-			VkRenderPass m_vkRenderPass = VK_NULL_HANDLE;
 			VkSwapchainKHR m_vkSwapchain = VK_NULL_HANDLE;
-			VkSemaphore m_vkImageAvailableSemaphore = VK_NULL_HANDLE;
+			std::vector<VkImage> m_images;
 			std::vector<VkImageView> m_frameViews;
-			std::vector<VkFramebuffer> m_framebuffers;
+			bool m_readbackSupported = false;
 
 		};
 	}
@@ -0,0 +1,553 @@
+#include <vulkan/VlkTexture.h>
+#include <vulkan/VlkRenderContext.h>
+#include <vulkan/VlkDevice.h>
+#include <vulkan/VlkUploadBatcher.h>
+#include <vulkan/VlkSamplerCache.h>
+#include <TextureTranscoder.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		// Stages sampling textures - uploads are made visible to all of them
+		static const VkPipelineStageFlags s_shaderReadStages =
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+		Texture *Texture::Create(const TextureDesc &desc) {
+			return new VlkTexture(desc);
+		}
+
+		bool Texture::IsFormatSupported(const TextureFormat format) {
+			return VlkTexture::IsVkFormatSupported(format);
+		}
+
+		VkFormat VlkTexture::GetVkFormat(const TextureFormat format) {
+			switch (format)
+			{
+			case TextureFormat::TextureR8:				return VK_FORMAT_R8_UNORM;
+			case TextureFormat::TextureRG8:			return VK_FORMAT_R8G8_UNORM;
+			case TextureFormat::TextureRGBA8_SRGB:		return VK_FORMAT_R8G8B8A8_SRGB;
+			case TextureFormat::TextureRGBA16F:		return VK_FORMAT_R16G16B16A16_SFLOAT;
+			case TextureFormat::TextureRGBA32F:		return VK_FORMAT_R32G32B32A32_SFLOAT;
+			// BC1 keeps its 1 bit alpha
+			case TextureFormat::TextureBC1:				return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+			case TextureFormat::TextureBC1_SRGB:		return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+			case TextureFormat::TextureBC3:				return VK_FORMAT_BC3_UNORM_BLOCK;
+			case TextureFormat::TextureBC3_SRGB:		return VK_FORMAT_BC3_SRGB_BLOCK;
+			case TextureFormat::TextureBC5:				return VK_FORMAT_BC5_UNORM_BLOCK;
+			case TextureFormat::TextureBC7:				return VK_FORMAT_BC7_UNORM_BLOCK;
+			case TextureFormat::TextureBC7_SRGB:		return VK_FORMAT_BC7_SRGB_BLOCK;
+			case TextureFormat::TextureETC2_RGBA8:		return VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK;
+			case TextureFormat::TextureETC2_RGBA8_SRGB:	return VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK;
+			case TextureFormat::TextureASTC_4x4:		return VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+			case TextureFormat::TextureASTC_4x4_SRGB:	return VK_FORMAT_ASTC_4x4_SRGB_BLOCK;
+			default: break;
+			}
+			return VK_FORMAT_R8G8B8A8_UNORM;
+		}
+
+		bool VlkTexture::IsVkFormatSupported(const TextureFormat format) {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+			const VkPhysicalDeviceFeatures &features = deviceP->GetEnabledFeatures();
+
+			switch (format)
+			{
+			case TextureFormat::TextureBC1:
+			case TextureFormat::TextureBC1_SRGB:
+			case TextureFormat::TextureBC3:
+			case TextureFormat::TextureBC3_SRGB:
+			case TextureFormat::TextureBC5:
+			case TextureFormat::TextureBC7:
+			case TextureFormat::TextureBC7_SRGB:
+				if (!features.textureCompressionBC) {
+					return false;
+				}
+				break;
+			case TextureFormat::TextureETC2_RGBA8:
+			case TextureFormat::TextureETC2_RGBA8_SRGB:
+				if (!features.textureCompressionETC2) {
+					return false;
+				}
+				break;
+			case TextureFormat::TextureASTC_4x4:
+			case TextureFormat::TextureASTC_4x4_SRGB:
+				if (!features.textureCompressionASTC_LDR) {
+					return false;
+				}
+				break;
+			default:
+				break;
+			}
+
+			VkFormatProperties properties = {};
+			vkGetPhysicalDeviceFormatProperties(deviceP->GetActiveAdapter().GetHandle(), GetVkFormat(format), &properties);
+
+			const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+			return (properties.optimalTilingFeatures & requiredFeatures) == requiredFeatures;
+		}
+
+		VlkTexture::VlkTexture(const TextureDesc &desc) : Texture(desc), m_imageFormat(desc.format) {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+			VlkRenderContext *contextP = static_cast<VlkRenderContext *>(VlkRenderContext::Get());
+
+			if (!m_desc.width || !m_desc.height || !m_desc.layers) {
+				throw new std::runtime_error("VlkTexture creation failed - empty texture.");
+			}
+			if (m_desc.type == TextureType::Texture2D && m_desc.layers > 1u) {
+				throw new std::runtime_error("VlkTexture creation failed - 2D textures have a single layer, use an array texture.");
+			}
+			if (m_desc.type == TextureType::TextureCube) {
+				if (m_desc.width != m_desc.height) {
+					throw new std::runtime_error("VlkTexture creation failed - cube faces must be square.");
+				}
+				if (m_desc.layers > 1u && !deviceP->GetEnabledFeatures().imageCubeArray) {
+					throw new std::runtime_error("VlkTexture creation failed - cube arrays are not supported by the device.");
+				}
+			}
+
+			m_layerCount = m_desc.type == TextureType::TextureCube ? m_desc.layers * 6u : m_desc.layers;
+
+			// Compressed data the device cannot sample is decoded while staging and stored uncompressed
+			if (IsCompressedFormat(m_desc.format) && !IsVkFormatSupported(m_desc.format)) {
+				if (!TextureTranscoder::CanTranscode(m_desc.format)) {
+					throw new std::runtime_error("VlkTexture creation failed - compressed format not supported by the device.");
+				}
+				m_imageFormat = TextureTranscoder::GetTranscodedFormat(m_desc.format);
+				m_transcoded = true;
+			}
+
+			m_vkFormat = GetVkFormat(m_imageFormat);
+
+			VkFormatProperties formatProperties = {};
+			vkGetPhysicalDeviceFormatProperties(deviceP->GetActiveAdapter().GetHandle(), m_vkFormat, &formatProperties);
+
+			const VkFormatFeatureFlags blitFeatures =
+				VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+			m_canBlit = (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+
+			uint32_t fullChain = 1u;
+			for (uint32_t size = std::max(m_desc.width, m_desc.height); size > 1u; size >>= 1u) {
+				fullChain++;
+			}
+
+			// Without blits (compressed formats) the chain can still be uploaded level by level, but only when asked for explicitly
+			m_mipLevels = m_desc.mipLevels ? std::min(m_desc.mipLevels, fullChain) : (m_canBlit ? fullChain : 1u);
+
+			if (m_desc.residentMip >= m_mipLevels) {
+				throw new std::runtime_error("VlkTexture creation failed - resident mip level out of range.");
+			}
+
+			m_residentMip = m_desc.residentMip;
+			CreateImage();
+
+			// The sampler covers the whole chain - views of partially resident images clamp the levels
+			m_vkSampler = contextP->GetSamplerCache()->GetSampler(m_desc.sampler, m_mipLevels);
+
+			if (!m_vkSampler) {
+				throw new std::runtime_error("VlkTexture creation failed - unable to create a sampler.");
+			}
+
+			// Sampled before any upload the texture reads undefined contents instead of faulting on the layout
+			VlkUploadBatcher *batcherP = contextP->GetUploadBatcher();
+			RecordShaderReadTransition(batcherP->GetCommandBuffer(), VK_IMAGE_LAYOUT_UNDEFINED, 0u, GetImageLevels());
+			m_uploadBatch = batcherP->GetBatchNumber();
+		}
+
+		VlkTexture::~VlkTexture() {
+			ReleaseImage();
+		}
+
+		void VlkTexture::CreateImage() {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+			VkDevice device = deviceP->GetHandle();
+
+			VkImageCreateInfo imageInfo = {};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.flags = m_desc.type == TextureType::TextureCube ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = m_vkFormat;
+			imageInfo.extent = { GetLevelWidth(m_residentMip), GetLevelHeight(m_residentMip), 1u };
+			imageInfo.mipLevels = GetImageLevels();
+			imageInfo.arrayLayers = m_layerCount;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			vkCreateImage(device, &imageInfo, deviceP->GetAllocationCallbacks(VlkHostAllocator::IMAGE), &m_vkImage);
+
+			if (!m_vkImage) {
+				throw new std::runtime_error("VlkTexture creation failed - unable to create an image.");
+			}
+
+			VkMemoryRequirements memoryRequirements = {};
+			vkGetImageMemoryRequirements(device, m_vkImage, &memoryRequirements);
+
+			m_vkMemory = deviceP->AllocateMemory(
+				memoryRequirements,
+				{ VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT },
+				MemoryCategory::TextureMemory);
+
+			if (!m_vkMemory) {
+				vkDestroyImage(device, m_vkImage, deviceP->GetAllocationCallbacks(VlkHostAllocator::IMAGE));
+				m_vkImage = VK_NULL_HANDLE;
+				throw new std::runtime_error("VlkTexture creation failed - unable to allocate image memory.");
+			}
+
+			vkBindImageMemory(device, m_vkImage, m_vkMemory, 0);
+			static_cast<VlkRenderContext *>(VlkRenderContext::Get())->RecordAllocation(memoryRequirements.size);
+			m_memorySize = memoryRequirements.size;
+
+			VkImageViewCreateInfo imageViewInfo = {};
+			imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			imageViewInfo.image = m_vkImage;
+			imageViewInfo.format = m_vkFormat;
+			imageViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			imageViewInfo.subresourceRange.levelCount = GetImageLevels();
+			imageViewInfo.subresourceRange.layerCount = m_layerCount;
+
+			switch (m_desc.type)
+			{
+			case TextureType::TextureArray:
+				imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+				break;
+			case TextureType::TextureCube:
+				imageViewInfo.viewType = m_desc.layers > 1u ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : VK_IMAGE_VIEW_TYPE_CUBE;
+				break;
+			default:
+				imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				break;
+			}
+
+			vkCreateImageView(device, &imageViewInfo, deviceP->GetAllocationCallbacks(VlkHostAllocator::IMAGE), &m_vkImageView);
+
+			if (!m_vkImageView) {
+				throw new std::runtime_error("VlkTexture creation failed - unable to create an image view.");
+			}
+
+			m_imageVersion++;
+		}
+
+		void VlkTexture::ReleaseImage() {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+			VlkUploadBatcher *batcherP = static_cast<VlkRenderContext *>(VlkRenderContext::Get())->GetUploadBatcher();
+
+			auto release = [deviceP, image = m_vkImage, view = m_vkImageView, memory = m_vkMemory]() {
+				VkDevice device = deviceP->GetHandle();
+				if (view) {
+					vkDestroyImageView(device, view, deviceP->GetAllocationCallbacks(VlkHostAllocator::IMAGE));
+				}
+				if (image) {
+					vkDestroyImage(device, image, deviceP->GetAllocationCallbacks(VlkHostAllocator::IMAGE));
+				}
+				if (memory) {
+					deviceP->FreeMemory(memory);
+				}
+			};
+
+			// Copies still being recorded reference the image - released once their batch is submitted and done
+			if (m_uploadBatch == batcherP->GetBatchNumber()) {
+				batcherP->DeferRelease(release);
+			}
+			else {
+				deviceP->DeferRelease(release);
+			}
+
+			m_vkImage = VK_NULL_HANDLE;
+			m_vkImageView = VK_NULL_HANDLE;
+			m_vkMemory = VK_NULL_HANDLE;
+			m_memorySize = 0u;
+		}
+
+		void VlkTexture::Bind() const {
+			VlkRenderContext *pVlkRenderContext = static_cast<VlkRenderContext *>(VlkRenderContext::Get());
+			pVlkRenderContext->BindTexture(this);
+		}
+
+		bool VlkTexture::IsUploadComplete() const {
+			return static_cast<VlkRenderContext *>(VlkRenderContext::Get())->GetUploadBatcher()->IsBatchComplete(m_uploadBatch);
+		}
+
+		void VlkTexture::RecordShaderReadTransition(VkCommandBuffer commandBuffer, const VkImageLayout oldLayout, const uint32_t baseLevel, const uint32_t levelCount) {
+
+			VkImageMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = oldLayout == VK_IMAGE_LAYOUT_UNDEFINED ? 0 : VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = m_vkImage;
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, levelCount, 0u, m_layerCount };
+
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				oldLayout == VK_IMAGE_LAYOUT_UNDEFINED ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT,
+				s_shaderReadStages,
+				0, 0, nullptr, 0, nullptr, 1, &barrier);
+		}
+
+		void VlkTexture::RecordCopy(VkCommandBuffer commandBuffer, const uint32_t mipLevel, const void *data, const bool discard) {
+
+			VlkRenderContext *contextP = static_cast<VlkRenderContext *>(VlkRenderContext::Get());
+
+			const uint32_t width = GetLevelWidth(mipLevel);
+			const uint32_t height = GetLevelHeight(mipLevel);
+			const VkDeviceSize size = GetTextureLevelSize(m_imageFormat, width, height) * m_layerCount;
+
+			// Offsets of compressed copies must be multiples of the block size - the batcher aligns to 16 bytes
+			const VlkStagingAllocation staging = contextP->GetUploadBatcher()->Allocate(size);
+
+			if (m_transcoded) {
+				// Decoded straight into staging memory - the compressed data is never copied
+				TextureTranscoder::Transcode(m_desc.format, width, height, m_layerCount, static_cast<const uint8_t *>(data), static_cast<uint8_t *>(staging.dataP));
+				contextP->RecordTranscode(static_cast<uint64_t>(width) * height * m_layerCount);
+			}
+			else {
+				std::memcpy(staging.dataP, data, size);
+			}
+
+			RecordStagedCopy(commandBuffer, mipLevel, staging, discard);
+		}
+
+		void VlkTexture::RecordStagedCopy(VkCommandBuffer commandBuffer, const uint32_t mipLevel, const VlkStagingAllocation &staging, const bool discard) {
+
+			VlkRenderContext *contextP = static_cast<VlkRenderContext *>(VlkRenderContext::Get());
+
+			const uint32_t width = GetLevelWidth(mipLevel);
+			const uint32_t height = GetLevelHeight(mipLevel);
+			const uint32_t imageLevel = mipLevel - m_residentMip;
+
+			// Earlier contents are discarded - only reads of frames already submitted have to finish first
+			if (discard) {
+				VkImageMemoryBarrier barrier = {};
+				barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.image = m_vkImage;
+				barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, imageLevel, 1u, 0u, m_layerCount };
+
+				vkCmdPipelineBarrier(commandBuffer, s_shaderReadStages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+			}
+
+			VkBufferImageCopy region = {};
+			region.bufferOffset = staging.offset;
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, imageLevel, 0u, m_layerCount };
+			region.imageExtent = { width, height, 1u };
+
+			vkCmdCopyBufferToImage(commandBuffer, staging.buffer, m_vkImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1u, &region);
+
+			contextP->RecordUpload(GetTextureLevelSize(m_imageFormat, width, height) * m_layerCount, 0u);
+		}
+
+		void VlkTexture::SetData(const void *data) {
+
+			VlkRenderContext *contextP = static_cast<VlkRenderContext *>(VlkRenderContext::Get());
+			VlkUploadBatcher *batcherP = contextP->GetUploadBatcher();
+			VkCommandBuffer commandBuffer = batcherP->GetCommandBuffer();
+			const uint32_t imageLevels = GetImageLevels();
+
+			RecordCopy(commandBuffer, m_residentMip, data, true);
+
+			// Without blits lower levels keep their contents, uploaded through SetMipData
+			if (imageLevels == 1u || !m_canBlit) {
+				RecordShaderReadTransition(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0u, 1u);
+				m_uploadBatch = batcherP->GetBatchNumber();
+				return;
+			}
+
+			VkImageMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = m_vkImage;
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 1u, imageLevels - 1u, 0u, m_layerCount };
+
+			// Levels below the top are overwritten entirely by the blits
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+			vkCmdPipelineBarrier(commandBuffer, s_shaderReadStages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			int32_t width = GetLevelWidth(m_residentMip);
+			int32_t height = GetLevelHeight(m_residentMip);
+
+			// Each level is downsampled from the previous one, which turns into a blit source once written
+			for (uint32_t level = 1u; level < imageLevels; level++) {
+
+				barrier.subresourceRange.baseMipLevel = level - 1u;
+				barrier.subresourceRange.levelCount = 1u;
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+				const int32_t levelWidth = std::max(width / 2, 1);
+				const int32_t levelHeight = std::max(height / 2, 1);
+
+				VkImageBlit blit = {};
+				blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1u, 0u, m_layerCount };
+				blit.srcOffsets[1] = { width, height, 1 };
+				blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0u, m_layerCount };
+				blit.dstOffsets[1] = { levelWidth, levelHeight, 1 };
+
+				vkCmdBlitImage(
+					commandBuffer,
+					m_vkImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					m_vkImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					1u, &blit, VK_FILTER_LINEAR);
+
+				width = levelWidth;
+				height = levelHeight;
+			}
+
+			// All but the last level were blit sources
+			barrier.subresourceRange.baseMipLevel = 0u;
+			barrier.subresourceRange.levelCount = imageLevels - 1u;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, s_shaderReadStages, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+			RecordShaderReadTransition(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLevels - 1u, 1u);
+
+			m_uploadBatch = batcherP->GetBatchNumber();
+		}
+
+		void VlkTexture::SetMipData(const uint32_t mipLevel, const void *data) {
+
+			if (mipLevel < m_residentMip || mipLevel >= m_mipLevels) {
+				throw new std::runtime_error("VlkTexture SetMipData failed - mip level not resident.");
+			}
+
+			VlkUploadBatcher *batcherP = static_cast<VlkRenderContext *>(VlkRenderContext::Get())->GetUploadBatcher();
+			VkCommandBuffer commandBuffer = batcherP->GetCommandBuffer();
+
+			RecordCopy(commandBuffer, mipLevel, data, true);
+			RecordShaderReadTransition(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevel - m_residentMip, 1u);
+
+			m_uploadBatch = batcherP->GetBatchNumber();
+		}
+
+		void VlkTexture::SetMipData(const uint32_t mipLevel, const VlkStagingAllocation &staging) {
+
+			// Compressed data still has to be decoded - read from staging memory like any other source
+			if (m_transcoded) {
+				SetMipData(mipLevel, staging.dataP);
+				return;
+			}
+
+			if (mipLevel < m_residentMip || mipLevel >= m_mipLevels) {
+				throw new std::runtime_error("VlkTexture SetMipData failed - mip level not resident.");
+			}
+
+			VlkUploadBatcher *batcherP = static_cast<VlkRenderContext *>(VlkRenderContext::Get())->GetUploadBatcher();
+			VkCommandBuffer commandBuffer = batcherP->GetCommandBuffer();
+
+			RecordStagedCopy(commandBuffer, mipLevel, staging, true);
+			RecordShaderReadTransition(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevel - m_residentMip, 1u);
+
+			m_uploadBatch = batcherP->GetBatchNumber();
+		}
+
+		void VlkTexture::SetResidentMip(const uint32_t mipLevel, const void *const *levelData) {
+
+			if (mipLevel >= m_mipLevels) {
+				throw new std::runtime_error("VlkTexture SetResidentMip failed - mip level out of range.");
+			}
+			if (mipLevel < m_residentMip && !levelData) {
+				throw new std::runtime_error("VlkTexture SetResidentMip failed - no data for the levels made resident.");
+			}
+			if (mipLevel == m_residentMip) {
+				return;
+			}
+
+			VlkUploadBatcher *batcherP = static_cast<VlkRenderContext *>(VlkRenderContext::Get())->GetUploadBatcher();
+			VkCommandBuffer commandBuffer = batcherP->GetCommandBuffer();
+
+			const VkImage oldImage = m_vkImage;
+			const uint32_t oldResidentMip = m_residentMip;
+			const uint32_t oldImageLevels = GetImageLevels();
+
+			// The old image stays alive until the copies out of it have executed
+			m_uploadBatch = batcherP->GetBatchNumber();
+			ReleaseImage();
+
+			m_residentMip = mipLevel;
+			CreateImage();
+
+			VkImageMemoryBarrier barriers[2] = {};
+
+			for (auto &barrier : barriers) {
+				barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			}
+
+			// Earlier uploads into the old image are complete and frames sampling it were submitted first
+			barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			barriers[0].image = oldImage;
+			barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0u, oldImageLevels, 0u, m_layerCount };
+
+			barriers[1].srcAccessMask = 0;
+			barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barriers[1].image = m_vkImage;
+			barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0u, GetImageLevels(), 0u, m_layerCount };
+
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				s_shaderReadStages | VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0, 0, nullptr, 0, nullptr, 2, barriers);
+
+			// Levels resident in both images move on the GPU
+			const uint32_t firstCommonLevel = std::max(oldResidentMip, m_residentMip);
+			std::vector<VkImageCopy> regions;
+
+			for (uint32_t level = firstCommonLevel; level < m_mipLevels; level++) {
+				VkImageCopy region = {};
+				region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - oldResidentMip, 0u, m_layerCount };
+				region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - m_residentMip, 0u, m_layerCount };
+				region.extent = { GetLevelWidth(level), GetLevelHeight(level), 1u };
+				regions.push_back(region);
+			}
+
+			vkCmdCopyImage(
+				commandBuffer,
+				oldImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				m_vkImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				regions.size(), regions.data());
+
+			// Levels becoming resident come from the caller
+			for (uint32_t level = m_residentMip; level < oldResidentMip; level++) {
+				RecordCopy(commandBuffer, level, levelData[level - m_residentMip], false);
+			}
+
+			RecordShaderReadTransition(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0u, GetImageLevels());
+		}
+	}
+}
@@ -0,0 +1,89 @@
+#ifndef VLK_TEXTURE_H_
+#define VLK_TEXTURE_H_
+
+#include <Texture.h>
+#include <vulkan/VlkUploadBatcher.h>
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+
+namespace PixelMachine {
+	namespace GPU {
+		/// <summary>
+		/// Sampled image in device local memory with optimal tiling. Uploads are recorded into the shared
+		/// upload batcher and submitted ahead of the next frame, mip chains are generated with blits on the
+		/// graphics queue. Block compressed formats the device lacks are decoded on the CPU while staging. Textures are sampled by graphics passes and compute passes of the graphics queue only.
+		/// Only levels from the resident mip on are allocated - changing residency moves the kept levels into a
+		/// reallocated image on the GPU and bumps the image version, so passes rewrite their descriptors.
+		/// </summary>
+		class VlkTexture : public Texture {
+		public:
+			VlkTexture(const TextureDesc &desc);
+			~VlkTexture();
+			uint32_t GetMipLevels() const override { return m_mipLevels; }
+			void Bind() const override;
+			void SetData(const void *data) override;
+			void SetMipData(const uint32_t mipLevel, const void *data) override;
+			bool IsUploadComplete() const override;
+			bool IsTranscoded() const override { return m_transcoded; }
+			uint32_t GetResidentMip() const override { return m_residentMip; }
+			uint64_t GetResidentSize() const override { return m_memorySize; }
+			void SetResidentMip(const uint32_t mipLevel, const void *const *levelData = nullptr) override;
+			/* Copies level <mipLevel> of every layer, as stored in a file, from staging memory filled by the
+			 caller - the copy joins the current upload batch */
+			void SetMipData(const uint32_t mipLevel, const VlkStagingAllocation &staging);
+
+			VkImage GetVkImage() const { return m_vkImage; }
+			VkImageView GetVkImageView() const { return m_vkImageView; }
+			VkSampler GetVkSampler() const { return m_vkSampler; }
+			VkFormat GetVkFormat() const { return m_vkFormat; }
+			/* Image layers - six per cube */
+			uint32_t GetLayerCount() const { return m_layerCount; }
+			/* Incremented whenever the image and view are reallocated */
+			uint64_t GetImageVersion() const { return m_imageVersion; }
+
+			static VkFormat GetVkFormat(const TextureFormat format);
+			/* True when the device samples <format> from optimal tiled images - compressed formats also need their feature enabled */
+			static bool IsVkFormatSupported(const TextureFormat format);
+
+		private:
+			/* Creates the image, its memory and view for the levels from the resident mip on */
+			void CreateImage();
+			/* Releases the image once the uploads and frames using it have completed */
+			void ReleaseImage();
+			uint32_t GetImageLevels() const { return m_mipLevels - m_residentMip; }
+			uint32_t GetLevelWidth(const uint32_t mipLevel) const { return std::max(m_desc.width >> mipLevel, 1u); }
+			uint32_t GetLevelHeight(const uint32_t mipLevel) const { return std::max(m_desc.height >> mipLevel, 1u); }
+			/* Stages <data> and records its copy into texture level <mipLevel> of every layer, leaving the level in
+			 TRANSFER_DST_OPTIMAL - <discard> transitions the level from UNDEFINED first */
+			void RecordCopy(VkCommandBuffer commandBuffer, const uint32_t mipLevel, const void *data, const bool discard);
+			/* Records the copy of <staging> into texture level <mipLevel> of every layer, as RecordCopy */
+			void RecordStagedCopy(VkCommandBuffer commandBuffer, const uint32_t mipLevel, const VlkStagingAllocation &staging, const bool discard);
+			/* Records the transition of <levelCount> levels from <baseLevel> on to SHADER_READ_ONLY_OPTIMAL */
+			void RecordShaderReadTransition(VkCommandBuffer commandBuffer, const VkImageLayout oldLayout, const uint32_t baseLevel, const uint32_t levelCount);
+
+			// Format of the image - RGBA8 when compressed data is transcoded
+			TextureFormat m_imageFormat = TextureFormat::TextureRGBA8;
+			VkFormat m_vkFormat = VK_FORMAT_UNDEFINED;
+			bool m_transcoded = false;
+			VkImage m_vkImage = VK_NULL_HANDLE;
+			VkDeviceMemory m_vkMemory = VK_NULL_HANDLE;
+			VkImageView m_vkImageView = VK_NULL_HANDLE;
+			// Owned by the sampler cache of the render context
+			VkSampler m_vkSampler = VK_NULL_HANDLE;
+			uint32_t m_mipLevels = 1u;
+			// Finest allocated level - image level 0
+			uint32_t m_residentMip = 0u;
+			VkDeviceSize m_memorySize = 0;
+			uint64_t m_imageVersion = 0;
+			uint32_t m_layerCount = 1u;
+			// Mip generation needs linear filtering and blits of the format
+			bool m_canBlit = false;
+			// Upload batch of the latest upload
+			uint64_t m_uploadBatch = 0;
+		};
+	}
+}
+
+#endif // !VLK_TEXTURE_H_
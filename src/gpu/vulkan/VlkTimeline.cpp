@@ -0,0 +1,68 @@
+#include <vulkan/VlkTimeline.h>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		VlkTimeline::~VlkTimeline() {
+			Destroy();
+		}
+
+		bool VlkTimeline::Create(VkDevice device, const VkAllocationCallbacks *allocatorP) {
+
+			Destroy();
+
+			VkSemaphoreTypeCreateInfo semaphoreTypeInfo = {};
+			semaphoreTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+			semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+			semaphoreTypeInfo.initialValue = 0u;
+
+			VkSemaphoreCreateInfo semaphoreInfo = {};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			semaphoreInfo.pNext = &semaphoreTypeInfo;
+
+			m_vkDevice = device;
+			m_allocatorP = allocatorP;
+			m_submittedValue = 0u;
+			m_completedValue = 0u;
+
+			vkCreateSemaphore(device, &semaphoreInfo, allocatorP, &m_vkSemaphore);
+
+			return m_vkSemaphore != VK_NULL_HANDLE;
+		}
+
+		void VlkTimeline::Destroy() {
+
+			if (m_vkSemaphore) {
+				vkDestroySemaphore(m_vkDevice, m_vkSemaphore, m_allocatorP);
+				m_vkSemaphore = VK_NULL_HANDLE;
+			}
+		}
+
+		bool VlkTimeline::IsComplete(const uint64_t value) {
+
+			if (value <= m_completedValue) {
+				return true;
+			}
+
+			vkGetSemaphoreCounterValue(m_vkDevice, m_vkSemaphore, &m_completedValue);
+
+			return value <= m_completedValue;
+		}
+
+		void VlkTimeline::WaitFor(const uint64_t value) {
+
+			if (IsComplete(value)) {
+				return;
+			}
+
+			VkSemaphoreWaitInfo waitInfo = {};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+			waitInfo.semaphoreCount = 1u;
+			waitInfo.pSemaphores = &m_vkSemaphore;
+			waitInfo.pValues = &value;
+
+			vkWaitSemaphores(m_vkDevice, &waitInfo, UINT64_MAX);
+			m_completedValue = value;
+		}
+	}
+}
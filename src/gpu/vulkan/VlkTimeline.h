@@ -0,0 +1,50 @@
+#ifndef VLK_TIMELINE_H_
+#define VLK_TIMELINE_H_
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+namespace PixelMachine {
+	namespace GPU {
+		/* Semaphore a submit waits for - <value> is ignored for binary semaphores */
+		struct VlkSemaphoreWait {
+			VkSemaphore semaphore = VK_NULL_HANDLE;
+			uint64_t value = 0;
+			VkPipelineStageFlags stages = 0;
+		};
+
+		/// <summary>
+		/// Timeline semaphore of one queue. Every submit signals the next value, so a single
+		/// value identifies a submit together with all work submitted before it on that queue.
+		/// </summary>
+		class VlkTimeline {
+		public:
+			VlkTimeline() = default;
+			VlkTimeline(const VlkTimeline &) = delete;
+			VlkTimeline &operator=(const VlkTimeline &) = delete;
+			~VlkTimeline();
+
+			bool Create(VkDevice device, const VkAllocationCallbacks *allocatorP);
+			void Destroy();
+			VkSemaphore GetHandle() const { return m_vkSemaphore; }
+			/* Reserves the value the next submit signals */
+			uint64_t Advance() { return ++m_submittedValue; }
+			/* Value signaled by the latest submit - waiting for it waits for all work on the queue */
+			uint64_t GetSubmittedValue() const { return m_submittedValue; }
+			/* Non-blocking - queries the semaphore only when the cached completed value is behind <value> */
+			bool IsComplete(const uint64_t value);
+			/* Blocks until the queue has signaled <value> */
+			void WaitFor(const uint64_t value);
+
+		private:
+			VkDevice m_vkDevice = VK_NULL_HANDLE;
+			const VkAllocationCallbacks *m_allocatorP = nullptr;
+			VkSemaphore m_vkSemaphore = VK_NULL_HANDLE;
+			uint64_t m_submittedValue = 0;
+			uint64_t m_completedValue = 0;
+		};
+	}
+}
+
+#endif // !VLK_TIMELINE_H_
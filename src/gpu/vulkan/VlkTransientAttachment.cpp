@@ -0,0 +1,122 @@
+#include <vulkan/VlkTransientAttachment.h>
+#include <vulkan/VlkRenderContext.h>
+#include <vulkan/VlkDevice.h>
+
+#include <stdexcept>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		static VkImageAspectFlags GetFormatAspect(const VkFormat format) {
+			switch (format)
+			{
+			case VK_FORMAT_D16_UNORM:
+			case VK_FORMAT_X8_D24_UNORM_PACK32:
+			case VK_FORMAT_D32_SFLOAT:
+				return VK_IMAGE_ASPECT_DEPTH_BIT;
+			case VK_FORMAT_D16_UNORM_S8_UINT:
+			case VK_FORMAT_D24_UNORM_S8_UINT:
+			case VK_FORMAT_D32_SFLOAT_S8_UINT:
+				return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+			default:
+				break;
+			}
+			return VK_IMAGE_ASPECT_COLOR_BIT;
+		}
+
+		VkFormat VlkTransientAttachment::FindDepthFormat(VkPhysicalDevice physicalDevice) {
+
+			// D32 is supported by every desktop driver, tilers are guaranteed one of the others
+			const VkFormat candidates[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D16_UNORM };
+
+			for (auto format : candidates) {
+				VkFormatProperties properties = {};
+				vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+
+				if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+					return format;
+				}
+			}
+
+			return VK_FORMAT_UNDEFINED;
+		}
+
+		VlkTransientAttachment::VlkTransientAttachment(VkFormat format, VkExtent2D extent, VkSampleCountFlagBits samples, VkImageUsageFlags usage)
+			: m_format(format), m_extent(extent), m_samples(samples), m_aspect(GetFormatAspect(format)) {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+			VkDevice device = deviceP->GetHandle();
+
+			VkImageCreateInfo imageInfo = {};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = m_format;
+			imageInfo.extent = { m_extent.width, m_extent.height, 1u };
+			imageInfo.mipLevels = 1u;
+			imageInfo.arrayLayers = 1u;
+			imageInfo.samples = m_samples;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			// Transient usage allows lazily allocated memory - nothing but attachment usage may go with it
+			imageInfo.usage = usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			vkCreateImage(device, &imageInfo, deviceP->GetAllocationCallbacks(VlkHostAllocator::IMAGE), &m_vkImage);
+
+			if (!m_vkImage) {
+				throw new std::runtime_error("VlkTransientAttachment creation failed - unable to create an image.");
+			}
+
+			VkMemoryRequirements memoryRequirements = {};
+			vkGetImageMemoryRequirements(device, m_vkImage, &memoryRequirements);
+
+			VkMemoryPropertyFlags memoryProperties = 0;
+			m_vkMemory = deviceP->AllocateMemory(
+				memoryRequirements,
+				{ VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT },
+				MemoryCategory::RenderTargetMemory,
+				&memoryProperties);
+
+			if (!m_vkMemory) {
+				throw new std::runtime_error("VlkTransientAttachment creation failed - unable to allocate image memory.");
+			}
+
+			m_lazilyAllocated = memoryProperties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+			vkBindImageMemory(device, m_vkImage, m_vkMemory, 0);
+
+			VkImageViewCreateInfo imageViewInfo = {};
+			imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			imageViewInfo.image = m_vkImage;
+			imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			imageViewInfo.format = m_format;
+			imageViewInfo.subresourceRange.aspectMask = m_aspect;
+			imageViewInfo.subresourceRange.levelCount = 1u;
+			imageViewInfo.subresourceRange.layerCount = 1u;
+
+			vkCreateImageView(device, &imageViewInfo, deviceP->GetAllocationCallbacks(VlkHostAllocator::IMAGE), &m_vkImageView);
+
+			if (!m_vkImageView) {
+				throw new std::runtime_error("VlkTransientAttachment creation failed - unable to create an image view.");
+			}
+		}
+
+		VlkTransientAttachment::~VlkTransientAttachment() {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+
+			// Frames in flight may still render into the attachment
+			deviceP->DeferRelease([deviceP, image = m_vkImage, view = m_vkImageView, memory = m_vkMemory]() {
+				VkDevice device = deviceP->GetHandle();
+				if (view) {
+					vkDestroyImageView(device, view, deviceP->GetAllocationCallbacks(VlkHostAllocator::IMAGE));
+				}
+				if (image) {
+					vkDestroyImage(device, image, deviceP->GetAllocationCallbacks(VlkHostAllocator::IMAGE));
+				}
+				if (memory) {
+					deviceP->FreeMemory(memory);
+				}
+			});
+		}
+	}
+}
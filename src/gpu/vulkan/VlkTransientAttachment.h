@@ -0,0 +1,49 @@
+#ifndef VLK_TRANSIENT_ATTACHMENT_H_
+#define VLK_TRANSIENT_ATTACHMENT_H_
+
+#include <vulkan/vulkan.h>
+
+namespace PixelMachine {
+	namespace GPU {
+		/// <summary>
+		/// Attachment image whose contents only live within one rendering instance - cleared on load
+		/// and never stored. Backed by lazily allocated memory where the device has it, so on tile based
+		/// GPUs it stays in tile memory and takes neither device memory nor bandwidth.
+		/// </summary>
+		class VlkTransientAttachment {
+		public:
+			VlkTransientAttachment(
+				VkFormat format,
+				VkExtent2D extent,
+				VkSampleCountFlagBits samples,
+				VkImageUsageFlags usage);
+			VlkTransientAttachment(const VlkTransientAttachment &) = delete;
+			VlkTransientAttachment &operator=(const VlkTransientAttachment &) = delete;
+			~VlkTransientAttachment();
+			VkImage GetVkImage() const { return m_vkImage; }
+			VkImageView GetVkImageView() const { return m_vkImageView; }
+			VkFormat GetFormat() const { return m_format; }
+			VkExtent2D GetExtent() const { return m_extent; }
+			VkSampleCountFlagBits GetSamples() const { return m_samples; }
+			/* Aspects of the format - depth formats with stencil transition both */
+			VkImageAspectFlags GetAspect() const { return m_aspect; }
+			/* True when backed by lazily allocated memory */
+			bool IsLazilyAllocated() const { return m_lazilyAllocated; }
+
+			/* First of the common depth formats usable as an optimal tiling attachment on <physicalDevice> */
+			static VkFormat FindDepthFormat(VkPhysicalDevice physicalDevice);
+
+		private:
+			VkFormat m_format = VK_FORMAT_UNDEFINED;
+			VkExtent2D m_extent = {};
+			VkSampleCountFlagBits m_samples = VK_SAMPLE_COUNT_1_BIT;
+			VkImageAspectFlags m_aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+			VkImage m_vkImage = VK_NULL_HANDLE;
+			VkDeviceMemory m_vkMemory = VK_NULL_HANDLE;
+			VkImageView m_vkImageView = VK_NULL_HANDLE;
+			bool m_lazilyAllocated = false;
+		};
+	}
+}
+
+#endif // !VLK_TRANSIENT_ATTACHMENT_H_
@@ -0,0 +1,259 @@
+#include <vulkan/VlkUploadBatcher.h>
+#include <vulkan/VlkRenderContext.h>
+#include <vulkan/VlkDevice.h>
+#include <vulkan/VlkBuffer.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace PixelMachine {
+	namespace GPU {
+
+		// Host written, read once by a copy - kept out of device local memory
+		static const VlkMemoryFlags s_stagingMemoryFlags = {
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			0,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT };
+
+		VlkUploadBatcher::VlkUploadBatcher() {
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+
+			VkCommandPoolCreateInfo commandPoolInfo = {};
+			commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			commandPoolInfo.queueFamilyIndex = deviceP->GetActiveQueue().second;
+			commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+			vkCreateCommandPool(deviceP->GetHandle(), &commandPoolInfo, deviceP->GetAllocationCallbacks(VlkHostAllocator::COMMAND_POOL), &m_vkCommandPool);
+
+			if (!m_vkCommandPool) {
+				throw new std::runtime_error("VlkUploadBatcher creation failed - cannot create command pool.");
+			}
+		}
+
+		VlkUploadBatcher::~VlkUploadBatcher() {
+
+			// Whatever is still recorded is submitted, textures may already be sampled expecting it
+			Flush();
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+
+			for (auto &chunk : m_chunks) {
+				vkUnmapMemory(deviceP->GetHandle(), chunk.m_vkMemory);
+				ReleaseVkBuffer(chunk.m_vkBuffer, chunk.m_vkMemory);
+			}
+
+			// Held allocations not returned - their reads were abandoned with the loader
+			for (auto &held : m_heldBuffers) {
+				vkUnmapMemory(deviceP->GetHandle(), held.second);
+				ReleaseVkBuffer(held.first, held.second);
+			}
+
+			// Submitted command buffers are freed with their pool
+			deviceP->DeferRelease([deviceP, commandPool = m_vkCommandPool]() {
+				vkDestroyCommandPool(deviceP->GetHandle(), commandPool, deviceP->GetAllocationCallbacks(VlkHostAllocator::COMMAND_POOL));
+			});
+		}
+
+		void VlkUploadBatcher::UpdateCompletedBatches() {
+
+			VlkTimeline &timeline = VlkRenderContext::GetVlkDevice()->GetTimeline(VlkDevice::QueueType::GRAPHICS);
+
+			// Batches complete in submission order
+			while (m_submittedBatches.size() && timeline.IsComplete(m_submittedBatches.front().m_timelineValue)) {
+				m_completedBatches = m_submittedBatches.front().m_batchNumber + 1u;
+				m_freeCommandBuffers.push_back(m_submittedBatches.front().m_vkCommandBuffer);
+				m_submittedBatches.pop_front();
+			}
+		}
+
+		bool VlkUploadBatcher::IsBatchComplete(const uint64_t batchNumber) {
+
+			if (batchNumber >= m_completedBatches) {
+				UpdateCompletedBatches();
+			}
+
+			return batchNumber < m_completedBatches;
+		}
+
+		uint32_t VlkUploadBatcher::AcquireChunk() {
+
+			for (uint32_t i = 0; i < m_chunks.size(); i++) {
+				if (i != m_currentChunk && !m_chunks[i].m_holdCount && IsBatchComplete(m_chunks[i].m_lastBatch)) {
+					m_chunks[i].m_offset = 0;
+					return i;
+				}
+			}
+
+			VlkStagingChunk chunk;
+			chunk.m_vkBuffer = CreateVkBuffer(sm_chunkSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, s_stagingMemoryFlags, MemoryCategory::StagingMemory, chunk.m_vkMemory);
+
+			if (!chunk.m_vkBuffer) {
+				throw new std::runtime_error("VlkUploadBatcher allocation failed - cannot create staging chunk.");
+			}
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+			vkMapMemory(deviceP->GetHandle(), chunk.m_vkMemory, 0, sm_chunkSize, 0, &chunk.m_mappedP);
+
+			m_chunks.push_back(chunk);
+			return m_chunks.size() - 1u;
+		}
+
+		VlkStagingAllocation VlkUploadBatcher::Allocate(const VkDeviceSize size, const VkDeviceSize alignment) {
+			return AllocateStaging(size, alignment, false);
+		}
+
+		VlkStagingAllocation VlkUploadBatcher::AllocateHeld(const VkDeviceSize size, const VkDeviceSize alignment) {
+			return AllocateStaging(size, alignment, true);
+		}
+
+		void VlkUploadBatcher::Release(const VlkStagingAllocation &allocation) {
+
+			if (allocation.chunkIndex != ~0u) {
+				VlkStagingChunk &chunk = m_chunks[allocation.chunkIndex];
+				chunk.m_holdCount--;
+				chunk.m_lastBatch = std::max(chunk.m_lastBatch, m_batchNumber);
+				return;
+			}
+
+			auto held = std::find_if(m_heldBuffers.begin(), m_heldBuffers.end(), [&allocation](const std::pair<VkBuffer, VkDeviceMemory> &buffer) { return buffer.first == allocation.buffer; });
+
+			if (held == m_heldBuffers.end()) {
+				return;
+			}
+
+			// Released with the dedicated buffers of the batch after its submit, right away when nothing is recorded
+			if (m_vkCommandBuffer) {
+				m_dedicatedBuffers.push_back(*held);
+			}
+			else {
+				vkUnmapMemory(VlkRenderContext::GetVlkDevice()->GetHandle(), held->second);
+				ReleaseVkBuffer(held->first, held->second);
+			}
+
+			m_heldBuffers.erase(held);
+		}
+
+		VlkStagingAllocation VlkUploadBatcher::AllocateStaging(const VkDeviceSize size, const VkDeviceSize alignment, const bool held) {
+
+			VlkStagingAllocation allocation;
+
+			if (size > sm_chunkSize) {
+
+				VkDeviceMemory memory = VK_NULL_HANDLE;
+				allocation.buffer = CreateVkBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, s_stagingMemoryFlags, MemoryCategory::StagingMemory, memory);
+
+				if (!allocation.buffer) {
+					throw new std::runtime_error("VlkUploadBatcher allocation failed - cannot create staging buffer.");
+				}
+
+				vkMapMemory(VlkRenderContext::GetVlkDevice()->GetHandle(), memory, 0, size, 0, &allocation.dataP);
+				(held ? m_heldBuffers : m_dedicatedBuffers).emplace_back(allocation.buffer, memory);
+
+				return allocation;
+			}
+
+			VkDeviceSize offset = m_currentChunk != ~0u ? (m_chunks[m_currentChunk].m_offset + alignment - 1u) / alignment * alignment : 0u;
+
+			if (m_currentChunk == ~0u || offset + size > sm_chunkSize) {
+				m_currentChunk = AcquireChunk();
+				offset = 0u;
+			}
+
+			VlkStagingChunk &chunk = m_chunks[m_currentChunk];
+			chunk.m_offset = offset + size;
+			chunk.m_lastBatch = m_batchNumber;
+			chunk.m_holdCount += held ? 1u : 0u;
+
+			allocation.buffer = chunk.m_vkBuffer;
+			allocation.chunkIndex = m_currentChunk;
+			allocation.offset = offset;
+			allocation.dataP = static_cast<uint8_t *>(chunk.m_mappedP) + offset;
+
+			return allocation;
+		}
+
+		VkCommandBuffer VlkUploadBatcher::GetCommandBuffer() {
+
+			if (m_vkCommandBuffer) {
+				return m_vkCommandBuffer;
+			}
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+			UpdateCompletedBatches();
+
+			if (m_freeCommandBuffers.size()) {
+				m_vkCommandBuffer = m_freeCommandBuffers.back();
+				m_freeCommandBuffers.pop_back();
+				vkResetCommandBuffer(m_vkCommandBuffer, 0);
+			}
+			else {
+				VkCommandBufferAllocateInfo commandBufferInfo = {};
+				commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+				commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+				commandBufferInfo.commandBufferCount = 1u;
+				commandBufferInfo.commandPool = m_vkCommandPool;
+
+				vkAllocateCommandBuffers(deviceP->GetHandle(), &commandBufferInfo, &m_vkCommandBuffer);
+
+				if (!m_vkCommandBuffer) {
+					throw new std::runtime_error("VlkUploadBatcher recording failed - cannot allocate command buffer.");
+				}
+			}
+
+			VkCommandBufferBeginInfo beginInfo = {};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+			vkBeginCommandBuffer(m_vkCommandBuffer, &beginInfo);
+
+			return m_vkCommandBuffer;
+		}
+
+		void VlkUploadBatcher::Flush() {
+
+			if (!m_vkCommandBuffer) {
+				return;
+			}
+
+			VlkDevice *deviceP = VlkRenderContext::GetVlkDevice();
+
+			vkEndCommandBuffer(m_vkCommandBuffer);
+
+			VlkSubmittedBatch batch;
+			batch.m_vkCommandBuffer = m_vkCommandBuffer;
+			batch.m_batchNumber = m_batchNumber;
+			batch.m_timelineValue = deviceP->Submit(VlkDevice::QueueType::GRAPHICS, m_vkCommandBuffer);
+			m_submittedBatches.push_back(batch);
+
+			static_cast<VlkRenderContext *>(VlkRenderContext::Get())->RecordUpload(0u, 1u);
+
+			// Released only now - deferred releases wait for the work submitted before them
+			for (auto &dedicated : m_dedicatedBuffers) {
+				vkUnmapMemory(deviceP->GetHandle(), dedicated.second);
+				ReleaseVkBuffer(dedicated.first, dedicated.second);
+			}
+
+			m_dedicatedBuffers.clear();
+
+			for (auto &release : m_pendingReleases) {
+				deviceP->DeferRelease(std::move(release));
+			}
+
+			m_pendingReleases.clear();
+			m_vkCommandBuffer = VK_NULL_HANDLE;
+			m_batchNumber++;
+		}
+
+		void VlkUploadBatcher::DeferRelease(std::function<void()> release) {
+
+			// Nothing recorded - no copy of the batch can reference the object
+			if (!m_vkCommandBuffer) {
+				VlkRenderContext::GetVlkDevice()->DeferRelease(std::move(release));
+				return;
+			}
+
+			m_pendingReleases.push_back(std::move(release));
+		}
+	}
+}
@@ -0,0 +1,101 @@
+#ifndef VLK_UPLOAD_BATCHER_H_
+#define VLK_UPLOAD_BATCHER_H_
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace PixelMachine {
+	namespace GPU {
+		/* Staging memory handed out for one copy - <dataP> is mapped at <offset> of <buffer> */
+		struct VlkStagingAllocation {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+			void *dataP = nullptr;
+			// Staging chunk holding the memory, ~0u for a buffer of its own
+			uint32_t chunkIndex = ~0u;
+		};
+
+		/// <summary>
+		/// Shared staging path of uploads that must not stall the frame. Copies are recorded into one
+		/// command buffer per batch, sourced from recycled staging chunks, and submitted on the graphics
+		/// queue ahead of the next frame - queue order and the barriers recorded with the copies make
+		/// them visible to every later pass without a CPU wait.
+		/// </summary>
+		class VlkUploadBatcher {
+		public:
+			VlkUploadBatcher();
+			VlkUploadBatcher(const VlkUploadBatcher &) = delete;
+			VlkUploadBatcher &operator=(const VlkUploadBatcher &) = delete;
+			~VlkUploadBatcher();
+
+			/* Mapped staging memory for <size> bytes, valid until the current batch completes. Sizes above a
+			 chunk get a buffer of their own */
+			VlkStagingAllocation Allocate(const VkDeviceSize size, const VkDeviceSize alignment = 16u);
+			/* Mapped staging memory kept out of recycling until Release - for data arriving frames later, such as
+			 file reads landing straight in staging memory */
+			VlkStagingAllocation AllocateHeld(const VkDeviceSize size, const VkDeviceSize alignment = 16u);
+			/* Returns a held allocation - copies from it must be recorded into the current batch, if any */
+			void Release(const VlkStagingAllocation &allocation);
+			/* Command buffer of the current batch, begun on first use */
+			VkCommandBuffer GetCommandBuffer();
+			/* Number of the batch copies are being recorded into */
+			uint64_t GetBatchNumber() const { return m_batchNumber; }
+			/* Non-blocking - true once the GPU has executed batch <batchNumber> */
+			bool IsBatchComplete(const uint64_t batchNumber);
+			/* Submits the current batch - a no-op when nothing was recorded */
+			void Flush();
+			/* Defers <release> until the current batch has executed - for objects its recorded copies reference */
+			void DeferRelease(std::function<void()> release);
+
+			uint64_t GetStagingCapacity() const { return m_chunks.size() * sm_chunkSize; }
+
+		private:
+			struct VlkStagingChunk {
+				VkBuffer m_vkBuffer = VK_NULL_HANDLE;
+				VkDeviceMemory m_vkMemory = VK_NULL_HANDLE;
+				void *m_mappedP = nullptr;
+				VkDeviceSize m_offset = 0;
+				// Latest batch copying from the chunk - reusable once it completes and nothing holds it
+				uint64_t m_lastBatch = 0;
+				uint32_t m_holdCount = 0u;
+			};
+
+			struct VlkSubmittedBatch {
+				VkCommandBuffer m_vkCommandBuffer = VK_NULL_HANDLE;
+				uint64_t m_batchNumber = 0;
+				uint64_t m_timelineValue = 0;
+			};
+
+			/* Chunk whose batches have all completed, a new one when there is none */
+			uint32_t AcquireChunk();
+			VlkStagingAllocation AllocateStaging(const VkDeviceSize size, const VkDeviceSize alignment, const bool held);
+			/* Retires submitted batches the GPU has finished, recycling their command buffers */
+			void UpdateCompletedBatches();
+
+			static constexpr VkDeviceSize sm_chunkSize = 8u << 20u;
+
+			VkCommandPool m_vkCommandPool = VK_NULL_HANDLE;
+			VkCommandBuffer m_vkCommandBuffer = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> m_freeCommandBuffers;
+			std::deque<VlkSubmittedBatch> m_submittedBatches;
+			std::vector<VlkStagingChunk> m_chunks;
+			// Chunk allocations are taken from, ~0u before the first one
+			uint32_t m_currentChunk = ~0u;
+			// Oversized allocations of the current batch, released once it is submitted
+			std::vector<std::pair<VkBuffer, VkDeviceMemory>> m_dedicatedBuffers;
+			// Oversized held allocations, joining the current batch on Release
+			std::vector<std::pair<VkBuffer, VkDeviceMemory>> m_heldBuffers;
+			// Releases handed to the device once the current batch is submitted
+			std::vector<std::function<void()>> m_pendingReleases;
+			uint64_t m_batchNumber = 0;
+			// Batches below this number have completed
+			uint64_t m_completedBatches = 0;
+		};
+	}
+}
+
+#endif // !VLK_UPLOAD_BATCHER_H_